@@ -0,0 +1,790 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <ufo/ufo.h>
+
+#include "core/ufo-ir-method-task.h"
+#include "core/ufo-ir-projector-task.h"
+#include "core/ufo-ir-state-dependent-task.h"
+#include "core/ufo-ir-basic-ops-processor.h"
+#include "core/ufo-ir-profiler.h"
+
+// Benchmark of the ir projector, basic operations and methods on synthetic
+// data. All timings are wall-clock seconds measured around a clFinish, so
+// the tool works with any OpenCL implementation including pocl.
+//
+// With --adjoint the tool instead checks <Ax, y> against <x, A^T y> for every
+// projection model and geometry and exits with a non-zero status if the
+// mismatch or the projector throughput is outside the given thresholds.
+//
+// With --steady-transfers it runs every method on two slices with the
+// profiler and fails if any buffer changed its location after the first
+// iteration of a slice.
+
+typedef struct {
+    UfoResources *resources;
+    UfoPluginManager *manager;
+    UfoGpuNode *node;
+    cl_command_queue cmd_queue;
+    gpointer context;
+    UfoIrBasicOpsProcessor *ops;
+    FILE *out;
+    gboolean first_record;
+} UfoIrBench;
+
+typedef struct {
+    gfloat intensity;
+    gfloat a, b;
+    gfloat x0, y0;
+    gfloat phi;
+} UfoIrBenchEllipse;
+
+// Modified Shepp-Logan phantom (Toft)
+static const UfoIrBenchEllipse shepp_logan[] = {
+    { 1.0f, 0.6900f, 0.9200f,  0.00f,  0.0000f,   0.0f},
+    {-0.8f, 0.6624f, 0.8740f,  0.00f, -0.0184f,   0.0f},
+    {-0.2f, 0.1100f, 0.3100f,  0.22f,  0.0000f, -18.0f},
+    {-0.2f, 0.1600f, 0.4100f, -0.22f,  0.0000f,  18.0f},
+    { 0.1f, 0.2100f, 0.2500f,  0.00f,  0.3500f,   0.0f},
+    { 0.1f, 0.0460f, 0.0460f,  0.00f,  0.1000f,   0.0f},
+    { 0.1f, 0.0460f, 0.0460f,  0.00f, -0.1000f,   0.0f},
+    { 0.1f, 0.0460f, 0.0230f, -0.08f, -0.6050f,   0.0f},
+    { 0.1f, 0.0230f, 0.0230f,  0.00f, -0.6060f,   0.0f},
+    { 0.1f, 0.0230f, 0.0460f,  0.06f, -0.6050f,   0.0f},
+};
+
+#define N_RANDOM_ELLIPSES 12
+
+static gchar *opt_sizes = NULL;
+static gchar *opt_angles = NULL;
+static gchar *opt_methods = NULL;
+static gchar *opt_phantom = NULL;
+static gchar *opt_output = NULL;
+static gint opt_iterations = 10;
+static gint opt_inner_iterations = 10;
+static gint opt_repeats = 5;
+static gint opt_seed = 1;
+static gboolean opt_adjoint = FALSE;
+static gchar *opt_models = NULL;
+static gdouble opt_max_adjoint_error = -1.0;
+static gdouble opt_min_rays_per_second = 0.0;
+static gdouble opt_min_voxel_updates_per_second = 0.0;
+static gboolean opt_steady_transfers = FALSE;
+
+static GOptionEntry entries[] = {
+    { "sizes", 's', 0, G_OPTION_ARG_STRING, &opt_sizes, "Comma separated volume sizes (default 128,256,512)", "LIST" },
+    { "angles", 'a', 0, G_OPTION_ARG_STRING, &opt_angles, "Comma separated numbers of projections (default 90,180)", "LIST" },
+    { "methods", 'm', 0, G_OPTION_ARG_STRING, &opt_methods, "Comma separated methods (default sirt,sart,asdpocs,sbtv)", "LIST" },
+    { "phantom", 'p', 0, G_OPTION_ARG_STRING, &opt_phantom, "shepp-logan or ellipses (default shepp-logan)", "NAME" },
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &opt_iterations, "Iterations per method (default 10)", "N" },
+    { "inner-iterations", 0, 0, G_OPTION_ARG_INT, &opt_inner_iterations, "Iterations of the ASD-POCS df_minimizer (default 10)", "N" },
+    { "repeats", 'r', 0, G_OPTION_ARG_INT, &opt_repeats, "Repetitions of projector and basic op timings (default 5)", "N" },
+    { "seed", 0, 0, G_OPTION_ARG_INT, &opt_seed, "Seed of the random ellipses phantom (default 1)", "N" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &opt_output, "JSON output file (default stdout)", "FILE" },
+    { "adjoint", 0, 0, G_OPTION_ARG_NONE, &opt_adjoint, "Check projector adjointness and throughput instead of benchmarking", NULL },
+    { "models", 0, 0, G_OPTION_ARG_STRING, &opt_models, "Comma separated projection models to check (default joseph)", "LIST" },
+    { "max-adjoint-error", 0, 0, G_OPTION_ARG_DOUBLE, &opt_max_adjoint_error, "Largest accepted relative adjoint mismatch (default per model)", "E" },
+    { "min-rays-per-second", 0, 0, G_OPTION_ARG_DOUBLE, &opt_min_rays_per_second, "Smallest accepted forward projection throughput (default 0, unchecked)", "R" },
+    { "min-voxel-updates-per-second", 0, 0, G_OPTION_ARG_DOUBLE, &opt_min_voxel_updates_per_second, "Smallest accepted backprojection throughput (default 0, unchecked)", "R" },
+    { "steady-transfers", 0, 0, G_OPTION_ARG_NONE, &opt_steady_transfers, "Check that methods move no data after the first iteration of a slice", NULL },
+    { NULL }
+};
+
+static guint *
+parse_list (const gchar *str, guint *n_values)
+{
+    gchar **parts = g_strsplit (str, ",", -1);
+    guint n = g_strv_length (parts);
+    guint *values = g_new0 (guint, n);
+
+    *n_values = 0;
+
+    for (guint i = 0; i < n; i++) {
+        guint value = (guint) g_ascii_strtoull (g_strstrip (parts[i]), NULL, 10);
+
+        if (value > 0)
+            values[(*n_values)++] = value;
+    }
+
+    g_strfreev (parts);
+    return values;
+}
+
+static void
+rasterize_ellipses (gfloat *data,
+                    guint size,
+                    const UfoIrBenchEllipse *ellipses,
+                    guint n_ellipses)
+{
+    memset (data, 0, sizeof (gfloat) * size * size);
+
+    for (guint e = 0; e < n_ellipses; e++) {
+        const UfoIrBenchEllipse *el = &ellipses[e];
+        gdouble phi = el->phi * G_PI / 180.0;
+        gdouble c = cos (phi);
+        gdouble s = sin (phi);
+
+        for (guint j = 0; j < size; j++) {
+            gdouble y = 1.0 - (2.0 * j + 1.0) / size;
+
+            for (guint i = 0; i < size; i++) {
+                gdouble x = (2.0 * i + 1.0) / size - 1.0;
+                gdouble xr = (x - el->x0) * c + (y - el->y0) * s;
+                gdouble yr = (y - el->y0) * c - (x - el->x0) * s;
+
+                if ((xr * xr) / (el->a * el->a) + (yr * yr) / (el->b * el->b) <= 1.0)
+                    data[j * size + i] += el->intensity;
+            }
+        }
+    }
+}
+
+static UfoBuffer *
+create_phantom (UfoIrBench *bench, guint size)
+{
+    UfoRequisition req = {.n_dims = 2, .dims = {size, size}};
+    UfoBuffer *phantom = ufo_buffer_new (&req, bench->context);
+    gfloat *data = ufo_buffer_get_host_array (phantom, NULL);
+
+    if (!g_strcmp0 (opt_phantom, "ellipses")) {
+        UfoIrBenchEllipse ellipses[N_RANDOM_ELLIPSES];
+        GRand *rand = g_rand_new_with_seed ((guint32) opt_seed);
+
+        for (guint i = 0; i < N_RANDOM_ELLIPSES; i++) {
+            ellipses[i].intensity = g_rand_double_range (rand, 0.1, 1.0);
+            ellipses[i].a = g_rand_double_range (rand, 0.05, 0.4);
+            ellipses[i].b = g_rand_double_range (rand, 0.05, 0.4);
+            ellipses[i].x0 = g_rand_double_range (rand, -0.5, 0.5);
+            ellipses[i].y0 = g_rand_double_range (rand, -0.5, 0.5);
+            ellipses[i].phi = g_rand_double_range (rand, 0.0, 180.0);
+        }
+
+        rasterize_ellipses (data, size, ellipses, N_RANDOM_ELLIPSES);
+        g_rand_free (rand);
+    }
+    else {
+        rasterize_ellipses (data, size, shepp_logan, G_N_ELEMENTS (shepp_logan));
+    }
+
+    return phantom;
+}
+
+static UfoIrProjectorTask *
+create_projector (UfoIrBench *bench, guint n_angles, gboolean is_forward, GError **error)
+{
+    UfoIrProjectorTask *projector;
+
+    projector = UFO_IR_PROJECTOR_TASK (ufo_plugin_manager_get_task_from_package (bench->manager, "ir", "parallel-projector", error));
+
+    if (projector == NULL)
+        return NULL;
+
+    g_object_set (projector, "angles_num", n_angles, NULL);
+    ufo_ir_projector_task_set_step (projector, G_PI / n_angles);
+    ufo_ir_state_dependent_task_set_is_forward (UFO_IR_STATE_DEPENDENT_TASK (projector), is_forward);
+    ufo_task_node_set_proc_node (UFO_TASK_NODE (projector), UFO_NODE (bench->node));
+
+    return projector;
+}
+
+static void
+write_record (UfoIrBench *bench,
+              guint size,
+              guint n_angles,
+              const gchar *kind,
+              const gchar *name,
+              guint iterations,
+              gdouble seconds,
+              gdouble rmse)
+{
+    fprintf (bench->out, "%s\n    {\"size\": %u, \"angles\": %u, \"kind\": \"%s\", \"name\": \"%s\", "
+                         "\"iterations\": %u, \"seconds\": %e, \"seconds_per_iteration\": %e",
+             bench->first_record ? "" : ",",
+             size, n_angles, kind, name, iterations, seconds, seconds / MAX (iterations, 1));
+
+    if (rmse >= 0.0)
+        fprintf (bench->out, ", \"rmse\": %e", rmse);
+
+    fprintf (bench->out, "}");
+    bench->first_record = FALSE;
+}
+
+static gdouble
+compute_rmse (UfoIrBench *bench, UfoBuffer *a, UfoBuffer *b)
+{
+    gsize n = ufo_buffer_get_size (a) / sizeof (gfloat);
+    gfloat *x = ufo_buffer_get_host_array (a, bench->cmd_queue);
+    gfloat *y = ufo_buffer_get_host_array (b, bench->cmd_queue);
+    gdouble sum = 0.0;
+
+    for (gsize i = 0; i < n; i++)
+        sum += (x[i] - y[i]) * (x[i] - y[i]);
+
+    return sqrt (sum / n);
+}
+
+static void
+fill_random (UfoIrBench *bench, UfoBuffer *buffer, GRand *rand)
+{
+    gsize n = ufo_buffer_get_size (buffer) / sizeof (gfloat);
+    gfloat *data = ufo_buffer_get_host_array (buffer, bench->cmd_queue);
+
+    for (gsize i = 0; i < n; i++)
+        data[i] = (gfloat) g_rand_double_range (rand, 0.0, 1.0);
+}
+
+static gdouble
+host_dot (UfoIrBench *bench, UfoBuffer *a, UfoBuffer *b)
+{
+    gsize n = ufo_buffer_get_size (a) / sizeof (gfloat);
+    gfloat *x = ufo_buffer_get_host_array (a, bench->cmd_queue);
+    gfloat *y = ufo_buffer_get_host_array (b, bench->cmd_queue);
+    gdouble sum = 0.0;
+
+    // Accumulate in double, the float reduction error would otherwise hide
+    // small mismatches on large geometries
+    for (gsize i = 0; i < n; i++)
+        sum += (gdouble) x[i] * y[i];
+
+    return sum;
+}
+
+// The pixel-driven joseph backprojection is not the transpose of its
+// forward projection and differs by about 18 % on random data, models with
+// an exact transpose only differ by rounding
+#define EXACT_ADJOINT_ERROR 1e-3
+#define JOSEPH_ADJOINT_ERROR 0.25
+
+static gdouble
+adjoint_tolerance (const gchar *model)
+{
+    if (opt_max_adjoint_error >= 0.0)
+        return opt_max_adjoint_error;
+
+    return g_strcmp0 (model, "joseph") ? EXACT_ADJOINT_ERROR : JOSEPH_ADJOINT_ERROR;
+}
+
+static gboolean
+check_adjoint (UfoIrBench *bench,
+               const gchar *model,
+               guint size,
+               guint n_angles,
+               GError **error)
+{
+    UfoIrProjectorTask *projector = create_projector (bench, n_angles, TRUE, error);
+    UfoRequisition volume_req = {.n_dims = 2, .dims = {size, size}};
+    UfoRequisition sino_req;
+
+    if (projector == NULL)
+        return FALSE;
+
+    g_object_set (projector, "model", model, NULL);
+    ufo_ir_projector_task_set_relaxation (projector, 1.0f);
+    ufo_ir_projector_task_set_correction_scale (projector, 1.0f);
+    ufo_task_setup (UFO_TASK (projector), bench->resources, error);
+
+    if (*error != NULL) {
+        g_object_unref (projector);
+        return FALSE;
+    }
+
+    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK (projector);
+    UfoBuffer *x = ufo_buffer_new (&volume_req, bench->context);
+    ufo_task_get_requisition (UFO_TASK (projector), &x, &sino_req, error);
+
+    if (*error != NULL) {
+        g_object_unref (x);
+        g_object_unref (projector);
+        return FALSE;
+    }
+
+    UfoBuffer *y = ufo_buffer_new (&sino_req, bench->context);
+    UfoBuffer *ax = ufo_buffer_new (&sino_req, bench->context);
+    UfoBuffer *aty = ufo_buffer_new (&volume_req, bench->context);
+    GRand *rand = g_rand_new_with_seed ((guint32) opt_seed);
+    GTimer *timer = g_timer_new ();
+
+    fill_random (bench, x, rand);
+    fill_random (bench, y, rand);
+
+    // Both directions accumulate into their output
+    ufo_ir_basic_ops_processor_set (bench->ops, ax, 0.0f);
+    ufo_ir_basic_ops_processor_set (bench->ops, aty, 0.0f);
+    ufo_ir_state_dependent_task_forward (sdprojector, &x, ax, &sino_req);
+    ufo_ir_state_dependent_task_backward (sdprojector, &y, aty, &volume_req);
+    clFinish (bench->cmd_queue);
+
+    gdouble ax_y = host_dot (bench, ax, y);
+    gdouble x_aty = host_dot (bench, x, aty);
+    gdouble scale = MAX (fabs (ax_y), fabs (x_aty));
+    gdouble mismatch = scale > 0.0 ? fabs (ax_y - x_aty) / scale : 0.0;
+
+    g_timer_start (timer);
+    for (gint i = 0; i < opt_repeats; i++)
+        ufo_ir_state_dependent_task_forward (sdprojector, &x, ax, &sino_req);
+    clFinish (bench->cmd_queue);
+    gdouble rays = (gdouble) sino_req.dims[0] * sino_req.dims[1] * opt_repeats / g_timer_elapsed (timer, NULL);
+
+    g_timer_start (timer);
+    for (gint i = 0; i < opt_repeats; i++)
+        ufo_ir_state_dependent_task_backward (sdprojector, &y, aty, &volume_req);
+    clFinish (bench->cmd_queue);
+    gdouble updates = (gdouble) size * size * n_angles * opt_repeats / g_timer_elapsed (timer, NULL);
+
+    gdouble tolerance = adjoint_tolerance (model);
+    gboolean passed = mismatch <= tolerance &&
+                      rays >= opt_min_rays_per_second &&
+                      updates >= opt_min_voxel_updates_per_second;
+
+    fprintf (bench->out, "%s\n    {\"size\": %u, \"angles\": %u, \"kind\": \"adjoint\", \"name\": \"%s\", "
+                         "\"ax_y\": %.12e, \"x_aty\": %.12e, \"relative_error\": %e, \"tolerance\": %e, "
+                         "\"rays_per_second\": %e, \"voxel_updates_per_second\": %e, \"passed\": %s}",
+             bench->first_record ? "" : ",",
+             size, n_angles, model, ax_y, x_aty, mismatch, tolerance, rays, updates, passed ? "true" : "false");
+    bench->first_record = FALSE;
+
+    if (!passed)
+        g_printerr ("%s %ux%u, %u angles: adjoint error %e, %e rays/s, %e voxel updates/s\n",
+                    model, size, size, n_angles, mismatch, rays, updates);
+
+    g_timer_destroy (timer);
+    g_rand_free (rand);
+    g_object_unref (aty);
+    g_object_unref (ax);
+    g_object_unref (y);
+    g_object_unref (x);
+    g_object_unref (projector);
+    return passed;
+}
+
+static void
+bench_projector (UfoIrBench *bench,
+                 UfoIrProjectorTask *projector,
+                 UfoBuffer *volume,
+                 UfoBuffer *sinogram,
+                 guint size,
+                 guint n_angles)
+{
+    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK (projector);
+    UfoRequisition volume_req, sino_req;
+    GTimer *timer = g_timer_new ();
+
+    ufo_buffer_get_requisition (volume, &volume_req);
+    ufo_buffer_get_requisition (sinogram, &sino_req);
+
+    UfoBuffer *sino_tmp = ufo_buffer_dup (sinogram);
+    UfoBuffer *volume_tmp = ufo_buffer_dup (volume);
+
+    // Warm up, the first launches include kernel and image setup
+    ufo_ir_state_dependent_task_forward (sdprojector, &volume, sino_tmp, &sino_req);
+    ufo_ir_state_dependent_task_backward (sdprojector, &sinogram, volume_tmp, &volume_req);
+    clFinish (bench->cmd_queue);
+
+    g_timer_start (timer);
+    for (gint i = 0; i < opt_repeats; i++)
+        ufo_ir_state_dependent_task_forward (sdprojector, &volume, sino_tmp, &sino_req);
+    clFinish (bench->cmd_queue);
+    write_record (bench, size, n_angles, "projector", "fp", opt_repeats, g_timer_elapsed (timer, NULL), -1.0);
+
+    g_timer_start (timer);
+    for (gint i = 0; i < opt_repeats; i++)
+        ufo_ir_state_dependent_task_backward (sdprojector, &sinogram, volume_tmp, &volume_req);
+    clFinish (bench->cmd_queue);
+    write_record (bench, size, n_angles, "projector", "bp", opt_repeats, g_timer_elapsed (timer, NULL), -1.0);
+
+    g_object_unref (sino_tmp);
+    g_object_unref (volume_tmp);
+    g_timer_destroy (timer);
+}
+
+static void
+bench_basic_ops (UfoIrBench *bench, UfoBuffer *volume, guint size)
+{
+    UfoIrBasicOpsProcessor *ops = bench->ops;
+    UfoBuffer *a = ufo_buffer_dup (volume);
+    UfoBuffer *b = ufo_buffer_dup (volume);
+    UfoBuffer *c = ufo_buffer_dup (volume);
+    GTimer *timer = g_timer_new ();
+    volatile gfloat sink = 0.0f;
+
+    ufo_buffer_copy (volume, a);
+    ufo_buffer_copy (volume, b);
+    ufo_ir_basic_ops_processor_set (ops, c, 0.0f);
+    clFinish (bench->cmd_queue);
+
+#define BENCH_OP(name, call) \
+    g_timer_start (timer); \
+    for (gint i = 0; i < opt_repeats; i++) { call; } \
+    clFinish (bench->cmd_queue); \
+    write_record (bench, size, 0, "basic_op", name, opt_repeats, g_timer_elapsed (timer, NULL), -1.0);
+
+    BENCH_OP ("set", ufo_ir_basic_ops_processor_set (ops, c, 1.0f));
+    BENCH_OP ("add", ufo_ir_basic_ops_processor_add (ops, a, b, c));
+    BENCH_OP ("add2", ufo_ir_basic_ops_processor_add2 (ops, a, b, 0.5f, c));
+    BENCH_OP ("deduction", ufo_ir_basic_ops_processor_deduction (ops, a, b, c));
+    BENCH_OP ("deduction2", ufo_ir_basic_ops_processor_deduction2 (ops, a, b, 0.5f, c));
+    BENCH_OP ("mul", ufo_ir_basic_ops_processor_mul (ops, a, b, c));
+    BENCH_OP ("mul_scalar", ufo_ir_basic_ops_processor_mul_scalar (ops, c, 1.0f));
+    BENCH_OP ("inv", ufo_ir_basic_ops_processor_inv (ops, c));
+    BENCH_OP ("positive_constraint", ufo_ir_basic_ops_processor_positive_constraint (ops, a, c));
+    BENCH_OP ("l1_norm", sink += ufo_ir_basic_ops_processor_l1_norm (ops, a));
+    BENCH_OP ("l2_norm", sink += ufo_ir_basic_ops_processor_l2_norm (ops, a));
+    BENCH_OP ("dot_product", sink += ufo_ir_basic_ops_processor_dot_product (ops, a, b));
+
+#undef BENCH_OP
+
+    (void) sink;
+    g_object_unref (a);
+    g_object_unref (b);
+    g_object_unref (c);
+    g_timer_destroy (timer);
+}
+
+static UfoIrMethodTask *
+create_method (UfoIrBench *bench, const gchar *name, guint n_angles, GError **error)
+{
+    UfoIrMethodTask *method;
+    UfoIrProjectorTask *projector;
+
+    method = UFO_IR_METHOD_TASK (ufo_plugin_manager_get_task_from_package (bench->manager, "ir", name, error));
+
+    if (method == NULL)
+        return NULL;
+
+    projector = create_projector (bench, n_angles, FALSE, error);
+
+    if (projector == NULL) {
+        g_object_unref (method);
+        return NULL;
+    }
+
+    ufo_ir_method_task_set_projector (method, projector);
+    g_object_unref (projector);
+    ufo_ir_method_task_set_iterations_number (method, (guint) opt_iterations);
+
+    if (!g_strcmp0 (name, "asdpocs")) {
+        UfoIrMethodTask *df_minimizer;
+
+        df_minimizer = UFO_IR_METHOD_TASK (ufo_plugin_manager_get_task_from_package (bench->manager, "ir", "sart", error));
+
+        if (df_minimizer == NULL) {
+            g_object_unref (method);
+            return NULL;
+        }
+
+        ufo_ir_method_task_set_iterations_number (df_minimizer, (guint) opt_inner_iterations);
+        g_object_set (method, "df_minimizer", df_minimizer, NULL);
+        g_object_unref (df_minimizer);
+    }
+
+    ufo_task_node_set_proc_node (UFO_TASK_NODE (method), UFO_NODE (bench->node));
+    ufo_task_setup (UFO_TASK (method), bench->resources, error);
+
+    if (error != NULL && *error != NULL) {
+        g_object_unref (method);
+        return NULL;
+    }
+
+    return method;
+}
+
+static gboolean
+bench_method (UfoIrBench *bench,
+              const gchar *name,
+              UfoBuffer *phantom,
+              UfoBuffer *sinogram,
+              guint size,
+              guint n_angles,
+              GError **error)
+{
+    UfoIrMethodTask *method = create_method (bench, name, n_angles, error);
+    UfoRequisition volume_req;
+
+    if (method == NULL)
+        return FALSE;
+
+    ufo_task_get_requisition (UFO_TASK (method), &sinogram, &volume_req, error);
+
+    if (error != NULL && *error != NULL) {
+        g_object_unref (method);
+        return FALSE;
+    }
+
+    UfoBuffer *volume = ufo_buffer_new (&volume_req, bench->context);
+    GTimer *timer = g_timer_new ();
+
+    ufo_task_process (UFO_TASK (method), &sinogram, volume, &volume_req);
+    clFinish (bench->cmd_queue);
+    gdouble elapsed = g_timer_elapsed (timer, NULL);
+
+    write_record (bench, size, n_angles, "method", name, (guint) opt_iterations, elapsed,
+                  compute_rmse (bench, volume, phantom));
+
+    g_timer_destroy (timer);
+    g_object_unref (volume);
+    g_object_unref (method);
+    return TRUE;
+}
+
+// The second slice catches transfers of its setup that were counted against
+// the last iteration of the first one
+static gboolean
+check_steady_transfers (UfoIrBench *bench,
+                        const gchar *name,
+                        UfoBuffer *sinogram,
+                        guint size,
+                        guint n_angles,
+                        GError **error)
+{
+    UfoIrMethodTask *method;
+    UfoRequisition volume_req;
+
+    ufo_ir_profiler_acquire ("ufo-ir-bench");
+    method = create_method (bench, name, n_angles, error);
+
+    if (method == NULL) {
+        ufo_ir_profiler_release ();
+        return FALSE;
+    }
+
+    ufo_task_get_requisition (UFO_TASK (method), &sinogram, &volume_req, error);
+
+    if (*error != NULL) {
+        g_object_unref (method);
+        ufo_ir_profiler_release ();
+        return FALSE;
+    }
+
+    UfoBuffer *volume = ufo_buffer_new (&volume_req, bench->context);
+
+    for (guint slice = 0; slice < 2; slice++)
+        ufo_task_process (UFO_TASK (method), &sinogram, volume, &volume_req);
+
+    clFinish (bench->cmd_queue);
+
+    guint64 steady = ufo_ir_profiler_get_steady_transfers ();
+    gboolean passed = steady == 0;
+
+    fprintf (bench->out, "%s\n    {\"size\": %u, \"angles\": %u, \"kind\": \"steady-transfers\", \"name\": \"%s\", "
+                         "\"iterations\": %u, \"slices\": 2, \"steady_transfers\": %" G_GUINT64_FORMAT ", \"passed\": %s}",
+             bench->first_record ? "" : ",",
+             size, n_angles, name, (guint) opt_iterations, steady, passed ? "true" : "false");
+    bench->first_record = FALSE;
+
+    if (!passed)
+        g_printerr ("%s %ux%u, %u angles: %" G_GUINT64_FORMAT " transfers after the first iteration of a slice\n",
+                    name, size, size, n_angles, steady);
+
+    g_object_unref (volume);
+    g_object_unref (method);
+    ufo_ir_profiler_release ();
+    return passed;
+}
+
+static gboolean
+bench_geometry (UfoIrBench *bench,
+                guint size,
+                guint n_angles,
+                gchar **methods,
+                guint *n_failed,
+                GError **error)
+{
+    UfoBuffer *phantom = create_phantom (bench, size);
+    UfoRequisition sino_req;
+
+    // Simulate the measurements with a projector in forward mode
+    UfoIrProjectorTask *simulator = create_projector (bench, n_angles, TRUE, error);
+
+    if (simulator == NULL) {
+        g_object_unref (phantom);
+        return FALSE;
+    }
+
+    ufo_task_setup (UFO_TASK (simulator), bench->resources, error);
+
+    if (*error != NULL) {
+        g_object_unref (simulator);
+        g_object_unref (phantom);
+        return FALSE;
+    }
+
+    ufo_task_get_requisition (UFO_TASK (simulator), &phantom, &sino_req, error);
+    UfoBuffer *sinogram = ufo_buffer_new (&sino_req, bench->context);
+    ufo_task_process (UFO_TASK (simulator), &phantom, sinogram, &sino_req);
+    clFinish (bench->cmd_queue);
+
+    if (opt_steady_transfers) {
+        for (guint i = 0; methods[i] != NULL && *error == NULL; i++) {
+            if (!check_steady_transfers (bench, g_strstrip (methods[i]), sinogram, size, n_angles, error))
+                (*n_failed)++;
+        }
+    }
+    else {
+        bench_projector (bench, simulator, phantom, sinogram, size, n_angles);
+
+        for (guint i = 0; methods[i] != NULL && *error == NULL; i++)
+            bench_method (bench, g_strstrip (methods[i]), phantom, sinogram, size, n_angles, error);
+    }
+
+    g_object_unref (sinogram);
+    g_object_unref (simulator);
+    g_object_unref (phantom);
+
+    return *error == NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+    GOptionContext *option_context;
+    GError *error = NULL;
+    UfoIrBench bench = {0};
+    guint n_failed = 0;
+
+#if !(GLIB_CHECK_VERSION (2, 36, 0))
+    g_type_init ();
+#endif
+
+    option_context = g_option_context_new ("- benchmark ufo-ir projectors and methods");
+    g_option_context_set_summary (option_context,
+                                  "Use UFO_DEVICE_TYPE=cpu to run on a CPU OpenCL platform such as pocl.\n"
+                                  "UFO_PLUGIN_PATH must point to the installed ir plugins.");
+    g_option_context_add_main_entries (option_context, entries, NULL);
+
+    if (!g_option_context_parse (option_context, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        return 1;
+    }
+
+    g_option_context_free (option_context);
+
+    guint n_sizes, n_angles;
+    guint *sizes = parse_list (opt_sizes != NULL ? opt_sizes : "128,256,512", &n_sizes);
+    guint *angles = parse_list (opt_angles != NULL ? opt_angles : "90,180", &n_angles);
+    gchar **methods = g_strsplit (opt_methods != NULL ? opt_methods : "sirt,sart,asdpocs,sbtv", ",", -1);
+
+    bench.resources = ufo_resources_new (&error);
+
+    if (bench.resources == NULL) {
+        g_printerr ("Could not initialize OpenCL: %s\n", error->message);
+        return 1;
+    }
+
+#ifdef UFO_IR_KERNEL_DIR
+    ufo_resources_add_path (bench.resources, UFO_IR_KERNEL_DIR);
+#endif
+
+    GList *nodes = ufo_resources_get_gpu_nodes (bench.resources);
+
+    if (nodes == NULL) {
+        g_printerr ("No OpenCL device found\n");
+        return 1;
+    }
+
+    bench.node = UFO_GPU_NODE (nodes->data);
+    bench.cmd_queue = ufo_gpu_node_get_cmd_queue (bench.node);
+    bench.context = ufo_resources_get_context (bench.resources);
+    bench.manager = ufo_plugin_manager_new ();
+    bench.ops = ufo_ir_basic_ops_processor_new (bench.resources, bench.cmd_queue);
+    bench.out = opt_output != NULL ? fopen (opt_output, "w") : stdout;
+    bench.first_record = TRUE;
+
+    if (bench.out == NULL) {
+        g_printerr ("Could not open `%s' for writing\n", opt_output);
+        return 1;
+    }
+
+    gchar device_name[256] = "unknown";
+    cl_device_id device;
+
+    if (clGetCommandQueueInfo (bench.cmd_queue, CL_QUEUE_DEVICE, sizeof (device), &device, NULL) == CL_SUCCESS)
+        clGetDeviceInfo (device, CL_DEVICE_NAME, sizeof (device_name), device_name, NULL);
+
+    fprintf (bench.out, "{\n  \"device\": \"%s\",\n  \"phantom\": \"%s\",\n  \"results\": [",
+             g_strstrip (device_name), opt_phantom != NULL ? opt_phantom : "shepp-logan");
+
+    if (opt_adjoint) {
+        gchar **models = g_strsplit (opt_models != NULL ? opt_models : "joseph", ",", -1);
+
+        // Say so when a model is held to the loose tolerance
+        for (guint m = 0; models[m] != NULL; m++) {
+            if (adjoint_tolerance (g_strstrip (models[m])) > EXACT_ADJOINT_ERROR)
+                g_printerr ("%s: accepting adjoint errors up to %g, the backprojection is not the exact transpose\n",
+                            models[m], adjoint_tolerance (models[m]));
+        }
+
+        for (guint m = 0; models[m] != NULL && error == NULL; m++) {
+            for (guint s = 0; s < n_sizes && error == NULL; s++) {
+                for (guint a = 0; a < n_angles && error == NULL; a++) {
+                    if (!check_adjoint (&bench, g_strstrip (models[m]), sizes[s], angles[a], &error))
+                        n_failed++;
+                }
+            }
+        }
+
+        g_strfreev (models);
+    }
+    else {
+        for (guint s = 0; s < n_sizes && error == NULL; s++) {
+            if (!opt_steady_transfers) {
+                UfoBuffer *volume = create_phantom (&bench, sizes[s]);
+                bench_basic_ops (&bench, volume, sizes[s]);
+                g_object_unref (volume);
+            }
+
+            for (guint a = 0; a < n_angles && error == NULL; a++)
+                bench_geometry (&bench, sizes[s], angles[a], methods, &n_failed, &error);
+        }
+    }
+
+    fprintf (bench.out, "\n  ]\n}\n");
+
+    if (bench.out != stdout)
+        fclose (bench.out);
+
+    g_strfreev (methods);
+    g_free (sizes);
+    g_free (angles);
+    g_object_unref (bench.ops);
+    g_object_unref (bench.manager);
+    g_list_free_full (nodes, g_object_unref);
+    g_object_unref (bench.resources);
+
+    if (error != NULL) {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+        return 1;
+    }
+
+    if (n_failed > 0) {
+        g_printerr ("%u checks failed\n", n_failed);
+        return 1;
+    }
+
+    return 0;
+}
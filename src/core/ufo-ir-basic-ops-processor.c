@@ -19,18 +19,32 @@
 
 #include <math.h>
 #include "ufo-ir-basic-ops-processor.h"
+#include "ufo-ir-profiler.h"
+#include "ufo-ir-host-ops.h"
+#include "ufo-ir-device.h"
+#include "ufo-ir-exec.h"
 #define OPS_FILENAME "ufo-ir-basic-ops.cl"
+#define BUFFER_OPS_FILENAME "ufo-ir-basic-ops-buffer.cl"
+
+// Launch configuration of the dot product reduction
+#define REDUCTION_GROUP_SIZE 128
+#define REDUCTION_NUM_GROUPS 64
 
 static cl_event operation (UfoBuffer *arg1, UfoBuffer *arg2, UfoBuffer *out, gpointer command_queue, gpointer kernel);
 static cl_event operation2 (UfoBuffer *arg1, UfoBuffer *arg2, gfloat modifier, UfoBuffer *out, gpointer command_queue, gpointer kernel);
-static gpointer kernel_from_name(UfoResources *resources, const gchar* name);
+static gpointer kernel_from_name(UfoResources *resources, const gchar *filename, const gchar* name);
 static void ufo_ir_basic_obs_processor_resources_init(UfoIrBasicOpsProcessor *self, UfoResources *resources, cl_command_queue cmd_queue);
 static void ufo_ir_basic_ops_processor_finalize (GObject *object);
-static void twoAraysIterator(UfoIrBasicOpsProcessor *self, UfoBuffer *arg1, UfoBuffer *arg2, UfoBuffer *output, void (*proc_fn)(const float *, const float *, float *));
 
-static void elementsMulOperation(const float *in1,const float *in2, float *outVal);
-static void elementsMaxOperation(const float *in1,const float *in2, float *outVal);
-static void elementsDivOperation(const float *in1,const float *in2, float *outVal);
+typedef enum {
+    HOST_ADD,
+    HOST_MUL,
+    HOST_DIV,
+    HOST_MAX
+} HostOperation;
+
+static gpointer host_operation (UfoIrBasicOpsProcessor *self, UfoBuffer *arg1, UfoBuffer *arg2, gfloat modifier, UfoBuffer *output, HostOperation op);
+static void twoAraysIterator(UfoIrBasicOpsProcessor *self, UfoBuffer *arg1, UfoBuffer *arg2, UfoBuffer *output, HostOperation op);
 
 struct _UfoIrBasicOpsProcessorPrivate {
     gpointer add_kernel;
@@ -40,9 +54,27 @@ struct _UfoIrBasicOpsProcessorPrivate {
     gpointer inv_kernel;
     gpointer mul_kernel;
     gpointer mul_rows_kernel;
+    gpointer mul_scalar_kernel;
+    gpointer dot_kernel;
     gpointer pc_kernel;
     gpointer set_kernel;
 
+    // Vectorized kernels on plain buffers
+    gpointer buffer_add_kernel;
+    gpointer buffer_mul_kernel;
+    gpointer buffer_div_kernel;
+    gpointer buffer_max_kernel;
+    gpointer buffer_sqrt_kernel;
+    gpointer buffer_scale_kernel;
+    gpointer buffer_set_kernel;
+    gpointer buffer_inv_kernel;
+    gpointer buffer_positive_kernel;
+    gpointer buffer_dot_kernel;
+    gboolean prefer_buffers;
+
+    // Per work-group results of the dot product reduction
+    cl_mem partial_sums;
+
     // Useful things
     UfoResources *resources;
     cl_command_queue command_queue;
@@ -79,6 +111,84 @@ num_elements (UfoRequisition *requisition)
     return num;
 }
 
+// Buffers whose data is already on the host are processed there instead of
+// being uploaded for a single kernel. NULL buffers are ignored.
+static gboolean
+on_host (UfoBuffer *buffer1, UfoBuffer *buffer2, UfoBuffer *buffer3)
+{
+    UfoBuffer *buffers[] = { buffer1, buffer2, buffer3 };
+
+    for (guint i = 0; i < G_N_ELEMENTS (buffers); i++) {
+        if (buffers[i] != NULL && ufo_buffer_get_location (buffers[i]) != UFO_BUFFER_LOCATION_HOST)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static guint
+buffer_length (UfoBuffer *buffer)
+{
+    UfoRequisition requisition;
+
+    ufo_buffer_get_requisition (buffer, &requisition);
+    return num_elements (&requisition);
+}
+
+// Image kernels only run on devices with native images and when some of the
+// data already is an image. Otherwise the buffer kernels avoid converting
+// the buffers between images and arrays.
+static gboolean
+use_images (UfoIrBasicOpsProcessorPrivate *priv, UfoBuffer *buffer1, UfoBuffer *buffer2, UfoBuffer *buffer3)
+{
+    UfoBuffer *buffers[] = { buffer1, buffer2, buffer3 };
+
+    if (priv->prefer_buffers)
+        return FALSE;
+
+    for (guint i = 0; i < G_N_ELEMENTS (buffers); i++) {
+        if (buffers[i] != NULL && ufo_buffer_get_location (buffers[i]) == UFO_BUFFER_LOCATION_DEVICE_IMAGE)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+// Runs one of the ELEMENT_WISE kernels on the elements [first, first + n).
+// A missing arg2 is replaced by arg1.
+static cl_event
+buffer_operation (UfoIrBasicOpsProcessorPrivate *priv,
+                  gpointer kernel,
+                  UfoBuffer *arg1,
+                  UfoBuffer *arg2,
+                  gfloat modifier,
+                  UfoBuffer *out,
+                  guint first,
+                  guint n)
+{
+    cl_event event;
+    gsize global_work_size = (n + 3) / 4;
+
+    if (n == 0)
+        return NULL;
+
+    cl_mem d_arg1 = ufo_ir_profiler_get_device_array (arg1, priv->command_queue);
+    cl_mem d_arg2 = arg2 != NULL ? ufo_ir_profiler_get_device_array (arg2, priv->command_queue) : d_arg1;
+    cl_mem d_out = ufo_ir_profiler_get_device_array (out, priv->command_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(cl_mem), (void *) &d_arg1));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(cl_mem), (void *) &d_arg2));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(gfloat), (void *) &modifier));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof(cl_mem), (void *) &d_out));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof(guint), (void *) &first));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 5, sizeof(guint), (void *) &n));
+
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, kernel,
+                                                        1, &global_work_size, NULL, &event));
+
+    return event;
+}
+
 UfoIrBasicOpsProcessor *
 ufo_ir_basic_ops_processor_new(UfoResources *resources,
                                cl_command_queue cmd_queue) {
@@ -90,6 +200,13 @@ ufo_ir_basic_ops_processor_new(UfoResources *resources,
 static void
 ufo_ir_basic_ops_processor_finalize (GObject *object)
 {
+    UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE (object);
+
+    if (priv->partial_sums) {
+        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->partial_sums));
+        priv->partial_sums = NULL;
+    }
+
     G_OBJECT_CLASS (ufo_ir_basic_ops_processor_parent_class)->finalize (object);
 }
 
@@ -100,6 +217,13 @@ ufo_ir_basic_ops_processor_add (UfoIrBasicOpsProcessor *self,
                                 UfoBuffer *result)
 {
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
+
+    if (on_host (buffer1, buffer2, result))
+        return host_operation (self, buffer1, buffer2, 1.0f, result, HOST_ADD);
+
+    if (!use_images (priv, buffer1, buffer2, result))
+        return buffer_operation (priv, priv->buffer_add_kernel, buffer1, buffer2, 1.0f, result, 0, buffer_length (result));
+
     return operation (buffer1, buffer2, result, priv->command_queue, priv->add_kernel);
 }
 
@@ -111,6 +235,13 @@ ufo_ir_basic_ops_processor_add2 (UfoIrBasicOpsProcessor *self,
                                  UfoBuffer *result)
 {
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
+
+    if (on_host (buffer1, buffer2, result))
+        return host_operation (self, buffer1, buffer2, modifier, result, HOST_ADD);
+
+    if (!use_images (priv, buffer1, buffer2, result))
+        return buffer_operation (priv, priv->buffer_add_kernel, buffer1, buffer2, modifier, result, 0, buffer_length (result));
+
     return operation2 (buffer1, buffer2, modifier, result, priv->command_queue, priv->add2_kernel);
 }
 
@@ -122,6 +253,13 @@ ufo_ir_basic_ops_processor_deduction (UfoIrBasicOpsProcessor *self,
                                       UfoBuffer *result)
 {
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
+
+    if (on_host (buffer1, buffer2, result))
+        return host_operation (self, buffer1, buffer2, -1.0f, result, HOST_ADD);
+
+    if (!use_images (priv, buffer1, buffer2, result))
+        return buffer_operation (priv, priv->buffer_add_kernel, buffer1, buffer2, -1.0f, result, 0, buffer_length (result));
+
     return operation (buffer1, buffer2, result, priv->command_queue, priv->ded_kernel);
 }
 
@@ -133,6 +271,13 @@ ufo_ir_basic_ops_processor_deduction2 (UfoIrBasicOpsProcessor *self,
                                        UfoBuffer *result)
 {
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
+
+    if (on_host (buffer1, buffer2, result))
+        return host_operation (self, buffer1, buffer2, -modifier, result, HOST_ADD);
+
+    if (!use_images (priv, buffer1, buffer2, result))
+        return buffer_operation (priv, priv->buffer_add_kernel, buffer1, buffer2, -modifier, result, 0, buffer_length (result));
+
     return operation2 (buffer1, buffer2, modifier, result, priv->command_queue, priv->ded2_kernel);
 }
 
@@ -142,7 +287,7 @@ ufo_ir_basic_ops_processor_div_element_wise(UfoIrBasicOpsProcessor *self,
                                             UfoBuffer *buffer2,
                                             UfoBuffer *result)
 {
-    twoAraysIterator(self, buffer1, buffer2, result, elementsDivOperation);
+    twoAraysIterator(self, buffer1, buffer2, result, HOST_DIV);
 }
 
 gfloat
@@ -153,46 +298,70 @@ ufo_ir_basic_ops_processor_dot_product(UfoIrBasicOpsProcessor *self,
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
     UfoRequisition buffer1_requisition;
     UfoRequisition buffer2_requisition;
+    gfloat partial[REDUCTION_NUM_GROUPS];
+    gdouble sum = 0.0;
 
     ufo_buffer_get_requisition (buffer1, &buffer1_requisition);
     ufo_buffer_get_requisition (buffer2, &buffer2_requisition);
 
-    gfloat *values1 = ufo_buffer_get_host_array (buffer1, priv->command_queue);
-    gfloat *values2 = ufo_buffer_get_host_array (buffer2, priv->command_queue);
+    guint length = num_elements (&buffer1_requisition);
 
-    guint length1 = num_elements (&buffer1_requisition);
-    guint length2 = num_elements (&buffer2_requisition);
-
-    guint length = 1;
-
-    if (buffer1_requisition.n_dims != buffer2_requisition.n_dims) {
+    if (buffer1_requisition.n_dims != buffer2_requisition.n_dims ||
+        length != num_elements (&buffer2_requisition)) {
         g_print("Buffers are not equal\n");
         return -1.0f;
     }
 
-    if (length1 == length2) {
-        length = length1;
-    }
-    else {
-        g_print("Buffers are not equal\n");
-        return -1.0f;
+    if (on_host (buffer1, buffer2, NULL)) {
+        gfloat *values1 = ufo_ir_profiler_get_host_array (buffer1, priv->command_queue);
+        gfloat *values2 = ufo_ir_profiler_get_host_array (buffer2, priv->command_queue);
+
+        return (gfloat) ufo_ir_host_ops_dot (values1, values2, length);
     }
 
-    guint partsCnt = (guint)buffer1_requisition.dims[buffer1_requisition.n_dims -1];
-    guint partLen = length / partsCnt;
+    gsize local_work_size = REDUCTION_GROUP_SIZE;
+    gsize global_work_size = REDUCTION_GROUP_SIZE * REDUCTION_NUM_GROUPS;
 
-    gfloat norm = 0;
+    if (use_images (priv, buffer1, buffer2, NULL)) {
+        cl_mem d_buffer1 = ufo_ir_profiler_get_device_image (buffer1, priv->command_queue);
+        cl_mem d_buffer2 = ufo_ir_profiler_get_device_image (buffer2, priv->command_queue);
+        guint width = (guint) buffer1_requisition.dims[0];
 
-    for(guint partNum = 0; partNum < partsCnt; partNum++) {
-        gfloat partNorm = 0;
-        for(guint i = 0; i < partLen; i++) {
-            guint index = partNum * i;
-            partNorm += values1[index] * values2[index];
-        }
-        norm += partNorm;
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dot_kernel, 0, sizeof(void *), (void *) &d_buffer1));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dot_kernel, 1, sizeof(void *), (void *) &d_buffer2));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dot_kernel, 2, sizeof(guint), (void *) &width));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dot_kernel, 3, sizeof(guint), (void *) &length));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dot_kernel, 4, sizeof(gfloat) * REDUCTION_GROUP_SIZE, NULL));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dot_kernel, 5, sizeof(cl_mem), (void *) &priv->partial_sums));
+
+        UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, priv->dot_kernel,
+                                                            1, &global_work_size, &local_work_size, NULL));
+    }
+    else {
+        cl_mem d_buffer1 = ufo_ir_profiler_get_device_array (buffer1, priv->command_queue);
+        cl_mem d_buffer2 = ufo_ir_profiler_get_device_array (buffer2, priv->command_queue);
+
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->buffer_dot_kernel, 0, sizeof(cl_mem), (void *) &d_buffer1));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->buffer_dot_kernel, 1, sizeof(cl_mem), (void *) &d_buffer2));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->buffer_dot_kernel, 2, sizeof(guint), (void *) &length));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->buffer_dot_kernel, 3, sizeof(gfloat) * REDUCTION_GROUP_SIZE, NULL));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->buffer_dot_kernel, 4, sizeof(cl_mem), (void *) &priv->partial_sums));
+
+        UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, priv->buffer_dot_kernel,
+                                                            1, &global_work_size, &local_work_size, NULL));
     }
 
-    return norm;
+    // The read has to wait for the reduction even inside a fork region
+    ufo_ir_exec_sync (priv->command_queue);
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueReadBuffer (priv->command_queue, priv->partial_sums, CL_TRUE,
+                                                    0, sizeof(partial), partial,
+                                                    0, NULL, NULL));
+    ufo_ir_exec_resume (priv->command_queue);
+
+    for (guint i = 0; i < REDUCTION_NUM_GROUPS; i++)
+        sum += partial[i];
+
+    return (gfloat) sum;
 }
 
 gpointer
@@ -203,14 +372,22 @@ ufo_ir_basic_ops_processor_inv (UfoIrBasicOpsProcessor *self,
     UfoRequisition requisition;
     ufo_buffer_get_requisition (buffer, &requisition);
 
-    cl_mem d_arg = ufo_buffer_get_device_image (buffer, priv->command_queue);
+    if (on_host (buffer, NULL, NULL)) {
+        gfloat *values = ufo_ir_profiler_get_host_array (buffer, priv->command_queue);
+        ufo_ir_host_ops_inv (values, values, num_elements (&requisition));
+        return NULL;
+    }
+
+    if (!use_images (priv, buffer, NULL, NULL))
+        return buffer_operation (priv, priv->buffer_inv_kernel, buffer, NULL, 0.0f, buffer, 0, num_elements (&requisition));
+
+    cl_mem d_arg = ufo_ir_profiler_get_device_image (buffer, priv->command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(priv->inv_kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(priv->inv_kernel, 1, sizeof(void *), (void *) &d_arg));
     cl_event event;
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel(priv->command_queue, priv->inv_kernel,
-                                                      requisition.n_dims, NULL, requisition.dims,
-                                                      NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, priv->inv_kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, &event));
 
     return event;
 }
@@ -220,20 +397,9 @@ ufo_ir_basic_ops_processor_l1_norm (UfoIrBasicOpsProcessor *self,
                                     UfoBuffer *buffer)
 {
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
-    UfoRequisition arg_requisition;
-    gfloat *values;
-    gfloat norm = 0;
+    gfloat *values = ufo_ir_profiler_get_host_array (buffer, priv->command_queue);
 
-    ufo_buffer_get_requisition (buffer, &arg_requisition);
-    values = ufo_buffer_get_host_array (buffer, priv->command_queue);
-
-    for (guint i = 0; i < arg_requisition.dims[0]; ++i) {
-        for (guint j = 0; j < arg_requisition.dims[1]; ++j) {
-            norm += (gfloat) fabs (values[i * arg_requisition.dims[1] + j]);
-        }
-    }
-
-    return norm;
+    return (gfloat) ufo_ir_host_ops_l1_norm (values, buffer_length (buffer));
 }
 
 gfloat
@@ -252,7 +418,7 @@ ufo_ir_basic_ops_processor_max_element_wise(UfoIrBasicOpsProcessor *self,
                                             UfoBuffer *buffer2,
                                             UfoBuffer *result)
 {
-    twoAraysIterator(self, buffer1, buffer2, result, elementsMaxOperation);
+    twoAraysIterator(self, buffer1, buffer2, result, HOST_MAX);
 }
 
 gpointer
@@ -262,6 +428,13 @@ ufo_ir_basic_ops_processor_mul (UfoIrBasicOpsProcessor *self,
                                 UfoBuffer *result)
 {
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
+
+    if (on_host (buffer1, buffer2, result))
+        return host_operation (self, buffer1, buffer2, 0.0f, result, HOST_MUL);
+
+    if (!use_images (priv, buffer1, buffer2, result))
+        return buffer_operation (priv, priv->buffer_mul_kernel, buffer1, buffer2, 0.0f, result, 0, buffer_length (result));
+
     return operation (buffer1, buffer2, result, priv->command_queue, priv->mul_kernel);
 }
 
@@ -271,7 +444,7 @@ ufo_ir_basic_ops_processor_mul_element_wise(UfoIrBasicOpsProcessor *self,
                                             UfoBuffer *buffer2,
                                             UfoBuffer *result)
 {
-    twoAraysIterator(self, buffer1, buffer2, result, elementsMulOperation);
+    twoAraysIterator(self, buffer1, buffer2, result, HOST_MUL);
 }
 
 gpointer
@@ -301,9 +474,24 @@ ufo_ir_basic_ops_processor_mul_rows (UfoIrBasicOpsProcessor *self,
         return NULL;
     }
 
-    cl_mem d_buffer1 = ufo_buffer_get_device_image (buffer1, priv->command_queue);
-    cl_mem d_buffer2 = ufo_buffer_get_device_image (buffer2, priv->command_queue);
-    cl_mem d_result  = ufo_buffer_get_device_image (result, priv->command_queue);
+    if (on_host (buffer1, buffer2, result)) {
+        gsize first = (gsize) offset * result_requisition.dims[0];
+        gfloat *values1 = ufo_ir_profiler_get_host_array (buffer1, priv->command_queue);
+        gfloat *values2 = ufo_ir_profiler_get_host_array (buffer2, priv->command_queue);
+        gfloat *values = ufo_ir_profiler_get_host_array (result, priv->command_queue);
+
+        ufo_ir_host_ops_mul (values1 + first, values2 + first, values + first,
+                             (gsize) n * result_requisition.dims[0]);
+        return NULL;
+    }
+
+    if (!use_images (priv, buffer1, buffer2, result))
+        return buffer_operation (priv, priv->buffer_mul_kernel, buffer1, buffer2, 0.0f, result,
+                                 offset * result_requisition.dims[0], n * result_requisition.dims[0]);
+
+    cl_mem d_buffer1 = ufo_ir_profiler_get_device_image (buffer1, priv->command_queue);
+    cl_mem d_buffer2 = ufo_ir_profiler_get_device_image (buffer2, priv->command_queue);
+    cl_mem d_result  = ufo_ir_profiler_get_device_image (result, priv->command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->mul_rows_kernel, 0, sizeof(void *), (void *) &d_buffer1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->mul_rows_kernel, 1, sizeof(void *), (void *) &d_buffer2));
@@ -314,9 +502,8 @@ ufo_ir_basic_ops_processor_mul_rows (UfoIrBasicOpsProcessor *self,
     operation_requisition.dims[1] = n;
 
     cl_event event;
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (priv->command_queue, priv->mul_rows_kernel,
-                                                       operation_requisition.n_dims, NULL, operation_requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, priv->mul_rows_kernel,
+                                                        operation_requisition.n_dims, operation_requisition.dims, NULL, &event));
 
     return event;
 }
@@ -330,13 +517,25 @@ ufo_ir_basic_ops_processor_mul_scalar(UfoIrBasicOpsProcessor *self,
     UfoRequisition requisition;
     ufo_buffer_get_requisition (buffer, &requisition);
 
-    gfloat *values = ufo_buffer_get_host_array (buffer, priv->command_queue);
-
-    guint length = num_elements (&requisition);
+    if (on_host (buffer, NULL, NULL)) {
+        gfloat *values = ufo_ir_profiler_get_host_array (buffer, priv->command_queue);
+        ufo_ir_host_ops_affine (values, multiplier, 0.0f, values, num_elements (&requisition));
+        return;
+    }
 
-    for(guint i = 0; i < length; i++) {
-        values[i] *= multiplier;
+    if (!use_images (priv, buffer, NULL, NULL)) {
+        buffer_operation (priv, priv->buffer_scale_kernel, buffer, NULL, multiplier, buffer, 0, num_elements (&requisition));
+        return;
     }
+
+    cl_mem d_buffer = ufo_ir_profiler_get_device_image (buffer, priv->command_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->mul_scalar_kernel, 0, sizeof(void *), (void *) &d_buffer));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->mul_scalar_kernel, 1, sizeof(gfloat), (void *) &multiplier));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->mul_scalar_kernel, 2, sizeof(void *), (void *) &d_buffer));
+
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, priv->mul_scalar_kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, NULL));
 }
 
 void
@@ -347,23 +546,15 @@ ufo_ir_basic_ops_processor_normalization(UfoIrBasicOpsProcessor *self,
     UfoRequisition requisition;
     ufo_buffer_get_requisition (buffer, &requisition);
 
-    gfloat *values = ufo_buffer_get_host_array (buffer, priv->command_queue);
+    gfloat *values = ufo_ir_profiler_get_host_array (buffer, priv->command_queue);
 
     guint length = num_elements (&requisition);
 
-    gfloat max = -G_MAXFLOAT;
-    gfloat min =  G_MAXFLOAT;
-
-    for (guint i = 0; i < length; i++) {
-        max = fmax(values[i], max);
-        min = fmin(values[i], min);
-    }
+    gfloat max, min;
+    ufo_ir_host_ops_min_max (values, length, &min, &max);
 
     gfloat delta = 1 / (max - min);
-
-    for (guint i = 0; i < length; i++) {
-        values[i] = delta * values[i] - min * delta;
-    }
+    ufo_ir_host_ops_affine (values, delta, -min * delta, values, length);
 }
 
 gpointer
@@ -378,15 +569,25 @@ ufo_ir_basic_ops_processor_positive_constraint (UfoIrBasicOpsProcessor *self,
     ufo_buffer_get_requisition (buffer, &buffer_requisition);
     ufo_buffer_resize (result, &buffer_requisition);
 
-    cl_mem d_buffer = ufo_buffer_get_device_image (buffer, priv->command_queue);
-    cl_mem d_result = ufo_buffer_get_device_image (result, priv->command_queue);
+    if (on_host (buffer, result, NULL)) {
+        gfloat *values = ufo_ir_profiler_get_host_array (buffer, priv->command_queue);
+        gfloat *out = ufo_ir_profiler_get_host_array (result, priv->command_queue);
+
+        ufo_ir_host_ops_positive (values, out, num_elements (&buffer_requisition));
+        return NULL;
+    }
+
+    if (!use_images (priv, buffer, result, NULL))
+        return buffer_operation (priv, priv->buffer_positive_kernel, buffer, NULL, 0.0f, result, 0, num_elements (&buffer_requisition));
+
+    cl_mem d_buffer = ufo_ir_profiler_get_device_image (buffer, priv->command_queue);
+    cl_mem d_result = ufo_ir_profiler_get_device_image (result, priv->command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->pc_kernel, 0, sizeof(void *), (void *) &d_buffer));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->pc_kernel, 1, sizeof(void *), (void *) &d_result));
 
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (priv->command_queue, priv->pc_kernel,
-                                                       buffer_requisition.n_dims, NULL, buffer_requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, priv->pc_kernel,
+                                                        buffer_requisition.n_dims, buffer_requisition.dims, NULL, &event));
 
     return event;
 }
@@ -399,15 +600,24 @@ ufo_ir_basic_ops_processor_set (UfoIrBasicOpsProcessor *self,
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
     UfoRequisition requisition;
     ufo_buffer_get_requisition (buffer, &requisition);
-    cl_mem d_buffer = ufo_buffer_get_device_image (buffer, priv->command_queue);
+
+    if (on_host (buffer, NULL, NULL)) {
+        gfloat *values = ufo_ir_profiler_get_host_array (buffer, priv->command_queue);
+        ufo_ir_host_ops_set (values, value, num_elements (&requisition));
+        return NULL;
+    }
+
+    if (!use_images (priv, buffer, NULL, NULL))
+        return buffer_operation (priv, priv->buffer_set_kernel, buffer, NULL, value, buffer, 0, num_elements (&requisition));
+
+    cl_mem d_buffer = ufo_ir_profiler_get_device_image (buffer, priv->command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->set_kernel, 0, sizeof(void *), (void *) &d_buffer));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->set_kernel, 1, sizeof(gfloat), (void *) &value));
 
     cl_event event;
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (priv->command_queue, priv->set_kernel,
-                                                       requisition.n_dims, NULL, requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, priv->set_kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, &event));
 
     return event;
 }
@@ -420,13 +630,14 @@ ufo_ir_basic_ops_processor_sqrt (UfoIrBasicOpsProcessor *self,
     UfoRequisition arg_requisition;
     ufo_buffer_get_requisition (buffer, &arg_requisition);
 
-    gfloat *values = ufo_buffer_get_host_array (buffer, priv->command_queue);
+    if (!on_host (buffer, NULL, NULL)) {
+        buffer_operation (priv, priv->buffer_sqrt_kernel, buffer, NULL, 0.0f, buffer, 0, num_elements (&arg_requisition));
+        return;
+    }
 
-    guint length = num_elements (&arg_requisition);
+    gfloat *values = ufo_ir_profiler_get_host_array (buffer, priv->command_queue);
 
-    for(guint i = 0; i < length; i++) {
-        values[i] =  sqrt(values[i]);
-    }
+    ufo_ir_host_ops_sqrt (values, values, num_elements (&arg_requisition));
 }
 
 static cl_event
@@ -451,17 +662,16 @@ operation (UfoBuffer *arg1,
         return NULL;
     }
 
-    cl_mem d_arg1 = ufo_buffer_get_device_image (arg1, command_queue);
-    cl_mem d_arg2 = ufo_buffer_get_device_image (arg2, command_queue);
-    cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
+    cl_mem d_arg1 = ufo_ir_profiler_get_device_image (arg1, command_queue);
+    cl_mem d_arg2 = ufo_ir_profiler_get_device_image (arg2, command_queue);
+    cl_mem d_out = ufo_ir_profiler_get_device_image (out, command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_arg2));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(void *), (void *) &d_out));
 
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
-                                                       arg1_requisition.n_dims, NULL, arg1_requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        arg1_requisition.n_dims, arg1_requisition.dims, NULL, &event));
 
     return event;
 }
@@ -489,28 +699,28 @@ operation2 (UfoBuffer *arg1,
         return NULL;
     }
 
-    cl_mem d_arg1 = ufo_buffer_get_device_image (arg1, command_queue);
-    cl_mem d_arg2 = ufo_buffer_get_device_image (arg2, command_queue);
-    cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
+    cl_mem d_arg1 = ufo_ir_profiler_get_device_image (arg1, command_queue);
+    cl_mem d_arg2 = ufo_ir_profiler_get_device_image (arg2, command_queue);
+    cl_mem d_out = ufo_ir_profiler_get_device_image (out, command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 0, sizeof(void *), (void *) &d_arg1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 1, sizeof(void *), (void *) &d_arg2));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 2, sizeof(gfloat), (void *) &modifier));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 3, sizeof(void *), (void *) &d_out));
 
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
-                                                       arg1_requisition.n_dims, NULL, arg1_requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        arg1_requisition.n_dims, arg1_requisition.dims, NULL, &event));
 
     return event;
 }
 
 static gpointer
 kernel_from_name (UfoResources *resources,
+                  const gchar *filename,
                   const gchar* name)
 {
     GError *error = NULL;
-    gpointer kernel = ufo_resources_get_kernel (resources, OPS_FILENAME, name, NULL, &error);
+    gpointer kernel = ufo_resources_get_kernel (resources, filename, name, NULL, &error);
 
     if (error) {
         g_error ("%s\n", error->message);
@@ -530,15 +740,86 @@ static void ufo_ir_basic_obs_processor_resources_init(UfoIrBasicOpsProcessor *se
     priv->command_queue = cmd_queue;
     priv->resources = resources;
 
-    priv->add_kernel = kernel_from_name(resources, "operation_add");
-    priv->add2_kernel = kernel_from_name(resources, "operation_add2");
-    priv->ded_kernel = kernel_from_name(resources, "operation_deduction");
-    priv->ded2_kernel = kernel_from_name(resources, "operation_deduction2");
-    priv->inv_kernel =  kernel_from_name(resources, "operation_inv");
-    priv->mul_kernel = kernel_from_name(resources, "operation_mul");
-    priv->mul_rows_kernel = kernel_from_name(resources, "op_mulRows");
-    priv->pc_kernel = kernel_from_name(resources, "POSC");
-    priv->set_kernel = kernel_from_name(resources, "operation_set");
+    priv->add_kernel = kernel_from_name(resources, OPS_FILENAME, "operation_add");
+    priv->add2_kernel = kernel_from_name(resources, OPS_FILENAME, "operation_add2");
+    priv->ded_kernel = kernel_from_name(resources, OPS_FILENAME, "operation_deduction");
+    priv->ded2_kernel = kernel_from_name(resources, OPS_FILENAME, "operation_deduction2");
+    priv->inv_kernel =  kernel_from_name(resources, OPS_FILENAME, "operation_inv");
+    priv->mul_kernel = kernel_from_name(resources, OPS_FILENAME, "operation_mul");
+    priv->mul_rows_kernel = kernel_from_name(resources, OPS_FILENAME, "op_mulRows");
+    priv->mul_scalar_kernel = kernel_from_name(resources, OPS_FILENAME, "operation_mul_scalar");
+    priv->dot_kernel = kernel_from_name(resources, OPS_FILENAME, "operation_dot_product");
+    priv->pc_kernel = kernel_from_name(resources, OPS_FILENAME, "POSC");
+    priv->set_kernel = kernel_from_name(resources, OPS_FILENAME, "operation_set");
+
+    priv->buffer_add_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_add");
+    priv->buffer_mul_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_mul");
+    priv->buffer_div_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_div");
+    priv->buffer_max_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_max");
+    priv->buffer_sqrt_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_sqrt");
+    priv->buffer_scale_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_scale");
+    priv->buffer_set_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_set");
+    priv->buffer_inv_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_inv");
+    priv->buffer_positive_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_positive");
+    priv->buffer_dot_kernel = kernel_from_name(resources, BUFFER_OPS_FILENAME, "buffer_dot_product");
+    priv->prefer_buffers = ufo_ir_device_prefers_buffers (cmd_queue);
+
+    cl_int error;
+    priv->partial_sums = clCreateBuffer (ufo_resources_get_context (resources),
+                                         CL_MEM_READ_WRITE,
+                                         sizeof(gfloat) * REDUCTION_NUM_GROUPS,
+                                         NULL, &error);
+    UFO_RESOURCES_CHECK_CLERR (error);
+}
+
+static void
+host_apply (HostOperation op,
+            const gfloat *values1,
+            const gfloat *values2,
+            gfloat modifier,
+            gfloat *outputs,
+            guint length)
+{
+    switch (op) {
+        case HOST_ADD:
+            ufo_ir_host_ops_add (values1, values2, modifier, outputs, length);
+            break;
+        case HOST_MUL:
+            ufo_ir_host_ops_mul (values1, values2, outputs, length);
+            break;
+        case HOST_DIV:
+            ufo_ir_host_ops_div (values1, values2, outputs, length);
+            break;
+        case HOST_MAX:
+            ufo_ir_host_ops_max (values1, values2, outputs, length);
+            break;
+    }
+}
+
+static gpointer
+host_operation (UfoIrBasicOpsProcessor *self,
+                UfoBuffer *arg1,
+                UfoBuffer *arg2,
+                gfloat modifier,
+                UfoBuffer *output,
+                HostOperation op)
+{
+    UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
+    guint length = buffer_length (arg1);
+
+    if (length != buffer_length (arg2) || length != buffer_length (output)) {
+        g_error ("Incorrect volume size.");
+        return NULL;
+    }
+
+    gfloat *values1 = ufo_ir_profiler_get_host_array (arg1, priv->command_queue);
+    gfloat *values2 = ufo_ir_profiler_get_host_array (arg2, priv->command_queue);
+    gfloat *outputs = ufo_ir_profiler_get_host_array (output, priv->command_queue);
+
+    host_apply (op, values1, values2, modifier, outputs, length);
+
+    // Nothing is enqueued, there is no event to wait for
+    return NULL;
 }
 
 static void
@@ -546,7 +827,7 @@ twoAraysIterator(UfoIrBasicOpsProcessor *self,
                  UfoBuffer *arg1,
                  UfoBuffer *arg2,
                  UfoBuffer *output,
-                 void(*proc_fn)(const float*, const float*, float*))
+                 HostOperation op)
 {
     UfoIrBasicOpsProcessorPrivate *priv = UFO_IR_BASIC_OPS_PROCESSOR_GET_PRIVATE(self);
     UfoRequisition arg1_requisition;
@@ -555,8 +836,39 @@ twoAraysIterator(UfoIrBasicOpsProcessor *self,
     ufo_buffer_get_requisition (arg1, &arg1_requisition);
     ufo_buffer_get_requisition (arg2, &arg2_requisition);
 
-    gfloat *values1 = ufo_buffer_get_host_array (arg1, priv->command_queue);
-    gfloat *values2 = ufo_buffer_get_host_array (arg2, priv->command_queue);
+    // Device data stays on the device, there are no image kernels for these
+    if (!on_host (arg1, arg2, output)) {
+        gpointer kernel = NULL;
+        gfloat modifier = 0.0f;
+
+        switch (op) {
+            case HOST_ADD:
+                kernel = priv->buffer_add_kernel;
+                modifier = 1.0f;
+                break;
+            case HOST_MUL:
+                kernel = priv->buffer_mul_kernel;
+                break;
+            case HOST_DIV:
+                kernel = priv->buffer_div_kernel;
+                break;
+            case HOST_MAX:
+                kernel = priv->buffer_max_kernel;
+                break;
+        }
+
+        if (num_elements (&arg1_requisition) != num_elements (&arg2_requisition) ||
+            num_elements (&arg1_requisition) != buffer_length (output)) {
+            g_error ("Incorrect volume size.");
+            return;
+        }
+
+        buffer_operation (priv, kernel, arg1, arg2, modifier, output, 0, num_elements (&arg1_requisition));
+        return;
+    }
+
+    gfloat *values1 = ufo_ir_profiler_get_host_array (arg1, priv->command_queue);
+    gfloat *values2 = ufo_ir_profiler_get_host_array (arg2, priv->command_queue);
 
     guint length1 = num_elements (&arg1_requisition);
     guint length2 = num_elements (&arg2_requisition);
@@ -572,33 +884,7 @@ twoAraysIterator(UfoIrBasicOpsProcessor *self,
         g_print("Buffers are not equal\n");
     }
 
-    gfloat *outputs = ufo_buffer_get_host_array (output, priv->command_queue);
+    gfloat *outputs = ufo_ir_profiler_get_host_array (output, priv->command_queue);
 
-    for (guint i = 0; i < length; i++) {
-        proc_fn(&values1[i], &values2[i], &outputs[i]);
-    }
-}
-
-static void
-elementsMulOperation(const float *in1,
-                     const float *in2,
-                     float *outVal)
-{
-    *outVal = (*in1) * (*in2);
-}
-
-static void
-elementsMaxOperation(const float *in1,
-                     const float *in2,
-                     float *outVal)
-{
-    *outVal = fmax(*in1,*in2);
-}
-
-static void
-elementsDivOperation(const float *in1,
-                     const float *in2,
-                     float *outVal)
-{
-    *outVal = (*in1) / (*in2);
+    host_apply (op, values1, values2, 1.0f, outputs, length);
 }
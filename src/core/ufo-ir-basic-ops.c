@@ -25,7 +25,12 @@
 
 #include <math.h>
 #include "ufo-ir-basic-ops.h"
+#include "ufo-ir-profiler.h"
+#include "ufo-ir-host-ops.h"
 #define OPS_FILENAME "ufo-basic-ops.cl"
+#define IR_OPS_FILENAME "ufo-ir-basic-ops.cl"
+#define BUFFER_OPS_FILENAME "ufo-ir-basic-ops-buffer.cl"
+#define MULTIGRID_OPS_FILENAME "ufo-ir-multigrid.cl"
 
 static cl_event
 operation (UfoBuffer *arg1,
@@ -49,17 +54,16 @@ operation (UfoBuffer *arg1,
         return NULL;
     }
 
-    cl_mem d_arg1 = ufo_buffer_get_device_image (arg1, command_queue);
-    cl_mem d_arg2 = ufo_buffer_get_device_image (arg2, command_queue);
-    cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
+    cl_mem d_arg1 = ufo_ir_profiler_get_device_image (arg1, command_queue);
+    cl_mem d_arg2 = ufo_ir_profiler_get_device_image (arg2, command_queue);
+    cl_mem d_out = ufo_ir_profiler_get_device_image (out, command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_arg2));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(void *), (void *) &d_out));
 
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
-                                                       arg1_requisition.n_dims, NULL, arg1_requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        arg1_requisition.n_dims, arg1_requisition.dims, NULL, &event));
 
     return event;
 }
@@ -87,27 +91,26 @@ operation2 (UfoBuffer *arg1,
         return NULL;
     }
 
-    cl_mem d_arg1 = ufo_buffer_get_device_image (arg1, command_queue);
-    cl_mem d_arg2 = ufo_buffer_get_device_image (arg2, command_queue);
-    cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
+    cl_mem d_arg1 = ufo_ir_profiler_get_device_image (arg1, command_queue);
+    cl_mem d_arg2 = ufo_ir_profiler_get_device_image (arg2, command_queue);
+    cl_mem d_out = ufo_ir_profiler_get_device_image (out, command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 0, sizeof(void *), (void *) &d_arg1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 1, sizeof(void *), (void *) &d_arg2));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 2, sizeof(gfloat), (void *) &modifier));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 3, sizeof(void *), (void *) &d_out));
 
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
-                                                       arg1_requisition.n_dims, NULL, arg1_requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        arg1_requisition.n_dims, arg1_requisition.dims, NULL, &event));
 
     return event;
 }
 
 static gpointer
-kernel_from_name (UfoResources *resources, const gchar* name)
+kernel_from_file (UfoResources *resources, const gchar *filename, const gchar* name)
 {
     GError *error = NULL;
-    gpointer kernel = ufo_resources_get_kernel (resources, OPS_FILENAME, name, NULL, &error);
+    gpointer kernel = ufo_resources_get_kernel (resources, filename, name, NULL, &error);
 
     if (error) {
         g_error ("%s\n", error->message);
@@ -118,6 +121,12 @@ kernel_from_name (UfoResources *resources, const gchar* name)
     return kernel;
 }
 
+static gpointer
+kernel_from_name (UfoResources *resources, const gchar* name)
+{
+    return kernel_from_file (resources, OPS_FILENAME, name);
+}
+
 gpointer
 ufo_ir_op_set (UfoBuffer *arg,
                gfloat     value,
@@ -126,15 +135,14 @@ ufo_ir_op_set (UfoBuffer *arg,
 {
     UfoRequisition requisition;
     ufo_buffer_get_requisition (arg, &requisition);
-    cl_mem d_arg = ufo_buffer_get_device_image (arg, command_queue);
+    cl_mem d_arg = ufo_ir_profiler_get_device_image (arg, command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(gfloat), (void *) &value));
 
     cl_event event;
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
-                                                       requisition.n_dims, NULL, requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, &event));
 
     return event;
 }
@@ -145,6 +153,50 @@ ufo_ir_op_set_generate_kernel (UfoResources *resources)
     return kernel_from_name(resources, "operation_set");
 }
 
+gpointer
+ufo_ir_op_set_buffer (UfoBuffer *arg,
+                      gfloat     value,
+                      gpointer   command_queue,
+                      gpointer   kernel)
+{
+    UfoRequisition requisition;
+    guint first = 0;
+    guint n = 1;
+
+    ufo_buffer_get_requisition (arg, &requisition);
+
+    for (guint i = 0; i < requisition.n_dims; i++)
+        n *= (guint) requisition.dims[i];
+
+    if (ufo_buffer_get_location (arg) == UFO_BUFFER_LOCATION_HOST) {
+        ufo_ir_host_ops_set (ufo_ir_profiler_get_host_array (arg, command_queue), value, n);
+        return NULL;
+    }
+
+    cl_mem d_arg = ufo_ir_profiler_get_device_array (arg, command_queue);
+    gsize global_work_size = (n + 3) / 4;
+
+    // buffer_set ignores its inputs
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(cl_mem), (void *) &d_arg));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(cl_mem), (void *) &d_arg));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(gfloat), (void *) &value));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof(cl_mem), (void *) &d_arg));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof(guint), (void *) &first));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 5, sizeof(guint), (void *) &n));
+
+    cl_event event;
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        1, &global_work_size, NULL, &event));
+
+    return event;
+}
+
+gpointer
+ufo_ir_op_set_buffer_generate_kernel (UfoResources *resources)
+{
+    return kernel_from_file(resources, BUFFER_OPS_FILENAME, "buffer_set");
+}
+
 gpointer
 ufo_ir_op_inv (UfoBuffer *arg,
                gpointer   command_queue,
@@ -153,14 +205,13 @@ ufo_ir_op_inv (UfoBuffer *arg,
     UfoRequisition requisition;
     ufo_buffer_get_requisition (arg, &requisition);
 
-    cl_mem d_arg = ufo_buffer_get_device_image (arg, command_queue);
+    cl_mem d_arg = ufo_ir_profiler_get_device_image (arg, command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 1, sizeof(void *), (void *) &d_arg));
     cl_event event;
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel(command_queue, kernel,
-                                                      requisition.n_dims, NULL, requisition.dims,
-                                                      NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, &event));
 
     return event;
 }
@@ -203,6 +254,57 @@ ufo_ir_op_add_generate_kernel (UfoResources *resources)
     return kernel_from_name(resources, "operation_add");
 }
 
+gpointer
+ufo_ir_op_add_buffer (UfoBuffer *arg1,
+                      UfoBuffer *arg2,
+                      UfoBuffer *out,
+                      gpointer   command_queue,
+                      gpointer   kernel)
+{
+    UfoRequisition requisition;
+    gfloat modifier = 1.0f;
+    guint first = 0;
+    guint n = 1;
+
+    ufo_buffer_get_requisition (out, &requisition);
+
+    for (guint i = 0; i < requisition.n_dims; i++)
+        n *= (guint) requisition.dims[i];
+
+    if (ufo_buffer_get_location (arg1) == UFO_BUFFER_LOCATION_HOST &&
+        ufo_buffer_get_location (arg2) == UFO_BUFFER_LOCATION_HOST &&
+        ufo_buffer_get_location (out) == UFO_BUFFER_LOCATION_HOST) {
+        ufo_ir_host_ops_add (ufo_ir_profiler_get_host_array (arg1, command_queue),
+                             ufo_ir_profiler_get_host_array (arg2, command_queue),
+                             modifier, ufo_ir_profiler_get_host_array (out, command_queue), n);
+        return NULL;
+    }
+
+    cl_mem d_arg1 = ufo_ir_profiler_get_device_array (arg1, command_queue);
+    cl_mem d_arg2 = ufo_ir_profiler_get_device_array (arg2, command_queue);
+    cl_mem d_out = ufo_ir_profiler_get_device_array (out, command_queue);
+    gsize global_work_size = (n + 3) / 4;
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(cl_mem), (void *) &d_arg1));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(cl_mem), (void *) &d_arg2));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(gfloat), (void *) &modifier));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof(cl_mem), (void *) &d_out));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof(guint), (void *) &first));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 5, sizeof(guint), (void *) &n));
+
+    cl_event event;
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        1, &global_work_size, NULL, &event));
+
+    return event;
+}
+
+gpointer
+ufo_ir_op_add_buffer_generate_kernel (UfoResources *resources)
+{
+    return kernel_from_file(resources, BUFFER_OPS_FILENAME, "buffer_add");
+}
+
 gpointer
 ufo_ir_op_mul_rows (UfoBuffer *arg1,
                     UfoBuffer *arg2,
@@ -230,9 +332,9 @@ ufo_ir_op_mul_rows (UfoBuffer *arg1,
         return NULL;
     }
 
-    cl_mem d_arg1 = ufo_buffer_get_device_image (arg1, command_queue);
-    cl_mem d_arg2 = ufo_buffer_get_device_image (arg2, command_queue);
-    cl_mem d_out  = ufo_buffer_get_device_image (out, command_queue);
+    cl_mem d_arg1 = ufo_ir_profiler_get_device_image (arg1, command_queue);
+    cl_mem d_arg2 = ufo_ir_profiler_get_device_image (arg2, command_queue);
+    cl_mem d_out  = ufo_ir_profiler_get_device_image (out, command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_arg2));
@@ -243,9 +345,8 @@ ufo_ir_op_mul_rows (UfoBuffer *arg1,
     operation_requisition.dims[1] = n;
 
     cl_event event;
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
-                                                       operation_requisition.n_dims, NULL, operation_requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        operation_requisition.n_dims, operation_requisition.dims, NULL, &event));
 
     return event;
 }
@@ -256,6 +357,51 @@ ufo_ir_op_mul_rows_generate_kernel (UfoResources *resources)
     return kernel_from_name(resources, "op_mulRows");
 }
 
+gpointer
+ufo_ir_op_copy_rows (UfoBuffer *arg,
+                     UfoBuffer *out,
+                     guint offset,
+                     guint n,
+                     gpointer command_queue,
+                     gpointer kernel)
+{
+    UfoRequisition arg_requisition, out_requisition;
+    ufo_buffer_get_requisition (arg, &arg_requisition);
+    ufo_buffer_get_requisition (out, &out_requisition);
+
+    if (arg_requisition.dims[0] != out_requisition.dims[0]) {
+        g_error ("Number of columns is different.");
+        return NULL;
+    }
+
+    if (arg_requisition.dims[1] < n || out_requisition.dims[1] < offset + n) {
+        g_error ("Rows are not enough.");
+        return NULL;
+    }
+
+    cl_mem d_arg = ufo_ir_profiler_get_device_image (arg, command_queue);
+    cl_mem d_out = ufo_ir_profiler_get_device_image (out, command_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_out));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(unsigned int), (void *) &offset));
+
+    UfoRequisition operation_requisition = arg_requisition;
+    operation_requisition.dims[1] = n;
+
+    cl_event event;
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        operation_requisition.n_dims, operation_requisition.dims, NULL, &event));
+
+    return event;
+}
+
+gpointer
+ufo_ir_op_copy_rows_generate_kernel (UfoResources *resources)
+{
+    return kernel_from_file(resources, IR_OPS_FILENAME, "op_copyRows");
+}
+
 gfloat
 ufo_ir_op_l1_norm (UfoBuffer *arg,
                    gpointer command_queue)
@@ -265,7 +411,7 @@ ufo_ir_op_l1_norm (UfoBuffer *arg,
     gfloat norm = 0;
 
     ufo_buffer_get_requisition (arg, &arg_requisition);
-    values = ufo_buffer_get_host_array (arg, command_queue);
+    values = ufo_ir_profiler_get_host_array (arg, command_queue);
 
     for (guint i = 0; i < arg_requisition.dims[0]; ++i) {
         for (guint j = 0; j < arg_requisition.dims[1]; ++j) {
@@ -304,15 +450,14 @@ ufo_ir_op_positive_constraint (UfoBuffer *arg,
     ufo_buffer_get_requisition (arg, &arg_requisition);
     ufo_buffer_resize (out, &arg_requisition);
 
-    cl_mem d_arg = ufo_buffer_get_device_image (arg, command_queue);
-    cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
+    cl_mem d_arg = ufo_ir_profiler_get_device_image (arg, command_queue);
+    cl_mem d_out = ufo_ir_profiler_get_device_image (out, command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_out));
 
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
-                                                       arg_requisition.n_dims, NULL, arg_requisition.dims,
-                                                       NULL, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        arg_requisition.n_dims, arg_requisition.dims, NULL, &event));
 
     return event;
 }
@@ -340,3 +485,65 @@ ufo_ir_op_deduction2_generate_kernel(UfoResources *resources)
 {
     return kernel_from_name(resources, "operation_deduction2");
 }
+
+gpointer
+ufo_ir_op_bin_detectors (UfoBuffer *fine,
+                         UfoBuffer *coarse,
+                         guint factor,
+                         guint angle_stride,
+                         gpointer command_queue,
+                         gpointer kernel)
+{
+    UfoRequisition requisition;
+    ufo_buffer_get_requisition (coarse, &requisition);
+
+    cl_mem d_fine = ufo_ir_profiler_get_device_image (fine, command_queue);
+    cl_mem d_coarse = ufo_ir_profiler_get_device_image (coarse, command_queue);
+    cl_int cl_factor = (cl_int) factor;
+    cl_int cl_stride = (cl_int) angle_stride;
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 0, sizeof(void *), (void *) &d_fine));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 1, sizeof(void *), (void *) &d_coarse));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 2, sizeof(cl_int), &cl_factor));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 3, sizeof(cl_int), &cl_stride));
+    cl_event event;
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, &event));
+
+    return event;
+}
+
+gpointer
+ufo_ir_op_bin_detectors_generate_kernel (UfoResources *resources)
+{
+    return kernel_from_file(resources, MULTIGRID_OPS_FILENAME, "bin_detectors");
+}
+
+gpointer
+ufo_ir_op_prolongate (UfoBuffer *coarse,
+                      UfoBuffer *fine,
+                      gfloat factor,
+                      gpointer command_queue,
+                      gpointer kernel)
+{
+    UfoRequisition requisition;
+    ufo_buffer_get_requisition (fine, &requisition);
+
+    cl_mem d_coarse = ufo_ir_profiler_get_device_image (coarse, command_queue);
+    cl_mem d_fine = ufo_ir_profiler_get_device_image (fine, command_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 0, sizeof(void *), (void *) &d_coarse));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 1, sizeof(void *), (void *) &d_fine));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 2, sizeof(gfloat), &factor));
+    cl_event event;
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (command_queue, kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, &event));
+
+    return event;
+}
+
+gpointer
+ufo_ir_op_prolongate_generate_kernel (UfoResources *resources)
+{
+    return kernel_from_file(resources, MULTIGRID_OPS_FILENAME, "prolongate");
+}
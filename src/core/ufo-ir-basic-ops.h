@@ -31,6 +31,14 @@ gpointer ufo_ir_op_set (UfoBuffer *arg,
                         gpointer   kernel);
 gpointer ufo_ir_op_set_generate_kernel(UfoResources *resources);
 
+// Like ufo_ir_op_set but fills the buffer where it is, on the host or as a
+// device array, without converting it to an image
+gpointer ufo_ir_op_set_buffer (UfoBuffer *arg,
+                               gfloat     value,
+                               gpointer   command_queue,
+                               gpointer   kernel);
+gpointer ufo_ir_op_set_buffer_generate_kernel(UfoResources *resources);
+
 gpointer ufo_ir_op_inv (UfoBuffer *arg,
                         gpointer   command_queue,
                         gpointer   kernel);
@@ -50,6 +58,15 @@ gpointer ufo_ir_op_add (UfoBuffer *arg1,
                         gpointer   kernel);
 gpointer ufo_ir_op_add_generate_kernel(UfoResources *resources);
 
+// Like ufo_ir_op_add but adds the buffers where they are, on the host or as
+// device arrays, without converting them to images
+gpointer ufo_ir_op_add_buffer (UfoBuffer *arg1,
+                               UfoBuffer *arg2,
+                               UfoBuffer *out,
+                               gpointer   command_queue,
+                               gpointer   kernel);
+gpointer ufo_ir_op_add_buffer_generate_kernel(UfoResources *resources);
+
 gpointer ufo_ir_op_mul_rows (UfoBuffer *arg1,
                              UfoBuffer *arg2,
                              UfoBuffer *out,
@@ -59,6 +76,15 @@ gpointer ufo_ir_op_mul_rows (UfoBuffer *arg1,
                              gpointer kernel);
 gpointer ufo_ir_op_mul_rows_generate_kernel(UfoResources *resources);
 
+// Writes the first n rows of arg to the rows from offset on of out
+gpointer ufo_ir_op_copy_rows (UfoBuffer *arg,
+                              UfoBuffer *out,
+                              guint offset,
+                              guint n,
+                              gpointer command_queue,
+                              gpointer kernel);
+gpointer ufo_ir_op_copy_rows_generate_kernel(UfoResources *resources);
+
 gfloat ufo_ir_op_l1_norm (UfoBuffer *arg,
                           gpointer command_queue);
 
@@ -82,6 +108,24 @@ gpointer ufo_ir_op_deduction2 (UfoBuffer *arg1,
                                gpointer command_queue,
                                gpointer kernel);
 gpointer ufo_ir_op_deduction2_generate_kernel(UfoResources *resources);
+
+// Sums factor neighbouring detectors of every angle_stride-th row of fine
+// into the coarse sinogram, scaled for pixels factor times larger
+gpointer ufo_ir_op_bin_detectors (UfoBuffer *fine,
+                                  UfoBuffer *coarse,
+                                  guint factor,
+                                  guint angle_stride,
+                                  gpointer command_queue,
+                                  gpointer kernel);
+gpointer ufo_ir_op_bin_detectors_generate_kernel(UfoResources *resources);
+
+// Bilinear upsampling of a volume onto one with factor times smaller pixels
+gpointer ufo_ir_op_prolongate (UfoBuffer *coarse,
+                               UfoBuffer *fine,
+                               gfloat factor,
+                               gpointer command_queue,
+                               gpointer kernel);
+gpointer ufo_ir_op_prolongate_generate_kernel(UfoResources *resources);
 G_END_DECLS
 
 #endif
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include "ufo-ir-cpu-projector.h"
+#include "ufo-ir-thread-pool.h"
+
+// The inner loops run over detectors or pixels without branches so that the
+// compiler vectorizes them with gathers.
+
+typedef struct {
+    const UfoIrCpuGeometry *geometry;
+    const gfloat *input;
+    gfloat *output;
+    guint offset;
+    guint n;
+    gfloat scale;
+} ProjectionArgs;
+
+typedef struct {
+    gfloat required_width;
+    gfloat diff;
+    gfloat rotation_origin_shift;
+    gfloat origin_shift;
+} Center;
+
+static Center
+get_center (const UfoIrCpuGeometry *geometry)
+{
+    Center center;
+
+    center.required_width = geometry->axis_pos * 2;
+
+    // diff > 0 when the center of rotation is right of the sinogram center
+    // and is left otherwise
+    center.diff = (gfloat) geometry->width - center.required_width;
+    center.rotation_origin_shift = center.diff / 2.0f;
+    center.origin_shift = (gfloat) geometry->width / 2.0f;
+
+    return center;
+}
+
+// Linear interpolation between line[o] and line[o + 1] where texels outside
+// of [0, n) read as 0 like with CLK_ADDRESS_CLAMP
+static inline gfloat
+interpolate (const gfloat *line, gint stride, gint n, gfloat t)
+{
+    gfloat t_floor = floorf (t);
+    gfloat weight = t - t_floor;
+    gint o0 = (gint) t_floor;
+    gint o1 = o0 + 1;
+    gint c0 = CLAMP (o0, 0, n - 1);
+    gint c1 = CLAMP (o1, 0, n - 1);
+    gfloat m0 = o0 == c0 ? 1.0f - weight : 0.0f;
+    gfloat m1 = o1 == c1 ? weight : 0.0f;
+
+    return m0 * line[c0 * stride] + m1 * line[c1 * stride];
+}
+
+// Ray sums of one angle, FP_hor walks along x and FP_vert along y
+UFO_IR_SIMD_CLONES static void
+forward_angle (const UfoIrCpuGeometry *geometry,
+               const gfloat *volume,
+               gfloat *ray_sums,
+               gfloat sin_theta,
+               gfloat cos_theta)
+{
+    Center center = get_center (geometry);
+    gboolean horizontal = !(fabsf (sin_theta) <= fabsf (cos_theta));
+    gint width = (gint) geometry->width;
+    gint height = (gint) geometry->height;
+    gint n_dets = (gint) geometry->n_dets;
+    gfloat det_step, slice_step, half_extent;
+
+    if (horizontal) {
+        det_step = -1.0f / sin_theta;
+        slice_step = cos_theta / sin_theta;
+        half_extent = 0.5f * height;
+    }
+    else {
+        det_step = 1.0f / cos_theta;
+        slice_step = sin_theta / cos_theta;
+        half_extent = 0.5f * width;
+    }
+
+    gint n_slices = horizontal ? width : height;
+    gint n_offsets = horizontal ? height : width;
+    gint slice_stride = horizontal ? 1 : width;
+    gint offset_stride = horizontal ? width : 1;
+
+    // The sampler subtracts half a pixel from the ray coordinate
+    gfloat det_origin = (0.5f + center.rotation_origin_shift - 0.5f * n_dets) * det_step +
+                        (-center.origin_shift) * slice_step +
+                        half_extent - 0.5f;
+
+    for (gint det = 0; det < n_dets; det++)
+        ray_sums[det] = 0.0f;
+
+    for (gint slice = 0; slice < n_slices; slice++) {
+        const gfloat *line = volume + slice * slice_stride;
+        gfloat start = det_origin + slice * slice_step;
+
+        for (gint det = 0; det < n_dets; det++)
+            ray_sums[det] += interpolate (line, offset_stride, n_offsets, start + det * det_step);
+    }
+}
+
+static void
+forward_angles (guint first, guint last, gpointer user_data)
+{
+    ProjectionArgs *args = user_data;
+    const UfoIrCpuGeometry *geometry = args->geometry;
+    Center center = get_center (geometry);
+    gfloat *ray_sums = g_new (gfloat, geometry->n_dets);
+
+    for (guint i = first; i < last; i++) {
+        guint angle = args->offset + i;
+        gfloat *row = args->output + (gsize) angle * geometry->n_dets;
+
+        forward_angle (geometry, args->input, ray_sums,
+                       geometry->sin_vals[angle], geometry->cos_vals[angle]);
+
+        for (guint det = 0; det < geometry->n_dets; det++) {
+            // Switch off inactive detectors.
+            if ((center.diff < 0 && det < fabsf (center.diff)) ||
+                (center.diff > 0 && det > center.required_width))
+                continue;
+
+            row[det] += args->scale * ray_sums[det];
+        }
+    }
+
+    g_free (ray_sums);
+}
+
+// Pixel-driven backprojection of one volume row
+UFO_IR_SIMD_CLONES static void
+backward_row (const UfoIrCpuGeometry *geometry,
+              const gfloat *sinogram,
+              gfloat *sums,
+              guint y,
+              guint offset,
+              guint n)
+{
+    Center center = get_center (geometry);
+    gint width = (gint) geometry->width;
+    gint n_dets = (gint) geometry->n_dets;
+    gfloat axis_pos = geometry->axis_pos;
+
+    gfloat half_active_dets = center.diff < 0 ? width - axis_pos : axis_pos;
+    gfloat sino_edge_0 = axis_pos - half_active_dets + 0.5f;
+    gfloat sino_edge_1 = axis_pos + half_active_dets - 0.5f;
+    gfloat f_y = y + 0.5f - center.origin_shift;
+
+    for (gint x = 0; x < width; x++)
+        sums[x] = 0.0f;
+
+    for (guint i = offset; i < offset + n; i++) {
+        const gfloat *projection = sinogram + (gsize) i * n_dets;
+        gfloat sin_theta = geometry->sin_vals[i];
+        gfloat cos_theta = geometry->cos_vals[i];
+        gfloat start = -f_y * sin_theta + (center.origin_shift - center.rotation_origin_shift);
+
+        for (gint x = 0; x < width; x++) {
+            gfloat f_x = x + 0.5f - center.origin_shift;
+
+            // Clamp to the active detectors like the BP kernel does
+            gfloat t = fminf (fmaxf (f_x * cos_theta + start, sino_edge_0), sino_edge_1);
+
+            sums[x] += interpolate (projection, 1, n_dets, t - 0.5f);
+        }
+    }
+}
+
+static void
+backward_rows (guint first, guint last, gpointer user_data)
+{
+    ProjectionArgs *args = user_data;
+    const UfoIrCpuGeometry *geometry = args->geometry;
+    gfloat *sums = g_new (gfloat, geometry->width);
+
+    for (guint y = first; y < last; y++) {
+        gfloat *row = args->output + (gsize) y * geometry->width;
+
+        backward_row (geometry, args->input, sums, y, args->offset, args->n);
+
+        for (guint x = 0; x < geometry->width; x++)
+            row[x] += args->scale * sums[x];
+    }
+
+    g_free (sums);
+}
+
+void
+ufo_ir_cpu_projector_forward (const UfoIrCpuGeometry *geometry,
+                              const gfloat *volume,
+                              gfloat *sinogram,
+                              guint offset,
+                              guint n,
+                              gfloat correction_scale)
+{
+    ProjectionArgs args = { geometry, volume, sinogram, offset, n, correction_scale };
+
+    // Angles are independent rows of the sinogram
+    ufo_ir_parallel_for (n, forward_angles, &args);
+}
+
+void
+ufo_ir_cpu_projector_backward (const UfoIrCpuGeometry *geometry,
+                               gfloat *volume,
+                               const gfloat *sinogram,
+                               guint offset,
+                               guint n,
+                               gfloat relaxation)
+{
+    ProjectionArgs args = { geometry, sinogram, volume, offset, n, relaxation };
+
+    // Every thread owns a band of volume rows and sums all angles for it
+    ufo_ir_parallel_for (geometry->height, backward_rows, &args);
+}
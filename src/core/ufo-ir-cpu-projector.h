@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_CPU_PROJECTOR_H
+#define __UFO_IR_CPU_PROJECTOR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Host implementation of the FP_hor, FP_vert and BP kernels of
+// projector-parallel-joseph.cl, including the border behaviour of the
+// linear clamp sampler.
+typedef struct {
+    guint width;
+    guint height;
+    guint n_dets;
+    const gfloat *sin_vals;
+    const gfloat *cos_vals;
+    gfloat axis_pos;
+} UfoIrCpuGeometry;
+
+// sinogram[offset, offset + n) += correction_scale * A volume
+void ufo_ir_cpu_projector_forward  (const UfoIrCpuGeometry *geometry,
+                                    const gfloat           *volume,
+                                    gfloat                 *sinogram,
+                                    guint                   offset,
+                                    guint                   n,
+                                    gfloat                  correction_scale);
+
+// volume += relaxation * BP sinogram[offset, offset + n)
+void ufo_ir_cpu_projector_backward (const UfoIrCpuGeometry *geometry,
+                                    gfloat                 *volume,
+                                    const gfloat           *sinogram,
+                                    guint                   offset,
+                                    guint                   n,
+                                    gfloat                  relaxation);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ufo/ufo.h>
+#include "ufo-ir-exec.h"
+
+typedef struct {
+    cl_context context;
+    cl_command_queue parallel;  // NULL if the device only runs in order
+    guint depth;
+    cl_event entry;             // launches of a new branch wait for it
+    cl_event tail;              // last launch of the current branch
+    GArray *tails;              // last launches of the finished branches
+} Region;
+
+G_LOCK_DEFINE_STATIC (exec);
+static GHashTable *regions = NULL;
+
+static cl_command_queue
+create_parallel_queue (cl_command_queue cmd_queue, cl_context context)
+{
+    cl_device_id device;
+    cl_command_queue_properties supported, properties;
+    cl_command_queue parallel;
+    cl_int error;
+
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_DEVICE,
+                                                      sizeof (device), &device, NULL));
+    UFO_RESOURCES_CHECK_CLERR (clGetDeviceInfo (device, CL_DEVICE_QUEUE_PROPERTIES,
+                                                sizeof (supported), &supported, NULL));
+
+    if (!(supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
+        return NULL;
+
+    // Keep profiling so that the profiler can time the launches
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_PROPERTIES,
+                                                      sizeof (properties), &properties, NULL));
+    properties = (properties & CL_QUEUE_PROFILING_ENABLE) | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+    parallel = clCreateCommandQueue (context, device, properties, &error);
+
+    if (error != CL_SUCCESS) {
+        g_warning ("Could not create an out-of-order queue, running in order");
+        return NULL;
+    }
+
+    return parallel;
+}
+
+// Regions live as long as the process, the out-of-order queue is replaced
+// when a queue of another context reuses the address
+static Region *
+get_region (gpointer cmd_queue)
+{
+    Region *region;
+    cl_context context;
+
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_CONTEXT,
+                                                      sizeof (context), &context, NULL));
+    G_LOCK (exec);
+
+    if (regions == NULL)
+        regions = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    region = g_hash_table_lookup (regions, cmd_queue);
+
+    if (region == NULL) {
+        region = g_new0 (Region, 1);
+        region->tails = g_array_new (FALSE, FALSE, sizeof (cl_event));
+        g_hash_table_insert (regions, cmd_queue, region);
+    }
+
+    G_UNLOCK (exec);
+
+    if (region->depth == 0 && region->context != context) {
+        if (region->parallel != NULL)
+            clReleaseCommandQueue (region->parallel);
+
+        region->context = context;
+        region->parallel = create_parallel_queue (cmd_queue, context);
+    }
+
+    return region;
+}
+
+// The region cmd_queue currently branches in, NULL outside of regions
+static Region *
+active_region (gpointer cmd_queue)
+{
+    Region *region = NULL;
+
+    G_LOCK (exec);
+
+    if (regions != NULL)
+        region = g_hash_table_lookup (regions, cmd_queue);
+
+    G_UNLOCK (exec);
+
+    if (region == NULL || region->depth == 0 || region->parallel == NULL)
+        return NULL;
+
+    return region;
+}
+
+static void
+end_branch (Region *region)
+{
+    if (region->tail != NULL) {
+        g_array_append_val (region->tails, region->tail);
+        region->tail = NULL;
+    }
+}
+
+// Makes cmd_queue wait for every launch of the region
+static void
+wait_for_branches (Region *region, gpointer cmd_queue)
+{
+    end_branch (region);
+
+    if (region->tails->len == 0)
+        return;
+
+    // Other queues only see events of flushed commands
+    UFO_RESOURCES_CHECK_CLERR (clFlush (region->parallel));
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (cmd_queue, region->tails->len,
+                                                             (cl_event *) region->tails->data, NULL));
+
+    for (guint i = 0; i < region->tails->len; i++)
+        clReleaseEvent (g_array_index (region->tails, cl_event, i));
+
+    g_array_set_size (region->tails, 0);
+}
+
+static void
+set_entry (Region *region, gpointer cmd_queue)
+{
+    if (region->entry != NULL)
+        clReleaseEvent (region->entry);
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (cmd_queue, 0, NULL, &region->entry));
+}
+
+void
+ufo_ir_exec_fork (gpointer cmd_queue)
+{
+    Region *region = get_region (cmd_queue);
+
+    if (region->depth++ > 0 || region->parallel == NULL)
+        return;
+
+    // Everything enqueued before the region precedes its launches
+    set_entry (region, cmd_queue);
+    UFO_RESOURCES_CHECK_CLERR (clFlush (cmd_queue));
+}
+
+void
+ufo_ir_exec_branch (gpointer cmd_queue)
+{
+    Region *region = active_region (cmd_queue);
+
+    if (region != NULL && region->depth == 1)
+        end_branch (region);
+}
+
+void
+ufo_ir_exec_join (gpointer cmd_queue)
+{
+    Region *region = get_region (cmd_queue);
+
+    g_return_if_fail (region->depth > 0);
+
+    if (--region->depth > 0 || region->parallel == NULL)
+        return;
+
+    wait_for_branches (region, cmd_queue);
+    clReleaseEvent (region->entry);
+    region->entry = NULL;
+}
+
+cl_int
+ufo_ir_exec_enqueue (gpointer cmd_queue,
+                     gpointer kernel,
+                     cl_uint work_dim,
+                     const size_t *global_work_size,
+                     const size_t *local_work_size,
+                     cl_event *event)
+{
+    Region *region = active_region (cmd_queue);
+    cl_event launch;
+    cl_int err;
+
+    if (region == NULL)
+        return clEnqueueNDRangeKernel (cmd_queue, kernel, work_dim, NULL,
+                                       global_work_size, local_work_size,
+                                       0, NULL, event);
+
+    err = clEnqueueNDRangeKernel (region->parallel, kernel, work_dim, NULL,
+                                  global_work_size, local_work_size,
+                                  1, region->tail != NULL ? &region->tail : &region->entry,
+                                  &launch);
+
+    if (err != CL_SUCCESS)
+        return err;
+
+    if (region->tail != NULL)
+        clReleaseEvent (region->tail);
+
+    region->tail = launch;
+
+    if (event != NULL) {
+        clRetainEvent (launch);
+        *event = launch;
+    }
+
+    return CL_SUCCESS;
+}
+
+void
+ufo_ir_exec_sync (gpointer cmd_queue)
+{
+    Region *region = active_region (cmd_queue);
+
+    if (region != NULL)
+        wait_for_branches (region, cmd_queue);
+}
+
+void
+ufo_ir_exec_resume (gpointer cmd_queue)
+{
+    Region *region = active_region (cmd_queue);
+
+    if (region != NULL) {
+        set_entry (region, cmd_queue);
+        UFO_RESOURCES_CHECK_CLERR (clFlush (cmd_queue));
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_EXEC_H
+#define __UFO_IR_EXEC_H
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Regions of independent kernel launches. Between fork and join, the
+// launches on cmd_queue that are separated by ufo_ir_exec_branch may run
+// concurrently on an out-of-order queue of the same device. Launches of one
+// branch stay in order, everything enqueued after the join waits for all
+// branches. On devices without out-of-order queues the calls do nothing.
+// Regions nest, only the outermost one branches.
+void   ufo_ir_exec_fork    (gpointer cmd_queue);
+void   ufo_ir_exec_branch  (gpointer cmd_queue);
+void   ufo_ir_exec_join    (gpointer cmd_queue);
+
+// Enqueues a kernel on cmd_queue or, inside a region, on the current branch
+cl_int ufo_ir_exec_enqueue (gpointer      cmd_queue,
+                            gpointer      kernel,
+                            cl_uint       work_dim,
+                            const size_t *global_work_size,
+                            const size_t *local_work_size,
+                            cl_event     *event);
+
+// Work enqueued directly on cmd_queue inside a region, e.g. a buffer
+// conversion or read, goes between sync and resume. It runs after all
+// launches so far and before all later ones.
+void   ufo_ir_exec_sync    (gpointer cmd_queue);
+void   ufo_ir_exec_resume  (gpointer cmd_queue);
+
+G_END_DECLS
+
+#endif
@@ -18,6 +18,8 @@
  */
 
 #include "ufo-ir-gradient-processor.h"
+#include "ufo-ir-profiler.h"
+#include "ufo-ir-host-ops.h"
 
 #define KERNELS_FILE_NAME "ufo-ir-gradient-processor.cl"
 
@@ -70,23 +72,49 @@ ufo_ir_gradient_processor_finalize (GObject *object)
     G_OBJECT_CLASS (ufo_ir_gradient_processor_parent_class)->finalize (object);
 }
 
+typedef void (*HostDifference) (const gfloat *in, gfloat *out, guint width, guint height);
+
+// Runs the difference on the host when both buffers already live there
+static gboolean
+host_difference (UfoIrGradientProcessorPrivate *priv,
+                 UfoBuffer *input,
+                 UfoBuffer *output,
+                 HostDifference difference)
+{
+    UfoRequisition requisition;
+
+    if (ufo_buffer_get_location (input) != UFO_BUFFER_LOCATION_HOST ||
+        ufo_buffer_get_location (output) != UFO_BUFFER_LOCATION_HOST)
+        return FALSE;
+
+    ufo_buffer_get_requisition (input, &requisition);
+    difference (ufo_ir_profiler_get_host_array (input, priv->command_queue),
+                ufo_ir_profiler_get_host_array (output, priv->command_queue),
+                (guint) requisition.dims[0], (guint) requisition.dims[1]);
+
+    return TRUE;
+}
+
 void
 ufo_ir_gradient_processor_dx_op (UfoIrGradientProcessor *self,
                                  UfoBuffer *input,
                                  UfoBuffer *output)
 {
     UfoIrGradientProcessorPrivate *priv = UFO_IR_GRADIENT_PROCESSOR_GET_PRIVATE(self);
+
+    if (host_difference (priv, input, output, ufo_ir_host_ops_dx))
+        return;
+
     UfoRequisition requisition;
     ufo_buffer_get_requisition(input,&requisition);
     cl_kernel kernel = priv->dxKernel;
-    cl_mem d_input = ufo_buffer_get_device_array(input, priv->command_queue);
-    cl_mem d_output = ufo_buffer_get_device_array(output, priv->command_queue);
+    cl_mem d_input = ufo_ir_profiler_get_device_array (input, priv->command_queue);
+    cl_mem d_output = ufo_ir_profiler_get_device_array (output, priv->command_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_input));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_output));
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (priv->command_queue, kernel,
-                                                       requisition.n_dims, NULL, requisition.dims,
-                                                       NULL, 0, NULL, NULL));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, NULL));
 }
 
 void
@@ -95,19 +123,22 @@ ufo_ir_gradient_processor_dxt_op (UfoIrGradientProcessor *self,
                                   UfoBuffer *output)
 {
     UfoIrGradientProcessorPrivate *priv = UFO_IR_GRADIENT_PROCESSOR_GET_PRIVATE(self);
+
+    if (host_difference (priv, input, output, ufo_ir_host_ops_dxt))
+        return;
+
     UfoRequisition requisition;
     ufo_buffer_get_requisition(input,&requisition);
     cl_kernel kernel = priv->dxtKernel;
-    cl_mem d_input = ufo_buffer_get_device_array(input, priv->command_queue);
-    cl_mem d_output = ufo_buffer_get_device_array(output, priv->command_queue);
+    cl_mem d_input = ufo_ir_profiler_get_device_array (input, priv->command_queue);
+    cl_mem d_output = ufo_ir_profiler_get_device_array (output, priv->command_queue);
     int stopIndex = requisition.dims[0] - 1;
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_input));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(int), (void *) &stopIndex));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(void *), (void *) &d_output));
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (priv->command_queue, kernel,
-                                                       requisition.n_dims, NULL, requisition.dims,
-                                                       NULL, 0, NULL, NULL));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, NULL));
 }
 
 void
@@ -116,19 +147,22 @@ ufo_ir_gradient_processor_dy_op (UfoIrGradientProcessor *self,
                                  UfoBuffer *output)
 {
     UfoIrGradientProcessorPrivate *priv = UFO_IR_GRADIENT_PROCESSOR_GET_PRIVATE(self);
+
+    if (host_difference (priv, input, output, ufo_ir_host_ops_dy))
+        return;
+
     UfoRequisition requisition;
     ufo_buffer_get_requisition(input,&requisition);
     cl_kernel kernel = priv->dyKernel;
-    cl_mem d_input = ufo_buffer_get_device_array(input, priv->command_queue);
-    cl_mem d_output = ufo_buffer_get_device_array(output, priv->command_queue);
+    cl_mem d_input = ufo_ir_profiler_get_device_array (input, priv->command_queue);
+    cl_mem d_output = ufo_ir_profiler_get_device_array (output, priv->command_queue);
     int lastOffset = requisition.dims[0] * requisition.dims[1];
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_input));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(int), (void *) &lastOffset));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(void *), (void *) &d_output));
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (priv->command_queue, kernel,
-                                                       requisition.n_dims, NULL, requisition.dims,
-                                                       NULL, 0, NULL, NULL));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, NULL));
 }
 
 void
@@ -137,11 +171,15 @@ ufo_ir_gradient_processor_dyt_op (UfoIrGradientProcessor *self,
                                   UfoBuffer *output)
 {
     UfoIrGradientProcessorPrivate *priv = UFO_IR_GRADIENT_PROCESSOR_GET_PRIVATE(self);
+
+    if (host_difference (priv, input, output, ufo_ir_host_ops_dyt))
+        return;
+
     UfoRequisition requisition;
     ufo_buffer_get_requisition(input,&requisition);
     cl_kernel kernel = priv->dytKernel;
-    cl_mem d_input = ufo_buffer_get_device_array(input, priv->command_queue);
-    cl_mem d_output = ufo_buffer_get_device_array(output, priv->command_queue);
+    cl_mem d_input = ufo_ir_profiler_get_device_array (input, priv->command_queue);
+    cl_mem d_output = ufo_ir_profiler_get_device_array (output, priv->command_queue);
     gint lastOffset = requisition.dims[0] * requisition.dims[1];
     gint stopIndex = requisition.dims[1] - 1;
 
@@ -149,9 +187,8 @@ ufo_ir_gradient_processor_dyt_op (UfoIrGradientProcessor *self,
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(gint), (void *) &lastOffset));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(gint), (void *) &stopIndex));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof(void *), (void *) &d_output));
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (priv->command_queue, kernel,
-                                                       requisition.n_dims, NULL, requisition.dims,
-                                                       NULL, 0, NULL, NULL));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (priv->command_queue, kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, NULL));
 }
 
 static void
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include "ufo-ir-host-ops.h"
+#include "ufo-ir-thread-pool.h"
+
+// Elements per parallel work item, small arrays stay on the calling thread
+#define BLOCK_SIZE 16384
+
+// Independent partial sums of a reduction. Accumulating lane-wise lets the
+// compiler vectorize without reassociating a single float sum.
+#define LANES 16
+
+typedef enum {
+    OP_ADD,
+    OP_MUL,
+    OP_DIV,
+    OP_MAX,
+    OP_AFFINE,
+    OP_SET,
+    OP_INV,
+    OP_POSITIVE,
+    OP_SQRT,
+    OP_DOT,
+    OP_L1_NORM,
+    OP_MIN_MAX,
+    OP_DX,
+    OP_DXT,
+    OP_DY,
+    OP_DYT
+} Op;
+
+typedef struct {
+    Op op;
+    const gfloat *a;
+    const gfloat *b;
+    gfloat *out;
+    gfloat modifier;
+    gfloat offset;
+    gsize n;
+    guint width;
+    guint height;
+    gdouble *partial;   // One value per block, two for OP_MIN_MAX
+} Args;
+
+UFO_IR_SIMD_CLONES static void
+element_wise (const Args *args, gsize first, gsize last)
+{
+    const gfloat *a = args->a;
+    const gfloat *b = args->b;
+    gfloat *out = args->out;
+    gfloat modifier = args->modifier;
+
+    switch (args->op) {
+        case OP_ADD:
+            for (gsize i = first; i < last; i++)
+                out[i] = a[i] + modifier * b[i];
+            break;
+        case OP_MUL:
+            for (gsize i = first; i < last; i++)
+                out[i] = a[i] * b[i];
+            break;
+        case OP_DIV:
+            for (gsize i = first; i < last; i++)
+                out[i] = a[i] / b[i];
+            break;
+        case OP_MAX:
+            for (gsize i = first; i < last; i++)
+                out[i] = fmaxf (a[i], b[i]);
+            break;
+        case OP_AFFINE:
+            for (gsize i = first; i < last; i++)
+                out[i] = modifier * a[i] + args->offset;
+            break;
+        case OP_SET:
+            for (gsize i = first; i < last; i++)
+                out[i] = modifier;
+            break;
+        case OP_INV:
+            for (gsize i = first; i < last; i++)
+                out[i] = a[i] != 0.0f ? 1.0f / a[i] : 0.0f;
+            break;
+        case OP_POSITIVE:
+            for (gsize i = first; i < last; i++)
+                out[i] = a[i] > 0.0f ? a[i] : 0.0f;
+            break;
+        case OP_SQRT:
+            for (gsize i = first; i < last; i++)
+                out[i] = sqrtf (a[i]);
+            break;
+        default:
+            break;
+    }
+}
+
+UFO_IR_SIMD_CLONES static void
+reduce (const Args *args, gsize first, gsize last, gdouble *result)
+{
+    const gfloat *a = args->a;
+    const gfloat *b = args->b;
+    gfloat lanes[LANES];
+    gfloat lanes_max[LANES];
+    gsize i = first;
+
+    for (guint j = 0; j < LANES; j++) {
+        lanes[j] = args->op == OP_MIN_MAX ? a[first] : 0.0f;
+        lanes_max[j] = a[first];
+    }
+
+    switch (args->op) {
+        case OP_DOT:
+            for (; i + LANES <= last; i += LANES)
+                for (guint j = 0; j < LANES; j++)
+                    lanes[j] += a[i + j] * b[i + j];
+            break;
+        case OP_L1_NORM:
+            for (; i + LANES <= last; i += LANES)
+                for (guint j = 0; j < LANES; j++)
+                    lanes[j] += fabsf (a[i + j]);
+            break;
+        case OP_MIN_MAX:
+            for (; i + LANES <= last; i += LANES) {
+                for (guint j = 0; j < LANES; j++) {
+                    lanes[j] = fminf (lanes[j], a[i + j]);
+                    lanes_max[j] = fmaxf (lanes_max[j], a[i + j]);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (args->op == OP_MIN_MAX) {
+        gfloat min = lanes[0];
+        gfloat max = lanes_max[0];
+
+        for (guint j = 1; j < LANES; j++) {
+            min = fminf (min, lanes[j]);
+            max = fmaxf (max, lanes_max[j]);
+        }
+
+        for (; i < last; i++) {
+            min = fminf (min, a[i]);
+            max = fmaxf (max, a[i]);
+        }
+
+        result[0] = min;
+        result[1] = max;
+        return;
+    }
+
+    gdouble sum = 0.0;
+
+    for (guint j = 0; j < LANES; j++)
+        sum += lanes[j];
+
+    for (; i < last; i++)
+        sum += args->op == OP_DOT ? (gdouble) a[i] * b[i] : fabsf (a[i]);
+
+    result[0] = sum;
+}
+
+// Periodic differences of one row, see ufo-ir-gradient-processor.cl
+UFO_IR_SIMD_CLONES static void
+difference_row (const Args *args, guint y)
+{
+    guint width = args->width;
+    guint height = args->height;
+    const gfloat *in = args->a + (gsize) y * width;
+    gfloat *out = args->out + (gsize) y * width;
+    const gfloat *other;
+
+    switch (args->op) {
+        case OP_DX:
+            out[0] = in[0] - in[width - 1];
+            for (guint x = 1; x < width; x++)
+                out[x] = in[x] - in[x - 1];
+            break;
+        case OP_DXT:
+            for (guint x = 0; x + 1 < width; x++)
+                out[x] = in[x] - in[x + 1];
+            out[width - 1] = in[width - 1] - in[0];
+            break;
+        case OP_DY:
+        case OP_DYT:
+            if (args->op == OP_DY)
+                other = args->a + (gsize) (y == 0 ? height - 1 : y - 1) * width;
+            else
+                other = args->a + (gsize) (y == height - 1 ? 0 : y + 1) * width;
+
+            for (guint x = 0; x < width; x++)
+                out[x] = in[x] - other[x];
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+run_blocks (guint first, guint last, gpointer user_data)
+{
+    Args *args = user_data;
+
+    for (guint block = first; block < last; block++) {
+        gsize start = (gsize) block * BLOCK_SIZE;
+        gsize end = MIN (start + BLOCK_SIZE, args->n);
+
+        switch (args->op) {
+            case OP_DOT:
+            case OP_L1_NORM:
+                reduce (args, start, end, &args->partial[block]);
+                break;
+            case OP_MIN_MAX:
+                reduce (args, start, end, &args->partial[2 * block]);
+                break;
+            default:
+                element_wise (args, start, end);
+                break;
+        }
+    }
+}
+
+static void
+run_rows (guint first, guint last, gpointer user_data)
+{
+    for (guint y = first; y < last; y++)
+        difference_row (user_data, y);
+}
+
+static guint
+n_blocks (gsize n)
+{
+    return (guint) ((n + BLOCK_SIZE - 1) / BLOCK_SIZE);
+}
+
+static void
+run_element_wise (Op op, const gfloat *a, const gfloat *b, gfloat modifier, gfloat offset, gfloat *out, gsize n)
+{
+    Args args = { op, a, b, out, modifier, offset, n, 0, 0, NULL };
+
+    ufo_ir_parallel_for (n_blocks (n), run_blocks, &args);
+}
+
+static gdouble
+run_reduction (Op op, const gfloat *a, const gfloat *b, gsize n)
+{
+    guint blocks = n_blocks (n);
+    gdouble *partial = g_new0 (gdouble, MAX (blocks, 1));
+    Args args = { op, a, b, NULL, 0.0f, 0.0f, n, 0, 0, partial };
+    gdouble sum = 0.0;
+
+    // Blocks are summed in order, the result does not depend on threading
+    ufo_ir_parallel_for (blocks, run_blocks, &args);
+
+    for (guint i = 0; i < blocks; i++)
+        sum += partial[i];
+
+    g_free (partial);
+    return sum;
+}
+
+static void
+run_differences (Op op, const gfloat *in, gfloat *out, guint width, guint height)
+{
+    Args args = { op, in, NULL, out, 0.0f, 0.0f, (gsize) width * height, width, height, NULL };
+
+    if (width > 0)
+        ufo_ir_parallel_for (height, run_rows, &args);
+}
+
+void
+ufo_ir_host_ops_add (const gfloat *a, const gfloat *b, gfloat modifier, gfloat *out, gsize n)
+{
+    run_element_wise (OP_ADD, a, b, modifier, 0.0f, out, n);
+}
+
+void
+ufo_ir_host_ops_mul (const gfloat *a, const gfloat *b, gfloat *out, gsize n)
+{
+    run_element_wise (OP_MUL, a, b, 0.0f, 0.0f, out, n);
+}
+
+void
+ufo_ir_host_ops_div (const gfloat *a, const gfloat *b, gfloat *out, gsize n)
+{
+    run_element_wise (OP_DIV, a, b, 0.0f, 0.0f, out, n);
+}
+
+void
+ufo_ir_host_ops_max (const gfloat *a, const gfloat *b, gfloat *out, gsize n)
+{
+    run_element_wise (OP_MAX, a, b, 0.0f, 0.0f, out, n);
+}
+
+void
+ufo_ir_host_ops_affine (const gfloat *a, gfloat scale, gfloat offset, gfloat *out, gsize n)
+{
+    run_element_wise (OP_AFFINE, a, NULL, scale, offset, out, n);
+}
+
+void
+ufo_ir_host_ops_set (gfloat *out, gfloat value, gsize n)
+{
+    run_element_wise (OP_SET, NULL, NULL, value, 0.0f, out, n);
+}
+
+void
+ufo_ir_host_ops_inv (const gfloat *a, gfloat *out, gsize n)
+{
+    run_element_wise (OP_INV, a, NULL, 0.0f, 0.0f, out, n);
+}
+
+void
+ufo_ir_host_ops_positive (const gfloat *a, gfloat *out, gsize n)
+{
+    run_element_wise (OP_POSITIVE, a, NULL, 0.0f, 0.0f, out, n);
+}
+
+void
+ufo_ir_host_ops_sqrt (const gfloat *a, gfloat *out, gsize n)
+{
+    run_element_wise (OP_SQRT, a, NULL, 0.0f, 0.0f, out, n);
+}
+
+gdouble
+ufo_ir_host_ops_dot (const gfloat *a, const gfloat *b, gsize n)
+{
+    return run_reduction (OP_DOT, a, b, n);
+}
+
+gdouble
+ufo_ir_host_ops_l1_norm (const gfloat *a, gsize n)
+{
+    return run_reduction (OP_L1_NORM, a, NULL, n);
+}
+
+void
+ufo_ir_host_ops_min_max (const gfloat *a, gsize n, gfloat *min, gfloat *max)
+{
+    guint blocks = n_blocks (n);
+    gdouble *partial = g_new (gdouble, 2 * MAX (blocks, 1));
+    Args args = { OP_MIN_MAX, a, NULL, NULL, 0.0f, 0.0f, n, 0, 0, partial };
+
+    *min = G_MAXFLOAT;
+    *max = -G_MAXFLOAT;
+
+    ufo_ir_parallel_for (blocks, run_blocks, &args);
+
+    for (guint i = 0; i < blocks; i++) {
+        *min = MIN (*min, (gfloat) partial[2 * i]);
+        *max = MAX (*max, (gfloat) partial[2 * i + 1]);
+    }
+
+    g_free (partial);
+}
+
+void
+ufo_ir_host_ops_dx (const gfloat *in, gfloat *out, guint width, guint height)
+{
+    run_differences (OP_DX, in, out, width, height);
+}
+
+void
+ufo_ir_host_ops_dxt (const gfloat *in, gfloat *out, guint width, guint height)
+{
+    run_differences (OP_DXT, in, out, width, height);
+}
+
+void
+ufo_ir_host_ops_dy (const gfloat *in, gfloat *out, guint width, guint height)
+{
+    run_differences (OP_DY, in, out, width, height);
+}
+
+void
+ufo_ir_host_ops_dyt (const gfloat *in, gfloat *out, guint width, guint height)
+{
+    run_differences (OP_DYT, in, out, width, height);
+}
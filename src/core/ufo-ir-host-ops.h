@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_HOST_OPS_H
+#define __UFO_IR_HOST_OPS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Multithreaded host versions of the basic ops and gradient kernels. The
+// outputs of element-wise ops may alias their inputs, those of the
+// differences may not.
+
+// out = a + modifier * b
+void    ufo_ir_host_ops_add      (const gfloat *a, const gfloat *b, gfloat modifier, gfloat *out, gsize n);
+void    ufo_ir_host_ops_mul      (const gfloat *a, const gfloat *b, gfloat *out, gsize n);
+void    ufo_ir_host_ops_div      (const gfloat *a, const gfloat *b, gfloat *out, gsize n);
+void    ufo_ir_host_ops_max      (const gfloat *a, const gfloat *b, gfloat *out, gsize n);
+// out = scale * a + offset
+void    ufo_ir_host_ops_affine   (const gfloat *a, gfloat scale, gfloat offset, gfloat *out, gsize n);
+void    ufo_ir_host_ops_set      (gfloat *out, gfloat value, gsize n);
+// 1 / a, 0 where a is 0
+void    ufo_ir_host_ops_inv      (const gfloat *a, gfloat *out, gsize n);
+void    ufo_ir_host_ops_positive (const gfloat *a, gfloat *out, gsize n);
+void    ufo_ir_host_ops_sqrt     (const gfloat *a, gfloat *out, gsize n);
+
+gdouble ufo_ir_host_ops_dot      (const gfloat *a, const gfloat *b, gsize n);
+gdouble ufo_ir_host_ops_l1_norm  (const gfloat *a, gsize n);
+void    ufo_ir_host_ops_min_max  (const gfloat *a, gsize n, gfloat *min, gfloat *max);
+
+// Periodic forward differences and their transposes as in
+// ufo-ir-gradient-processor.cl
+void    ufo_ir_host_ops_dx       (const gfloat *in, gfloat *out, guint width, guint height);
+void    ufo_ir_host_ops_dxt      (const gfloat *in, gfloat *out, guint width, guint height);
+void    ufo_ir_host_ops_dy       (const gfloat *in, gfloat *out, guint width, guint height);
+void    ufo_ir_host_ops_dyt      (const gfloat *in, gfloat *out, guint width, guint height);
+
+G_END_DECLS
+
+#endif
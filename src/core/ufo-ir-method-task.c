@@ -24,7 +24,31 @@
 #endif
 
 #include "ufo-ir-method-task.h"
+#include "ufo-ir-profiler.h"
+#include "ufo-ir-basic-ops.h"
 #include <ufo/ufo.h>
+#include <stdio.h>
+#include <string.h>
+
+// Scalars a method can report for a single iteration
+#define MAX_TELEMETRY_VALUES 16
+
+// Lanes in use, the memory plan may allow fewer than requested, previews
+// reuse their reduced buffers and estimates come out in iteration order
+#define N_LANES(priv) ((priv)->preview || (priv)->emit_every > 0 ? 1 : MIN ((priv)->n_lanes, (priv)->planned_lanes))
+
+// Set for methods that called next_lane
+#define LANES_ACTIVE(priv) (N_LANES (priv) > 1 && (priv)->n_slices > 0)
+
+// Pinned staging memory and device copy of one in-flight input slice
+typedef struct {
+    cl_mem pinned;
+    gpointer host;
+    gsize size;
+    UfoBuffer *device;
+    cl_event free;      // the slice that used the slot last is done
+    cl_event upload;
+} PrefetchSlot;
 
 // Private methods definitions
 // Class related methods
@@ -43,6 +67,12 @@ static void ufo_ir_method_task_get_requisition (UfoTask *task, UfoBuffer **input
 // IrMethod private Methods
 
 static const gchar *ufo_ir_method_task_get_package_name (UfoTaskNode *self);
+static void telemetry_write (UfoIrMethodTaskPrivate *priv, guint iteration, gdouble seconds);
+static void telemetry_close (UfoIrMethodTaskPrivate *priv);
+static void prefetch_release (UfoIrMethodTaskPrivate *priv);
+static void lanes_release (UfoIrMethodTaskPrivate *priv);
+static gboolean ensure_transfer_queue (UfoIrMethodTaskPrivate *priv, cl_command_queue cmd_queue);
+static void plan_memory (UfoIrMethodTask *self, UfoBuffer *input, UfoRequisition *requisition, GError **error);
 
 G_DEFINE_TYPE_WITH_CODE (UfoIrMethodTask, ufo_ir_method_task, UFO_TYPE_TASK_NODE,
                          G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK, ufo_task_interface_init))
@@ -52,16 +82,86 @@ G_DEFINE_TYPE_WITH_CODE (UfoIrMethodTask, ufo_ir_method_task, UFO_TYPE_TASK_NODE
 struct _UfoIrMethodTaskPrivate {
     UfoIrProjectorTask *projector;
     guint iterations_number;
+    gboolean profiling;
+
+    // telemetry
+    gchar *telemetry;
+    FILE *telemetry_fp;
+    gboolean telemetry_json;
+    gboolean telemetry_active;
+    guint telemetry_rows;
+    gint64 iteration_start;
+    const gchar *columns[MAX_TELEMETRY_VALUES];
+    guint n_columns;
+    const gchar *names[MAX_TELEMETRY_VALUES];
+    gdouble values[MAX_TELEMETRY_VALUES];
+    guint n_values;
+
+    // prefetch
+    gboolean prefetch;
+    cl_command_queue transfer_queue;
+    PrefetchSlot slots[2];
+    guint slot;
+    UfoBuffer *staged_inputs[1];
+
+    // concurrent slices, each lane has its own queue and the event marking
+    // the end of its last slice
+    guint n_lanes;
+    guint lane;
+    guint n_slices;
+    cl_command_queue lanes[UFO_IR_METHOD_TASK_MAX_LANES];
+    cl_event lane_done[UFO_IR_METHOD_TASK_MAX_LANES];
+    UfoBuffer *lane_inputs[UFO_IR_METHOD_TASK_MAX_LANES];
+
+    // device memory plan
+    guint memory_budget;
+    guint planned_lanes;
+    guint planned_tile_rows;    // tile rows the plan set on the projector
+    gboolean tiles_rejected;
+    gsize planned_size;
+
+    // preview, the slice is reconstructed with a copy of the projector on
+    // the binned and decimated sinogram and upsampled
+    gboolean preview;
+    guint preview_binning;
+    guint preview_angle_stride;
+    gboolean in_preview;
+    UfoIrProjectorTask *preview_projector;
+    UfoBuffer *preview_sinogram;
+    UfoBuffer *preview_volume;
+    gpointer bin_kernel;
+    gpointer prolongate_kernel;
+    gpointer context;
+
+    // emit-every, stop may be requested from any thread
+    guint emit_every;
+    gint stop;
 };
 
 enum {
     PROP_0,
     PROP_PROJECTOR,
     PROP_ITERATIONS_NUMBER,
+    PROP_PROFILING,
+    PROP_TELEMETRY,
+    PROP_PREFETCH,
+    PROP_CONCURRENT_SLICES,
+    PROP_MEMORY_BUDGET,
+    PROP_PREVIEW,
+    PROP_PREVIEW_BINNING,
+    PROP_PREVIEW_ANGLE_STRIDE,
+    PROP_EMIT_EVERY,
     N_PROPERTIES
 };
 
+enum {
+    ITERATION,
+    ESTIMATE,
+    LAST_SIGNAL
+};
+
 static GParamSpec *properties[N_PROPERTIES] = {NULL, };
+static guint signals[LAST_SIGNAL] = { 0 };
 
 static void
 ufo_ir_method_task_class_init (UfoIrMethodTaskClass *klass)
@@ -83,14 +183,120 @@ ufo_ir_method_task_class_init (UfoIrMethodTaskClass *klass)
                                 "Current projector",
                                 UFO_IR_TYPE_PROJECTOR_TASK,
                                 G_PARAM_READWRITE);
+
+    // Record every kernel launch and write a summary table and a
+    // Chrome trace when the task is destroyed
+    properties[PROP_PROFILING] =
+            g_param_spec_boolean("profiling",
+                                 "Profile OpenCL kernels",
+                                 "Profile OpenCL kernels",
+                                 FALSE,
+                                 G_PARAM_READWRITE);
+
+    // File receiving one row per iteration with the wall time and the
+    // scalars reported by the method, JSON if it ends with .json, CSV
+    // otherwise
+    properties[PROP_TELEMETRY] =
+            g_param_spec_string("telemetry",
+                                "Telemetry output file",
+                                "Telemetry output file",
+                                NULL,
+                                G_PARAM_READWRITE);
+
+    // Upload the input and hand the output to downstream tasks on a second
+    // command queue, so transfers overlap with the iterations of the
+    // neighbouring slices
+    properties[PROP_PREFETCH] =
+            g_param_spec_boolean("prefetch",
+                                 "Overlap slice transfers with iterations",
+                                 "Overlap slice transfers with iterations",
+                                 FALSE,
+                                 G_PARAM_READWRITE);
+
+    // Slices reconstructed at the same time on as many command queues of
+    // the device, each with its own workspace
+    properties[PROP_CONCURRENT_SLICES] =
+            g_param_spec_uint("concurrent-slices",
+                              "Number of slices reconstructed concurrently",
+                              "Number of slices reconstructed concurrently",
+                              1, UFO_IR_METHOD_TASK_MAX_LANES, 1,
+                              G_PARAM_READWRITE);
+
+    // Caps the workspace of the slices, several reconstructions can share a
+    // device this way
+    properties[PROP_MEMORY_BUDGET] =
+            g_param_spec_uint("memory-budget",
+                              "Device memory for the slices in MiB, 0 derives it from the device",
+                              "Device memory for the slices in MiB, 0 derives it from the device",
+                              0, G_MAXUINT, 0,
+                              G_PARAM_READWRITE);
+
+    // Fast low resolution reconstruction for alignment, reusing the kernels
+    // of the projector on a reduced grid
+    properties[PROP_PREVIEW] =
+            g_param_spec_boolean("preview",
+                                 "Reconstruct binned and decimated slices",
+                                 "Reconstruct binned and decimated slices",
+                                 FALSE,
+                                 G_PARAM_READWRITE);
+
+    properties[PROP_PREVIEW_BINNING] =
+            g_param_spec_uint("preview-binning",
+                              "Detectors binned in a preview",
+                              "Detectors binned in a preview",
+                              1, 16, 4,
+                              G_PARAM_READWRITE);
+
+    properties[PROP_PREVIEW_ANGLE_STRIDE] =
+            g_param_spec_uint("preview-angle-stride",
+                              "Every n-th angle is used in a preview",
+                              "Every n-th angle is used in a preview",
+                              1, 64, 4,
+                              G_PARAM_READWRITE);
+
+    // Hands intermediate estimates to the estimate signal
+    properties[PROP_EMIT_EVERY] =
+            g_param_spec_uint("emit-every",
+                              "Emit the estimate every n iterations, 0 only outputs the result",
+                              "Emit the estimate every n iterations, 0 only outputs the result",
+                              0, G_MAXUINT, 0,
+                              G_PARAM_READWRITE);
+
     for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++){
         g_object_class_install_property (gobject_class, i, properties[i]);
     }
 
+    // Emitted after every iteration with its number and wall time, the
+    // reported scalars are available via ufo_ir_method_task_get_telemetry_value
+    signals[ITERATION] =
+            g_signal_new ("iteration",
+                          G_TYPE_FROM_CLASS (klass),
+                          G_SIGNAL_RUN_LAST,
+                          0, NULL, NULL,
+                          g_cclosure_marshal_generic,
+                          G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_DOUBLE);
+
+    // Emitted every emit-every iterations with the number of the iteration
+    // and the estimate, which is only valid during the emission and stays
+    // where the method keeps it. Handlers copy what they want to keep and
+    // may call ufo_ir_method_task_stop to finish the slice with it.
+    signals[ESTIMATE] =
+            g_signal_new ("estimate",
+                          G_TYPE_FROM_CLASS (klass),
+                          G_SIGNAL_RUN_LAST,
+                          0, NULL, NULL,
+                          g_cclosure_marshal_generic,
+                          G_TYPE_NONE, 2, G_TYPE_UINT, UFO_TYPE_BUFFER);
+
     g_type_class_add_private (gobject_class, sizeof(UfoIrMethodTaskPrivate));
 
     UfoTaskNodeClass *taskklass = UFO_TASK_NODE_CLASS (klass);
     taskklass->get_package_name = ufo_ir_method_task_get_package_name;
+
+    klass->refine = NULL;
+    klass->n_volumes = 1;
+    klass->n_sinograms = 1;
+    klass->host_storage = FALSE;
 }
 
 static void
@@ -109,6 +315,28 @@ ufo_ir_method_task_init(UfoIrMethodTask *self)
     self->priv = UFO_IR_METHOD_TASK_GET_PRIVATE(self);
     self->priv->projector = NULL;
     self->priv->iterations_number = 10;
+    self->priv->profiling = FALSE;
+    self->priv->telemetry = NULL;
+    self->priv->telemetry_fp = NULL;
+    self->priv->telemetry_active = FALSE;
+    self->priv->n_columns = 0;
+    self->priv->n_values = 0;
+    self->priv->n_lanes = 1;
+    self->priv->memory_budget = 0;
+    self->priv->planned_lanes = UFO_IR_METHOD_TASK_MAX_LANES;
+    self->priv->planned_tile_rows = 0;
+    self->priv->tiles_rejected = FALSE;
+    self->priv->planned_size = 0;
+    self->priv->preview = FALSE;
+    self->priv->preview_binning = 4;
+    self->priv->preview_angle_stride = 4;
+    self->priv->emit_every = 0;
+    self->priv->stop = FALSE;
+
+    const gchar *profiling = g_getenv (UFO_IR_PROFILING_ENV);
+
+    if (profiling != NULL && *profiling != '\0' && g_strcmp0 (profiling, "0"))
+        ufo_ir_method_task_set_profiling (self, TRUE);
 }
 
 static void
@@ -126,6 +354,33 @@ ufo_ir_method_task_set_property (GObject      *object,
         case PROP_PROJECTOR:
             ufo_ir_method_task_set_projector(self, UFO_IR_PROJECTOR_TASK(g_value_get_object(value)));
             break;
+        case PROP_PROFILING:
+            ufo_ir_method_task_set_profiling(self, g_value_get_boolean(value));
+            break;
+        case PROP_TELEMETRY:
+            ufo_ir_method_task_set_telemetry(self, g_value_get_string(value));
+            break;
+        case PROP_PREFETCH:
+            ufo_ir_method_task_set_prefetch(self, g_value_get_boolean(value));
+            break;
+        case PROP_CONCURRENT_SLICES:
+            ufo_ir_method_task_set_concurrent_slices(self, g_value_get_uint(value));
+            break;
+        case PROP_MEMORY_BUDGET:
+            ufo_ir_method_task_set_memory_budget(self, g_value_get_uint(value));
+            break;
+        case PROP_PREVIEW:
+            ufo_ir_method_task_set_preview(self, g_value_get_boolean(value));
+            break;
+        case PROP_PREVIEW_BINNING:
+            ufo_ir_method_task_set_preview_binning(self, g_value_get_uint(value));
+            break;
+        case PROP_PREVIEW_ANGLE_STRIDE:
+            ufo_ir_method_task_set_preview_angle_stride(self, g_value_get_uint(value));
+            break;
+        case PROP_EMIT_EVERY:
+            ufo_ir_method_task_set_emit_every(self, g_value_get_uint(value));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -147,6 +402,33 @@ ufo_ir_method_task_get_property (GObject    *object,
         case PROP_PROJECTOR:
             g_value_set_object(value, ufo_ir_method_task_get_projector(self));
             break;
+        case PROP_PROFILING:
+            g_value_set_boolean(value, ufo_ir_method_task_get_profiling(self));
+            break;
+        case PROP_TELEMETRY:
+            g_value_set_string(value, ufo_ir_method_task_get_telemetry(self));
+            break;
+        case PROP_PREFETCH:
+            g_value_set_boolean(value, ufo_ir_method_task_get_prefetch(self));
+            break;
+        case PROP_CONCURRENT_SLICES:
+            g_value_set_uint(value, ufo_ir_method_task_get_concurrent_slices(self));
+            break;
+        case PROP_MEMORY_BUDGET:
+            g_value_set_uint(value, ufo_ir_method_task_get_memory_budget(self));
+            break;
+        case PROP_PREVIEW:
+            g_value_set_boolean(value, ufo_ir_method_task_get_preview(self));
+            break;
+        case PROP_PREVIEW_BINNING:
+            g_value_set_uint(value, ufo_ir_method_task_get_preview_binning(self));
+            break;
+        case PROP_PREVIEW_ANGLE_STRIDE:
+            g_value_set_uint(value, ufo_ir_method_task_get_preview_angle_stride(self));
+            break;
+        case PROP_EMIT_EVERY:
+            g_value_set_uint(value, ufo_ir_method_task_get_emit_every(self));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -185,6 +467,1082 @@ ufo_ir_method_task_set_iterations_number (UfoIrMethodTask *self, guint value)
     priv->iterations_number = value;
 }
 
+gboolean
+ufo_ir_method_task_get_profiling (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->profiling;
+}
+
+void
+ufo_ir_method_task_set_profiling (UfoIrMethodTask *self, gboolean value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    if (priv->profiling == value)
+        return;
+
+    if (value) {
+        // A value other than "1" in the environment names the report files
+        const gchar *prefix = g_getenv (UFO_IR_PROFILING_ENV);
+
+        if (!g_strcmp0 (prefix, "1") || !g_strcmp0 (prefix, "0"))
+            prefix = NULL;
+
+        ufo_ir_profiler_acquire (prefix);
+    }
+    else {
+        ufo_ir_profiler_release ();
+    }
+
+    priv->profiling = value;
+}
+
+void
+ufo_ir_method_task_profile_scope (UfoIrMethodTask *self, guint iteration, gint subset)
+{
+    if (!ufo_ir_profiler_is_active ())
+        return;
+
+    const gchar *name = ufo_task_node_get_plugin_name (UFO_TASK_NODE (self));
+
+    ufo_ir_profiler_set_scope (ufo_ir_method_task_get_cmd_queue (self),
+                               name != NULL ? name : G_OBJECT_TYPE_NAME (self),
+                               iteration, subset);
+}
+
+void
+ufo_ir_method_task_profile_slice (UfoIrMethodTask *self)
+{
+    if (!ufo_ir_profiler_is_active ())
+        return;
+
+    const gchar *name = ufo_task_node_get_plugin_name (UFO_TASK_NODE (self));
+
+    ufo_ir_profiler_clear_scope (ufo_ir_method_task_get_cmd_queue (self),
+                                 name != NULL ? name : G_OBJECT_TYPE_NAME (self));
+}
+
+gboolean
+ufo_ir_method_task_get_prefetch (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->prefetch;
+}
+
+void
+ufo_ir_method_task_set_prefetch (UfoIrMethodTask *self, gboolean value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    if (!value)
+        prefetch_release (priv);
+
+    priv->prefetch = value;
+}
+
+static cl_command_queue
+node_cmd_queue (UfoIrMethodTask *self)
+{
+    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE (self)));
+    return ufo_gpu_node_get_cmd_queue (node);
+}
+
+guint
+ufo_ir_method_task_get_concurrent_slices (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->n_lanes;
+}
+
+void
+ufo_ir_method_task_set_concurrent_slices (UfoIrMethodTask *self, guint value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    value = CLAMP (value, 1, UFO_IR_METHOD_TASK_MAX_LANES);
+
+    if (priv->n_lanes == value)
+        return;
+
+    lanes_release (priv);
+    priv->n_lanes = value;
+}
+
+static void
+lanes_release (UfoIrMethodTaskPrivate *priv)
+{
+    for (guint i = 0; i < UFO_IR_METHOD_TASK_MAX_LANES; i++) {
+        if (priv->lane_inputs[i] != NULL) {
+            g_object_unref (priv->lane_inputs[i]);
+            priv->lane_inputs[i] = NULL;
+        }
+
+        if (priv->lanes[i] != NULL) {
+            clFinish (priv->lanes[i]);
+            clReleaseCommandQueue (priv->lanes[i]);
+            priv->lanes[i] = NULL;
+        }
+
+        if (priv->lane_done[i] != NULL) {
+            clReleaseEvent (priv->lane_done[i]);
+            priv->lane_done[i] = NULL;
+        }
+    }
+
+    priv->lane = 0;
+    priv->n_slices = 0;
+}
+
+// In-order queue on the device and context of cmd_queue, keeping profiling
+// so that the profiler can time the launches
+static cl_command_queue
+create_lane_queue (cl_command_queue cmd_queue)
+{
+    cl_context context;
+    cl_device_id device;
+    cl_command_queue_properties properties;
+    cl_command_queue lane;
+    cl_int error;
+
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_CONTEXT,
+                                                      sizeof (context), &context, NULL));
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_DEVICE,
+                                                      sizeof (device), &device, NULL));
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_PROPERTIES,
+                                                      sizeof (properties), &properties, NULL));
+    lane = clCreateCommandQueue (context, device, properties & CL_QUEUE_PROFILING_ENABLE, &error);
+
+    return error == CL_SUCCESS ? lane : NULL;
+}
+
+gpointer
+ufo_ir_method_task_next_lane (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    cl_command_queue cmd_queue = node_cmd_queue (self);
+    guint lane = priv->n_slices++ % N_LANES (priv);
+
+    // A lane on the queue of the proc node would hold back the copies of
+    // the other lanes and the tasks downstream, so every lane gets its own
+    if (N_LANES (priv) > 1 && priv->lanes[lane] == NULL) {
+        priv->lanes[lane] = create_lane_queue (cmd_queue);
+
+        if (priv->lanes[lane] == NULL) {
+            g_warning ("Could not create a command queue, reconstructing one slice at a time");
+            lanes_release (priv);
+            priv->n_lanes = 1;
+            lane = 0;
+        }
+    }
+
+    priv->lane = lane;
+
+    if (N_LANES (priv) > 1)
+        cmd_queue = priv->lanes[lane];
+
+    if (priv->projector != NULL)
+        ufo_ir_state_dependent_task_set_cmd_queue (UFO_IR_STATE_DEPENDENT_TASK (priv->projector),
+                                                   N_LANES (priv) > 1 ? cmd_queue : NULL);
+
+    // The lane still has the scope of its previous slice
+    ufo_ir_method_task_profile_slice (self);
+
+    return cmd_queue;
+}
+
+guint
+ufo_ir_method_task_get_lane (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->lane;
+}
+
+gpointer
+ufo_ir_method_task_get_cmd_queue (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    if (N_LANES (priv) > 1 && priv->lanes[priv->lane] != NULL)
+        return priv->lanes[priv->lane];
+
+    return node_cmd_queue (self);
+}
+
+// Copies the input into a device buffer owned by the lane. The copy runs on
+// the transfer queue after the previous slice of the lane released the
+// buffer and the lane waits for it on the device. Host inputs are written
+// blocking because upstream reuses them once process returns, which keeps
+// the host at most one slice per lane ahead.
+static UfoBuffer **
+stage_on_lane (UfoIrMethodTask *self, UfoBuffer **inputs)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    UfoBuffer **staged = &priv->lane_inputs[priv->lane];
+    cl_command_queue cmd_queue = ufo_ir_method_task_get_cmd_queue (self);
+    cl_command_queue copy_queue = cmd_queue;
+    gsize size = ufo_buffer_get_size (inputs[0]);
+    UfoRequisition requisition;
+    cl_event waits[2];
+    cl_uint n_waits = 0;
+    cl_event copied;
+    cl_mem device;
+
+    ufo_buffer_get_requisition (inputs[0], &requisition);
+
+    if (*staged != NULL &&
+        (ufo_buffer_cmp_dimensions (*staged, &requisition) ||
+         ufo_buffer_get_location (*staged) != UFO_BUFFER_LOCATION_DEVICE)) {
+        g_object_unref (*staged);
+        *staged = NULL;
+    }
+
+    if (*staged == NULL)
+        *staged = ufo_buffer_dup (inputs[0]);
+
+    device = ufo_ir_profiler_get_device_array (*staged, cmd_queue);
+
+    if (ensure_transfer_queue (priv, cmd_queue))
+        copy_queue = priv->transfer_queue;
+
+    if (priv->lane_done[priv->lane] != NULL)
+        waits[n_waits++] = priv->lane_done[priv->lane];
+
+    if (ufo_buffer_get_location (inputs[0]) == UFO_BUFFER_LOCATION_HOST) {
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueWriteBuffer (copy_queue, device, CL_TRUE, 0, size,
+                                                         ufo_ir_profiler_get_host_array (inputs[0], cmd_queue),
+                                                         n_waits, n_waits > 0 ? waits : NULL, &copied));
+    }
+    else {
+        // Upstream kernels wrote the input on the queue of the proc node and
+        // must not overwrite it before the copy
+        cl_command_queue node_queue = node_cmd_queue (self);
+        cl_mem source = ufo_ir_profiler_get_device_array (inputs[0], node_queue);
+
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (node_queue, 0, NULL, &waits[n_waits]));
+        UFO_RESOURCES_CHECK_CLERR (clFlush (node_queue));
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueCopyBuffer (copy_queue, source, device, 0, 0, size,
+                                                        n_waits + 1, waits, &copied));
+        UFO_RESOURCES_CHECK_CLERR (clFlush (copy_queue));
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (node_queue, 1, &copied, NULL));
+        clReleaseEvent (waits[n_waits]);
+    }
+
+    if (copy_queue != cmd_queue)
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (cmd_queue, 1, &copied, NULL));
+
+    clReleaseEvent (copied);
+
+    priv->staged_inputs[0] = *staged;
+    return priv->staged_inputs;
+}
+
+// The end of the slice frees the staged input of the lane. Tasks downstream
+// run on the queue of the proc node, which waits for this lane only, and
+// downloads on the host side run on the lane itself.
+static void
+publish_on_lane (UfoIrMethodTask *self, UfoBuffer *output)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    UfoBufferLocation location = ufo_buffer_get_location (output);
+    cl_command_queue cmd_queue = ufo_ir_method_task_get_cmd_queue (self);
+    cl_event *done = &priv->lane_done[priv->lane];
+
+    if (*done != NULL)
+        clReleaseEvent (*done);
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (cmd_queue, 0, NULL, done));
+    UFO_RESOURCES_CHECK_CLERR (clFlush (cmd_queue));
+
+    if (location != UFO_BUFFER_LOCATION_DEVICE && location != UFO_BUFFER_LOCATION_DEVICE_IMAGE)
+        return;
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (node_cmd_queue (self), 1, done, NULL));
+
+    if (location == UFO_BUFFER_LOCATION_DEVICE)
+        ufo_ir_profiler_get_device_array (output, cmd_queue);
+    else
+        ufo_ir_profiler_get_device_image (output, cmd_queue);
+}
+
+static void
+prefetch_release_slot (UfoIrMethodTaskPrivate *priv, PrefetchSlot *slot)
+{
+    if (slot->upload != NULL)
+        clWaitForEvents (1, &slot->upload);
+
+    if (slot->pinned != NULL) {
+        clEnqueueUnmapMemObject (priv->transfer_queue, slot->pinned, slot->host, 0, NULL, NULL);
+        clFinish (priv->transfer_queue);
+        clReleaseMemObject (slot->pinned);
+    }
+
+    if (slot->device != NULL)
+        g_object_unref (slot->device);
+
+    if (slot->free != NULL)
+        clReleaseEvent (slot->free);
+
+    if (slot->upload != NULL)
+        clReleaseEvent (slot->upload);
+
+    memset (slot, 0, sizeof (PrefetchSlot));
+}
+
+static void
+prefetch_release (UfoIrMethodTaskPrivate *priv)
+{
+    if (priv->transfer_queue == NULL)
+        return;
+
+    for (guint i = 0; i < G_N_ELEMENTS (priv->slots); i++)
+        prefetch_release_slot (priv, &priv->slots[i]);
+
+    clFinish (priv->transfer_queue);
+    clReleaseCommandQueue (priv->transfer_queue);
+    priv->transfer_queue = NULL;
+}
+
+// Second in-order queue on the device and context of cmd_queue
+static gboolean
+ensure_transfer_queue (UfoIrMethodTaskPrivate *priv, cl_command_queue cmd_queue)
+{
+    cl_context context;
+    cl_device_id device;
+    cl_int error;
+
+    if (priv->transfer_queue != NULL)
+        return TRUE;
+
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_CONTEXT,
+                                                      sizeof (context), &context, NULL));
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_DEVICE,
+                                                      sizeof (device), &device, NULL));
+    priv->transfer_queue = clCreateCommandQueue (context, device, 0, &error);
+
+    if (error != CL_SUCCESS) {
+        g_warning ("Could not create a transfer queue, inputs are copied on the command queue");
+        priv->transfer_queue = NULL;
+        priv->prefetch = FALSE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// Pinned staging memory and a device buffer like input, both reused while
+// the slice size stays the same
+static void
+prefetch_prepare_slot (UfoIrMethodTaskPrivate *priv,
+                       PrefetchSlot *slot,
+                       UfoBuffer *input,
+                       cl_command_queue cmd_queue)
+{
+    gsize size = ufo_buffer_get_size (input);
+    cl_context context;
+    cl_int error;
+
+    if (slot->upload != NULL) {
+        // The staging memory is written again below
+        UFO_RESOURCES_CHECK_CLERR (clWaitForEvents (1, &slot->upload));
+        clReleaseEvent (slot->upload);
+        slot->upload = NULL;
+    }
+
+    if (slot->size != size) {
+        cl_event free = slot->free;
+
+        slot->free = NULL;
+        prefetch_release_slot (priv, slot);
+        slot->free = free;
+
+        UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_CONTEXT,
+                                                          sizeof (context), &context, NULL));
+        slot->pinned = clCreateBuffer (context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &error);
+        UFO_RESOURCES_CHECK_CLERR (error);
+        slot->host = clEnqueueMapBuffer (priv->transfer_queue, slot->pinned, CL_TRUE, CL_MAP_WRITE,
+                                         0, size, 0, NULL, NULL, &error);
+        UFO_RESOURCES_CHECK_CLERR (error);
+        slot->size = size;
+    }
+
+    // Methods may have moved the last slice off the device, a new buffer is
+    // allocated there without a transfer
+    if (slot->device != NULL && ufo_buffer_get_location (slot->device) != UFO_BUFFER_LOCATION_DEVICE) {
+        g_object_unref (slot->device);
+        slot->device = NULL;
+    }
+
+    if (slot->device == NULL) {
+        slot->device = ufo_buffer_dup (input);
+        ufo_ir_profiler_get_device_array (slot->device, cmd_queue);
+    }
+}
+
+UfoBuffer **
+ufo_ir_method_task_stage_inputs (UfoIrMethodTask *self, UfoBuffer **inputs)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    cl_command_queue cmd_queue;
+    PrefetchSlot *slot;
+    cl_event done;
+
+    // Other lanes run while this one uploads, prefetching is not needed
+    if (LANES_ACTIVE (priv))
+        return stage_on_lane (self, inputs);
+
+    if (!priv->prefetch || ufo_buffer_get_location (inputs[0]) != UFO_BUFFER_LOCATION_HOST)
+        return inputs;
+
+    cmd_queue = node_cmd_queue (self);
+
+    if (!ensure_transfer_queue (priv, cmd_queue))
+        return inputs;
+
+    slot = &priv->slots[priv->slot];
+    priv->slot = (priv->slot + 1) % G_N_ELEMENTS (priv->slots);
+
+    // Everything enqueued so far belongs to the previous slice, whose slot
+    // is the next one to be reused
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (cmd_queue, 0, NULL, &done));
+    UFO_RESOURCES_CHECK_CLERR (clFlush (cmd_queue));
+
+    if (priv->slots[priv->slot].free != NULL)
+        clReleaseEvent (priv->slots[priv->slot].free);
+
+    priv->slots[priv->slot].free = done;
+
+    prefetch_prepare_slot (priv, slot, inputs[0], cmd_queue);
+    memcpy (slot->host, ufo_ir_profiler_get_host_array (inputs[0], cmd_queue), slot->size);
+
+    // The upload only waits for the slice before the previous one, kernels
+    // of this slice wait for the upload
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueWriteBuffer (priv->transfer_queue,
+                                                     ufo_ir_profiler_get_device_array (slot->device, cmd_queue),
+                                                     CL_FALSE, 0, slot->size, slot->host,
+                                                     slot->free != NULL ? 1 : 0,
+                                                     slot->free != NULL ? &slot->free : NULL,
+                                                     &slot->upload));
+    UFO_RESOURCES_CHECK_CLERR (clFlush (priv->transfer_queue));
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (cmd_queue, 1, &slot->upload, NULL));
+
+    priv->staged_inputs[0] = slot->device;
+    return priv->staged_inputs;
+}
+
+void
+ufo_ir_method_task_publish_output (UfoIrMethodTask *self, UfoBuffer *output)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    UfoBufferLocation location = ufo_buffer_get_location (output);
+    cl_command_queue cmd_queue;
+    cl_event done;
+
+    // Tasks downstream access host arrays without the profiler
+    ufo_ir_profiler_sync_host (output);
+
+    if (LANES_ACTIVE (priv)) {
+        publish_on_lane (self, output);
+        return;
+    }
+
+    if (!priv->prefetch || priv->transfer_queue == NULL ||
+        (location != UFO_BUFFER_LOCATION_DEVICE && location != UFO_BUFFER_LOCATION_DEVICE_IMAGE))
+        return;
+
+    cmd_queue = node_cmd_queue (self);
+
+    // The transfer queue waits for this slice only, the download downstream
+    // then runs while the next slice iterates on cmd_queue
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (cmd_queue, 0, NULL, &done));
+    UFO_RESOURCES_CHECK_CLERR (clFlush (cmd_queue));
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (priv->transfer_queue, 1, &done, NULL));
+    clReleaseEvent (done);
+
+    // Makes the transfer queue the one the buffer downloads on
+    if (location == UFO_BUFFER_LOCATION_DEVICE)
+        ufo_ir_profiler_get_device_array (output, priv->transfer_queue);
+    else
+        ufo_ir_profiler_get_device_image (output, priv->transfer_queue);
+}
+
+const gchar *
+ufo_ir_method_task_get_telemetry (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->telemetry;
+}
+
+void
+ufo_ir_method_task_set_telemetry (UfoIrMethodTask *self, const gchar *value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    telemetry_close (priv);
+    g_free (priv->telemetry);
+    priv->telemetry = value != NULL && *value != '\0' ? g_strdup (value) : NULL;
+}
+
+gboolean
+ufo_ir_method_task_telemetry_begin (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    // Nothing is recorded unless somebody is listening
+    priv->telemetry_active = priv->telemetry != NULL ||
+                             g_signal_has_handler_pending (self, signals[ITERATION], 0, TRUE);
+    priv->n_values = 0;
+
+    if (priv->telemetry_active)
+        priv->iteration_start = g_get_monotonic_time ();
+
+    return priv->telemetry_active;
+}
+
+void
+ufo_ir_method_task_telemetry_record (UfoIrMethodTask *self, const gchar *name, gdouble value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    if (!priv->telemetry_active)
+        return;
+
+    for (guint i = 0; i < priv->n_values; i++) {
+        if (!g_strcmp0 (priv->names[i], name)) {
+            priv->values[i] = value;
+            return;
+        }
+    }
+
+    if (priv->n_values < MAX_TELEMETRY_VALUES) {
+        priv->names[priv->n_values] = name;
+        priv->values[priv->n_values] = value;
+        priv->n_values++;
+    }
+}
+
+void
+ufo_ir_method_task_telemetry_end (UfoIrMethodTask *self, guint iteration)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    if (!priv->telemetry_active)
+        return;
+
+    gdouble seconds = (g_get_monotonic_time () - priv->iteration_start) / (gdouble) G_USEC_PER_SEC;
+
+    if (priv->telemetry != NULL)
+        telemetry_write (priv, iteration, seconds);
+
+    g_signal_emit (self, signals[ITERATION], 0, iteration, seconds);
+    priv->telemetry_active = FALSE;
+}
+
+static gboolean
+telemetry_lookup (UfoIrMethodTaskPrivate *priv, const gchar *name, gdouble *value)
+{
+    for (guint i = 0; i < priv->n_values; i++) {
+        if (!g_strcmp0 (priv->names[i], name)) {
+            *value = priv->values[i];
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+gboolean
+ufo_ir_method_task_get_telemetry_value (UfoIrMethodTask *self, const gchar *name, gdouble *value)
+{
+    return telemetry_lookup (UFO_IR_METHOD_TASK_GET_PRIVATE (self), name, value);
+}
+
+static void
+telemetry_write (UfoIrMethodTaskPrivate *priv, guint iteration, gdouble seconds)
+{
+    if (priv->telemetry_fp == NULL) {
+        priv->telemetry_fp = fopen (priv->telemetry, "w");
+
+        if (priv->telemetry_fp == NULL) {
+            g_warning ("Could not open telemetry file `%s'", priv->telemetry);
+            g_free (priv->telemetry);
+            priv->telemetry = NULL;
+            return;
+        }
+
+        priv->telemetry_json = g_str_has_suffix (priv->telemetry, ".json");
+        priv->telemetry_rows = 0;
+
+        // CSV columns are fixed by the scalars of the first iteration
+        priv->n_columns = priv->n_values;
+
+        for (guint i = 0; i < priv->n_values; i++)
+            priv->columns[i] = priv->names[i];
+
+        if (priv->telemetry_json) {
+            fprintf (priv->telemetry_fp, "[");
+        }
+        else {
+            fprintf (priv->telemetry_fp, "iteration,seconds");
+
+            for (guint i = 0; i < priv->n_columns; i++)
+                fprintf (priv->telemetry_fp, ",%s", priv->columns[i]);
+
+            fprintf (priv->telemetry_fp, "\n");
+        }
+    }
+
+    if (priv->telemetry_json) {
+        fprintf (priv->telemetry_fp, "%s\n  {\"iteration\": %u, \"seconds\": %e",
+                 priv->telemetry_rows > 0 ? "," : "", iteration, seconds);
+
+        for (guint i = 0; i < priv->n_values; i++)
+            fprintf (priv->telemetry_fp, ", \"%s\": %e", priv->names[i], priv->values[i]);
+
+        fprintf (priv->telemetry_fp, "}");
+    }
+    else {
+        fprintf (priv->telemetry_fp, "%u,%e", iteration, seconds);
+
+        for (guint i = 0; i < priv->n_columns; i++) {
+            gdouble value;
+
+            if (telemetry_lookup (priv, priv->columns[i], &value))
+                fprintf (priv->telemetry_fp, ",%e", value);
+            else
+                fprintf (priv->telemetry_fp, ",");
+        }
+
+        fprintf (priv->telemetry_fp, "\n");
+    }
+
+    priv->telemetry_rows++;
+}
+
+static void
+telemetry_close (UfoIrMethodTaskPrivate *priv)
+{
+    if (priv->telemetry_fp == NULL)
+        return;
+
+    if (priv->telemetry_json)
+        fprintf (priv->telemetry_fp, "\n]\n");
+
+    fclose (priv->telemetry_fp);
+    priv->telemetry_fp = NULL;
+}
+
+gboolean
+ufo_ir_method_task_get_host_storage (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    GObjectClass *klass;
+    gchar *backend = NULL;
+    guint tile_rows = 0;
+    gboolean result;
+
+    if (priv->projector == NULL)
+        return FALSE;
+
+    klass = G_OBJECT_GET_CLASS (priv->projector);
+
+    if (g_object_class_find_property (klass, "backend") != NULL)
+        g_object_get (priv->projector, "backend", &backend, NULL);
+
+    if (g_object_class_find_property (klass, "tile_rows") != NULL)
+        g_object_get (priv->projector, "tile_rows", &tile_rows, NULL);
+
+    result = !g_strcmp0 (backend, "cpu") || tile_rows > 0;
+    g_free (backend);
+
+    return result;
+}
+
+void
+ufo_ir_method_task_place_buffer (UfoIrMethodTask *self, UfoBuffer *buffer)
+{
+    cl_command_queue cmd_queue = ufo_ir_method_task_get_cmd_queue (self);
+
+    if (ufo_ir_method_task_get_host_storage (self))
+        ufo_ir_profiler_get_host_array (buffer, cmd_queue);
+    else
+        ufo_ir_profiler_get_device_array (buffer, cmd_queue);
+}
+
+UfoBuffer *
+ufo_ir_method_task_dup_buffer (UfoIrMethodTask *self, UfoBuffer *buffer)
+{
+    UfoBuffer *copy = ufo_buffer_dup (buffer);
+
+    ufo_ir_method_task_place_buffer (self, copy);
+    return copy;
+}
+
+guint
+ufo_ir_method_task_get_memory_budget (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->memory_budget;
+}
+
+void
+ufo_ir_method_task_set_memory_budget (UfoIrMethodTask *self, guint value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    priv->memory_budget = value;
+}
+
+static gsize
+memory_budget_bytes (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    cl_device_id device;
+    cl_ulong size;
+
+    if (priv->memory_budget > 0)
+        return (gsize) priv->memory_budget << 20;
+
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (node_cmd_queue (self), CL_QUEUE_DEVICE,
+                                                      sizeof (device), &device, NULL));
+    UFO_RESOURCES_CHECK_CLERR (clGetDeviceInfo (device, CL_DEVICE_GLOBAL_MEM_SIZE,
+                                                sizeof (size), &size, NULL));
+
+    // The rest is left to the projector, the driver and other tasks
+    return (gsize) (size / 4 * 3);
+}
+
+// Picks the number of concurrent slices and the tile rows of the projector
+// so that the workspace of the slices fits the budget, fails if even one
+// slice does not fit
+static void
+plan_memory (UfoIrMethodTask *self, UfoBuffer *input, UfoRequisition *requisition, GError **error)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    UfoIrMethodTaskClass *klass = UFO_IR_METHOD_TASK_GET_CLASS (self);
+    GObjectClass *projector_class = G_OBJECT_GET_CLASS (priv->projector);
+    UfoRequisition sino_req;
+    guint user_tile_rows = 0;
+    guint lanes = priv->n_lanes;
+    guint tile_rows = 0;
+
+    ufo_buffer_get_requisition (input, &sino_req);
+
+    gsize volume = requisition->dims[0] * requisition->dims[1] * sizeof (gfloat);
+    gsize sinogram = sino_req.dims[0] * sino_req.dims[1] * sizeof (gfloat);
+    gsize row = requisition->dims[0] * sizeof (gfloat);
+    gsize budget = memory_budget_bytes (self);
+    gsize slice = klass->n_volumes * volume + klass->n_sinograms * sinogram;
+    gsize fixed = priv->prefetch ? 2 * sinogram : 0;
+
+    gboolean can_tile = klass->host_storage && !priv->tiles_rejected &&
+                        g_object_class_find_property (projector_class, "tile_rows") != NULL;
+
+    if (can_tile) {
+        g_object_get (priv->projector, "tile_rows", &user_tile_rows, NULL);
+
+        // Tiling requested by the user is left alone
+        if (user_tile_rows != priv->planned_tile_rows) {
+            can_tile = FALSE;
+
+            if (user_tile_rows > 0)
+                slice = sinogram + MIN (user_tile_rows, requisition->dims[1]) * row;
+        }
+    }
+
+    // Lanes keep their own copy of the input
+    while (lanes > 1 && fixed + lanes * (slice + sinogram) > budget)
+        lanes--;
+
+    if (lanes == 1 && fixed + slice > budget && can_tile) {
+        // Only the sinogram and a band of volume rows stay on the device
+        gsize rest = budget > fixed + sinogram ? budget - fixed - sinogram : 0;
+
+        tile_rows = (guint) CLAMP (rest / row, 1, requisition->dims[1]);
+        slice = sinogram + tile_rows * row;
+    }
+
+    if (fixed + slice > budget) {
+        g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_GET_REQUISITION,
+                     "%s: the workspace of a slice (%" G_GSIZE_FORMAT " MiB) exceeds the memory budget of %" G_GSIZE_FORMAT " MiB, "
+                     "raise memory-budget%s",
+                     G_OBJECT_TYPE_NAME (self), (fixed + slice) >> 20, budget >> 20,
+                     priv->prefetch ? " or disable prefetch" : "");
+        return;
+    }
+
+    if (lanes == N_LANES (priv) && tile_rows == priv->planned_tile_rows && slice == priv->planned_size)
+        return;
+
+    if (lanes < N_LANES (priv))
+        lanes_release (priv);
+
+    if (can_tile && tile_rows != priv->planned_tile_rows) {
+        guint requested = tile_rows;
+
+        g_object_set (priv->projector, "tile_rows", requested, NULL);
+        g_object_get (priv->projector, "tile_rows", &tile_rows, NULL);
+        priv->tiles_rejected = requested > 0 && tile_rows == 0;
+
+        if (priv->tiles_rejected) {
+            g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_GET_REQUISITION,
+                         "%s: a slice only fits the memory budget of %" G_GSIZE_FORMAT " MiB in tiles, "
+                         "which the projector does not support",
+                         G_OBJECT_TYPE_NAME (self), budget >> 20);
+            return;
+        }
+    }
+
+    priv->planned_lanes = lanes;
+    priv->planned_tile_rows = tile_rows;
+    priv->planned_size = slice;
+
+    g_debug ("%s: %u volumes of %" G_GSIZE_FORMAT " KiB and %u sinograms of %" G_GSIZE_FORMAT " KiB per slice, "
+             "budget %" G_GSIZE_FORMAT " MiB: %u of %u concurrent slices, %u tile rows",
+             G_OBJECT_TYPE_NAME (self), klass->n_volumes, volume >> 10, klass->n_sinograms, sinogram >> 10,
+             budget >> 20, lanes, priv->n_lanes, tile_rows);
+}
+
+gboolean
+ufo_ir_method_task_get_preview (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->preview;
+}
+
+void
+ufo_ir_method_task_set_preview (UfoIrMethodTask *self, gboolean value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    priv->preview = value;
+}
+
+guint
+ufo_ir_method_task_get_preview_binning (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->preview_binning;
+}
+
+void
+ufo_ir_method_task_set_preview_binning (UfoIrMethodTask *self, guint value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    priv->preview_binning = MAX (value, 1);
+}
+
+guint
+ufo_ir_method_task_get_preview_angle_stride (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->preview_angle_stride;
+}
+
+void
+ufo_ir_method_task_set_preview_angle_stride (UfoIrMethodTask *self, guint value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    priv->preview_angle_stride = MAX (value, 1);
+}
+
+static void
+preview_release (UfoIrMethodTaskPrivate *priv)
+{
+    if (priv->preview_projector != NULL) {
+        g_object_unref (priv->preview_projector);
+        priv->preview_projector = NULL;
+    }
+
+    if (priv->preview_sinogram != NULL) {
+        g_object_unref (priv->preview_sinogram);
+        priv->preview_sinogram = NULL;
+    }
+
+    if (priv->preview_volume != NULL) {
+        g_object_unref (priv->preview_volume);
+        priv->preview_volume = NULL;
+    }
+
+    if (priv->context != NULL) {
+        UFO_RESOURCES_CHECK_CLERR (clReleaseContext (priv->context));
+        priv->context = NULL;
+    }
+}
+
+GObject *
+ufo_ir_method_task_clone (GObject *source, const gchar **skip)
+{
+    GObject *copy = g_object_new (G_OBJECT_TYPE (source), NULL);
+    guint n_specs;
+    GParamSpec **specs = g_object_class_list_properties (G_OBJECT_GET_CLASS (source), &n_specs);
+
+    for (guint i = 0; i < n_specs; i++) {
+        GParamSpec *spec = specs[i];
+        GValue value = G_VALUE_INIT;
+
+        if ((spec->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+            (spec->flags & G_PARAM_CONSTRUCT_ONLY) ||
+            g_strv_contains (skip, spec->name))
+            continue;
+
+        g_value_init (&value, spec->value_type);
+        g_object_get_property (source, spec->name, &value);
+        g_object_set_property (copy, spec->name, &value);
+        g_value_unset (&value);
+    }
+
+    g_free (specs);
+    return copy;
+}
+
+void
+ufo_ir_method_task_setup_preview (UfoIrMethodTask *self, UfoResources *resources, GError **error)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    const gchar *skip[] = { "axis_position", "angles_num", "angle_stride", NULL };
+
+    preview_release (priv);
+
+    if (!priv->preview || priv->projector == NULL || (error != NULL && *error != NULL))
+        return;
+
+    if (g_object_class_find_property (G_OBJECT_GET_CLASS (priv->projector), "angle_stride") == NULL) {
+        g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_SETUP,
+                     "%s cannot project decimated sinograms", G_OBJECT_TYPE_NAME (priv->projector));
+        return;
+    }
+
+    priv->preview_projector = UFO_IR_PROJECTOR_TASK (ufo_ir_method_task_clone (G_OBJECT (priv->projector), skip));
+    g_object_set (priv->preview_projector, "angle_stride", priv->preview_angle_stride, NULL);
+
+    ufo_task_node_set_proc_node (UFO_TASK_NODE (priv->preview_projector),
+                                 ufo_task_node_get_proc_node (UFO_TASK_NODE (self)));
+    ufo_task_setup (UFO_TASK (priv->preview_projector), resources, error);
+
+    priv->context = ufo_resources_get_context (resources);
+    UFO_RESOURCES_CHECK_CLERR (clRetainContext (priv->context));
+    priv->bin_kernel = ufo_ir_op_bin_detectors_generate_kernel (resources);
+    priv->prolongate_kernel = ufo_ir_op_prolongate_generate_kernel (resources);
+}
+
+static UfoBuffer *
+preview_buffer (UfoIrMethodTaskPrivate *priv, UfoBuffer *buffer, UfoRequisition *requisition)
+{
+    if (buffer == NULL)
+        return ufo_buffer_new (requisition, priv->context);
+
+    if (ufo_buffer_cmp_dimensions (buffer, requisition) != 0)
+        ufo_buffer_resize (buffer, requisition);
+
+    return buffer;
+}
+
+gboolean
+ufo_ir_method_task_run_preview (UfoIrMethodTask *self,
+                                UfoBuffer **inputs,
+                                UfoBuffer *output,
+                                UfoRequisition *requisition)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    cl_command_queue cmd_queue = node_cmd_queue (self);
+    UfoIrProjectorTask *projector = priv->projector;
+    UfoRequisition sino_req;
+    UfoRequisition volume_req;
+
+    if (priv->preview_projector == NULL || priv->in_preview)
+        return FALSE;
+
+    ufo_buffer_get_requisition (inputs[0], &sino_req);
+
+    // Binned detector coordinates, the default axis is the center of the
+    // full detector row
+    gfloat axis_position = ufo_ir_projector_task_get_axis_position (projector);
+
+    if (axis_position < 0)
+        axis_position = sino_req.dims[0] / 2.0f;
+
+    ufo_ir_projector_task_set_axis_position (priv->preview_projector, axis_position / priv->preview_binning);
+
+    sino_req.dims[0] = MAX (sino_req.dims[0] / priv->preview_binning, 1);
+    sino_req.dims[1] = (sino_req.dims[1] + priv->preview_angle_stride - 1) / priv->preview_angle_stride;
+
+    priv->preview_sinogram = preview_buffer (priv, priv->preview_sinogram, &sino_req);
+    ufo_ir_op_bin_detectors (inputs[0], priv->preview_sinogram, priv->preview_binning,
+                             priv->preview_angle_stride, cmd_queue, priv->bin_kernel);
+
+    ufo_task_get_requisition (UFO_TASK (priv->preview_projector), &priv->preview_sinogram, &volume_req, NULL);
+    priv->preview_volume = preview_buffer (priv, priv->preview_volume, &volume_req);
+
+    // The method runs as usual with the preview projector in place
+    priv->projector = priv->preview_projector;
+    priv->in_preview = TRUE;
+    ufo_task_process (UFO_TASK (self), &priv->preview_sinogram, priv->preview_volume, &volume_req);
+    priv->in_preview = FALSE;
+    priv->projector = projector;
+
+    ufo_ir_op_prolongate (priv->preview_volume, output, (gfloat) priv->preview_binning,
+                          cmd_queue, priv->prolongate_kernel);
+    return TRUE;
+}
+
+gboolean
+ufo_ir_method_task_refine (UfoIrMethodTask *self,
+                           UfoBuffer **inputs,
+                           UfoBuffer *output,
+                           UfoRequisition *requisition)
+{
+    UfoIrMethodTaskClass *klass = UFO_IR_METHOD_TASK_GET_CLASS (self);
+    gpointer cmd_queue = ufo_ir_method_task_get_cmd_queue (self);
+    gboolean result;
+
+    // The caller continues in its own scope once the nested method is done
+    ufo_ir_profiler_push_scope (cmd_queue);
+    ufo_ir_method_task_profile_slice (self);
+
+    // Methods without a warm start simply run from scratch
+    if (klass->refine != NULL)
+        result = klass->refine (self, inputs, output, requisition);
+    else
+        result = ufo_task_process (UFO_TASK (self), inputs, output, requisition);
+
+    ufo_ir_profiler_pop_scope (cmd_queue);
+    return result;
+}
+
+guint
+ufo_ir_method_task_get_emit_every (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    return priv->emit_every;
+}
+
+void
+ufo_ir_method_task_set_emit_every (UfoIrMethodTask *self, guint value)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    priv->emit_every = value;
+}
+
+void
+ufo_ir_method_task_stop (UfoIrMethodTask *self)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+    g_atomic_int_set (&priv->stop, TRUE);
+}
+
+gboolean
+ufo_ir_method_task_emit (UfoIrMethodTask *self, UfoBuffer *estimate, guint iteration)
+{
+    UfoIrMethodTaskPrivate *priv = UFO_IR_METHOD_TASK_GET_PRIVATE (self);
+
+    // Preview estimates are binned, the upsampled result goes downstream
+    if (priv->emit_every > 0 && !priv->in_preview &&
+        (iteration + 1) % priv->emit_every == 0 &&
+        g_signal_has_handler_pending (self, signals[ESTIMATE], 0, TRUE))
+        g_signal_emit (self, signals[ESTIMATE], 0, iteration, estimate);
+
+    return !g_atomic_int_compare_and_exchange (&priv->stop, TRUE, FALSE);
+}
+
 static void
 ufo_ir_method_task_dispose (GObject *object)
 {
@@ -195,6 +1553,12 @@ ufo_ir_method_task_dispose (GObject *object)
         priv->projector = NULL;
     }
 
+    ufo_ir_method_task_set_profiling (UFO_IR_METHOD_TASK (object), FALSE);
+    ufo_ir_method_task_set_telemetry (UFO_IR_METHOD_TASK (object), NULL);
+    prefetch_release (priv);
+    lanes_release (priv);
+    preview_release (priv);
+
     G_OBJECT_CLASS (ufo_ir_method_task_parent_class)->dispose (object);
 }
 
@@ -247,8 +1611,12 @@ ufo_ir_method_task_get_requisition (UfoTask        *task,
 
     if (priv->projector == NULL)
         g_error ("Projector not specified");
-    else
+    else {
         ufo_task_get_requisition (UFO_TASK(priv->projector), inputs, requisition, error);
+
+        if (error == NULL || *error == NULL)
+            plan_memory (UFO_IR_METHOD_TASK (task), inputs[0], requisition, error);
+    }
 }
 
 static const gchar *
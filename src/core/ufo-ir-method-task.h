@@ -43,6 +43,17 @@ struct _UfoIrMethodTask {
 
 struct _UfoIrMethodTaskClass {
     UfoTaskNodeClass parent_class;
+
+    // Continue iterating from the estimate already stored in output, reusing
+    // whatever workspace the method cached during previous calls
+    gboolean (*refine) (UfoIrMethodTask *self, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+
+    // Volume and sinogram sized buffers a slice needs at most, including
+    // input and output, for planning the device memory. host_storage is set
+    // by methods following ufo_ir_method_task_get_host_storage.
+    guint n_volumes;
+    guint n_sinograms;
+    gboolean host_storage;
 };
 
 UfoNode  *ufo_ir_method_task_new       (void);
@@ -54,6 +65,94 @@ void                ufo_ir_method_task_set_projector(UfoIrMethodTask *self, UfoI
 guint ufo_ir_method_task_get_iterations_number(UfoIrMethodTask *self);
 void  ufo_ir_method_task_set_iterations_number(UfoIrMethodTask *self, guint value);
 
+gboolean ufo_ir_method_task_get_profiling(UfoIrMethodTask *self);
+void     ufo_ir_method_task_set_profiling(UfoIrMethodTask *self, gboolean value);
+// Methods call profile_slice first in process, the transfers that set up a
+// slice do not count as steady state
+void     ufo_ir_method_task_profile_scope(UfoIrMethodTask *self, guint iteration, gint subset);
+void     ufo_ir_method_task_profile_slice(UfoIrMethodTask *self);
+
+const gchar *ufo_ir_method_task_get_telemetry(UfoIrMethodTask *self);
+void         ufo_ir_method_task_set_telemetry(UfoIrMethodTask *self, const gchar *value);
+
+// Methods wrap each iteration in begin/end and report the scalars they
+// already computed in between, recording is skipped if nobody listens.
+// begin returns whether somebody listens, so that quantities which need
+// an extra reduction are only computed when they are recorded
+gboolean ufo_ir_method_task_telemetry_begin(UfoIrMethodTask *self);
+void     ufo_ir_method_task_telemetry_record(UfoIrMethodTask *self, const gchar *name, gdouble value);
+void     ufo_ir_method_task_telemetry_end(UfoIrMethodTask *self, guint iteration);
+gboolean ufo_ir_method_task_get_telemetry_value(UfoIrMethodTask *self, const gchar *name, gdouble *value);
+
+gboolean ufo_ir_method_task_get_prefetch(UfoIrMethodTask *self);
+void     ufo_ir_method_task_set_prefetch(UfoIrMethodTask *self, gboolean value);
+
+// Methods pass their inputs through stage_inputs at the start of process
+// and publish the output at the end. In prefetch mode the first uploads the
+// input on a second queue through pinned memory, alternating between two
+// device buffers, and returns inputs referring to the device copy. The
+// second lets downstream tasks download the output on that queue, so
+// neither waits for the kernels of the neighbouring slices. With concurrent
+// slices the input is copied to the current lane instead.
+UfoBuffer **ufo_ir_method_task_stage_inputs(UfoIrMethodTask *self, UfoBuffer **inputs);
+void        ufo_ir_method_task_publish_output(UfoIrMethodTask *self, UfoBuffer *output);
+
+#define UFO_IR_METHOD_TASK_MAX_LANES 8
+
+guint ufo_ir_method_task_get_concurrent_slices(UfoIrMethodTask *self);
+void  ufo_ir_method_task_set_concurrent_slices(UfoIrMethodTask *self, guint value);
+
+// Methods supporting concurrent slices call next_lane first in process,
+// which picks the lane of the slice round-robin, points the projector at
+// its queue and returns it. get_lane indexes the workspace of the lane and
+// get_cmd_queue returns its queue, the one of the proc node otherwise.
+gpointer ufo_ir_method_task_next_lane(UfoIrMethodTask *self);
+guint    ufo_ir_method_task_get_lane(UfoIrMethodTask *self);
+gpointer ufo_ir_method_task_get_cmd_queue(UfoIrMethodTask *self);
+
+// Projectors computing on host arrays, the cpu backend and tiled
+// projections, want the buffers of the method in host memory. place_buffer
+// moves a buffer to that storage, a fresh one is only allocated there.
+gboolean   ufo_ir_method_task_get_host_storage(UfoIrMethodTask *self);
+void       ufo_ir_method_task_place_buffer(UfoIrMethodTask *self, UfoBuffer *buffer);
+UfoBuffer *ufo_ir_method_task_dup_buffer(UfoIrMethodTask *self, UfoBuffer *buffer);
+
+// Device memory in MiB the slices may use, 0 takes three quarters of the
+// global memory of the device. When the workspace of the slices exceeds
+// it, fewer slices run concurrently and methods with host storage tile
+// the projections.
+guint ufo_ir_method_task_get_memory_budget(UfoIrMethodTask *self);
+void  ufo_ir_method_task_set_memory_budget(UfoIrMethodTask *self, guint value);
+
+gboolean ufo_ir_method_task_get_preview(UfoIrMethodTask *self);
+void     ufo_ir_method_task_set_preview(UfoIrMethodTask *self, gboolean value);
+guint    ufo_ir_method_task_get_preview_binning(UfoIrMethodTask *self);
+void     ufo_ir_method_task_set_preview_binning(UfoIrMethodTask *self, guint value);
+guint    ufo_ir_method_task_get_preview_angle_stride(UfoIrMethodTask *self);
+void     ufo_ir_method_task_set_preview_angle_stride(UfoIrMethodTask *self, guint value);
+
+// Methods call setup_preview at the end of setup and run_preview first in
+// process. In preview mode the latter reconstructs the slice binned and
+// decimated through process and upsamples it into output, it returns FALSE
+// when process should continue as usual.
+void     ufo_ir_method_task_setup_preview(UfoIrMethodTask *self, UfoResources *resources, GError **error);
+gboolean ufo_ir_method_task_run_preview(UfoIrMethodTask *self, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+
+// Every emit_every iterations the estimate signal hands out the current
+// estimate while the slice is still running. Methods call emit after each
+// iteration and finish the slice with the current estimate when it returns
+// FALSE, which it does once after stop was called.
+guint    ufo_ir_method_task_get_emit_every(UfoIrMethodTask *self);
+void     ufo_ir_method_task_set_emit_every(UfoIrMethodTask *self, guint value);
+void     ufo_ir_method_task_stop(UfoIrMethodTask *self);
+gboolean ufo_ir_method_task_emit(UfoIrMethodTask *self, UfoBuffer *estimate, guint iteration);
+
+// Copy of source made through its writable properties except those named
+// in skip, for projectors and methods working on reduced grids
+GObject *ufo_ir_method_task_clone(GObject *source, const gchar **skip);
+
+gboolean ufo_ir_method_task_refine(UfoIrMethodTask *self, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+
 G_END_DECLS
 
 #endif
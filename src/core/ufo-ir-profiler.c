@@ -0,0 +1,721 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include "ufo-ir-profiler.h"
+#include "ufo-ir-exec.h"
+
+// Events are resolved in batches and folded into per-kernel summaries and
+// the trace file, which is written as the run goes, so that long runs keep
+// neither thousands of cl_event objects nor a record per launch alive
+#define MAX_PENDING_EVENTS 4096
+
+// Object data of buffers whose host array the device still uses
+#define HOST_HOLD_KEY "ufo-ir-host-hold"
+
+// What a command queue works on, transfers count as steady state only while
+// a method iterates. A nested method saves the scope of its caller in outer.
+typedef struct _Scope Scope;
+
+struct _Scope {
+    const gchar *method;
+    gboolean iterating;
+    guint iteration;
+    gint subset;
+    Scope *outer;
+};
+
+typedef enum {
+    IMAGE_TO_ARRAY,
+    ARRAY_TO_IMAGE,
+    UPLOAD,
+    DOWNLOAD,
+    N_TRANSFERS
+} Transfer;
+
+// Location changes of one method. Iterations after the first of a slice
+// count as steady state.
+typedef struct {
+    guint slices;
+    guint iterations;
+    guint64 total[N_TRANSFERS];
+    guint64 steady[N_TRANSFERS];
+} Locations;
+
+typedef struct {
+    cl_event event;
+    const gchar *kernel;
+    const gchar *method;
+    guint iteration;
+    gint subset;
+    guint queue;
+    cl_ulong queued;
+    cl_ulong submit;
+    cl_ulong start;
+    cl_ulong end;
+} Record;
+
+typedef struct {
+    const gchar *kernel;
+    guint calls;
+    cl_ulong total;
+    cl_ulong max;
+    cl_ulong submit;
+    cl_ulong wait;
+} Summary;
+
+G_LOCK_DEFINE_STATIC (profiler);
+
+static gint users = 0;
+static gchar *prefix = NULL;
+static GHashTable *scopes = NULL;
+static GHashTable *queues = NULL;
+static GArray *pending = NULL;
+static GArray *summaries = NULL;
+static GHashTable *summary_index = NULL;
+static FILE *trace_fp = NULL;
+static guint n_traced = 0;
+static cl_ulong trace_origin = 0;
+static GHashTable *locations = NULL;
+static gboolean warned = FALSE;
+
+static void
+scope_free (gpointer data)
+{
+    Scope *scope = data;
+
+    while (scope != NULL) {
+        Scope *outer = scope->outer;
+
+        g_free (scope);
+        scope = outer;
+    }
+}
+
+// Scope of cmd_queue, created on first use, called with the lock held
+static Scope *
+lookup_scope (gpointer cmd_queue)
+{
+    Scope *scope = g_hash_table_lookup (scopes, cmd_queue);
+
+    if (scope == NULL) {
+        scope = g_new0 (Scope, 1);
+        scope->subset = -1;
+        g_hash_table_insert (scopes, cmd_queue, scope);
+    }
+
+    return scope;
+}
+
+// Swaps the pending records for an empty array, called with the lock held
+static GArray *
+take_pending (void)
+{
+    GArray *batch = pending;
+
+    pending = g_array_new (FALSE, TRUE, sizeof (Record));
+    return batch;
+}
+
+// Waits for the events of batch and reads their times, without the lock so
+// that other threads keep enqueuing meanwhile
+static void
+resolve (GArray *batch)
+{
+    for (guint i = 0; i < batch->len; i++) {
+        Record *record = &g_array_index (batch, Record, i);
+        cl_int err = clWaitForEvents (1, &record->event);
+
+        err |= clGetEventProfilingInfo (record->event, CL_PROFILING_COMMAND_QUEUED, sizeof (cl_ulong), &record->queued, NULL);
+        err |= clGetEventProfilingInfo (record->event, CL_PROFILING_COMMAND_SUBMIT, sizeof (cl_ulong), &record->submit, NULL);
+        err |= clGetEventProfilingInfo (record->event, CL_PROFILING_COMMAND_START, sizeof (cl_ulong), &record->start, NULL);
+        err |= clGetEventProfilingInfo (record->event, CL_PROFILING_COMMAND_END, sizeof (cl_ulong), &record->end, NULL);
+
+        if (err != CL_SUCCESS) {
+            if (!g_atomic_int_get (&warned)) {
+                g_warning ("OpenCL profiling information not available, "
+                           "the command queue must be created with CL_QUEUE_PROFILING_ENABLE");
+                g_atomic_int_set (&warned, TRUE);
+            }
+
+            record->end = record->start = record->submit = record->queued = 0;
+        }
+
+        clReleaseEvent (record->event);
+        record->event = NULL;
+    }
+}
+
+static void
+trace_record (Record *record)
+{
+    if (trace_fp == NULL)
+        return;
+
+    // Times are relative to the first launch that was resolved
+    if (trace_origin == 0)
+        trace_origin = record->queued;
+
+    fprintf (trace_fp, "%s\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, "
+                       "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"iteration\": %u, \"subset\": %d}}",
+             n_traced == 0 ? "" : ",",
+             record->kernel, record->method != NULL ? record->method : "none", record->queue,
+             record->start >= trace_origin ? (record->start - trace_origin) * 1e-3 : 0.0,
+             (record->end - record->start) * 1e-3,
+             record->iteration, record->subset);
+    n_traced++;
+}
+
+// Adds a resolved batch to the summaries and the trace and frees it, called
+// with the lock held
+static void
+fold (GArray *batch)
+{
+    for (guint i = 0; i < batch->len; i++) {
+        Record *record = &g_array_index (batch, Record, i);
+        guint pos = GPOINTER_TO_UINT (g_hash_table_lookup (summary_index, record->kernel));
+
+        if (pos == 0) {
+            Summary empty = { record->kernel, 0, 0, 0, 0, 0 };
+            g_array_append_val (summaries, empty);
+            pos = summaries->len;
+            g_hash_table_insert (summary_index, (gpointer) record->kernel, GUINT_TO_POINTER (pos));
+        }
+
+        Summary *summary = &g_array_index (summaries, Summary, pos - 1);
+        cl_ulong duration = record->end - record->start;
+
+        summary->calls++;
+        summary->total += duration;
+        summary->max = MAX (summary->max, duration);
+        summary->submit += record->submit - record->queued;
+        summary->wait += record->start - record->submit;
+
+        trace_record (record);
+    }
+
+    g_array_free (batch, TRUE);
+}
+
+static const gchar *
+kernel_name (cl_kernel kernel)
+{
+    gchar name[128] = "unknown";
+
+    clGetKernelInfo (kernel, CL_KERNEL_FUNCTION_NAME, sizeof (name), name, NULL);
+    return g_intern_string (name);
+}
+
+static gint
+compare_summary (gconstpointer a, gconstpointer b)
+{
+    const Summary *sa = a;
+    const Summary *sb = b;
+
+    if (sa->total == sb->total)
+        return 0;
+
+    return sa->total < sb->total ? 1 : -1;
+}
+
+static void
+write_summary (const gchar *filename)
+{
+    FILE *fp = fopen (filename, "w");
+
+    if (fp == NULL) {
+        g_warning ("Could not write profile summary `%s'", filename);
+        return;
+    }
+
+    g_array_sort (summaries, compare_summary);
+
+    fprintf (fp, "%-32s %10s %14s %12s %12s %14s %14s\n",
+             "Kernel", "Calls", "Total [ms]", "Mean [us]", "Max [us]", "Submit [ms]", "Wait [ms]");
+
+    for (guint i = 0; i < summaries->len; i++) {
+        Summary *summary = &g_array_index (summaries, Summary, i);
+
+        fprintf (fp, "%-32s %10u %14.3f %12.3f %12.3f %14.3f %14.3f\n",
+                 summary->kernel, summary->calls,
+                 summary->total * 1e-6,
+                 summary->total * 1e-3 / summary->calls,
+                 summary->max * 1e-3,
+                 summary->submit * 1e-6,
+                 summary->wait * 1e-6);
+    }
+
+    fclose (fp);
+}
+
+static void
+trace_open (const gchar *filename)
+{
+    trace_fp = fopen (filename, "w");
+    n_traced = 0;
+    trace_origin = 0;
+
+    if (trace_fp == NULL) {
+        g_warning ("Could not write profile trace `%s'", filename);
+        return;
+    }
+
+    fprintf (trace_fp, "{\"traceEvents\": [");
+}
+
+static void
+trace_close (void)
+{
+    if (trace_fp == NULL)
+        return;
+
+    fprintf (trace_fp, "\n]}\n");
+    fclose (trace_fp);
+    trace_fp = NULL;
+}
+
+static Locations *
+method_locations (const gchar *method)
+{
+    Locations *entry = g_hash_table_lookup (locations, method);
+
+    if (entry == NULL) {
+        entry = g_new0 (Locations, 1);
+        g_hash_table_insert (locations, (gpointer) method, entry);
+    }
+
+    return entry;
+}
+
+static void
+write_locations (const gchar *filename)
+{
+    static const gchar *names[N_TRANSFERS] = { "image->array", "array->image", "upload", "download" };
+    GHashTableIter iter;
+    gpointer method, value;
+    FILE *fp = fopen (filename, "w");
+
+    if (fp == NULL) {
+        g_warning ("Could not write location report `%s'", filename);
+        return;
+    }
+
+    fprintf (fp, "%-24s %-14s %8s %12s %12s %18s\n",
+             "Method", "Change", "Slices", "Total", "Per slice", "Steady per iter");
+
+    g_hash_table_iter_init (&iter, locations);
+
+    while (g_hash_table_iter_next (&iter, &method, &value)) {
+        Locations *entry = value;
+        guint steady_iterations = entry->iterations - MIN (entry->iterations, entry->slices);
+
+        for (guint i = 0; i < N_TRANSFERS; i++) {
+            fprintf (fp, "%-24s %-14s %8u %12" G_GUINT64_FORMAT " %12.2f %18.2f\n",
+                     (const gchar *) method, names[i], entry->slices, entry->total[i],
+                     entry->slices > 0 ? (gdouble) entry->total[i] / entry->slices : 0.0,
+                     steady_iterations > 0 ? (gdouble) entry->steady[i] / steady_iterations : 0.0);
+        }
+    }
+
+    fclose (fp);
+}
+
+void
+ufo_ir_profiler_acquire (const gchar *report_prefix)
+{
+    G_LOCK (profiler);
+
+    if (users == 0) {
+        prefix = g_strdup (report_prefix != NULL ? report_prefix : "ufo-ir-profile");
+        scopes = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, scope_free);
+        queues = g_hash_table_new (g_direct_hash, g_direct_equal);
+        pending = g_array_new (FALSE, TRUE, sizeof (Record));
+        summaries = g_array_new (FALSE, TRUE, sizeof (Summary));
+        summary_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+        locations = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+        warned = FALSE;
+
+        gchar *trace_name = g_strdup_printf ("%s-trace.json", prefix);
+        trace_open (trace_name);
+        g_free (trace_name);
+    }
+
+    g_atomic_int_inc (&users);
+    G_UNLOCK (profiler);
+}
+
+void
+ufo_ir_profiler_release (void)
+{
+    G_LOCK (profiler);
+
+    if (users == 0 || !g_atomic_int_dec_and_test (&users)) {
+        G_UNLOCK (profiler);
+        return;
+    }
+
+    // Nobody profiles any more, the last batch is resolved with the lock
+    // held so that a new user cannot start meanwhile
+    GArray *batch = take_pending ();
+    resolve (batch);
+    fold (batch);
+    trace_close ();
+
+    gchar *summary_name = g_strdup_printf ("%s-summary.txt", prefix);
+    gchar *trace_name = g_strdup_printf ("%s-trace.json", prefix);
+    gchar *locations_name = g_strdup_printf ("%s-locations.txt", prefix);
+
+    write_summary (summary_name);
+    write_locations (locations_name);
+    g_message ("ir profile written to %s, %s and %s", summary_name, trace_name, locations_name);
+
+    g_free (summary_name);
+    g_free (trace_name);
+    g_free (locations_name);
+    g_free (prefix);
+    g_hash_table_destroy (scopes);
+    g_hash_table_destroy (queues);
+    g_array_free (pending, TRUE);
+    g_array_free (summaries, TRUE);
+    g_hash_table_destroy (summary_index);
+    g_hash_table_destroy (locations);
+    prefix = NULL;
+    scopes = NULL;
+    queues = NULL;
+    pending = NULL;
+    summaries = NULL;
+    summary_index = NULL;
+    locations = NULL;
+
+    G_UNLOCK (profiler);
+}
+
+gboolean
+ufo_ir_profiler_is_active (void)
+{
+    return g_atomic_int_get (&users) > 0;
+}
+
+void
+ufo_ir_profiler_set_scope (gpointer cmd_queue,
+                           const gchar *method,
+                           guint iteration,
+                           gint subset)
+{
+    if (!ufo_ir_profiler_is_active ())
+        return;
+
+    G_LOCK (profiler);
+
+    if (scopes != NULL) {
+        Scope *scope = lookup_scope (cmd_queue);
+
+        scope->method = g_intern_string (method);
+        scope->iterating = TRUE;
+        scope->iteration = iteration;
+        scope->subset = subset;
+
+        // Every subset of an iteration sets the scope, count the first
+        if (subset <= 0) {
+            Locations *entry = method_locations (scope->method);
+
+            entry->iterations++;
+
+            if (iteration == 0)
+                entry->slices++;
+        }
+    }
+
+    G_UNLOCK (profiler);
+}
+
+void
+ufo_ir_profiler_clear_scope (gpointer cmd_queue,
+                             const gchar *method)
+{
+    if (!ufo_ir_profiler_is_active ())
+        return;
+
+    G_LOCK (profiler);
+
+    if (scopes != NULL) {
+        Scope *scope = lookup_scope (cmd_queue);
+
+        scope->method = g_intern_string (method);
+        scope->iterating = FALSE;
+        scope->iteration = 0;
+        scope->subset = -1;
+    }
+
+    G_UNLOCK (profiler);
+}
+
+void
+ufo_ir_profiler_push_scope (gpointer cmd_queue)
+{
+    if (!ufo_ir_profiler_is_active ())
+        return;
+
+    G_LOCK (profiler);
+
+    if (scopes != NULL) {
+        Scope *outer = lookup_scope (cmd_queue);
+        Scope *scope = g_new (Scope, 1);
+
+        *scope = *outer;
+
+        // The table keeps the chain, outer must not be freed on replacing it
+        g_hash_table_steal (scopes, cmd_queue);
+        scope->outer = outer;
+        g_hash_table_insert (scopes, cmd_queue, scope);
+    }
+
+    G_UNLOCK (profiler);
+}
+
+void
+ufo_ir_profiler_pop_scope (gpointer cmd_queue)
+{
+    if (!ufo_ir_profiler_is_active ())
+        return;
+
+    G_LOCK (profiler);
+
+    if (scopes != NULL) {
+        Scope *scope = g_hash_table_lookup (scopes, cmd_queue);
+
+        if (scope != NULL && scope->outer != NULL) {
+            g_hash_table_steal (scopes, cmd_queue);
+            g_hash_table_insert (scopes, cmd_queue, scope->outer);
+            g_free (scope);
+        }
+    }
+
+    G_UNLOCK (profiler);
+}
+
+guint64
+ufo_ir_profiler_get_steady_transfers (void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    guint64 count = 0;
+
+    G_LOCK (profiler);
+
+    if (locations != NULL) {
+        g_hash_table_iter_init (&iter, locations);
+
+        while (g_hash_table_iter_next (&iter, NULL, &value)) {
+            Locations *entry = value;
+
+            for (guint i = 0; i < N_TRANSFERS; i++)
+                count += entry->steady[i];
+        }
+    }
+
+    G_UNLOCK (profiler);
+    return count;
+}
+
+cl_int
+ufo_ir_profiler_enqueue (gpointer cmd_queue,
+                         gpointer kernel,
+                         cl_uint work_dim,
+                         const size_t *global_work_size,
+                         const size_t *local_work_size,
+                         cl_event *event)
+{
+    cl_event local_event = NULL;
+    cl_event *target = event;
+    GArray *batch = NULL;
+    gboolean active = ufo_ir_profiler_is_active ();
+    cl_int err;
+
+    if (active && target == NULL)
+        target = &local_event;
+
+    err = ufo_ir_exec_enqueue (cmd_queue, kernel, work_dim,
+                               global_work_size, local_work_size, target);
+
+    if (!active || err != CL_SUCCESS)
+        return err;
+
+    G_LOCK (profiler);
+
+    if (pending != NULL) {
+        Scope *scope = g_hash_table_lookup (scopes, cmd_queue);
+        guint queue = GPOINTER_TO_UINT (g_hash_table_lookup (queues, cmd_queue));
+        Record record = { 0 };
+
+        if (queue == 0) {
+            queue = g_hash_table_size (queues) + 1;
+            g_hash_table_insert (queues, cmd_queue, GUINT_TO_POINTER (queue));
+        }
+
+        record.event = *target;
+        record.kernel = kernel_name (kernel);
+        record.queue = queue - 1;
+        record.subset = -1;
+
+        if (scope != NULL) {
+            record.method = scope->method;
+            record.iteration = scope->iteration;
+            record.subset = scope->subset;
+        }
+
+        clRetainEvent (record.event);
+        g_array_append_val (pending, record);
+
+        if (pending->len >= MAX_PENDING_EVENTS)
+            batch = take_pending ();
+    }
+
+    G_UNLOCK (profiler);
+
+    if (batch != NULL) {
+        resolve (batch);
+
+        G_LOCK (profiler);
+
+        // The last user may have gone while the batch was resolved
+        if (summaries != NULL)
+            fold (batch);
+        else
+            g_array_free (batch, TRUE);
+
+        G_UNLOCK (profiler);
+    }
+
+    if (local_event != NULL)
+        clReleaseEvent (local_event);
+
+    return err;
+}
+
+static void
+count_transfer (gpointer cmd_queue, UfoBufferLocation location, UfoBufferLocation target)
+{
+    Transfer transfer;
+
+    if (location == UFO_BUFFER_LOCATION_HOST)
+        transfer = UPLOAD;
+    else if (target == UFO_BUFFER_LOCATION_HOST)
+        transfer = DOWNLOAD;
+    else if (target == UFO_BUFFER_LOCATION_DEVICE)
+        transfer = IMAGE_TO_ARRAY;
+    else
+        transfer = ARRAY_TO_IMAGE;
+
+    G_LOCK (profiler);
+
+    if (locations != NULL) {
+        Scope *scope = g_hash_table_lookup (scopes, cmd_queue);
+        Locations *entry = method_locations (scope != NULL ? scope->method : g_intern_string ("none"));
+
+        entry->total[transfer]++;
+
+        if (scope != NULL && scope->iterating && scope->iteration > 0)
+            entry->steady[transfer]++;
+    }
+
+    G_UNLOCK (profiler);
+}
+
+typedef gpointer (*Accessor) (UfoBuffer *buffer, gpointer cmd_queue);
+
+static gpointer
+get_location (UfoBuffer *buffer, gpointer cmd_queue, UfoBufferLocation target, Accessor accessor)
+{
+    UfoBufferLocation location = ufo_buffer_get_location (buffer);
+    gpointer result;
+
+    ufo_ir_profiler_sync_host (buffer);
+
+    if (location == target || location == UFO_BUFFER_LOCATION_INVALID)
+        return accessor (buffer, cmd_queue);
+
+    if (ufo_ir_profiler_is_active ())
+        count_transfer (cmd_queue, location, target);
+
+    // The move is enqueued on cmd_queue, so it has to be ordered against the
+    // launches of a fork region
+    ufo_ir_exec_sync (cmd_queue);
+    result = accessor (buffer, cmd_queue);
+    ufo_ir_exec_resume (cmd_queue);
+
+    return result;
+}
+
+gpointer
+ufo_ir_profiler_get_device_image (UfoBuffer *buffer, gpointer cmd_queue)
+{
+    return get_location (buffer, cmd_queue, UFO_BUFFER_LOCATION_DEVICE_IMAGE, ufo_buffer_get_device_image);
+}
+
+gpointer
+ufo_ir_profiler_get_device_array (UfoBuffer *buffer, gpointer cmd_queue)
+{
+    return get_location (buffer, cmd_queue, UFO_BUFFER_LOCATION_DEVICE, ufo_buffer_get_device_array);
+}
+
+gpointer
+ufo_ir_profiler_get_host_array (UfoBuffer *buffer, gpointer cmd_queue)
+{
+    return get_location (buffer, cmd_queue, UFO_BUFFER_LOCATION_HOST, (Accessor) ufo_buffer_get_host_array);
+}
+
+static void
+release_event (gpointer event)
+{
+    clReleaseEvent (event);
+}
+
+void
+ufo_ir_profiler_hold_host (UfoBuffer *buffer, gpointer event)
+{
+    clRetainEvent (event);
+    g_object_set_data_full (G_OBJECT (buffer), HOST_HOLD_KEY, event, release_event);
+}
+
+gpointer
+ufo_ir_profiler_get_host_hold (UfoBuffer *buffer)
+{
+    return g_object_get_data (G_OBJECT (buffer), HOST_HOLD_KEY);
+}
+
+void
+ufo_ir_profiler_sync_host (UfoBuffer *buffer)
+{
+    cl_event event = g_object_get_data (G_OBJECT (buffer), HOST_HOLD_KEY);
+
+    if (event == NULL)
+        return;
+
+    UFO_RESOURCES_CHECK_CLERR (clWaitForEvents (1, &event));
+    g_object_set_data (G_OBJECT (buffer), HOST_HOLD_KEY, NULL);
+}
+
+void
+ufo_ir_profiler_copy (UfoBuffer *src, UfoBuffer *dst)
+{
+    ufo_ir_profiler_sync_host (src);
+    ufo_ir_profiler_sync_host (dst);
+    ufo_buffer_copy (src, dst);
+}
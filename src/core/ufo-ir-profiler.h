@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_PROFILER_H
+#define __UFO_IR_PROFILER_H
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <glib.h>
+#include <ufo/ufo.h>
+
+G_BEGIN_DECLS
+
+// Environment variable enabling the profiler for every method task. Its
+// value, unless "1", is used as prefix of the written report files.
+#define UFO_IR_PROFILING_ENV "UFO_IR_PROFILING"
+
+void     ufo_ir_profiler_acquire   (const gchar *prefix);
+void     ufo_ir_profiler_release   (void);
+gboolean ufo_ir_profiler_is_active (void);
+
+void   ufo_ir_profiler_set_scope (gpointer     cmd_queue,
+                                  const gchar *method,
+                                  guint        iteration,
+                                  gint         subset);
+
+// Methods clear the scope of their queue when a slice starts, transfers
+// count as steady state only from the second iteration on. A nested method
+// runs between push and pop, which restores the scope of its caller.
+void   ufo_ir_profiler_clear_scope (gpointer     cmd_queue,
+                                    const gchar *method);
+void   ufo_ir_profiler_push_scope  (gpointer     cmd_queue);
+void   ufo_ir_profiler_pop_scope   (gpointer     cmd_queue);
+
+// Transfers made after the first iteration of a slice, by all methods
+guint64 ufo_ir_profiler_get_steady_transfers (void);
+
+cl_int ufo_ir_profiler_enqueue   (gpointer      cmd_queue,
+                                  gpointer      kernel,
+                                  cl_uint       work_dim,
+                                  const size_t *global_work_size,
+                                  const size_t *local_work_size,
+                                  cl_event     *event);
+
+// Location accessors of UfoBuffer that count the conversions between images
+// and arrays and the host transfers they cause
+gpointer ufo_ir_profiler_get_device_image (UfoBuffer *buffer,
+                                           gpointer   cmd_queue);
+gpointer ufo_ir_profiler_get_device_array (UfoBuffer *buffer,
+                                           gpointer   cmd_queue);
+gpointer ufo_ir_profiler_get_host_array   (UfoBuffer *buffer,
+                                           gpointer   cmd_queue);
+
+// The host array of buffer stays in use by the device until event, the next
+// access through the accessors above or ufo_ir_profiler_copy waits for it
+void     ufo_ir_profiler_hold_host     (UfoBuffer *buffer,
+                                        gpointer   event);
+gpointer ufo_ir_profiler_get_host_hold (UfoBuffer *buffer);
+void     ufo_ir_profiler_sync_host     (UfoBuffer *buffer);
+void     ufo_ir_profiler_copy          (UfoBuffer *src,
+                                        UfoBuffer *dst);
+
+G_END_DECLS
+
+#endif
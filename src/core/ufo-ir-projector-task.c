@@ -17,6 +17,7 @@
  * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <math.h>
 #include "ufo-ir-projector-task.h"
 
 
@@ -219,6 +220,61 @@ ufo_ir_projector_task_set_correction_scale(UfoIrProjectorTask *self, gfloat valu
     priv->correction_scale = value;
 }
 
+// Estimates ||A|| by power iteration on A^T A. The volume and sinogram are
+// only used as templates for temporary buffers, relaxation and correction
+// scale are restored afterwards.
+gfloat
+ufo_ir_projector_task_estimate_norm (UfoIrProjectorTask *self,
+                                     UfoIrBasicOpsProcessor *ops,
+                                     UfoBuffer *volume,
+                                     UfoBuffer *sinogram,
+                                     guint n_iterations)
+{
+    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK (self);
+    gfloat relaxation = ufo_ir_projector_task_get_relaxation (self);
+    gfloat correction_scale = ufo_ir_projector_task_get_correction_scale (self);
+    gfloat norm = 0.0f;
+
+    ufo_ir_projector_task_set_relaxation (self, 1.0f);
+    ufo_ir_projector_task_set_correction_scale (self, 1.0f);
+
+    // The system matrix is non-negative, so a constant start vector is not
+    // orthogonal to the principal singular vector.
+    UfoBuffer *v = ufo_buffer_dup (volume);
+    UfoBuffer *w = ufo_buffer_dup (volume);
+    UfoBuffer *s = ufo_buffer_dup (sinogram);
+    ufo_ir_basic_ops_processor_set (ops, v, 1.0f);
+    ufo_ir_basic_ops_processor_mul_scalar (ops, v, 1.0f / ufo_ir_basic_ops_processor_l2_norm (ops, v));
+
+    for (guint i = 0; i < n_iterations; i++) {
+        ufo_ir_basic_ops_processor_set (ops, s, 0.0f);
+        ufo_ir_state_dependent_task_forward (sdprojector, &v, s, NULL);
+        ufo_ir_basic_ops_processor_set (ops, w, 0.0f);
+        ufo_ir_state_dependent_task_backward (sdprojector, &s, w, NULL);
+
+        gfloat eigenvalue = ufo_ir_basic_ops_processor_l2_norm (ops, w);
+
+        if (eigenvalue <= 0.0f)
+            break;
+
+        norm = sqrtf (eigenvalue);
+        ufo_ir_basic_ops_processor_mul_scalar (ops, w, 1.0f / eigenvalue);
+
+        UfoBuffer *tmp = v;
+        v = w;
+        w = tmp;
+    }
+
+    g_object_unref (v);
+    g_object_unref (w);
+    g_object_unref (s);
+
+    ufo_ir_projector_task_set_relaxation (self, relaxation);
+    ufo_ir_projector_task_set_correction_scale (self, correction_scale);
+
+    return norm;
+}
+
 static guint
 ufo_ir_projector_task_get_num_inputs (UfoTask *task)
 {
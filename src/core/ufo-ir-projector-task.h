@@ -21,6 +21,7 @@
 #define __UFO_IR_PROJECTOR_TASK_H
 
 #include "ufo-ir-state-dependent-task.h"
+#include "ufo-ir-basic-ops-processor.h"
 
 G_BEGIN_DECLS
 
@@ -62,6 +63,8 @@ void   ufo_ir_projector_task_set_relaxation(UfoIrProjectorTask *self, gfloat val
 gfloat ufo_ir_projector_task_get_correction_scale(UfoIrProjectorTask *self);
 void   ufo_ir_projector_task_set_correction_scale(UfoIrProjectorTask *self, gfloat value);
 
+gfloat ufo_ir_projector_task_estimate_norm (UfoIrProjectorTask *self, UfoIrBasicOpsProcessor *ops, UfoBuffer *volume, UfoBuffer *sinogram, guint n_iterations);
+
 G_END_DECLS
 
 #endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <ufo/ufo.h>
+#include "ufo-ir-sparse-matrix.h"
+
+// The matrix is the one of projector-parallel-joseph-matched.cl. The weights
+// are computed with the same single precision expressions, so the on-the-fly
+// fallback produces the same operator.
+
+typedef struct {
+    UfoIrSparseMatrix matrix;
+    gpointer context;
+    gfloat axis_pos;
+    gfloat *sin_vals;
+    gfloat *cos_vals;
+    gint refs;
+} CacheEntry;
+
+G_LOCK_DEFINE_STATIC (cache);
+static GList *cache = NULL;
+
+static gboolean
+append_entry (GArray *col_idx, GArray *values, guint col, gfloat value, gsize budget)
+{
+    if (value <= 0.0f)
+        return TRUE;
+
+    // A and its transpose, one index and one weight each
+    if ((col_idx->len + 1) * 2 * (sizeof (guint32) + sizeof (gfloat)) > budget)
+        return FALSE;
+
+    guint32 index = col;
+    g_array_append_val (col_idx, index);
+    g_array_append_val (values, value);
+    return TRUE;
+}
+
+static gboolean
+build_rows (guint n_dets,
+            guint n_angles,
+            const gfloat *sin_vals,
+            const gfloat *cos_vals,
+            gfloat axis_pos,
+            gsize budget,
+            GArray *row_ptr,
+            GArray *col_idx,
+            GArray *values)
+{
+    // The forward kernels assume a square slice as wide as the detector
+    gint width = (gint) n_dets;
+    gint height = (gint) n_dets;
+    gfloat required_width = axis_pos * 2;
+    gfloat diff = (gfloat) width - required_width;
+    gfloat rotation_origin_shift = diff / 2.0f;
+    gfloat origin_shift = (gfloat) width / 2.0f;
+    guint32 start = 0;
+
+    g_array_append_val (row_ptr, start);
+
+    for (guint angle = 0; angle < n_angles; angle++) {
+        gfloat sin_theta = sin_vals[angle];
+        gfloat cos_theta = cos_vals[angle];
+        gboolean horizontal = !(fabs (sin_theta) <= fabs (cos_theta));
+        gfloat det_step, slice_step, half_extent;
+
+        if (horizontal) {
+            det_step = -1.0f / sin_theta;
+            slice_step = cos_theta / sin_theta;
+            half_extent = 0.5f * height;
+        }
+        else {
+            det_step = 1.0f / cos_theta;
+            slice_step = sin_theta / cos_theta;
+            half_extent = 0.5f * width;
+        }
+
+        gfloat det_origin = (0.5f + rotation_origin_shift - 0.5f * n_dets) * det_step +
+                            (-origin_shift) * slice_step +
+                            half_extent - 0.5f;
+
+        gint n_slices = horizontal ? width : height;
+        gint n_offsets = horizontal ? height : width;
+
+        for (gint det = 0; det < (gint) n_dets; det++) {
+            gboolean active = !((diff < 0 && det < fabs (diff)) ||
+                                (diff > 0 && det > required_width));
+
+            for (gint slice = 0; active && slice < n_slices; slice++) {
+                gfloat t = det_origin + det * det_step + slice * slice_step;
+                gfloat t_floor = floorf (t);
+                gfloat weight = t - t_floor;
+                gint offset = (gint) t_floor;
+
+                for (gint k = 0; k < 2; k++) {
+                    gint o = offset + k;
+                    gfloat w = k == 0 ? 1.0f - weight : weight;
+
+                    if (o < 0 || o >= n_offsets)
+                        continue;
+
+                    guint col = horizontal ? (guint) (o * width + slice) : (guint) (slice * width + o);
+
+                    if (!append_entry (col_idx, values, col, w, budget))
+                        return FALSE;
+                }
+            }
+
+            guint32 end = col_idx->len;
+            g_array_append_val (row_ptr, end);
+        }
+    }
+
+    return TRUE;
+}
+
+static cl_mem
+upload (gpointer context, gpointer data, gsize size, cl_int *errcode)
+{
+    if (*errcode != CL_SUCCESS)
+        return NULL;
+
+    // Empty matrices still need a valid buffer
+    return clCreateBuffer (context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                           MAX (size, sizeof (guint32)), data, errcode);
+}
+
+static void
+release_buffers (UfoIrSparseMatrix *matrix)
+{
+    cl_mem *buffers[] = { &matrix->row_ptr, &matrix->col_idx, &matrix->values,
+                          &matrix->t_row_ptr, &matrix->t_col_idx, &matrix->t_values };
+
+    for (guint i = 0; i < G_N_ELEMENTS (buffers); i++) {
+        if (*buffers[i] != NULL) {
+            UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (*buffers[i]));
+            *buffers[i] = NULL;
+        }
+    }
+}
+
+static gboolean
+build_matrix (UfoIrSparseMatrix *matrix,
+              gpointer context,
+              const gfloat *sin_vals,
+              const gfloat *cos_vals,
+              gfloat axis_pos,
+              gsize budget)
+{
+    GArray *row_ptr = g_array_sized_new (FALSE, FALSE, sizeof (guint32), matrix->n_rows + 1);
+    GArray *col_idx = g_array_new (FALSE, FALSE, sizeof (guint32));
+    GArray *values = g_array_new (FALSE, FALSE, sizeof (gfloat));
+    gboolean success = FALSE;
+
+    if (build_rows (matrix->n_dets, matrix->n_angles, sin_vals, cos_vals, axis_pos,
+                    budget, row_ptr, col_idx, values)) {
+        guint32 *rows = (guint32 *) row_ptr->data;
+        guint32 *cols = (guint32 *) col_idx->data;
+        gfloat *vals = (gfloat *) values->data;
+        guint32 *t_rows = g_new0 (guint32, matrix->n_cols + 1);
+        guint32 *t_cols = g_new (guint32, MAX (col_idx->len, 1));
+        gfloat *t_vals = g_new (gfloat, MAX (values->len, 1));
+        guint32 *fill = g_new (guint32, matrix->n_cols);
+        cl_int errcode = CL_SUCCESS;
+
+        matrix->nnz = col_idx->len;
+        matrix->size = 2 * matrix->nnz * (sizeof (guint32) + sizeof (gfloat)) +
+                       (matrix->n_rows + matrix->n_cols + 2) * sizeof (guint32);
+
+        // Counting sort by pixel, visiting rays in order keeps the ray
+        // indices of every transposed row sorted
+        for (gsize i = 0; i < matrix->nnz; i++)
+            t_rows[cols[i] + 1]++;
+
+        for (guint i = 0; i < matrix->n_cols; i++)
+            t_rows[i + 1] += t_rows[i];
+
+        memcpy (fill, t_rows, matrix->n_cols * sizeof (guint32));
+
+        for (guint row = 0; row < matrix->n_rows; row++) {
+            for (guint32 i = rows[row]; i < rows[row + 1]; i++) {
+                guint32 pos = fill[cols[i]]++;
+                t_cols[pos] = row;
+                t_vals[pos] = vals[i];
+            }
+        }
+
+        matrix->row_ptr = upload (context, rows, (matrix->n_rows + 1) * sizeof (guint32), &errcode);
+        matrix->col_idx = upload (context, cols, matrix->nnz * sizeof (guint32), &errcode);
+        matrix->values = upload (context, vals, matrix->nnz * sizeof (gfloat), &errcode);
+        matrix->t_row_ptr = upload (context, t_rows, (matrix->n_cols + 1) * sizeof (guint32), &errcode);
+        matrix->t_col_idx = upload (context, t_cols, matrix->nnz * sizeof (guint32), &errcode);
+        matrix->t_values = upload (context, t_vals, matrix->nnz * sizeof (gfloat), &errcode);
+
+        success = errcode == CL_SUCCESS;
+
+        if (!success)
+            release_buffers (matrix);
+
+        g_free (fill);
+        g_free (t_vals);
+        g_free (t_cols);
+        g_free (t_rows);
+    }
+
+    g_array_free (values, TRUE);
+    g_array_free (col_idx, TRUE);
+    g_array_free (row_ptr, TRUE);
+    return success;
+}
+
+static gboolean
+entry_matches (CacheEntry *entry,
+               gpointer context,
+               guint n_dets,
+               guint n_angles,
+               const gfloat *sin_vals,
+               const gfloat *cos_vals,
+               gfloat axis_pos)
+{
+    return entry->context == context &&
+           entry->matrix.n_dets == n_dets &&
+           entry->matrix.n_angles == n_angles &&
+           entry->axis_pos == axis_pos &&
+           !memcmp (entry->sin_vals, sin_vals, n_angles * sizeof (gfloat)) &&
+           !memcmp (entry->cos_vals, cos_vals, n_angles * sizeof (gfloat));
+}
+
+UfoIrSparseMatrix *
+ufo_ir_sparse_matrix_acquire_parallel (gpointer context,
+                                       guint n_dets,
+                                       guint n_angles,
+                                       const gfloat *sin_vals,
+                                       const gfloat *cos_vals,
+                                       gfloat axis_pos,
+                                       gsize budget)
+{
+    CacheEntry *entry = NULL;
+
+    G_LOCK (cache);
+
+    for (GList *it = cache; it != NULL; it = g_list_next (it)) {
+        if (entry_matches (it->data, context, n_dets, n_angles, sin_vals, cos_vals, axis_pos)) {
+            entry = it->data;
+            entry->refs++;
+            break;
+        }
+    }
+
+    if (entry == NULL) {
+        entry = g_new0 (CacheEntry, 1);
+        entry->matrix.n_dets = n_dets;
+        entry->matrix.n_angles = n_angles;
+        entry->matrix.n_rows = n_angles * n_dets;
+        entry->matrix.n_cols = n_dets * n_dets;
+
+        if (build_matrix (&entry->matrix, context, sin_vals, cos_vals, axis_pos, budget)) {
+            entry->context = context;
+            entry->axis_pos = axis_pos;
+            entry->sin_vals = g_memdup (sin_vals, n_angles * sizeof (gfloat));
+            entry->cos_vals = g_memdup (cos_vals, n_angles * sizeof (gfloat));
+            entry->refs = 1;
+            UFO_RESOURCES_CHECK_CLERR (clRetainContext (context));
+            cache = g_list_prepend (cache, entry);
+            g_debug ("Built %ux%u system matrix with %" G_GSIZE_FORMAT " non-zeros, %" G_GSIZE_FORMAT " bytes",
+                     entry->matrix.n_rows, entry->matrix.n_cols, entry->matrix.nnz, entry->matrix.size);
+        }
+        else {
+            g_free (entry);
+            entry = NULL;
+        }
+    }
+
+    G_UNLOCK (cache);
+    return entry != NULL ? &entry->matrix : NULL;
+}
+
+void
+ufo_ir_sparse_matrix_release (UfoIrSparseMatrix *matrix)
+{
+    CacheEntry *entry = (CacheEntry *) matrix;
+
+    if (matrix == NULL)
+        return;
+
+    G_LOCK (cache);
+
+    if (--entry->refs == 0) {
+        cache = g_list_remove (cache, entry);
+        release_buffers (&entry->matrix);
+        UFO_RESOURCES_CHECK_CLERR (clReleaseContext (entry->context));
+        g_free (entry->sin_vals);
+        g_free (entry->cos_vals);
+        g_free (entry);
+    }
+
+    G_UNLOCK (cache);
+}
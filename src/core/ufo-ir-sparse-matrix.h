@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_SPARSE_MATRIX_H
+#define __UFO_IR_SPARSE_MATRIX_H
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Parallel beam system matrix in CSR format. Rows of A are rays ordered by
+// angle and detector, columns are pixels in row-major order. The transpose
+// is stored as well, its column indices are sorted so that a range of
+// angles can be selected by binary search.
+typedef struct {
+    guint n_dets;
+    guint n_angles;
+    guint n_rows;
+    guint n_cols;
+    gsize nnz;
+    gsize size;
+
+    cl_mem row_ptr;
+    cl_mem col_idx;
+    cl_mem values;
+
+    cl_mem t_row_ptr;
+    cl_mem t_col_idx;
+    cl_mem t_values;
+} UfoIrSparseMatrix;
+
+UfoIrSparseMatrix *ufo_ir_sparse_matrix_acquire_parallel (gpointer      context,
+                                                          guint         n_dets,
+                                                          guint         n_angles,
+                                                          const gfloat *sin_vals,
+                                                          const gfloat *cos_vals,
+                                                          gfloat        axis_pos,
+                                                          gsize         budget);
+void               ufo_ir_sparse_matrix_release          (UfoIrSparseMatrix *matrix);
+
+G_END_DECLS
+
+#endif
@@ -30,6 +30,10 @@
 struct _UfoIrStateDependentTaskPrivate {
     gboolean is_forward;
     gpointer op_set_kernel;
+    gpointer op_set_buffer_kernel;
+
+    // Queue of the current caller, NULL for the one of the proc node
+    gpointer cmd_queue;
 };
 
 // Private methods definitions
@@ -185,6 +189,25 @@ ufo_ir_state_dependent_task_set_is_forward(UfoIrStateDependentTask *self, gboole
     priv->is_forward = value;
 }
 
+gpointer
+ufo_ir_state_dependent_task_get_cmd_queue(UfoIrStateDependentTask *self)
+{
+    UfoIrStateDependentTaskPrivate *priv = UFO_IR_STATE_DEPENDENT_TASK_GET_PRIVATE (self);
+
+    if (priv->cmd_queue != NULL)
+        return priv->cmd_queue;
+
+    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(self)));
+    return ufo_gpu_node_get_cmd_queue (node);
+}
+
+void
+ufo_ir_state_dependent_task_set_cmd_queue(UfoIrStateDependentTask *self, gpointer cmd_queue)
+{
+    UfoIrStateDependentTaskPrivate *priv = UFO_IR_STATE_DEPENDENT_TASK_GET_PRIVATE (self);
+    priv->cmd_queue = cmd_queue;
+}
+
 UfoNode *
 ufo_ir_state_dependent_task_new (void)
 {
@@ -198,10 +221,13 @@ ufo_ir_state_dependent_task_process (UfoTask *self,
                          UfoRequisition *requisition)
 {
     UfoIrStateDependentTaskPrivate * priv= UFO_IR_STATE_DEPENDENT_TASK_GET_PRIVATE(self);
-    // Clear the output memory first
-    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(self)));
-    cl_command_queue cmd_queue = (cl_command_queue) ufo_gpu_node_get_cmd_queue(node);
-    ufo_ir_op_set(output, 0.0f, cmd_queue, priv->op_set_kernel);
+    cl_command_queue cmd_queue = ufo_ir_state_dependent_task_get_cmd_queue(UFO_IR_STATE_DEPENDENT_TASK(self));
+
+    // Clear the output memory first, where it already is
+    if (ufo_buffer_get_location (output) == UFO_BUFFER_LOCATION_DEVICE_IMAGE)
+        ufo_ir_op_set(output, 0.0f, cmd_queue, priv->op_set_kernel);
+    else
+        ufo_ir_op_set_buffer(output, 0.0f, cmd_queue, priv->op_set_buffer_kernel);
 
     if(priv->is_forward) {
         return ufo_ir_state_dependent_task_forward(UFO_IR_STATE_DEPENDENT_TASK(self), inputs, output, requisition);
@@ -218,6 +244,7 @@ ufo_ir_state_dependent_task_setup(UfoTask      *task,
 {
     UfoIrStateDependentTaskPrivate *priv = UFO_IR_STATE_DEPENDENT_TASK_GET_PRIVATE (task);
     priv->op_set_kernel = ufo_ir_op_set_generate_kernel(resources);
+    priv->op_set_buffer_kernel = ufo_ir_op_set_buffer_generate_kernel(resources);
     if (UFO_IR_STATE_DEPENDENT_TASK_GET_CLASS(task)->setup != NULL) {
         UFO_IR_STATE_DEPENDENT_TASK_GET_CLASS(task)->setup(UFO_IR_STATE_DEPENDENT_TASK(task), resources, error);
     }
@@ -75,6 +75,11 @@ gboolean ufo_ir_state_dependent_task_backward (UfoIrStateDependentTask *task,
 gboolean ufo_ir_state_dependent_task_get_is_forward(UfoIrStateDependentTask *self);
 void     ufo_ir_state_dependent_task_set_is_forward(UfoIrStateDependentTask *self, gboolean value);
 
+// Queue the projections are enqueued on, the one of the proc node unless a
+// method running several slices at once set another
+gpointer ufo_ir_state_dependent_task_get_cmd_queue(UfoIrStateDependentTask *self);
+void     ufo_ir_state_dependent_task_set_cmd_queue(UfoIrStateDependentTask *self, gpointer cmd_queue);
+
 G_END_DECLS
 
 #endif
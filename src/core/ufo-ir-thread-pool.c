@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ufo-ir-thread-pool.h"
+
+// Chunks per thread, more than one evens out rows of different cost
+#define CHUNKS_PER_THREAD 4
+
+typedef struct {
+    UfoIrParallelFunc func;
+    gpointer user_data;
+    GMutex lock;
+    GCond done;
+    guint pending;
+} Job;
+
+typedef struct {
+    Job *job;
+    guint first;
+    guint last;
+} Chunk;
+
+static GThreadPool *pool = NULL;
+static guint n_threads = 1;
+
+static void
+run_chunk (gpointer data, gpointer unused)
+{
+    Chunk *chunk = data;
+    Job *job = chunk->job;
+
+    job->func (chunk->first, chunk->last, job->user_data);
+
+    g_mutex_lock (&job->lock);
+
+    if (--job->pending == 0)
+        g_cond_signal (&job->done);
+
+    g_mutex_unlock (&job->lock);
+}
+
+static gpointer
+create_pool (gpointer unused)
+{
+    n_threads = MAX (g_get_num_processors (), 1);
+    pool = g_thread_pool_new (run_chunk, NULL, (gint) n_threads, FALSE, NULL);
+    return NULL;
+}
+
+guint
+ufo_ir_parallel_n_threads (void)
+{
+    static GOnce once = G_ONCE_INIT;
+
+    g_once (&once, create_pool, NULL);
+    return n_threads;
+}
+
+void
+ufo_ir_parallel_for (guint n_items,
+                     UfoIrParallelFunc func,
+                     gpointer user_data)
+{
+    guint n_chunks = MIN (n_items, ufo_ir_parallel_n_threads () * CHUNKS_PER_THREAD);
+
+    if (n_chunks <= 1 || pool == NULL) {
+        if (n_items > 0)
+            func (0, n_items, user_data);
+
+        return;
+    }
+
+    Job job;
+    Chunk *chunks = g_new (Chunk, n_chunks);
+    guint step = (n_items + n_chunks - 1) / n_chunks;
+
+    job.func = func;
+    job.user_data = user_data;
+    g_mutex_init (&job.lock);
+    g_cond_init (&job.done);
+    job.pending = 0;
+
+    g_mutex_lock (&job.lock);
+
+    for (guint i = 0; i < n_chunks && i * step < n_items; i++) {
+        chunks[i].job = &job;
+        chunks[i].first = i * step;
+        chunks[i].last = MIN ((i + 1) * step, n_items);
+        job.pending++;
+        g_thread_pool_push (pool, &chunks[i], NULL);
+    }
+
+    while (job.pending > 0)
+        g_cond_wait (&job.done, &job.lock);
+
+    g_mutex_unlock (&job.lock);
+    g_mutex_clear (&job.lock);
+    g_cond_clear (&job.done);
+    g_free (chunks);
+}
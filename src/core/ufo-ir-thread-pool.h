@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_THREAD_POOL_H
+#define __UFO_IR_THREAD_POOL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Host loops marked with this are compiled for AVX-512, AVX2 and the
+// baseline ISA when GCC supports it, the best version is picked at load time
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define UFO_IR_SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define UFO_IR_SIMD_CLONES
+#endif
+
+// Processes the items [first, last) of a parallel loop
+typedef void (*UfoIrParallelFunc) (guint first, guint last, gpointer user_data);
+
+// Splits [0, n_items) into chunks, runs them on a process wide pool of one
+// thread per processor and returns when all chunks are done
+void  ufo_ir_parallel_for      (guint             n_items,
+                                UfoIrParallelFunc func,
+                                gpointer          user_data);
+guint ufo_ir_parallel_n_threads (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,369 @@
+// Joseph model on plain buffers with manual interpolation, for devices
+// without native images. Same geometry as projector-parallel-joseph.cl.
+
+#define BLOCK_SIZE 64
+#define UFO_BUFFER_MAX_NDIMS 3
+
+typedef struct {
+    long origin[UFO_BUFFER_MAX_NDIMS];
+    long size[UFO_BUFFER_MAX_NDIMS];
+} UfoRegion;
+
+typedef struct {
+  unsigned long height;
+  unsigned long width;
+
+  unsigned long n_dets;
+  unsigned long n_angles;
+} UfoGeometryDims;
+
+typedef struct {
+    float det_scale;
+    float axis_pos;
+} UfoParallelGeometrySpec;
+
+typedef enum {
+    Vertical = 1,
+    Horizontal = 0
+} Direction;
+
+typedef struct {
+  uint offset;
+  uint n;
+  Direction direction;
+} UfoProjectionsSubset;
+
+// Linear interpolation at t along n texels that are stride apart. Like the
+// linear clamp sampler, texel i is centered at i + 0.5 and texels outside of
+// [0, n) read as 0.
+inline float
+interpolate (global const float *line, int stride, int n, float t)
+{
+    float position = t - 0.5f;
+    float position_floor = floor(position);
+    float weight = position - position_floor;
+    int i0 = convert_int(position_floor);
+    int i1 = i0 + 1;
+    float v0 = (i0 >= 0 && i0 < n) ? line[i0 * stride] : 0.0f;
+    float v1 = (i1 >= 0 && i1 < n) ? line[i1 * stride] : 0.0f;
+
+    return (1.0f - weight) * v0 + weight * v1;
+}
+
+// The rays of FP_hor cross every column at its center and those of FP_vert
+// every row, so only one axis is interpolated
+inline float
+forward (global const float *volume,
+         int slice_stride,
+         int offset_stride,
+         int n_slices,
+         int n_offsets,
+         float start,
+         float slice_step)
+{
+    // split up the calculation by parts to increse percision
+    float detected_value = 0.0f;
+
+    for (int j = 0; j < n_slices; j += BLOCK_SIZE) {
+        float inner_sum = 0.0f;
+
+        for (int i = j; i < min(j + BLOCK_SIZE, n_slices); i++) {
+            inner_sum += interpolate(volume + i * slice_stride, offset_stride, n_offsets, start);
+            start += slice_step;
+        }
+
+        detected_value += inner_sum;
+    }
+
+    return detected_value;
+}
+
+kernel
+void FP_hor(global const float             *volume,
+            global const float             *r_sinogram,
+            global       float             *w_sinogram,
+            constant     float             *sin_val,
+            constant     float             *cos_val,
+            const        UfoGeometryDims   dimensions,
+            const        float             axis_pos,
+            const        UfoProjectionsSubset part,
+            const        float             correction_scale)
+{
+    const int det = get_global_id(0);
+    const int angle = part.offset + get_global_id(1);
+
+    float required_width = axis_pos * 2;
+
+    // diff > 0 when the center of rotation is right of the sinogram center
+    // and is left otherwise
+    float diff = (float)dimensions.width - required_width;
+
+    // Shift of the rotation center from the center of a slice in the X-axis
+    float rotation_origin_shift = diff / 2.0f;
+    // Shift to put the origin in X-axis into the center of the slice
+    float origin_shift = (float)dimensions.width / 2.0f;
+
+    // Switch off inactive detectors.
+    if ((diff < 0 && det < fabs(diff)) ||
+        (diff > 0 && det > required_width)) {
+        return;
+    }
+
+    const float fDetStep   = -1.0f / sin_val[angle];
+    float fSliceStep = cos_val[angle] / sin_val[angle];
+
+    float start = (0.5f + rotation_origin_shift + det - 0.5f * dimensions.n_dets) * fDetStep +
+                  (-origin_shift) * fSliceStep +
+                  0.5f * dimensions.height;
+
+    float detected_value = forward(volume, 1, dimensions.width,
+                                   dimensions.width, dimensions.height,
+                                   start, fSliceStep);
+
+    const size_t index = angle * dimensions.n_dets + det;
+    w_sinogram[index] = r_sinogram[index] + detected_value * correction_scale;
+}
+
+kernel
+void FP_vert(global const float             *volume,
+             global const float             *r_sinogram,
+             global       float             *w_sinogram,
+             constant     float             *sin_val,
+             constant     float             *cos_val,
+             const        UfoGeometryDims   dimensions,
+             const        float             axis_pos,
+             const        UfoProjectionsSubset part,
+             const        float             correction_scale)
+{
+    const int det = get_global_id(0);
+    const int angle = part.offset + get_global_id(1);
+
+    float required_width = axis_pos * 2;
+
+    // diff > 0 when the center of rotation is right of the sinogram center
+    // and is left otherwise
+    float diff = (float)dimensions.width - required_width;
+
+    // Shift of the rotation center from the center of a slice in the X-axis
+    float rotation_origin_shift = diff / 2.0f;
+    // Shift to put the origin in X-axis into the center of the slice
+    float origin_shift = (float)dimensions.width / 2.0f;
+
+    // Switch off inactive detectors.
+    if ((diff < 0 && det < fabs(diff)) ||
+        (diff > 0 && det > required_width)) {
+        return;
+    }
+
+    const float fDetStep   = 1.0f / cos_val[angle];
+    float fSliceStep = sin_val[angle] / cos_val[angle];
+
+    float start = (0.5f + rotation_origin_shift + det - 0.5f * dimensions.n_dets) * fDetStep +
+                  (-origin_shift) * fSliceStep +
+                  0.5f * dimensions.width;
+
+    float detected_value = forward(volume, dimensions.width, 1,
+                                   dimensions.height, dimensions.width,
+                                   start, fSliceStep);
+
+    const size_t index = angle * dimensions.n_dets + det;
+    w_sinogram[index] = r_sinogram[index] + detected_value * correction_scale;
+}
+
+kernel
+void BP(global const float             *r_volume,
+        global       float             *w_volume,
+        global const float             *sinogram,
+        const        float             relax_param,
+        constant     float             *sin_val,
+        constant     float             *cos_val,
+        const        UfoGeometryDims   dimensions,
+        const        float             axis_pos,
+        const        UfoProjectionsSubset part)
+{
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    float required_width = axis_pos * 2;
+
+    // diff > 0 when the center of rotation is right of the sinogram center
+    // and is left otherwise
+    float diff = (float)dimensions.width - required_width;
+
+    float half_active_dets = diff < 0 ? dimensions.width - axis_pos : axis_pos;
+    float sino_edge_0 = axis_pos - half_active_dets + 0.5f;
+    float sino_edge_1 = axis_pos + half_active_dets - 0.5f;
+
+    // Shift of the rotation center from the center of a slice in the X-axis
+    float rotation_origin_shift = diff / 2.0f;
+    // Shift to put the origin in X-axis into the center of the slice
+    float origin_shift = (float)dimensions.width / 2.0f;
+
+    const float fX = convert_float(x) + 0.5f - origin_shift;
+    const float fY = convert_float(y) + 0.5f - origin_shift;
+
+    float value = 0.0f;
+
+    for (int i = part.offset; i < part.offset + part.n; ++i) {
+        float t = fX * cos_val[i] - fY * sin_val[i] +
+                  (origin_shift - rotation_origin_shift);
+
+        // Clamp to the active detectors like the image kernel does
+        t = clamp(t, sino_edge_0, sino_edge_1);
+
+        value += interpolate(sinogram + i * dimensions.n_dets, 1, dimensions.n_dets, t);
+    }
+
+    const size_t index = y * dimensions.width + x;
+    w_volume[index] = r_volume[index] + relax_param * value;
+}
+
+// Tiled versions for volumes that do not fit on the device. volume holds
+// the rows [first_row, first_row + n_rows) of the slice, all other rows read
+// as 0. The projections are linear in the volume, so the sums over all tiles
+// equal the projections of the whole slice and tiles need no halo.
+
+kernel
+void FP_hor_tile(global const float             *volume,
+                 global const float             *r_sinogram,
+                 global       float             *w_sinogram,
+                 constant     float             *sin_val,
+                 constant     float             *cos_val,
+                 const        UfoGeometryDims   dimensions,
+                 const        float             axis_pos,
+                 const        UfoProjectionsSubset part,
+                 const        float             correction_scale,
+                 const        int               first_row,
+                 const        int               n_rows)
+{
+    const int det = get_global_id(0);
+    const int angle = part.offset + get_global_id(1);
+
+    float required_width = axis_pos * 2;
+    float diff = (float)dimensions.width - required_width;
+    float rotation_origin_shift = diff / 2.0f;
+    float origin_shift = (float)dimensions.width / 2.0f;
+
+    if ((diff < 0 && det < fabs(diff)) ||
+        (diff > 0 && det > required_width)) {
+        return;
+    }
+
+    const float fDetStep   = -1.0f / sin_val[angle];
+    float fSliceStep = cos_val[angle] / sin_val[angle];
+
+    // Position of the ray in the rows of the tile
+    float start = (0.5f + rotation_origin_shift + det - 0.5f * dimensions.n_dets) * fDetStep +
+                  (-origin_shift) * fSliceStep +
+                  0.5f * dimensions.height - first_row;
+
+    // Only the columns where the ray runs between the rows -1 and n_rows
+    // of the tile touch it
+    int first = 0;
+    int last = dimensions.width;
+
+    if (fabs(fSliceStep) > 1e-6f) {
+        float a = (-0.5f - start) / fSliceStep;
+        float b = (n_rows + 0.5f - start) / fSliceStep;
+        first = max(convert_int(floor(fmin(a, b))) - 1, 0);
+        last = min(convert_int(ceil(fmax(a, b))) + 2, (int) dimensions.width);
+    }
+    else if (start < -0.5f || start >= n_rows + 0.5f) {
+        last = 0;
+    }
+
+    float detected_value = 0.0f;
+
+    if (first < last)
+        detected_value = forward(volume + first, 1, dimensions.width,
+                                 last - first, n_rows,
+                                 start + first * fSliceStep, fSliceStep);
+
+    const size_t index = angle * dimensions.n_dets + det;
+    w_sinogram[index] = r_sinogram[index] + detected_value * correction_scale;
+}
+
+kernel
+void FP_vert_tile(global const float             *volume,
+                  global const float             *r_sinogram,
+                  global       float             *w_sinogram,
+                  constant     float             *sin_val,
+                  constant     float             *cos_val,
+                  const        UfoGeometryDims   dimensions,
+                  const        float             axis_pos,
+                  const        UfoProjectionsSubset part,
+                  const        float             correction_scale,
+                  const        int               first_row,
+                  const        int               n_rows)
+{
+    const int det = get_global_id(0);
+    const int angle = part.offset + get_global_id(1);
+
+    float required_width = axis_pos * 2;
+    float diff = (float)dimensions.width - required_width;
+    float rotation_origin_shift = diff / 2.0f;
+    float origin_shift = (float)dimensions.width / 2.0f;
+
+    if ((diff < 0 && det < fabs(diff)) ||
+        (diff > 0 && det > required_width)) {
+        return;
+    }
+
+    const float fDetStep   = 1.0f / cos_val[angle];
+    float fSliceStep = sin_val[angle] / cos_val[angle];
+
+    float start = (0.5f + rotation_origin_shift + det - 0.5f * dimensions.n_dets) * fDetStep +
+                  (-origin_shift) * fSliceStep +
+                  0.5f * dimensions.width;
+
+    // The ray crosses the rows of the tile only
+    float detected_value = forward(volume, dimensions.width, 1,
+                                   n_rows, dimensions.width,
+                                   start + first_row * fSliceStep, fSliceStep);
+
+    const size_t index = angle * dimensions.n_dets + det;
+    w_sinogram[index] = r_sinogram[index] + detected_value * correction_scale;
+}
+
+kernel
+void BP_tile(global const float             *r_volume,
+             global       float             *w_volume,
+             global const float             *sinogram,
+             const        float             relax_param,
+             constant     float             *sin_val,
+             constant     float             *cos_val,
+             const        UfoGeometryDims   dimensions,
+             const        float             axis_pos,
+             const        UfoProjectionsSubset part,
+             const        int               first_row)
+{
+    const int x = get_global_id(0);
+    const int y = first_row + get_global_id(1);
+
+    float required_width = axis_pos * 2;
+    float diff = (float)dimensions.width - required_width;
+
+    float half_active_dets = diff < 0 ? dimensions.width - axis_pos : axis_pos;
+    float sino_edge_0 = axis_pos - half_active_dets + 0.5f;
+    float sino_edge_1 = axis_pos + half_active_dets - 0.5f;
+
+    float rotation_origin_shift = diff / 2.0f;
+    float origin_shift = (float)dimensions.width / 2.0f;
+
+    const float fX = convert_float(x) + 0.5f - origin_shift;
+    const float fY = convert_float(y) + 0.5f - origin_shift;
+
+    float value = 0.0f;
+
+    for (int i = part.offset; i < part.offset + part.n; ++i) {
+        float t = fX * cos_val[i] - fY * sin_val[i] +
+                  (origin_shift - rotation_origin_shift);
+
+        t = clamp(t, sino_edge_0, sino_edge_1);
+
+        value += interpolate(sinogram + i * dimensions.n_dets, 1, dimensions.n_dets, t);
+    }
+
+    const size_t index = get_global_id(1) * dimensions.width + x;
+    w_volume[index] = r_volume[index] + relax_param * value;
+}
@@ -0,0 +1,54 @@
+// Sparse matrix-vector products with the precomputed Joseph system matrix.
+// The FP_hor, FP_vert and BP kernels of the fallback are taken from
+// projector-parallel-joseph-matched.cl, which computes the same operator.
+
+kernel void
+spmv (global const uint  *row_ptr,
+      global const uint  *col_idx,
+      global const float *values,
+      global const float *x,
+      global       float *y,
+      const        uint   row_offset,
+      const        float  scale)
+{
+    const uint row = row_offset + get_global_id(0);
+    float sum = 0.0f;
+
+    for (uint i = row_ptr[row]; i < row_ptr[row + 1]; i++)
+        sum += values[i] * x[col_idx[i]];
+
+    y[row] += scale * sum;
+}
+
+// Transposed product restricted to the columns [col_begin, col_end), that
+// is to the rays of a subset of angles. Column indices of every row are
+// sorted, so the first one in range is found by binary search.
+kernel void
+spmv_transposed (global const uint  *row_ptr,
+                 global const uint  *col_idx,
+                 global const float *values,
+                 global const float *x,
+                 global       float *y,
+                 const        uint   col_begin,
+                 const        uint   col_end,
+                 const        float  scale)
+{
+    const uint row = get_global_id(0);
+    uint low = row_ptr[row];
+    uint high = row_ptr[row + 1];
+    float sum = 0.0f;
+
+    while (low < high) {
+        uint mid = (low + high) / 2;
+
+        if (col_idx[mid] < col_begin)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (uint i = low; i < row_ptr[row + 1] && col_idx[i] < col_end; i++)
+        sum += values[i] * x[col_idx[i]];
+
+    y[row] += scale * sum;
+}
@@ -0,0 +1,243 @@
+const sampler_t nb_clamp_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP | CLK_FILTER_NEAREST;
+
+#define BLOCK_SIZE 64
+#define UFO_BUFFER_MAX_NDIMS 3
+
+typedef struct {
+    long origin[UFO_BUFFER_MAX_NDIMS];
+    long size[UFO_BUFFER_MAX_NDIMS];
+} UfoRegion;
+
+typedef struct {
+  unsigned long height;
+  unsigned long width;
+
+  unsigned long n_dets;
+  unsigned long n_angles;
+} UfoGeometryDims;
+
+typedef struct {
+    float det_scale;
+    float axis_pos;
+} UfoParallelGeometrySpec;
+
+typedef enum {
+    Vertical = 1,
+    Horizontal = 0
+} Direction;
+
+typedef struct {
+  uint offset;
+  uint n;
+  Direction direction;
+} UfoProjectionsSubset;
+
+// Joseph projector whose BP is the exact transpose of FP. FP does the same
+// ray-driven walk as projector-parallel-joseph.cl but interpolates by hand
+// instead of using the linear sampler, whose weights are only 8 bit precise
+// on many GPUs. BP gathers, for every pixel, the few detectors whose rays
+// interpolate it and applies the very same weights, so no atomics are needed.
+
+typedef struct {
+    float det_step;
+    float slice_step;
+    float det_origin;
+    float diff;
+    float required_width;
+} RayGeometry;
+
+inline RayGeometry
+ray_geometry (float sin_theta,
+              float cos_theta,
+              Direction direction,
+              const UfoGeometryDims dimensions,
+              const float axis_pos)
+{
+    RayGeometry geometry;
+
+    geometry.required_width = axis_pos * 2;
+
+    // diff > 0 when the center of rotation is right of the sinogram center
+    // and is left otherwise
+    geometry.diff = (float)dimensions.width - geometry.required_width;
+
+    // Shift of the rotation center from the center of a slice in the X-axis
+    float rotation_origin_shift = geometry.diff / 2.0f;
+    // Shift to put the origin in X-axis into the center of the slice
+    float origin_shift = (float)dimensions.width / 2.0f;
+    float half_extent;
+
+    if (direction == Horizontal) {
+        geometry.det_step = -1.0f / sin_theta;
+        geometry.slice_step = cos_theta / sin_theta;
+        half_extent = 0.5f * dimensions.height;
+    }
+    else {
+        geometry.det_step = 1.0f / cos_theta;
+        geometry.slice_step = sin_theta / cos_theta;
+        half_extent = 0.5f * dimensions.width;
+    }
+
+    // Texel coordinate of detector 0 on slice line 0, shifted by the half
+    // pixel that the linear sampler subtracts
+    geometry.det_origin = (0.5f + rotation_origin_shift - 0.5f * dimensions.n_dets) * geometry.det_step +
+                          (-origin_shift) * geometry.slice_step +
+                          half_extent - 0.5f;
+
+    return geometry;
+}
+
+inline bool
+is_active (const RayGeometry *geometry, int det)
+{
+    return !((geometry->diff < 0 && det < fabs(geometry->diff)) ||
+             (geometry->diff > 0 && det > geometry->required_width));
+}
+
+// Texel coordinate at which the ray of @det crosses slice line @slice. FP
+// and BP must evaluate exactly this expression to stay transposed.
+inline float
+ray_offset (const RayGeometry *geometry, int det, int slice)
+{
+    return geometry->det_origin + det * geometry->det_step + slice * geometry->slice_step;
+}
+
+inline int2
+pixel (Direction direction, int slice, int offset)
+{
+    return direction == Horizontal ? (int2)(slice, offset) : (int2)(offset, slice);
+}
+
+inline void
+forward (read_only     image2d_t               volume,
+         read_only     image2d_t               r_sinogram,
+         write_only    image2d_t               w_sinogram,
+         constant      float                   *sin_val,
+         constant      float                   *cos_val,
+         const         UfoGeometryDims         dimensions,
+         const         float                   axis_pos,
+         const         UfoProjectionsSubset    part,
+         const         float                   correction_scale,
+         Direction                             direction)
+{
+    int2 sino_coord;
+    sino_coord.y = part.offset + get_global_id(1);
+    sino_coord.x = get_global_id(0);
+
+    RayGeometry geometry = ray_geometry (sin_val[sino_coord.y], cos_val[sino_coord.y],
+                                         direction, dimensions, axis_pos);
+
+    // Switch off inactive detectors.
+    if (!is_active (&geometry, sino_coord.x))
+        return;
+
+    int n_slices = direction == Horizontal ? dimensions.width : dimensions.height;
+
+    // split up the calculation by parts to increse percision
+    float detected_value = 0.0f;
+
+    for (int start = 0; start < n_slices; start += BLOCK_SIZE) {
+        float inner_sum = 0.0f;
+        int end = min (start + BLOCK_SIZE, n_slices);
+
+        for (int slice = start; slice < end; slice++) {
+            float t = ray_offset (&geometry, sino_coord.x, slice);
+            float t_floor = floor (t);
+            float weight = t - t_floor;
+            int offset = convert_int (t_floor);
+
+            // Clamp addressing returns 0 outside of the volume
+            inner_sum += (1.0f - weight) * read_imagef(volume, nb_clamp_sampler, pixel (direction, slice, offset)).x +
+                         weight * read_imagef(volume, nb_clamp_sampler, pixel (direction, slice, offset + 1)).x;
+        }
+
+        detected_value += inner_sum;
+    }
+
+    float4 det_value = read_imagef(r_sinogram, nb_clamp_sampler, sino_coord) +
+                       detected_value * correction_scale;
+    write_imagef (w_sinogram, sino_coord, det_value);
+}
+
+kernel
+void FP_hor(read_only     image2d_t               volume,
+            read_only     image2d_t               r_sinogram,
+            write_only    image2d_t               w_sinogram,
+            constant      float                   *sin_val,
+            constant      float                   *cos_val,
+            const         UfoGeometryDims         dimensions,
+            const         float                   axis_pos,
+            const         UfoProjectionsSubset    part,
+            const         float                   correction_scale)
+{
+    forward (volume, r_sinogram, w_sinogram, sin_val, cos_val,
+             dimensions, axis_pos, part, correction_scale, Horizontal);
+}
+
+kernel
+void FP_vert(read_only     image2d_t               volume,
+             read_only     image2d_t               r_sinogram,
+             write_only    image2d_t               w_sinogram,
+             constant      float                   *sin_val,
+             constant      float                   *cos_val,
+             const         UfoGeometryDims         dimensions,
+             const         float                   axis_pos,
+             const         UfoProjectionsSubset    part,
+             const         float                   correction_scale)
+{
+    forward (volume, r_sinogram, w_sinogram, sin_val, cos_val,
+             dimensions, axis_pos, part, correction_scale, Vertical);
+}
+
+kernel
+void BP(read_only  image2d_t           r_volume,
+        write_only image2d_t           w_volume,
+        read_only  image2d_t           sinogram,
+        const      float               relax_param,
+        constant   float               *sin_val,
+        constant   float               *cos_val,
+        const      UfoGeometryDims     dimensions,
+        const      float               axis_pos,
+        const      UfoProjectionsSubset    part)
+{
+    int2 vol_coord;
+    vol_coord.x = get_global_id(0);
+    vol_coord.y = get_global_id(1);
+
+    // FP walks along x for horizontal and along y for vertical subsets and
+    // interpolates across the other axis
+    int slice = part.direction == Horizontal ? vol_coord.x : vol_coord.y;
+    int offset = part.direction == Horizontal ? vol_coord.y : vol_coord.x;
+    float value = 0.0f;
+
+    for (int i = 0; i < part.n; ++i) {
+        int angle = i + part.offset;
+        RayGeometry geometry = ray_geometry (sin_val[angle], cos_val[angle],
+                                             part.direction, dimensions, axis_pos);
+
+        // Neighbouring rays are at least one texel apart along the
+        // interpolation axis, so at most two detectors touch the pixel
+        float center = (offset - ray_offset (&geometry, 0, slice)) / geometry.det_step;
+        int first = convert_int (floor (center)) - 1;
+
+        for (int det = max (first, 0); det <= min (first + 3, (int) dimensions.n_dets - 1); det++) {
+            if (!is_active (&geometry, det))
+                continue;
+
+            float t = ray_offset (&geometry, det, slice);
+            float t_floor = floor (t);
+            float weight = t - t_floor;
+            int lower = convert_int (t_floor);
+
+            if (lower == offset)
+                weight = 1.0f - weight;
+            else if (lower + 1 != offset)
+                continue;
+
+            value += weight * read_imagef(sinogram, nb_clamp_sampler, (int2)(det, angle)).x;
+        }
+    }
+
+    float4 result = read_imagef(r_volume, nb_clamp_sampler, vol_coord) + relax_param * value;
+    write_imagef (w_volume, vol_coord, result);
+}
@@ -0,0 +1,97 @@
+/*
+ * Buffer versions of the basic operations. Every work item handles four
+ * consecutive elements of [first, first + n) with vector loads and stores,
+ * the last one also the remaining n % 4 elements. `b' and `modifier' are
+ * ignored by the unary operations.
+ */
+
+#define ELEMENT_WISE(name, expression)                                          \
+kernel                                                                          \
+void name (global const float *a,                                               \
+           global const float *b,                                               \
+           const float modifier,                                                \
+           global float *out,                                                   \
+           const uint first,                                                    \
+           const uint n)                                                        \
+{                                                                               \
+    const uint i = 4 * get_global_id(0);                                        \
+                                                                                \
+    if (i + 4 <= n) {                                                           \
+        float4 x = vload4(0, a + first + i);                                    \
+        float4 y = vload4(0, b + first + i);                                    \
+        vstore4(expression, 0, out + first + i);                                \
+    }                                                                           \
+    else {                                                                      \
+        for (uint j = first + i; j < first + n; j++) {                          \
+            float x = a[j];                                                     \
+            float y = b[j];                                                     \
+            out[j] = expression;                                                \
+        }                                                                       \
+    }                                                                           \
+}
+
+ELEMENT_WISE (buffer_add, x + modifier * y)
+ELEMENT_WISE (buffer_mul, x * y)
+ELEMENT_WISE (buffer_div, x / y)
+ELEMENT_WISE (buffer_max, fmax(x, y))
+ELEMENT_WISE (buffer_scale, modifier * x)
+ELEMENT_WISE (buffer_inv, select(1.0f / x, 0.0f * x, x == 0.0f))
+ELEMENT_WISE (buffer_positive, fmax(x, 0.0f))
+ELEMENT_WISE (buffer_sqrt, sqrt(x))
+
+kernel
+void buffer_set (global const float *a,
+                 global const float *b,
+                 const float modifier,
+                 global float *out,
+                 const uint first,
+                 const uint n)
+{
+    const uint i = 4 * get_global_id(0);
+
+    if (i + 4 <= n) {
+        vstore4((float4) (modifier), 0, out + first + i);
+    }
+    else {
+        for (uint j = first + i; j < first + n; j++)
+            out[j] = modifier;
+    }
+}
+
+/*
+ * Like operation_dot_product, every work-group stores the sum of its strided
+ * part in partial[group_id].
+ */
+kernel
+void buffer_dot_product (global const float *a,
+                         global const float *b,
+                         const uint length,
+                         local float *scratch,
+                         global float *partial)
+{
+    const uint lid = get_local_id(0);
+    float4 sum = 0.0f;
+
+    for (uint i = 4 * get_global_id(0); i < length; i += 4 * get_global_size(0)) {
+        if (i + 4 <= length) {
+            sum += vload4(0, a + i) * vload4(0, b + i);
+        }
+        else {
+            for (uint j = i; j < length; j++)
+                sum.s0 += a[j] * b[j];
+        }
+    }
+
+    scratch[lid] = sum.s0 + sum.s1 + sum.s2 + sum.s3;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (uint stride = get_local_size(0) / 2; stride > 0; stride >>= 1) {
+        if (lid < stride)
+            scratch[lid] += scratch[lid + stride];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+        partial[get_group_id(0)] = scratch[0];
+}
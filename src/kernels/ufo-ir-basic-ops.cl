@@ -170,6 +170,84 @@ void op_mulRows (read_only  image2d_t arg1_r,
     write_imagef(out, coord_w, value);
 }
 
+kernel
+void op_copyRows (read_only  image2d_t arg_r,
+                  write_only image2d_t out,
+                  const uint    offset)
+{
+    const uint X = get_global_id(0);
+    const uint Y = get_global_id(1);
+
+    float2 coord_r;
+    coord_r.x = (float)X + 0.5f;
+    coord_r.y = (float)Y + 0.5f;
+
+    int2 coord_w;
+    coord_w.x = X;
+    coord_w.y = offset + Y;
+
+    write_imagef(out, coord_w, read_imagef(arg_r, imageSampler, coord_r));
+}
+
+kernel
+void operation_mul_scalar (read_only image2d_t arg_r,
+                           const float  modifier,
+                           write_only image2d_t out)
+{
+    const uint X = get_global_id(0);
+    const uint Y = get_global_id(1);
+
+    float2 coord_r;
+    coord_r.x = (float)X + 0.5f;
+    coord_r.y = (float)Y + 0.5f;
+
+    int2 coord_w;
+    coord_w.x = X;
+    coord_w.y = Y;
+
+    float value = modifier * read_imagef(arg_r, imageSampler, coord_r).s0;
+
+    write_imagef(out, coord_w, value);
+}
+
+/*
+ * Every work-group accumulates a strided part of the element-wise product and
+ * stores its sum in partial[group_id]. The few partial sums are added on the
+ * host.
+ */
+kernel
+void operation_dot_product (read_only image2d_t arg1_r,
+                            read_only image2d_t arg2_r,
+                            const uint width,
+                            const uint length,
+                            local float *scratch,
+                            global float *partial)
+{
+    const uint lid = get_local_id(0);
+    float sum = 0.0f;
+
+    for (uint i = get_global_id(0); i < length; i += get_global_size(0)) {
+        int2 coord;
+        coord.x = i % width;
+        coord.y = i / width;
+        sum += read_imagef(arg1_r, imageSampler, coord).s0 *
+               read_imagef(arg2_r, imageSampler, coord).s0;
+    }
+
+    scratch[lid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (uint stride = get_local_size(0) / 2; stride > 0; stride >>= 1) {
+        if (lid < stride)
+            scratch[lid] += scratch[lid + stride];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+        partial[get_group_id(0)] = scratch[0];
+}
+
 kernel
 void operation_gradient_magnitude (read_only image2d_t arg_r,
                                    write_only image2d_t out)
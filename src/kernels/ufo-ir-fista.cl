@@ -0,0 +1,111 @@
+const sampler_t nb_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+/*
+ * Divergence of the dual field p = (px, py). It is the negative adjoint of
+ * the forward differences with Neumann boundary used in tv_prox_dual.
+ */
+float
+divergence (global const float2 *p,
+            const int x,
+            const int y,
+            const int width,
+            const int height)
+{
+    const int idx = y * width + x;
+    float div = 0.0f;
+
+    if (x < width - 1)
+        div += p[idx].x;
+
+    if (x > 0)
+        div -= p[idx - 1].x;
+
+    if (y < height - 1)
+        div += p[idx].y;
+
+    if (y > 0)
+        div -= p[idx - width].y;
+
+    return div;
+}
+
+kernel
+void tv_prox_init (global float2 *p)
+{
+    p[get_global_id(1) * get_global_size(0) + get_global_id(0)] = (float2)(0.0f, 0.0f);
+}
+
+/*
+ * One Chambolle projection step for
+ *   min_u 0.5 * ||u - z||^2 + weight * TV(u)
+ * computing p_out = (p + tau * grad(div p - z / weight)) /
+ *                   (1 + tau * |grad(div p - z / weight)|)
+ * in a single pass. tau must not exceed 1/8.
+ */
+kernel
+void tv_prox_dual (read_only image2d_t z,
+                   global const float2 *p_in,
+                   global float2 *p_out,
+                   const float weight,
+                   const float tau)
+{
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int width = get_global_size(0);
+    const int height = get_global_size(1);
+    const int idx = y * width + x;
+    const float inv_weight = 1.0f / weight;
+
+    float g = divergence (p_in, x, y, width, height) -
+              inv_weight * read_imagef(z, nb_sampler, (int2)(x, y)).s0;
+
+    float2 grad = (float2)(0.0f, 0.0f);
+
+    if (x < width - 1)
+        grad.x = divergence (p_in, x + 1, y, width, height) -
+                 inv_weight * read_imagef(z, nb_sampler, (int2)(x + 1, y)).s0 - g;
+
+    if (y < height - 1)
+        grad.y = divergence (p_in, x, y + 1, width, height) -
+                 inv_weight * read_imagef(z, nb_sampler, (int2)(x, y + 1)).s0 - g;
+
+    p_out[idx] = (p_in[idx] + tau * grad) / (1.0f + tau * length(grad));
+}
+
+/*
+ * u = z - weight * div p, optionally clipped to non-negative values
+ */
+kernel
+void tv_prox_primal (read_only image2d_t z,
+                     global const float2 *p,
+                     const float weight,
+                     const int positive,
+                     write_only image2d_t out)
+{
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    float value = read_imagef(z, nb_sampler, (int2)(x, y)).s0 -
+                  weight * divergence (p, x, y, get_global_size(0), get_global_size(1));
+
+    if (positive)
+        value = fmax(value, 0.0f);
+
+    write_imagef(out, (int2)(x, y), value);
+}
+
+/*
+ * y = x + momentum * (x - x_prev)
+ */
+kernel
+void fista_momentum (read_only image2d_t x,
+                     read_only image2d_t x_prev,
+                     const float momentum,
+                     write_only image2d_t y)
+{
+    const int2 coord = (int2)(get_global_id(0), get_global_id(1));
+    float value = read_imagef(x, nb_sampler, coord).s0;
+
+    value += momentum * (value - read_imagef(x_prev, nb_sampler, coord).s0);
+    write_imagef(y, coord, value);
+}
@@ -0,0 +1,44 @@
+const sampler_t nb_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+const sampler_t linear_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+/*
+ * Sinogram of a coarse level. A coarse detector sums factor fine ones, and
+ * coarse pixels are factor times longer, so that ray sums in coarse pixel
+ * units shrink by the factor once more. Only every angle_stride-th row is
+ * kept.
+ */
+kernel
+void bin_detectors (read_only image2d_t fine,
+                    write_only image2d_t coarse,
+                    const int factor,
+                    const int angle_stride)
+{
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    float sum = 0.0f;
+
+    for (int i = 0; i < factor; i++)
+        sum += read_imagef(fine, nb_sampler, (int2)(x * factor + i, y * angle_stride)).x;
+
+    write_imagef(coarse, (int2)(x, y), sum / (factor * factor));
+}
+
+/*
+ * Bilinear interpolation of a coarse estimate at the pixel centers of the
+ * finer grid. Both grids are centered on the rotation axis.
+ */
+kernel
+void prolongate (read_only image2d_t coarse,
+                 write_only image2d_t fine,
+                 const float factor)
+{
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const float2 fine_center = (float2)(get_global_size(0), get_global_size(1)) * 0.5f;
+    const float2 coarse_center = convert_float2(get_image_dim(coarse)) * 0.5f;
+
+    // The linear sampler reads texel i at coordinate i + 0.5
+    const float2 pos = ((float2)(x + 0.5f, y + 0.5f) - fine_center) / factor + coarse_center;
+
+    write_imagef(fine, (int2)(x, y), read_imagef(coarse, linear_sampler, pos));
+}
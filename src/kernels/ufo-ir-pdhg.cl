@@ -0,0 +1,65 @@
+const sampler_t nb_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+/*
+ * Dual step of the data term 0.5 * ||Ax - b||^2:
+ * q_out = (q + sigma * (Ax - b)) / (1 + sigma)
+ */
+kernel
+void pdhg_dual_data (read_only image2d_t q,
+                     read_only image2d_t ax,
+                     read_only image2d_t b,
+                     const float sigma,
+                     write_only image2d_t q_out)
+{
+    const int2 coord = (int2)(get_global_id(0), get_global_id(1));
+
+    float value = read_imagef(q, nb_sampler, coord).s0 +
+                  sigma * (read_imagef(ax, nb_sampler, coord).s0 -
+                           read_imagef(b, nb_sampler, coord).s0);
+
+    write_imagef(q_out, coord, value / (1.0f + sigma));
+}
+
+/*
+ * Dual step of the isotropic TV term lambda * ||Dx||_2,1: p = p + sigma * Dx
+ * followed by the projection onto the ball |p| <= lambda
+ */
+kernel
+void pdhg_dual_tv (global float *px,
+                   global float *py,
+                   global const float *gx,
+                   global const float *gy,
+                   const float sigma,
+                   const float lambda)
+{
+    const int index = get_global_id(1) * get_global_size(0) + get_global_id(0);
+    float2 p = (float2)(px[index] + sigma * gx[index],
+                        py[index] + sigma * gy[index]);
+
+    p /= fmax(1.0f, length(p) / lambda);
+    px[index] = p.x;
+    py[index] = p.y;
+}
+
+/*
+ * Primal step x_out = x - tau * g and the over-relaxation
+ * x_bar = 2 * x_out - x
+ */
+kernel
+void pdhg_primal (read_only image2d_t x,
+                  read_only image2d_t g,
+                  const float tau,
+                  const int positive,
+                  write_only image2d_t x_out,
+                  write_only image2d_t x_bar)
+{
+    const int2 coord = (int2)(get_global_id(0), get_global_id(1));
+    float old = read_imagef(x, nb_sampler, coord).s0;
+    float value = old - tau * read_imagef(g, nb_sampler, coord).s0;
+
+    if (positive)
+        value = fmax(value, 0.0f);
+
+    write_imagef(x_out, coord, value);
+    write_imagef(x_bar, coord, 2.0f * value - old);
+}
@@ -26,6 +26,7 @@
 
 #include "ufo-ir-asdpocs-task.h"
 #include "core/ufo-ir-basic-ops.h"
+#include "core/ufo-ir-profiler.h"
 #include "ufo-ir-parallel-projector-task.h"
 
 static void ufo_ir_asdpocs_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
@@ -101,6 +102,10 @@ ufo_ir_asdpocs_task_class_init (UfoIrAsdpocsTaskClass *klass)
     oclass->get_property = ufo_ir_asdpocs_task_get_property;
     oclass->dispose = ufo_ir_asdpocs_task_dispose;
 
+    // Including the workspace of a SIRT minimizer, the largest one
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_volumes = 7;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_sinograms = 4;
+
     properties[PROP_BETA] =
         g_param_spec_float("beta",
                            "Beta",
@@ -384,6 +389,7 @@ ufo_ir_asdpocs_task_setup (UfoTask *task,
     UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task));
     ufo_task_node_set_proc_node(UFO_TASK_NODE(projector), ufo_task_node_get_proc_node(UFO_TASK_NODE(task)));
     ufo_task_setup(UFO_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), resources, error);
+    ufo_ir_method_task_setup_preview(UFO_IR_METHOD_TASK(task), resources, error);
 
     // Init df_minimizer
     if (priv->df_minimizer == NULL) {
@@ -416,11 +422,18 @@ ufo_ir_asdpocs_task_process (UfoTask *task,
 {
     UfoIrAsdpocsTaskPrivate *priv = UFO_IR_ASDPOCS_TASK_GET_PRIVATE(task);
 
+    ufo_ir_method_task_profile_slice (UFO_IR_METHOD_TASK(task));
+
+    if (ufo_ir_method_task_run_preview (UFO_IR_METHOD_TASK(task), inputs, output, requisition))
+        return TRUE;
+
+    inputs = ufo_ir_method_task_stage_inputs (UFO_IR_METHOD_TASK(task), inputs);
+
     // Check and setup temp buffer
     if(priv->grad_temp_buffer) {
         UfoRequisition grad_req;
         ufo_buffer_get_requisition(priv->grad_temp_buffer, &grad_req);
-        if( grad_req.dims[0] == requisition->dims[0] && grad_req.dims[1] == requisition->dims[1] ) {
+        if( grad_req.dims[0] != requisition->dims[0] || grad_req.dims[1] != requisition->dims[1] ) {
             g_object_unref(priv->grad_temp_buffer);
             priv->grad_temp_buffer = ufo_buffer_dup(output);
         }
@@ -455,9 +468,14 @@ ufo_ir_asdpocs_task_process (UfoTask *task,
     guint max_iterations = ufo_ir_method_task_get_iterations_number(UFO_IR_METHOD_TASK(task));
 
     while (iteration < max_iterations) {
-        // run method to minimize data fidelity term
+        ufo_ir_method_task_telemetry_begin (UFO_IR_METHOD_TASK(task));
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "beta", beta);
+
+        // run method to minimize data fidelity term, continuing from the
+        // current estimate and reusing the minimizer's workspace
         g_object_set (priv->df_minimizer, "relaxation_factor", beta, NULL);
-        ufo_task_process(priv->df_minimizer, inputs, x, NULL);
+        ufo_ir_method_task_refine(UFO_IR_METHOD_TASK(priv->df_minimizer), inputs, x, requisition);
+        ufo_ir_method_task_profile_scope (UFO_IR_METHOD_TASK(task), iteration, -1);
 
         // impose positive constraint: if x_i < 0 then x_i = 0
         if (priv->positive_constraint) {
@@ -465,10 +483,10 @@ ufo_ir_asdpocs_task_process (UfoTask *task,
         }
 
         // save result as an result
-        ufo_buffer_copy (x, output);
+        ufo_ir_profiler_copy (x, output);
 
         // Find residual between the simulated and real measurements
-        ufo_buffer_copy (inputs[0], b_residual);
+        ufo_ir_profiler_copy (inputs[0], b_residual);
         ufo_ir_projector_task_set_correction_scale(UFO_IR_PROJECTOR_TASK(projector), -1.0f);
         for (guint i = 0 ; i < n_subsets; ++i) {
             ufo_ir_parallel_projector_subset_fp(projector, x, b_residual, &subsets[i]);
@@ -487,9 +505,10 @@ ufo_ir_asdpocs_task_process (UfoTask *task,
         }
 
         // save current solution
-        ufo_buffer_copy (x, x_prev);
+        ufo_ir_profiler_copy (x, x_prev);
 
         ufo_math_tvstd_method_process_real(UFO_IR_ASDPOCS_TASK(task), x, x, dtgv, cmd_queue);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "dtgv", dtgv);
 
         // compute new regularization coefficient
         const gfloat epsilon = 0.001f;
@@ -502,9 +521,24 @@ ufo_ir_asdpocs_task_process (UfoTask *task,
             dtgv *= priv->alpha_red;
         }
 
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "dd", dd);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "dp", dp);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "dg", dg);
+        ufo_ir_method_task_telemetry_end (UFO_IR_METHOD_TASK(task), iteration);
+
+        if (!ufo_ir_method_task_emit (UFO_IR_METHOD_TASK(task), x, iteration))
+            break;
+
         iteration++;
     }
 
+    g_object_unref(x);
+    g_object_unref(x_prev);
+    g_object_unref(x_residual);
+    g_object_unref(b_residual);
+    g_free(subsets);
+
+    ufo_ir_method_task_publish_output (UFO_IR_METHOD_TASK(task), output);
     return TRUE;
 }
 
@@ -561,8 +595,8 @@ ufo_math_tvstd_method_process_real (UfoIrAsdpocsTask *self,
     UfoRequisition input_req;
     ufo_buffer_get_requisition (input, &input_req);
 
-    cl_mem d_input = ufo_buffer_get_device_image (input, cmd_queue);
-    cl_mem d_grad = ufo_buffer_get_device_image (priv->grad_temp_buffer, cmd_queue);
+    cl_mem d_input = ufo_ir_profiler_get_device_image (input, cmd_queue);
+    cl_mem d_grad = ufo_ir_profiler_get_device_image (priv->grad_temp_buffer, cmd_queue);
 
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->tvstd, 0, sizeof(cl_mem), &d_input));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->tvstd, 1, sizeof(cl_mem), &d_grad));
@@ -571,7 +605,8 @@ ufo_math_tvstd_method_process_real (UfoIrAsdpocsTask *self,
     guint iteration = 0;
 
     while (iteration < 20) {
-        UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (cmd_queue, priv->tvstd, input_req.n_dims, NULL, input_req.dims, NULL, 0, NULL, NULL));
+        UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, priv->tvstd,
+                                                            input_req.n_dims, input_req.dims, NULL, NULL));
         l1 = ufo_ir_op_l1_norm (priv->grad_temp_buffer, cmd_queue);
         factor = relaxation / l1;
         ufo_ir_op_deduction2 (input, priv->grad_temp_buffer, factor, output, cmd_queue, priv->op_dd2_kernel);
@@ -0,0 +1,544 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <math.h>
+
+#include "ufo-ir-fista-task.h"
+#include "core/ufo-ir-basic-ops-processor.h"
+#include "core/ufo-ir-profiler.h"
+
+// Step of the Chambolle projection, convergent for tau <= 1/8
+#define TV_PROX_TAU 0.125f
+// Power iterations used to estimate the Lipschitz constant ||A||^2
+#define NORM_ITERATIONS 20
+
+static void ufo_ir_fista_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
+static void ufo_ir_fista_task_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
+static void ufo_ir_fista_task_dispose (GObject *object);
+static void ufo_ir_fista_task_finalize (GObject *object);
+static void ufo_task_interface_init (UfoTaskIface *iface);
+static void ufo_ir_fista_task_setup (UfoTask *task, UfoResources *resources, GError **error);
+static gboolean ufo_ir_fista_task_process (UfoTask *task, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+
+static void tv_prox (UfoIrFistaTaskPrivate *priv, UfoBuffer *z, UfoBuffer *out, gfloat weight, UfoRequisition *requisition, cl_command_queue cmd_queue);
+static void momentum (UfoIrFistaTaskPrivate *priv, UfoBuffer *x, UfoBuffer *x_prev, gfloat factor, UfoBuffer *y, UfoRequisition *requisition, cl_command_queue cmd_queue);
+
+struct _UfoIrFistaTaskPrivate {
+    // Method parameters
+    gfloat lambda;
+    guint tv_iterations;
+    gboolean adaptive_restart;
+    gboolean positive_constraint;
+
+    UfoIrBasicOpsProcessor *bo_processor;
+    cl_context context;
+    cl_kernel prox_init_kernel;
+    cl_kernel prox_dual_kernel;
+    cl_kernel prox_primal_kernel;
+    cl_kernel momentum_kernel;
+
+    // Dual field of the TV prox, ping-ponged between two buffers and warm
+    // started across outer iterations
+    cl_mem dual[2];
+    guint current_dual;
+    gsize dual_size;
+
+    // Lipschitz constant of the data term for the last seen geometry
+    gfloat lipschitz;
+    gsize lipschitz_dims[2];
+};
+
+G_DEFINE_TYPE_WITH_CODE (UfoIrFistaTask, ufo_ir_fista_task, UFO_IR_TYPE_METHOD_TASK,
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK,
+                                                ufo_task_interface_init))
+
+#define UFO_IR_FISTA_TASK_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_IR_TYPE_FISTA_TASK, UfoIrFistaTaskPrivate))
+
+enum {
+    PROP_0 = 100,
+    PROP_LAMBDA,
+    PROP_TV_ITERATIONS,
+    PROP_ADAPTIVE_RESTART,
+    PROP_POSITIVE_CONSTRAINT,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = { NULL, };
+
+static void
+ufo_task_interface_init (UfoTaskIface *iface)
+{
+    iface->process = ufo_ir_fista_task_process;
+    iface->setup = ufo_ir_fista_task_setup;
+}
+
+static void
+ufo_ir_fista_task_class_init (UfoIrFistaTaskClass *klass)
+{
+    GObjectClass *oclass = G_OBJECT_CLASS (klass);
+
+    oclass->set_property = ufo_ir_fista_task_set_property;
+    oclass->get_property = ufo_ir_fista_task_get_property;
+    oclass->dispose = ufo_ir_fista_task_dispose;
+    oclass->finalize = ufo_ir_fista_task_finalize;
+
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_volumes = 6;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_sinograms = 2;
+
+    properties[PROP_LAMBDA] =
+            g_param_spec_float("lambda",
+                               "Lambda",
+                               "Weight of the TV regularization",
+                               0.0f, G_MAXFLOAT, 0.1f,
+                               G_PARAM_READWRITE);
+
+    properties[PROP_TV_ITERATIONS] =
+            g_param_spec_uint("tv_iterations",
+                              "TV iterations",
+                              "Chambolle iterations of the TV proximal step",
+                              1, G_MAXUINT, 10,
+                              G_PARAM_READWRITE);
+
+    properties[PROP_ADAPTIVE_RESTART] =
+            g_param_spec_boolean("adaptive_restart",
+                                 "Adaptive restart",
+                                 "Reset the momentum when it points against the gradient step",
+                                 TRUE,
+                                 G_PARAM_READWRITE);
+
+    properties[PROP_POSITIVE_CONSTRAINT] =
+            g_param_spec_boolean("positive_constraint",
+                                 "Impose positive constraint",
+                                 "Impose positive constraint",
+                                 TRUE,
+                                 G_PARAM_READWRITE);
+
+    for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
+        g_object_class_install_property (oclass, i, properties[i]);
+
+    g_type_class_add_private (oclass, sizeof(UfoIrFistaTaskPrivate));
+}
+
+static void
+ufo_ir_fista_task_init(UfoIrFistaTask *self)
+{
+    UfoIrFistaTaskPrivate *priv;
+    self->priv = priv = UFO_IR_FISTA_TASK_GET_PRIVATE(self);
+    priv->lambda = 0.1f;
+    priv->tv_iterations = 10;
+    priv->adaptive_restart = TRUE;
+    priv->positive_constraint = TRUE;
+    priv->bo_processor = NULL;
+    priv->dual[0] = NULL;
+    priv->dual[1] = NULL;
+    priv->dual_size = 0;
+    priv->lipschitz = 0.0f;
+}
+
+static void
+ufo_ir_fista_task_set_property (GObject *object,
+                                guint property_id,
+                                const GValue *value,
+                                GParamSpec *pspec)
+{
+    UfoIrFistaTask *self = UFO_IR_FISTA_TASK (object);
+
+    switch (property_id) {
+        case PROP_LAMBDA:
+            ufo_ir_fista_task_set_lambda(self, g_value_get_float(value));
+            break;
+        case PROP_TV_ITERATIONS:
+            ufo_ir_fista_task_set_tv_iterations(self, g_value_get_uint(value));
+            break;
+        case PROP_ADAPTIVE_RESTART:
+            ufo_ir_fista_task_set_adaptive_restart(self, g_value_get_boolean(value));
+            break;
+        case PROP_POSITIVE_CONSTRAINT:
+            ufo_ir_fista_task_set_positive_constraint(self, g_value_get_boolean(value));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_ir_fista_task_get_property (GObject *object,
+                                guint property_id,
+                                GValue *value,
+                                GParamSpec *pspec)
+{
+    UfoIrFistaTask *self = UFO_IR_FISTA_TASK (object);
+
+    switch (property_id) {
+        case PROP_LAMBDA:
+            g_value_set_float(value, ufo_ir_fista_task_get_lambda(self));
+            break;
+        case PROP_TV_ITERATIONS:
+            g_value_set_uint(value, ufo_ir_fista_task_get_tv_iterations(self));
+            break;
+        case PROP_ADAPTIVE_RESTART:
+            g_value_set_boolean(value, ufo_ir_fista_task_get_adaptive_restart(self));
+            break;
+        case PROP_POSITIVE_CONSTRAINT:
+            g_value_set_boolean(value, ufo_ir_fista_task_get_positive_constraint(self));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_ir_fista_task_dispose (GObject *object)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (object);
+
+    if (priv->bo_processor != NULL) {
+        g_object_unref (priv->bo_processor);
+        priv->bo_processor = NULL;
+    }
+
+    G_OBJECT_CLASS (ufo_ir_fista_task_parent_class)->dispose (object);
+}
+
+static void
+ufo_ir_fista_task_finalize (GObject *object)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (object);
+
+    for (guint i = 0; i < 2; i++) {
+        if (priv->dual[i]) {
+            UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->dual[i]));
+            priv->dual[i] = NULL;
+        }
+    }
+
+    if (priv->context) {
+        UFO_RESOURCES_CHECK_CLERR (clReleaseContext (priv->context));
+        priv->context = NULL;
+    }
+
+    G_OBJECT_CLASS (ufo_ir_fista_task_parent_class)->finalize (object);
+}
+
+gfloat
+ufo_ir_fista_task_get_lambda(UfoIrFistaTask *self)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (self);
+    return priv->lambda;
+}
+
+void
+ufo_ir_fista_task_set_lambda(UfoIrFistaTask *self, gfloat value)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (self);
+    priv->lambda = value;
+}
+
+guint
+ufo_ir_fista_task_get_tv_iterations(UfoIrFistaTask *self)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (self);
+    return priv->tv_iterations;
+}
+
+void
+ufo_ir_fista_task_set_tv_iterations(UfoIrFistaTask *self, guint value)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (self);
+    priv->tv_iterations = value;
+}
+
+gboolean
+ufo_ir_fista_task_get_adaptive_restart(UfoIrFistaTask *self)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (self);
+    return priv->adaptive_restart;
+}
+
+void
+ufo_ir_fista_task_set_adaptive_restart(UfoIrFistaTask *self, gboolean value)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (self);
+    priv->adaptive_restart = value;
+}
+
+gboolean
+ufo_ir_fista_task_get_positive_constraint(UfoIrFistaTask *self)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (self);
+    return priv->positive_constraint;
+}
+
+void
+ufo_ir_fista_task_set_positive_constraint(UfoIrFistaTask *self, gboolean value)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (self);
+    priv->positive_constraint = value;
+}
+
+UfoNode *
+ufo_ir_fista_task_new (void)
+{
+    return UFO_NODE (g_object_new (UFO_IR_TYPE_FISTA_TASK, NULL));
+}
+
+static void
+ufo_ir_fista_task_setup (UfoTask      *task,
+                         UfoResources *resources,
+                         GError       **error)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (task);
+    ufo_task_node_set_proc_node(UFO_TASK_NODE(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), ufo_task_node_get_proc_node(UFO_TASK_NODE(task)));
+
+    ufo_task_setup(UFO_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), resources, error);
+    ufo_ir_method_task_setup_preview(UFO_IR_METHOD_TASK(task), resources, error);
+
+    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
+    priv->bo_processor = ufo_ir_basic_ops_processor_new(resources, cmd_queue);
+
+    priv->context = ufo_resources_get_context (resources);
+    UFO_RESOURCES_CHECK_CLERR (clRetainContext (priv->context));
+
+    priv->prox_init_kernel = ufo_resources_get_kernel (resources, "ufo-ir-fista.cl", "tv_prox_init", NULL, error);
+
+    if (priv->prox_init_kernel == NULL)
+        return;
+
+    priv->prox_dual_kernel = ufo_resources_get_kernel (resources, "ufo-ir-fista.cl", "tv_prox_dual", NULL, error);
+
+    if (priv->prox_dual_kernel == NULL)
+        return;
+
+    priv->prox_primal_kernel = ufo_resources_get_kernel (resources, "ufo-ir-fista.cl", "tv_prox_primal", NULL, error);
+
+    if (priv->prox_primal_kernel == NULL)
+        return;
+
+    priv->momentum_kernel = ufo_resources_get_kernel (resources, "ufo-ir-fista.cl", "fista_momentum", NULL, error);
+}
+
+static gboolean
+ufo_ir_fista_task_process (UfoTask *task,
+                           UfoBuffer **inputs,
+                           UfoBuffer *output,
+                           UfoRequisition *requisition)
+{
+    UfoIrFistaTaskPrivate *priv = UFO_IR_FISTA_TASK_GET_PRIVATE (task);
+
+    ufo_ir_method_task_profile_slice (UFO_IR_METHOD_TASK(task));
+
+    if (ufo_ir_method_task_run_preview (UFO_IR_METHOD_TASK(task), inputs, output, requisition))
+        return TRUE;
+
+    inputs = ufo_ir_method_task_stage_inputs (UFO_IR_METHOD_TASK(task), inputs);
+    UfoIrBasicOpsProcessor *ops = priv->bo_processor;
+    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
+
+    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task));
+    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK(projector);
+
+    UfoRequisition volume_req;
+    ufo_buffer_get_requisition (output, &volume_req);
+
+    // The step 1 / ||A||^2 only depends on the geometry
+    if (priv->lipschitz <= 0.0f ||
+        priv->lipschitz_dims[0] != volume_req.dims[0] ||
+        priv->lipschitz_dims[1] != volume_req.dims[1]) {
+        gfloat norm = ufo_ir_projector_task_estimate_norm (projector, ops, output, inputs[0], NORM_ITERATIONS);
+        priv->lipschitz = norm * norm;
+        priv->lipschitz_dims[0] = volume_req.dims[0];
+        priv->lipschitz_dims[1] = volume_req.dims[1];
+    }
+
+    if (priv->lipschitz <= 0.0f) {
+        ufo_ir_basic_ops_processor_set(ops, output, 0.0f);
+        return TRUE;
+    }
+
+    gfloat step = 1.0f / priv->lipschitz;
+
+    gsize dual_size = volume_req.dims[0] * volume_req.dims[1] * 2 * sizeof (gfloat);
+
+    if (priv->dual_size != dual_size) {
+        for (guint i = 0; i < 2; i++) {
+            cl_int error;
+
+            if (priv->dual[i])
+                UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->dual[i]));
+
+            priv->dual[i] = clCreateBuffer (priv->context, CL_MEM_READ_WRITE, dual_size, NULL, &error);
+            UFO_RESOURCES_CHECK_CLERR (error);
+        }
+
+        priv->dual_size = dual_size;
+    }
+
+    priv->current_dual = 0;
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_init_kernel, 0, sizeof (cl_mem), &priv->dual[0]));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, priv->prox_init_kernel,
+                                                        2, volume_req.dims, NULL, NULL));
+
+    UfoBuffer *x = output;
+    UfoBuffer *x_prev = ufo_buffer_dup (output);
+    UfoBuffer *y = ufo_buffer_dup (output);
+    UfoBuffer *z = ufo_buffer_dup (output);
+    UfoBuffer *sino_tmp = ufo_buffer_dup (inputs[0]);
+    UfoBuffer *restart_a = NULL;
+    UfoBuffer *restart_b = NULL;
+
+    ufo_ir_basic_ops_processor_set(ops, x, 0.0f);
+    ufo_ir_basic_ops_processor_set(ops, y, 0.0f);
+
+    if (priv->adaptive_restart) {
+        restart_a = ufo_buffer_dup (output);
+        restart_b = ufo_buffer_dup (output);
+    }
+
+    gfloat t = 1.0f;
+    guint max_iterations = ufo_ir_method_task_get_iterations_number(UFO_IR_METHOD_TASK(task));
+
+    for (guint iteration = 0; iteration < max_iterations; iteration++) {
+        ufo_ir_method_task_profile_scope (UFO_IR_METHOD_TASK(task), iteration, -1);
+        ufo_ir_method_task_telemetry_begin (UFO_IR_METHOD_TASK(task));
+        // z = y + step * A^T (b - A y)
+        ufo_ir_profiler_copy (inputs[0], sino_tmp);
+        ufo_ir_projector_task_set_correction_scale(projector, -1.0f);
+        ufo_ir_state_dependent_task_forward(sdprojector, &y, sino_tmp, requisition);
+
+        ufo_ir_profiler_copy (y, z);
+        ufo_ir_projector_task_set_relaxation(projector, step);
+        ufo_ir_state_dependent_task_backward(sdprojector, &sino_tmp, z, requisition);
+
+        // x_k+1 = prox(z), the previous estimate is kept for the momentum
+        UfoBuffer *tmp = x_prev;
+        x_prev = x;
+        x = tmp;
+        tv_prox (priv, z, x, step * priv->lambda, &volume_req, cmd_queue);
+
+        gfloat t_next = (1.0f + sqrtf (1.0f + 4.0f * t * t)) / 2.0f;
+        gfloat factor = (t - 1.0f) / t_next;
+
+        // Gradient restart scheme: drop the momentum once it points uphill
+        if (priv->adaptive_restart) {
+            ufo_ir_basic_ops_processor_deduction(ops, y, x, restart_a);
+            ufo_ir_basic_ops_processor_deduction(ops, x, x_prev, restart_b);
+
+            if (ufo_ir_basic_ops_processor_dot_product(ops, restart_a, restart_b) > 0.0f) {
+                g_debug ("FISTA iteration: %d, restarting momentum", iteration);
+                t_next = 1.0f;
+                factor = 0.0f;
+            }
+        }
+
+        momentum (priv, x, x_prev, factor, y, &volume_req, cmd_queue);
+        t = t_next;
+
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "step", step);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "momentum", factor);
+        ufo_ir_method_task_telemetry_end (UFO_IR_METHOD_TASK(task), iteration);
+
+        if (!ufo_ir_method_task_emit (UFO_IR_METHOD_TASK(task), x, iteration))
+            break;
+    }
+
+    if (x != output)
+        ufo_ir_profiler_copy (x, output);
+
+    g_object_unref (x == output ? x_prev : x);
+    g_object_unref (y);
+    g_object_unref (z);
+    g_object_unref (sino_tmp);
+
+    if (restart_a) {
+        g_object_unref (restart_a);
+        g_object_unref (restart_b);
+    }
+
+    ufo_ir_method_task_publish_output (UFO_IR_METHOD_TASK(task), output);
+    return TRUE;
+}
+
+static void
+tv_prox (UfoIrFistaTaskPrivate *priv,
+         UfoBuffer *z,
+         UfoBuffer *out,
+         gfloat weight,
+         UfoRequisition *requisition,
+         cl_command_queue cmd_queue)
+{
+    cl_mem d_z = ufo_ir_profiler_get_device_image (z, cmd_queue);
+    cl_mem d_out = ufo_ir_profiler_get_device_image (out, cmd_queue);
+    gfloat tau = TV_PROX_TAU;
+    gint positive = priv->positive_constraint;
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_dual_kernel, 0, sizeof (cl_mem), &d_z));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_dual_kernel, 3, sizeof (gfloat), &weight));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_dual_kernel, 4, sizeof (gfloat), &tau));
+
+    // Without regularization only the primal step (and positivity) remains
+    for (guint i = 0; weight > 0.0f && i < priv->tv_iterations; i++) {
+        cl_mem p_in = priv->dual[priv->current_dual];
+        cl_mem p_out = priv->dual[1 - priv->current_dual];
+
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_dual_kernel, 1, sizeof (cl_mem), &p_in));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_dual_kernel, 2, sizeof (cl_mem), &p_out));
+        UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, priv->prox_dual_kernel,
+                                                            2, requisition->dims, NULL, NULL));
+        priv->current_dual = 1 - priv->current_dual;
+    }
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_primal_kernel, 0, sizeof (cl_mem), &d_z));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_primal_kernel, 1, sizeof (cl_mem), &priv->dual[priv->current_dual]));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_primal_kernel, 2, sizeof (gfloat), &weight));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_primal_kernel, 3, sizeof (gint), &positive));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->prox_primal_kernel, 4, sizeof (cl_mem), &d_out));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, priv->prox_primal_kernel,
+                                                        2, requisition->dims, NULL, NULL));
+}
+
+static void
+momentum (UfoIrFistaTaskPrivate *priv,
+          UfoBuffer *x,
+          UfoBuffer *x_prev,
+          gfloat factor,
+          UfoBuffer *y,
+          UfoRequisition *requisition,
+          cl_command_queue cmd_queue)
+{
+    cl_mem d_x = ufo_ir_profiler_get_device_image (x, cmd_queue);
+    cl_mem d_x_prev = ufo_ir_profiler_get_device_image (x_prev, cmd_queue);
+    cl_mem d_y = ufo_ir_profiler_get_device_image (y, cmd_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->momentum_kernel, 0, sizeof (cl_mem), &d_x));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->momentum_kernel, 1, sizeof (cl_mem), &d_x_prev));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->momentum_kernel, 2, sizeof (gfloat), &factor));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->momentum_kernel, 3, sizeof (cl_mem), &d_y));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, priv->momentum_kernel,
+                                                        2, requisition->dims, NULL, NULL));
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_FISTA_TASK_H
+#define __UFO_IR_FISTA_TASK_H
+
+#include "core/ufo-ir-method-task.h"
+
+
+G_BEGIN_DECLS
+
+#define UFO_IR_TYPE_FISTA_TASK             (ufo_ir_fista_task_get_type())
+#define UFO_IR_FISTA_TASK(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), UFO_IR_TYPE_FISTA_TASK, UfoIrFistaTask))
+#define UFO_IR_IS_FISTA_TASK(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), UFO_IR_TYPE_FISTA_TASK))
+#define UFO_IR_FISTA_TASK_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), UFO_IR_TYPE_FISTA_TASK, UfoIrFistaTaskClass))
+#define UFO_IR_IS_FISTA_TASK_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), UFO_IR_TYPE_FISTA_TASK))
+#define UFO_IR_FISTA_TASK_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), UFO_IR_TYPE_FISTA_TASK, UfoIrFistaTaskClass))
+
+typedef struct _UfoIrFistaTask           UfoIrFistaTask;
+typedef struct _UfoIrFistaTaskClass      UfoIrFistaTaskClass;
+typedef struct _UfoIrFistaTaskPrivate    UfoIrFistaTaskPrivate;
+
+struct _UfoIrFistaTask {
+    UfoIrMethodTask parent_instance;
+
+    UfoIrFistaTaskPrivate *priv;
+};
+
+struct _UfoIrFistaTaskClass {
+    UfoIrMethodTaskClass parent_class;
+};
+
+UfoNode  *ufo_ir_fista_task_new       (void);
+GType     ufo_ir_fista_task_get_type  (void);
+
+gfloat   ufo_ir_fista_task_get_lambda(UfoIrFistaTask *self);
+void     ufo_ir_fista_task_set_lambda(UfoIrFistaTask *self, gfloat value);
+
+guint    ufo_ir_fista_task_get_tv_iterations(UfoIrFistaTask *self);
+void     ufo_ir_fista_task_set_tv_iterations(UfoIrFistaTask *self, guint value);
+
+gboolean ufo_ir_fista_task_get_adaptive_restart(UfoIrFistaTask *self);
+void     ufo_ir_fista_task_set_adaptive_restart(UfoIrFistaTask *self, gboolean value);
+
+gboolean ufo_ir_fista_task_get_positive_constraint(UfoIrFistaTask *self);
+void     ufo_ir_fista_task_set_positive_constraint(UfoIrFistaTask *self, gboolean value);
+
+G_END_DECLS
+
+#endif
+
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <math.h>
+
+#include "ufo-ir-lsqr-task.h"
+#include "core/ufo-ir-basic-ops-processor.h"
+#include "core/ufo-ir-profiler.h"
+
+static void ufo_ir_lsqr_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
+static void ufo_ir_lsqr_task_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
+static void ufo_ir_lsqr_task_dispose (GObject *object);
+static void ufo_task_interface_init (UfoTaskIface *iface);
+static void ufo_ir_lsqr_task_setup (UfoTask *task, UfoResources *resources, GError **error);
+static gboolean ufo_ir_lsqr_task_process (UfoTask *task, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+
+struct _UfoIrLsqrTaskPrivate {
+    gfloat tolerance;
+    UfoIrBasicOpsProcessor *bo_processor;
+};
+
+G_DEFINE_TYPE_WITH_CODE (UfoIrLsqrTask, ufo_ir_lsqr_task, UFO_IR_TYPE_METHOD_TASK,
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK,
+                                                ufo_task_interface_init))
+
+#define UFO_IR_LSQR_TASK_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_IR_TYPE_LSQR_TASK, UfoIrLsqrTaskPrivate))
+
+enum {
+    PROP_0 = 100,
+    PROP_TOLERANCE,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = { NULL, };
+
+static void
+ufo_task_interface_init (UfoTaskIface *iface)
+{
+    iface->process = ufo_ir_lsqr_task_process;
+    iface->setup = ufo_ir_lsqr_task_setup;
+}
+
+static void
+ufo_ir_lsqr_task_class_init (UfoIrLsqrTaskClass *klass)
+{
+    GObjectClass *oclass = G_OBJECT_CLASS (klass);
+
+    oclass->set_property = ufo_ir_lsqr_task_set_property;
+    oclass->get_property = ufo_ir_lsqr_task_get_property;
+    oclass->dispose = ufo_ir_lsqr_task_dispose;
+
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_volumes = 3;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_sinograms = 2;
+
+    // Stop when the estimate of ||b - Ax|| drops below tolerance * ||b||,
+    // 0 runs all iterations.
+    properties[PROP_TOLERANCE] =
+            g_param_spec_float("tolerance",
+                               "tolerance",
+                               "Relative residual to stop at",
+                               0.0f, 1.0f, 0.0f,
+                               G_PARAM_READWRITE);
+
+    for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
+        g_object_class_install_property (oclass, i, properties[i]);
+
+    g_type_class_add_private (oclass, sizeof(UfoIrLsqrTaskPrivate));
+}
+
+static void
+ufo_ir_lsqr_task_init(UfoIrLsqrTask *self)
+{
+    self->priv = UFO_IR_LSQR_TASK_GET_PRIVATE(self);
+    self->priv->tolerance = 0.0f;
+    self->priv->bo_processor = NULL;
+}
+
+static void
+ufo_ir_lsqr_task_set_property (GObject *object,
+                               guint property_id,
+                               const GValue *value,
+                               GParamSpec *pspec)
+{
+    UfoIrLsqrTask *self = UFO_IR_LSQR_TASK (object);
+
+    switch (property_id) {
+        case PROP_TOLERANCE:
+            ufo_ir_lsqr_task_set_tolerance(self, g_value_get_float(value));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_ir_lsqr_task_get_property (GObject *object,
+                               guint property_id,
+                               GValue *value,
+                               GParamSpec *pspec)
+{
+    UfoIrLsqrTask *self = UFO_IR_LSQR_TASK (object);
+
+    switch (property_id) {
+        case PROP_TOLERANCE:
+            g_value_set_float(value, ufo_ir_lsqr_task_get_tolerance(self));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_ir_lsqr_task_dispose (GObject *object)
+{
+    UfoIrLsqrTaskPrivate *priv = UFO_IR_LSQR_TASK_GET_PRIVATE (object);
+
+    if (priv->bo_processor != NULL) {
+        g_object_unref (priv->bo_processor);
+        priv->bo_processor = NULL;
+    }
+
+    G_OBJECT_CLASS (ufo_ir_lsqr_task_parent_class)->dispose (object);
+}
+
+gfloat
+ufo_ir_lsqr_task_get_tolerance(UfoIrLsqrTask *self)
+{
+    UfoIrLsqrTaskPrivate *priv = UFO_IR_LSQR_TASK_GET_PRIVATE (self);
+    return priv->tolerance;
+}
+
+void
+ufo_ir_lsqr_task_set_tolerance(UfoIrLsqrTask *self, gfloat value)
+{
+    UfoIrLsqrTaskPrivate *priv = UFO_IR_LSQR_TASK_GET_PRIVATE (self);
+    priv->tolerance = value;
+}
+
+UfoNode *
+ufo_ir_lsqr_task_new (void)
+{
+    return UFO_NODE (g_object_new (UFO_IR_TYPE_LSQR_TASK, NULL));
+}
+
+static void
+ufo_ir_lsqr_task_setup (UfoTask      *task,
+                        UfoResources *resources,
+                        GError       **error)
+{
+    UfoIrLsqrTaskPrivate *priv = UFO_IR_LSQR_TASK_GET_PRIVATE (task);
+    ufo_task_node_set_proc_node(UFO_TASK_NODE(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), ufo_task_node_get_proc_node(UFO_TASK_NODE(task)));
+
+    ufo_task_setup(UFO_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), resources, error);
+    ufo_ir_method_task_setup_preview(UFO_IR_METHOD_TASK(task), resources, error);
+
+    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
+    priv->bo_processor = ufo_ir_basic_ops_processor_new(resources, cmd_queue);
+}
+
+static gboolean
+ufo_ir_lsqr_task_process (UfoTask *task,
+                          UfoBuffer **inputs,
+                          UfoBuffer *output,
+                          UfoRequisition *requisition)
+{
+    UfoIrLsqrTaskPrivate *priv = UFO_IR_LSQR_TASK_GET_PRIVATE (task);
+
+    ufo_ir_method_task_profile_slice (UFO_IR_METHOD_TASK(task));
+
+    if (ufo_ir_method_task_run_preview (UFO_IR_METHOD_TASK(task), inputs, output, requisition))
+        return TRUE;
+
+    inputs = ufo_ir_method_task_stage_inputs (UFO_IR_METHOD_TASK(task), inputs);
+    UfoIrBasicOpsProcessor *ops = priv->bo_processor;
+
+    // Get and setup projector
+    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task));
+    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK(projector);
+    ufo_ir_projector_task_set_relaxation(projector, 1.0f);
+    ufo_ir_projector_task_set_correction_scale(projector, 1.0f);
+
+    UfoBuffer *x = output;
+    ufo_ir_basic_ops_processor_set(ops, x, 0.0f);
+
+    // beta * u = b
+    UfoBuffer *u = ufo_buffer_dup (inputs[0]);
+    ufo_ir_profiler_copy (inputs[0], u);
+    gfloat beta = ufo_ir_basic_ops_processor_l2_norm(ops, u);
+
+    if (beta <= 0.0f) {
+        g_object_unref(u);
+        return TRUE;
+    }
+
+    ufo_ir_basic_ops_processor_mul_scalar(ops, u, 1.0f / beta);
+
+    // alpha * v = A^T u
+    UfoBuffer *v = ufo_buffer_dup (output);
+    ufo_ir_basic_ops_processor_set(ops, v, 0.0f);
+    ufo_ir_state_dependent_task_backward(sdprojector, &u, v, requisition);
+    gfloat alpha = ufo_ir_basic_ops_processor_l2_norm(ops, v);
+
+    if (alpha <= 0.0f) {
+        g_object_unref(u);
+        g_object_unref(v);
+        return TRUE;
+    }
+
+    ufo_ir_basic_ops_processor_mul_scalar(ops, v, 1.0f / alpha);
+
+    UfoBuffer *w = ufo_buffer_dup (output);
+    ufo_ir_profiler_copy (v, w);
+
+    gfloat phibar = beta;
+    gfloat rhobar = alpha;
+    gfloat phibar_stop = priv->tolerance * beta;
+
+    guint max_iterations = ufo_ir_method_task_get_iterations_number(UFO_IR_METHOD_TASK(task));
+    for (guint iteration = 0; iteration < max_iterations; iteration++) {
+        ufo_ir_method_task_profile_scope (UFO_IR_METHOD_TASK(task), iteration, -1);
+        ufo_ir_method_task_telemetry_begin (UFO_IR_METHOD_TASK(task));
+        // Golub-Kahan bidiagonalization. The projector accumulates into its
+        // output, so scaling the old vector first fuses the subtraction.
+        // beta * u = A v - alpha * u
+        ufo_ir_basic_ops_processor_mul_scalar(ops, u, -alpha);
+        ufo_ir_state_dependent_task_forward(sdprojector, &v, u, requisition);
+        beta = ufo_ir_basic_ops_processor_l2_norm(ops, u);
+
+        if (beta > 0.0f)
+            ufo_ir_basic_ops_processor_mul_scalar(ops, u, 1.0f / beta);
+
+        // alpha * v = A^T u - beta * v
+        ufo_ir_basic_ops_processor_mul_scalar(ops, v, -beta);
+        ufo_ir_state_dependent_task_backward(sdprojector, &u, v, requisition);
+        alpha = ufo_ir_basic_ops_processor_l2_norm(ops, v);
+
+        if (alpha > 0.0f)
+            ufo_ir_basic_ops_processor_mul_scalar(ops, v, 1.0f / alpha);
+
+        // Plane rotation eliminating the subdiagonal beta
+        gfloat rho = sqrtf(rhobar * rhobar + beta * beta);
+        gfloat c = rhobar / rho;
+        gfloat s = beta / rho;
+        gfloat theta = s * alpha;
+        gfloat phi = c * phibar;
+        rhobar = -c * alpha;
+        phibar = s * phibar;
+
+        // x = x + (phi / rho) * w, w = v - (theta / rho) * w
+        ufo_ir_basic_ops_processor_add2(ops, x, w, phi / rho, x);
+        ufo_ir_basic_ops_processor_add2(ops, v, w, -theta / rho, w);
+
+        g_debug ("LSQR iteration: %d, |b - Ax| = %e", iteration, phibar);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "alpha", alpha);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "beta", beta);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "residual", phibar);
+        ufo_ir_method_task_telemetry_end (UFO_IR_METHOD_TASK(task), iteration);
+
+        if (!ufo_ir_method_task_emit (UFO_IR_METHOD_TASK(task), x, iteration))
+            break;
+
+        if (phibar <= phibar_stop || alpha <= 0.0f || beta <= 0.0f)
+            break;
+    }
+
+    g_object_unref(u);
+    g_object_unref(v);
+    g_object_unref(w);
+    ufo_ir_method_task_publish_output (UFO_IR_METHOD_TASK(task), output);
+    return TRUE;
+}
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <string.h>
+
+#include "ufo-ir-multigrid-task.h"
+#include "core/ufo-ir-basic-ops.h"
+
+// Coarser levels than this are skipped
+#define MIN_COARSE_WIDTH 16
+
+static void ufo_ir_multigrid_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
+static void ufo_ir_multigrid_task_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
+static void ufo_ir_multigrid_task_dispose (GObject *object);
+static void ufo_ir_multigrid_task_finalize (GObject *object);
+static void ufo_task_interface_init (UfoTaskIface *iface);
+static void ufo_ir_multigrid_task_setup (UfoTask *task, UfoResources *resources, GError **error);
+static gboolean ufo_ir_multigrid_task_process (UfoTask *task, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+
+static void levels_release (UfoIrMultigridTaskPrivate *priv);
+
+// A binned copy of the method with its own projector and workspace
+typedef struct {
+    guint factor;
+    UfoIrProjectorTask *projector;
+    UfoIrMethodTask *method;
+    UfoBuffer *sinogram;
+    UfoBuffer *volume;
+} Level;
+
+struct _UfoIrMultigridTaskPrivate {
+    // Method parameters
+    guint n_levels;
+    UfoTask *method;
+
+    // Level 0 is the method itself
+    Level levels[UFO_IR_MULTIGRID_TASK_MAX_LEVELS];
+    gboolean warm_start;
+
+    cl_context context;
+    gpointer bin_kernel;
+    gpointer prolongate_kernel;
+};
+
+G_DEFINE_TYPE_WITH_CODE (UfoIrMultigridTask, ufo_ir_multigrid_task, UFO_IR_TYPE_METHOD_TASK,
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK,
+                                                ufo_task_interface_init))
+
+#define UFO_IR_MULTIGRID_TASK_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_IR_TYPE_MULTIGRID_TASK, UfoIrMultigridTaskPrivate))
+
+enum {
+    PROP_0 = 100,
+    PROP_LEVELS,
+    PROP_METHOD,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = { NULL, };
+
+static void
+ufo_task_interface_init (UfoTaskIface *iface)
+{
+    iface->process = ufo_ir_multigrid_task_process;
+    iface->setup = ufo_ir_multigrid_task_setup;
+}
+
+static void
+ufo_ir_multigrid_task_class_init (UfoIrMultigridTaskClass *klass)
+{
+    GObjectClass *oclass = G_OBJECT_CLASS (klass);
+
+    oclass->set_property = ufo_ir_multigrid_task_set_property;
+    oclass->get_property = ufo_ir_multigrid_task_get_property;
+    oclass->dispose = ufo_ir_multigrid_task_dispose;
+    oclass->finalize = ufo_ir_multigrid_task_finalize;
+
+    // A SIRT workspace plus a third of it for the coarse levels
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_volumes = 4;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_sinograms = 4;
+
+    properties[PROP_LEVELS] =
+            g_param_spec_uint("levels",
+                              "Number of resolution levels",
+                              "Number of resolution levels, each coarser one binned by 2",
+                              1, UFO_IR_MULTIGRID_TASK_MAX_LEVELS, 2,
+                              G_PARAM_READWRITE);
+
+    // Runs num-iterations on each coarse level and its own number of
+    // iterations on the full resolution
+    properties[PROP_METHOD] =
+            g_param_spec_object("method",
+                                "Wrapped method",
+                                "Wrapped method",
+                                UFO_TYPE_TASK,
+                                G_PARAM_READWRITE);
+
+    for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
+        g_object_class_install_property (oclass, i, properties[i]);
+
+    g_type_class_add_private (oclass, sizeof(UfoIrMultigridTaskPrivate));
+}
+
+static void
+ufo_ir_multigrid_task_init(UfoIrMultigridTask *self)
+{
+    UfoIrMultigridTaskPrivate *priv;
+    self->priv = priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE(self);
+    priv->n_levels = 2;
+    priv->method = NULL;
+    priv->warm_start = FALSE;
+    priv->context = NULL;
+    memset (priv->levels, 0, sizeof (priv->levels));
+}
+
+static void
+ufo_ir_multigrid_task_set_property (GObject *object,
+                                    guint property_id,
+                                    const GValue *value,
+                                    GParamSpec *pspec)
+{
+    UfoIrMultigridTask *self = UFO_IR_MULTIGRID_TASK (object);
+
+    switch (property_id) {
+        case PROP_LEVELS:
+            ufo_ir_multigrid_task_set_levels(self, g_value_get_uint(value));
+            break;
+        case PROP_METHOD:
+            ufo_ir_multigrid_task_set_method(self, g_value_get_object(value));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_ir_multigrid_task_get_property (GObject *object,
+                                    guint property_id,
+                                    GValue *value,
+                                    GParamSpec *pspec)
+{
+    UfoIrMultigridTask *self = UFO_IR_MULTIGRID_TASK (object);
+
+    switch (property_id) {
+        case PROP_LEVELS:
+            g_value_set_uint(value, ufo_ir_multigrid_task_get_levels(self));
+            break;
+        case PROP_METHOD:
+            g_value_set_object(value, ufo_ir_multigrid_task_get_method(self));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_ir_multigrid_task_dispose (GObject *object)
+{
+    UfoIrMultigridTaskPrivate *priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE (object);
+
+    levels_release (priv);
+
+    if (priv->method != NULL) {
+        g_object_unref (priv->method);
+        priv->method = NULL;
+    }
+
+    G_OBJECT_CLASS (ufo_ir_multigrid_task_parent_class)->dispose (object);
+}
+
+static void
+ufo_ir_multigrid_task_finalize (GObject *object)
+{
+    UfoIrMultigridTaskPrivate *priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE (object);
+
+    if (priv->context) {
+        UFO_RESOURCES_CHECK_CLERR (clReleaseContext (priv->context));
+        priv->context = NULL;
+    }
+
+    G_OBJECT_CLASS (ufo_ir_multigrid_task_parent_class)->finalize (object);
+}
+
+guint
+ufo_ir_multigrid_task_get_levels(UfoIrMultigridTask *self)
+{
+    UfoIrMultigridTaskPrivate *priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE (self);
+    return priv->n_levels;
+}
+
+void
+ufo_ir_multigrid_task_set_levels(UfoIrMultigridTask *self, guint value)
+{
+    UfoIrMultigridTaskPrivate *priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE (self);
+    priv->n_levels = CLAMP (value, 1, UFO_IR_MULTIGRID_TASK_MAX_LEVELS);
+}
+
+UfoTask *
+ufo_ir_multigrid_task_get_method(UfoIrMultigridTask *self)
+{
+    UfoIrMultigridTaskPrivate *priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE (self);
+    return priv->method;
+}
+
+void
+ufo_ir_multigrid_task_set_method(UfoIrMultigridTask *self, UfoTask *value)
+{
+    UfoIrMultigridTaskPrivate *priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE (self);
+
+    if (priv->method != NULL)
+        g_object_unref (priv->method);
+
+    priv->method = value != NULL ? g_object_ref (value) : NULL;
+}
+
+UfoNode *
+ufo_ir_multigrid_task_new (void)
+{
+    return UFO_NODE (g_object_new (UFO_IR_TYPE_MULTIGRID_TASK, NULL));
+}
+
+static void
+levels_release (UfoIrMultigridTaskPrivate *priv)
+{
+    for (guint i = 1; i < UFO_IR_MULTIGRID_TASK_MAX_LEVELS; i++) {
+        Level *level = &priv->levels[i];
+
+        if (level->method != NULL)
+            g_object_unref (level->method);
+
+        if (level->projector != NULL)
+            g_object_unref (level->projector);
+
+        if (level->sinogram != NULL)
+            g_object_unref (level->sinogram);
+
+        if (level->volume != NULL)
+            g_object_unref (level->volume);
+
+        memset (level, 0, sizeof (Level));
+    }
+}
+
+static void
+ufo_ir_multigrid_task_setup (UfoTask      *task,
+                             UfoResources *resources,
+                             GError       **error)
+{
+    UfoIrMultigridTaskPrivate *priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE (task);
+    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task));
+    UfoNode *proc_node = ufo_task_node_get_proc_node(UFO_TASK_NODE(task));
+
+    // Properties the copies must not share with the method
+    const gchar *method_skip[] = { "projector", "telemetry", "prefetch", "concurrent-slices", "emit-every", NULL };
+    const gchar *projector_skip[] = { "axis_position", NULL };
+
+    if (priv->method == NULL || !UFO_IR_IS_METHOD_TASK (priv->method)) {
+        g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_SETUP, "method is not defined");
+        return;
+    }
+
+    if (projector == NULL) {
+        g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_SETUP, "No projector specified.");
+        return;
+    }
+
+    // The method sets up the projector, only the result of the levels goes downstream
+    ufo_task_node_set_proc_node(UFO_TASK_NODE(priv->method), proc_node);
+    ufo_ir_method_task_set_projector(UFO_IR_METHOD_TASK(priv->method), projector);
+    ufo_ir_method_task_set_emit_every(UFO_IR_METHOD_TASK(priv->method), 0);
+    ufo_task_setup(priv->method, resources, error);
+
+    if (error != NULL && *error != NULL)
+        return;
+
+    // Without a warm start every level would begin from scratch
+    priv->warm_start = UFO_IR_METHOD_TASK_GET_CLASS (priv->method)->refine != NULL;
+
+    if (priv->n_levels > 1 && !priv->warm_start)
+        g_warning ("%s cannot continue from an estimate, reconstructing at full resolution only",
+                   G_OBJECT_TYPE_NAME (priv->method));
+
+    levels_release (priv);
+
+    for (guint i = 1; i < priv->n_levels && priv->warm_start; i++) {
+        Level *level = &priv->levels[i];
+        gfloat axis_position = ufo_ir_projector_task_get_axis_position (projector);
+
+        level->factor = 1 << i;
+        level->projector = UFO_IR_PROJECTOR_TASK (ufo_ir_method_task_clone (G_OBJECT (projector), projector_skip));
+
+        // Detectors are binned and all angles are kept
+        ufo_ir_projector_task_set_axis_position (level->projector,
+                                                 axis_position < 0 ? axis_position : axis_position / level->factor);
+
+        level->method = UFO_IR_METHOD_TASK (ufo_ir_method_task_clone (G_OBJECT (priv->method), method_skip));
+        ufo_ir_method_task_set_projector (level->method, level->projector);
+        ufo_ir_method_task_set_iterations_number (level->method,
+                                                  ufo_ir_method_task_get_iterations_number (UFO_IR_METHOD_TASK (task)));
+        ufo_task_node_set_proc_node (UFO_TASK_NODE (level->method), proc_node);
+        ufo_task_setup (UFO_TASK (level->method), resources, error);
+
+        if (error != NULL && *error != NULL)
+            return;
+    }
+
+    priv->context = ufo_resources_get_context (resources);
+    UFO_RESOURCES_CHECK_CLERR (clRetainContext (priv->context));
+
+    priv->bin_kernel = ufo_ir_op_bin_detectors_generate_kernel (resources);
+    priv->prolongate_kernel = ufo_ir_op_prolongate_generate_kernel (resources);
+}
+
+static UfoBuffer *
+ensure_buffer (UfoIrMultigridTaskPrivate *priv, UfoBuffer *buffer, UfoRequisition *requisition)
+{
+    if (buffer == NULL)
+        return ufo_buffer_new (requisition, priv->context);
+
+    if (ufo_buffer_cmp_dimensions (buffer, requisition) != 0)
+        ufo_buffer_resize (buffer, requisition);
+
+    return buffer;
+}
+
+static gboolean
+ufo_ir_multigrid_task_process (UfoTask *task,
+                               UfoBuffer **inputs,
+                               UfoBuffer *output,
+                               UfoRequisition *requisition)
+{
+    UfoIrMultigridTaskPrivate *priv = UFO_IR_MULTIGRID_TASK_GET_PRIVATE (task);
+
+    ufo_ir_method_task_profile_slice (UFO_IR_METHOD_TASK(task));
+
+    inputs = ufo_ir_method_task_stage_inputs (UFO_IR_METHOD_TASK(task), inputs);
+    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
+
+    UfoRequisition sino_req;
+    ufo_buffer_get_requisition (inputs[0], &sino_req);
+
+    UfoBuffer *estimate = NULL;
+    guint estimate_factor = 1;
+
+    // From the coarsest level up, each one starting from the result of the
+    // previous
+    for (guint i = priv->n_levels - 1; i > 0; i--) {
+        Level *level = &priv->levels[i];
+        UfoRequisition coarse_sino_req = sino_req;
+        UfoRequisition volume_req;
+
+        if (level->method == NULL || sino_req.dims[0] / level->factor < MIN_COARSE_WIDTH)
+            continue;
+
+        coarse_sino_req.dims[0] = sino_req.dims[0] / level->factor;
+        level->sinogram = ensure_buffer (priv, level->sinogram, &coarse_sino_req);
+        ufo_ir_op_bin_detectors (inputs[0], level->sinogram, level->factor, 1, cmd_queue, priv->bin_kernel);
+
+        ufo_task_get_requisition (UFO_TASK (level->method), &level->sinogram, &volume_req, NULL);
+        level->volume = ensure_buffer (priv, level->volume, &volume_req);
+
+        if (estimate == NULL) {
+            ufo_task_process (UFO_TASK (level->method), &level->sinogram, level->volume, &volume_req);
+        }
+        else {
+            ufo_ir_op_prolongate (estimate, level->volume, (gfloat) estimate_factor / level->factor,
+                                  cmd_queue, priv->prolongate_kernel);
+            ufo_ir_method_task_refine (level->method, &level->sinogram, level->volume, &volume_req);
+        }
+
+        estimate = level->volume;
+        estimate_factor = level->factor;
+    }
+
+    if (estimate == NULL) {
+        ufo_task_process (priv->method, inputs, output, requisition);
+    }
+    else {
+        ufo_ir_op_prolongate (estimate, output, (gfloat) estimate_factor, cmd_queue, priv->prolongate_kernel);
+        ufo_ir_method_task_refine (UFO_IR_METHOD_TASK (priv->method), inputs, output, requisition);
+    }
+
+    ufo_ir_method_task_publish_output (UFO_IR_METHOD_TASK(task), output);
+    return TRUE;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_MULTIGRID_TASK_H
+#define __UFO_IR_MULTIGRID_TASK_H
+
+#include "core/ufo-ir-method-task.h"
+
+
+G_BEGIN_DECLS
+
+#define UFO_IR_TYPE_MULTIGRID_TASK             (ufo_ir_multigrid_task_get_type())
+#define UFO_IR_MULTIGRID_TASK(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), UFO_IR_TYPE_MULTIGRID_TASK, UfoIrMultigridTask))
+#define UFO_IR_IS_MULTIGRID_TASK(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), UFO_IR_TYPE_MULTIGRID_TASK))
+#define UFO_IR_MULTIGRID_TASK_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), UFO_IR_TYPE_MULTIGRID_TASK, UfoIrMultigridTaskClass))
+#define UFO_IR_IS_MULTIGRID_TASK_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), UFO_IR_TYPE_MULTIGRID_TASK))
+#define UFO_IR_MULTIGRID_TASK_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), UFO_IR_TYPE_MULTIGRID_TASK, UfoIrMultigridTaskClass))
+
+#define UFO_IR_MULTIGRID_TASK_MAX_LEVELS 4
+
+typedef struct _UfoIrMultigridTask           UfoIrMultigridTask;
+typedef struct _UfoIrMultigridTaskClass      UfoIrMultigridTaskClass;
+typedef struct _UfoIrMultigridTaskPrivate    UfoIrMultigridTaskPrivate;
+
+struct _UfoIrMultigridTask {
+    UfoIrMethodTask parent_instance;
+
+    UfoIrMultigridTaskPrivate *priv;
+};
+
+struct _UfoIrMultigridTaskClass {
+    UfoIrMethodTaskClass parent_class;
+};
+
+UfoNode  *ufo_ir_multigrid_task_new       (void);
+GType     ufo_ir_multigrid_task_get_type  (void);
+
+// Number of resolution levels, level i is binned by 2^i
+guint    ufo_ir_multigrid_task_get_levels(UfoIrMultigridTask *self);
+void     ufo_ir_multigrid_task_set_levels(UfoIrMultigridTask *self, guint value);
+
+UfoTask *ufo_ir_multigrid_task_get_method(UfoIrMultigridTask *self);
+void     ufo_ir_multigrid_task_set_method(UfoIrMultigridTask *self, UfoTask *value);
+
+G_END_DECLS
+
+#endif
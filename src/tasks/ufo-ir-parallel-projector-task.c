@@ -18,6 +18,12 @@
  */
 
 #include "ufo-ir-parallel-projector-task.h"
+#include "core/ufo-ir-profiler.h"
+#include "core/ufo-ir-sparse-matrix.h"
+#include "core/ufo-ir-cpu-projector.h"
+#include "core/ufo-ir-device.h"
+#include "core/ufo-ir-exec.h"
+#include "core/ufo-ir-basic-ops.h"
 #include <math.h>
 
 #ifdef __APPLE__
@@ -26,6 +32,8 @@
 #include <CL/cl.h>
 #endif
 
+#define MAX_SPLIT 16
+
 struct _UfoIrParallelProjectorTaskPrivate {
     cl_context context;
 
@@ -36,16 +44,66 @@ struct _UfoIrParallelProjectorTaskPrivate {
     gfloat *scan_host_cos_lut;
 
     gchar *model_name;      // Projection model name
+    gchar *backend;         // "opencl" or "cpu"
     gpointer fp_kernel[2];  // Forward projections kernels
     gpointer bp_kernel;     // Backprojection kernel
 
+    // Buffer variants of the joseph kernels for devices that emulate images
+    gpointer fp_buffer_kernel[2];
+    gpointer bp_buffer_kernel;
+    gint prefer_buffers;    // -1 until the device is known
+
     gboolean first_run;     // Required to avoid the recalculation of angles
     guint detectors_num;
     guint angles_num;
+    guint angle_stride;     // Sinogram rows are every n-th angle of the scan
     UfoIrProjectionsSubset *full_subsets_list;
     guint full_subsets_cnt;
+
+    // System matrix of the joseph-csr model
+    gpointer spmv_kernel;
+    gpointer spmv_t_kernel;
+    UfoIrSparseMatrix *matrix;
+    guint matrix_budget;    // In MiB
+    gboolean matrix_failed; // Budget exceeded, use the fallback kernels
+
+    // Angle partitions spread over the devices of the context. Partition 0
+    // runs on the queue of the caller, the others on queues of their own
+    // and add their partial results to it.
+    guint split;
+    cl_device_id *devices;
+    guint n_devices;
+    cl_device_id split_device;  // Device of the caller the queues belong to
+    cl_command_queue split_queues[MAX_SPLIT];
+    UfoIrProjectionsSubset *split_subsets[MAX_SPLIT];
+    guint split_subsets_cnt[MAX_SPLIT];
+    UfoBuffer *split_volumes[MAX_SPLIT];
+    UfoBuffer *split_sinograms[MAX_SPLIT];
+    cl_event split_free;        // The partial buffers may be reused
+    gpointer op_set_buffer_kernel;
+    gpointer op_add_buffer_kernel;
+
+    // Tiled projections of volumes kept in host memory, streamed through
+    // the device a band of rows at a time
+    guint tile_rows;
+    gpointer fp_tile_kernel[2];
+    gpointer bp_tile_kernel;
+    cl_mem tile;
+    gsize tile_size;
+    cl_mem tile_sinogram;   // Device copy of host sinograms
+    gsize tile_sinogram_size;
+    cl_event tile_done;     // Last tiled projection, the tiles are free after it
 };
 
+#define CSR_MODEL "joseph-csr"
+#define CSR_FALLBACK_MODEL "joseph-matched"
+#define IMAGE_MODEL "joseph"
+#define BUFFER_MODEL "joseph-buffer"
+#define CPU_BACKEND "cpu"
+
+#define USE_CPU_BACKEND(priv) (!g_strcmp0 ((priv)->backend, CPU_BACKEND))
+#define USE_TILES(priv) ((priv)->tile_rows > 0 && (priv)->bp_tile_kernel != NULL)
+
 static void ufo_task_interface_init (UfoTaskIface *iface);
 static void ufo_ir_parallel_projector_task_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
 static void ufo_ir_parallel_projector_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
@@ -56,6 +114,16 @@ static cl_mem create_lut_buffer (guint angles_num, gfloat angles_step, const cl_
 static UfoIrProjectionsSubset *generate_full_subsets_list (UfoIrParallelProjectorTaskPrivate *priv);
 static void ufo_ir_parallel_projector_subset_bp_real(UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, UfoIrProjectionsSubset *subset, UfoRequisition *requisitions, cl_command_queue cmd_queue);
 static void ufo_ir_parallel_projector_subset_fp_real(UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, UfoIrProjectionsSubset *subset, UfoRequisition *requisitions, cl_command_queue cmd_queue);
+static gboolean load_kernels (UfoResources *resources, const gchar *model, gpointer *fp_kernel, gpointer *bp_kernel, GError **error);
+static gboolean use_buffer_kernels (UfoIrParallelProjectorTaskPrivate *priv, UfoBuffer *volume, UfoBuffer *sinogram, cl_command_queue cmd_queue);
+static gboolean ensure_matrix (UfoIrParallelProjectorTask *self, UfoBuffer *volume);
+static void matrix_product (UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, guint offset, guint n, gboolean transposed, cl_command_queue cmd_queue);
+static void cpu_project (UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, guint offset, guint n, gboolean backward, cl_command_queue cmd_queue);
+static void project_subsets (UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, UfoIrProjectionsSubset *subsets, guint n_subsets, gboolean backward, cl_command_queue cmd_queue);
+static gboolean ensure_split (UfoIrParallelProjectorTask *self, cl_command_queue cmd_queue);
+static void split_project (UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, gboolean backward, cl_command_queue cmd_queue);
+static void release_split (UfoIrParallelProjectorTaskPrivate *priv, gboolean subsets_only);
+static void tiled_project (UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, UfoIrProjectionsSubset *subsets, guint n_subsets, gboolean backward, cl_command_queue cmd_queue);
 // State dependent methods
 static void ufo_ir_parallel_projector_task_setup (UfoIrStateDependentTask *self, UfoResources *resources, GError **error);
 gboolean ufo_ir_parallel_projector_task_forward(UfoIrStateDependentTask *self, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
@@ -71,6 +139,11 @@ enum {
     PROP_0 = 200,
     PROP_MODEL,
     PROP_ANGLES_NUM,
+    PROP_MATRIX_BUDGET,
+    PROP_BACKEND,
+    PROP_SPLIT,
+    PROP_TILE_ROWS,
+    PROP_ANGLE_STRIDE,
     N_PROPERTIES
 };
 
@@ -81,13 +154,10 @@ ufo_ir_parallel_projector_task_new (void) {
     return UFO_NODE (g_object_new (UFO_IR_TYPE_PARALLEL_PROJECTOR_TASK, NULL));
 }
 
+// Angle tables and the subsets derived from them
 static void
-ufo_ir_parallel_projector_task_finalize (GObject *object)
+release_luts (UfoIrParallelProjectorTaskPrivate *priv)
 {
-    UfoIrParallelProjectorTaskPrivate *priv;
-
-    priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE (object);
-
     if (priv->scan_sin_lut) {
         UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->scan_sin_lut));
         priv->scan_sin_lut = NULL;
@@ -98,6 +168,40 @@ ufo_ir_parallel_projector_task_finalize (GObject *object)
         priv->scan_cos_lut = NULL;
     }
 
+    g_free (priv->scan_host_sin_lut);
+    g_free (priv->scan_host_cos_lut);
+    g_free (priv->full_subsets_list);
+    priv->scan_host_sin_lut = NULL;
+    priv->scan_host_cos_lut = NULL;
+    priv->full_subsets_list = NULL;
+}
+
+static void
+ufo_ir_parallel_projector_task_finalize (GObject *object)
+{
+    UfoIrParallelProjectorTaskPrivate *priv;
+
+    priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE (object);
+
+    release_luts (priv);
+    ufo_ir_sparse_matrix_release (priv->matrix);
+    priv->matrix = NULL;
+
+    release_split (priv, FALSE);
+    g_free (priv->devices);
+
+    if (priv->tile != NULL)
+        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->tile));
+
+    if (priv->tile_sinogram != NULL)
+        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->tile_sinogram));
+
+    if (priv->tile_done != NULL)
+        clReleaseEvent (priv->tile_done);
+
+    g_free (priv->model_name);
+    g_free (priv->backend);
+
     G_OBJECT_CLASS (ufo_ir_parallel_projector_task_parent_class)->finalize (object);
 }
 
@@ -136,6 +240,52 @@ ufo_ir_parallel_projector_task_class_init (UfoIrParallelProjectorTaskClass *klas
                            (guint)0, G_MAXUINT, (guint)0,
                            G_PARAM_READWRITE);
 
+    // Device memory the joseph-csr model may use for A and its transpose.
+    // Larger matrices fall back to the on-the-fly joseph-matched kernels.
+    properties[PROP_MATRIX_BUDGET] =
+        g_param_spec_uint ("matrix_budget",
+                           "Memory budget of the system matrix in MiB",
+                           "Memory budget of the system matrix in MiB",
+                           (guint)0, G_MAXUINT, (guint)1024,
+                           G_PARAM_READWRITE);
+
+    // "cpu" runs the joseph model natively on the host with one thread per
+    // core instead of through the OpenCL device
+    properties[PROP_BACKEND] =
+        g_param_spec_string ("backend",
+                             "Projection backend, opencl or cpu",
+                             "Projection backend, opencl or cpu",
+                             "opencl",
+                             G_PARAM_READWRITE);
+
+    // Number of angle ranges projected concurrently, assigned to the
+    // devices of the context in turn starting with the one of the caller
+    properties[PROP_SPLIT] =
+        g_param_spec_uint ("split",
+                           "Number of angle partitions spread over the devices",
+                           "Number of angle partitions spread over the devices",
+                           (guint)1, (guint)MAX_SPLIT, (guint)1,
+                           G_PARAM_READWRITE);
+
+    // Keep the volume in host memory and project it in bands of that many
+    // rows, so that device memory scales with the band instead of the
+    // slice. 0 projects whole slices.
+    properties[PROP_TILE_ROWS] =
+        g_param_spec_uint ("tile_rows",
+                           "Volume rows per tile, 0 disables tiling",
+                           "Volume rows per tile, 0 disables tiling",
+                           (guint)0, G_MAXUINT, (guint)0,
+                           G_PARAM_READWRITE);
+
+    // Projects sinograms holding only every n-th angle of the scan with the
+    // same step, used by previews
+    properties[PROP_ANGLE_STRIDE] =
+        g_param_spec_uint ("angle_stride",
+                           "Angles of the scan between two sinogram rows",
+                           "Angles of the scan between two sinogram rows",
+                           (guint)1, G_MAXUINT, (guint)1,
+                           G_PARAM_READWRITE);
+
     for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
         g_object_class_install_property (oclass, i, properties[i]);
 
@@ -148,6 +298,11 @@ ufo_ir_parallel_projector_task_init(UfoIrParallelProjectorTask *self) {
     self->priv->model_name = g_strdup("joseph");
     self->priv->angles_num = 0;
     self->priv->first_run = TRUE;
+    self->priv->matrix_budget = 1024;
+    self->priv->backend = g_strdup("opencl");
+    self->priv->prefer_buffers = -1;
+    self->priv->split = 1;
+    self->priv->angle_stride = 1;
 }
 
 // -----------------------------------------------------------------------------
@@ -168,8 +323,22 @@ void ufo_ir_parallel_projector_subset_fp(UfoIrParallelProjectorTask *self,
                                              UfoBuffer *volume,
                                              UfoBuffer *sinogram,
                                              UfoIrProjectionsSubset *subset) {
-    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE (self)));
-    cl_command_queue cmd_queue = ufo_gpu_node_get_cmd_queue (node);
+    cl_command_queue cmd_queue = ufo_ir_state_dependent_task_get_cmd_queue (UFO_IR_STATE_DEPENDENT_TASK (self));
+
+    if (USE_CPU_BACKEND(self->priv)) {
+        cpu_project (self, volume, sinogram, subset->offset, subset->n, FALSE, cmd_queue);
+        return;
+    }
+
+    if (USE_TILES(self->priv)) {
+        tiled_project (self, volume, sinogram, subset, 1, FALSE, cmd_queue);
+        return;
+    }
+
+    if (ensure_matrix (self, volume)) {
+        matrix_product (self, volume, sinogram, subset->offset, subset->n, FALSE, cmd_queue);
+        return;
+    }
 
     UfoRequisition req;
     ufo_buffer_get_requisition(sinogram, &req);
@@ -185,8 +354,22 @@ ufo_ir_parallel_projector_subset_bp(UfoIrParallelProjectorTask *self,
                                     UfoIrProjectionsSubset *subset) {
 
 
-    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE (self)));
-    cl_command_queue cmd_queue = ufo_gpu_node_get_cmd_queue (node);
+    cl_command_queue cmd_queue = ufo_ir_state_dependent_task_get_cmd_queue (UFO_IR_STATE_DEPENDENT_TASK (self));
+
+    if (USE_CPU_BACKEND(self->priv)) {
+        cpu_project (self, volume, sinogram, subset->offset, subset->n, TRUE, cmd_queue);
+        return;
+    }
+
+    if (USE_TILES(self->priv)) {
+        tiled_project (self, volume, sinogram, subset, 1, TRUE, cmd_queue);
+        return;
+    }
+
+    if (ensure_matrix (self, volume)) {
+        matrix_product (self, volume, sinogram, subset->offset, subset->n, TRUE, cmd_queue);
+        return;
+    }
 
     UfoRequisition req;
     ufo_buffer_get_requisition(volume, &req);
@@ -223,6 +406,21 @@ ufo_ir_parallel_projector_task_set_property (GObject *object,
         case PROP_ANGLES_NUM:
             ufo_ir_parallel_projector_set_angles_num(self, g_value_get_uint(value));
             break;
+        case PROP_MATRIX_BUDGET:
+            ufo_ir_parallel_projector_set_matrix_budget(self, g_value_get_uint(value));
+            break;
+        case PROP_BACKEND:
+            ufo_ir_parallel_projector_set_backend(self, g_value_get_string(value));
+            break;
+        case PROP_SPLIT:
+            ufo_ir_parallel_projector_set_split(self, g_value_get_uint(value));
+            break;
+        case PROP_TILE_ROWS:
+            ufo_ir_parallel_projector_set_tile_rows(self, g_value_get_uint(value));
+            break;
+        case PROP_ANGLE_STRIDE:
+            ufo_ir_parallel_projector_set_angle_stride(self, g_value_get_uint(value));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -252,6 +450,21 @@ ufo_ir_parallel_projector_task_get_property (GObject *object,
         case PROP_ANGLES_NUM:
             g_value_set_uint(value, ufo_ir_parallel_projector_get_angles_num(self));
             break;
+        case PROP_MATRIX_BUDGET:
+            g_value_set_uint(value, ufo_ir_parallel_projector_get_matrix_budget(self));
+            break;
+        case PROP_BACKEND:
+            g_value_set_string(value, ufo_ir_parallel_projector_get_backend(self));
+            break;
+        case PROP_SPLIT:
+            g_value_set_uint(value, ufo_ir_parallel_projector_get_split(self));
+            break;
+        case PROP_TILE_ROWS:
+            g_value_set_uint(value, ufo_ir_parallel_projector_get_tile_rows(self));
+            break;
+        case PROP_ANGLE_STRIDE:
+            g_value_set_uint(value, ufo_ir_parallel_projector_get_angle_stride(self));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -296,6 +509,72 @@ void ufo_ir_parallel_projector_set_angles_num(UfoIrParallelProjectorTask *self,
     priv->angles_num = angles_num;
 }
 
+guint ufo_ir_parallel_projector_get_matrix_budget(UfoIrParallelProjectorTask *self) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    return priv->matrix_budget;
+}
+
+void ufo_ir_parallel_projector_set_matrix_budget(UfoIrParallelProjectorTask *self, guint matrix_budget) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    priv->matrix_budget = matrix_budget;
+    priv->matrix_failed = FALSE;
+}
+
+const gchar *ufo_ir_parallel_projector_get_backend(UfoIrParallelProjectorTask *self) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    return priv->backend;
+}
+
+void ufo_ir_parallel_projector_set_backend(UfoIrParallelProjectorTask *self, const gchar *backend) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    g_free(priv->backend);
+    priv->backend = g_ascii_strdown(backend, -1);
+}
+
+guint ufo_ir_parallel_projector_get_split(UfoIrParallelProjectorTask *self) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    return priv->split;
+}
+
+void ufo_ir_parallel_projector_set_split(UfoIrParallelProjectorTask *self, guint split) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    release_split (priv, FALSE);
+    priv->split = CLAMP (split, 1, MAX_SPLIT);
+}
+
+guint ufo_ir_parallel_projector_get_tile_rows(UfoIrParallelProjectorTask *self) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    return priv->tile_rows;
+}
+
+void ufo_ir_parallel_projector_set_tile_rows(UfoIrParallelProjectorTask *self, guint tile_rows) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+
+    // After setup only models that loaded the tile kernels can tile
+    if (tile_rows > 0 && priv->context != NULL && priv->bp_tile_kernel == NULL) {
+        g_warning ("The %s model cannot tile projections", priv->model_name);
+        tile_rows = 0;
+    }
+
+    priv->tile_rows = tile_rows;
+}
+
+guint ufo_ir_parallel_projector_get_angle_stride(UfoIrParallelProjectorTask *self) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    return priv->angle_stride;
+}
+
+void ufo_ir_parallel_projector_set_angle_stride(UfoIrParallelProjectorTask *self, guint angle_stride) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    angle_stride = MAX (angle_stride, 1);
+
+    // The angles are recomputed with the next requisition
+    if (priv->angle_stride != angle_stride)
+        priv->first_run = TRUE;
+
+    priv->angle_stride = angle_stride;
+}
+
 // -----------------------------------------------------------------------------
 
 // -----------------------------------------------------------------------------
@@ -316,9 +595,18 @@ ufo_ir_parallel_projector_task_get_requisition (UfoTask *self,
         priv->angles_num = buffer_req.dims[1];
     }
 
-    if (priv->first_run || priv->angles_num != buffer_req.dims[1]) {
+    // Backprojections get sinograms, whose height changes with a preview
+    // or a different scan
+    if (!ufo_ir_state_dependent_task_get_is_forward (UFO_IR_STATE_DEPENDENT_TASK(self)) &&
+        priv->angles_num != buffer_req.dims[1]) {
+        priv->angles_num = buffer_req.dims[1];
+        priv->first_run = TRUE;
+    }
+
+    if (priv->first_run) {
         priv->first_run = FALSE;
-        gfloat angles_step = ufo_ir_projector_task_get_step(UFO_IR_PROJECTOR_TASK(self));
+        release_luts (priv);
+        gfloat angles_step = ufo_ir_projector_task_get_step(UFO_IR_PROJECTOR_TASK(self)) * priv->angle_stride;
         priv->scan_sin_lut = create_lut_buffer (priv->angles_num,
                                                 angles_step,
                                                 &priv->context,
@@ -330,6 +618,11 @@ ufo_ir_parallel_projector_task_get_requisition (UfoTask *self,
                                                 &priv->scan_host_cos_lut, cos);
 
         priv->full_subsets_list = generate_full_subsets_list(priv);
+        release_split (priv, TRUE);
+
+        ufo_ir_sparse_matrix_release (priv->matrix);
+        priv->matrix = NULL;
+        priv->matrix_failed = FALSE;
     }
 
     if (priv->detectors_num != buffer_req.dims[0]) {
@@ -366,25 +659,81 @@ ufo_ir_parallel_projector_task_setup (UfoIrStateDependentTask *self,
     priv->context = ufo_resources_get_context (resources);
     UFO_RESOURCES_CHECK_CLERR (clRetainContext (priv->context));
 
-    // Load kernels
-    gchar *filename = g_strdup_printf ("projector-parallel-%s.cl", priv->model_name);
+    // All devices UFO uses share the context, so partitions on other
+    // devices read and write the same memory objects
+    GList *cmd_queues = ufo_resources_get_cmd_queues (resources);
 
-    priv->bp_kernel = ufo_resources_get_kernel (resources, filename, "BP", NULL, error);
+    g_free (priv->devices);
+    priv->devices = g_new0 (cl_device_id, MAX (g_list_length (cmd_queues), 1));
+    priv->n_devices = 0;
 
-    if (priv->bp_kernel == NULL)
-        return;
+    for (GList *it = cmd_queues; it != NULL; it = g_list_next (it))
+        UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (it->data, CL_QUEUE_DEVICE, sizeof (cl_device_id),
+                                                          &priv->devices[priv->n_devices++], NULL));
 
-    priv->fp_kernel[Horizontal] = ufo_resources_get_kernel (resources, filename, "FP_hor", NULL, error);
+    g_list_free (cmd_queues);
+    priv->op_set_buffer_kernel = ufo_ir_op_set_buffer_generate_kernel (resources);
+    priv->op_add_buffer_kernel = ufo_ir_op_add_buffer_generate_kernel (resources);
 
-    if (priv->fp_kernel[Horizontal] == NULL)
-        return;
+    if (USE_CPU_BACKEND(priv)) {
+        if (g_strcmp0 (priv->model_name, "joseph"))
+            g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_SETUP,
+                         "The cpu backend only implements the joseph model, not `%s'", priv->model_name);
 
-    priv->fp_kernel[Vertical] = ufo_resources_get_kernel (resources, filename, "FP_vert", NULL, error);
+        return;
+    }
 
-    if (priv->fp_kernel[Vertical] == NULL)
+    if (priv->tile_rows > 0 && g_strcmp0 (priv->model_name, IMAGE_MODEL) && g_strcmp0 (priv->model_name, BUFFER_MODEL)) {
+        g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_SETUP,
+                     "Tiled projections need the %s or %s model, not `%s'", IMAGE_MODEL, BUFFER_MODEL, priv->model_name);
         return;
+    }
 
-    g_free (filename);
+    // Load kernels. The joseph-csr model keeps the on-the-fly kernels of
+    // joseph-matched for geometries whose matrix exceeds the budget.
+    const gchar *model = priv->model_name;
+
+    if (!g_strcmp0 (priv->model_name, CSR_MODEL)) {
+        gchar *filename = g_strdup_printf ("projector-parallel-%s.cl", CSR_MODEL);
+        priv->spmv_kernel = ufo_resources_get_kernel (resources, filename, "spmv", NULL, error);
+
+        if (priv->spmv_kernel != NULL)
+            priv->spmv_t_kernel = ufo_resources_get_kernel (resources, filename, "spmv_transposed", NULL, error);
+
+        g_free (filename);
+
+        if (priv->spmv_t_kernel == NULL)
+            return;
+
+        model = CSR_FALLBACK_MODEL;
+    }
+
+    // joseph-buffer always runs the buffer kernels, joseph picks them once
+    // the device is known
+    if (!g_strcmp0 (model, BUFFER_MODEL) || !g_strcmp0 (model, IMAGE_MODEL)) {
+        if (!load_kernels (resources, BUFFER_MODEL, priv->fp_buffer_kernel, &priv->bp_buffer_kernel, error))
+            return;
+
+        // Also without tile_rows, a memory budget may switch tiling on later
+        gchar *filename = g_strdup_printf ("projector-parallel-%s.cl", BUFFER_MODEL);
+        priv->bp_tile_kernel = ufo_resources_get_kernel (resources, filename, "BP_tile", NULL, error);
+
+        if (priv->bp_tile_kernel != NULL)
+            priv->fp_tile_kernel[Horizontal] = ufo_resources_get_kernel (resources, filename, "FP_hor_tile", NULL, error);
+
+        if (priv->fp_tile_kernel[Horizontal] != NULL)
+            priv->fp_tile_kernel[Vertical] = ufo_resources_get_kernel (resources, filename, "FP_vert_tile", NULL, error);
+
+        g_free (filename);
+
+        if (priv->fp_tile_kernel[Vertical] == NULL)
+            return;
+
+        if (!g_strcmp0 (model, BUFFER_MODEL))
+            return;
+    }
+
+    load_kernels (resources, model, priv->fp_kernel, &priv->bp_kernel, error);
 }
 
 gboolean
@@ -394,16 +743,32 @@ ufo_ir_parallel_projector_task_forward(UfoIrStateDependentTask *self,
                                        UfoRequisition *requisition) {
     UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
 
-    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE (self)));
-    cl_command_queue cmd_queue = ufo_gpu_node_get_cmd_queue (node);
+    cl_command_queue cmd_queue = ufo_ir_state_dependent_task_get_cmd_queue (UFO_IR_STATE_DEPENDENT_TASK (self));
 
-    UfoRequisition req;
-    ufo_buffer_get_requisition(output, &req);
+    if (USE_CPU_BACKEND(priv)) {
+        cpu_project (UFO_IR_PARALLEL_PROJECTOR_TASK(self), inputs[0], output, 0, priv->angles_num, FALSE, cmd_queue);
+        return TRUE;
+    }
+
+    if (USE_TILES(priv)) {
+        tiled_project (UFO_IR_PARALLEL_PROJECTOR_TASK(self), inputs[0], output,
+                       priv->full_subsets_list, priv->full_subsets_cnt, FALSE, cmd_queue);
+        return TRUE;
+    }
 
-    for (guint i = 0 ; i < priv->full_subsets_cnt; ++i) {
-        ufo_ir_parallel_projector_subset_fp_real(UFO_IR_PARALLEL_PROJECTOR_TASK(self), inputs[0], output, &priv->full_subsets_list[i], &req, cmd_queue);
+    if (ensure_matrix (UFO_IR_PARALLEL_PROJECTOR_TASK(self), inputs[0])) {
+        matrix_product (UFO_IR_PARALLEL_PROJECTOR_TASK(self), inputs[0], output, 0, priv->angles_num, FALSE, cmd_queue);
+        return TRUE;
     }
 
+    if (ensure_split (UFO_IR_PARALLEL_PROJECTOR_TASK(self), cmd_queue)) {
+        split_project (UFO_IR_PARALLEL_PROJECTOR_TASK(self), inputs[0], output, FALSE, cmd_queue);
+        return TRUE;
+    }
+
+    project_subsets (UFO_IR_PARALLEL_PROJECTOR_TASK(self), inputs[0], output,
+                     priv->full_subsets_list, priv->full_subsets_cnt, FALSE, cmd_queue);
+
     return TRUE;
 }
 
@@ -414,17 +779,32 @@ ufo_ir_parallel_projector_task_backward(UfoIrStateDependentTask *self,
                                         UfoRequisition *requisition) {
     UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
 
-    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE (self)));
-    cl_command_queue cmd_queue = ufo_gpu_node_get_cmd_queue (node);
+    cl_command_queue cmd_queue = ufo_ir_state_dependent_task_get_cmd_queue (UFO_IR_STATE_DEPENDENT_TASK (self));
 
+    if (USE_CPU_BACKEND(priv)) {
+        cpu_project (UFO_IR_PARALLEL_PROJECTOR_TASK(self), output, inputs[0], 0, priv->angles_num, TRUE, cmd_queue);
+        return TRUE;
+    }
 
-    UfoRequisition req;
-    ufo_buffer_get_requisition(output, &req);
+    if (USE_TILES(priv)) {
+        tiled_project (UFO_IR_PARALLEL_PROJECTOR_TASK(self), output, inputs[0],
+                       priv->full_subsets_list, priv->full_subsets_cnt, TRUE, cmd_queue);
+        return TRUE;
+    }
+
+    if (ensure_matrix (UFO_IR_PARALLEL_PROJECTOR_TASK(self), output)) {
+        matrix_product (UFO_IR_PARALLEL_PROJECTOR_TASK(self), output, inputs[0], 0, priv->angles_num, TRUE, cmd_queue);
+        return TRUE;
+    }
 
-    for (guint i = 0 ; i < priv->full_subsets_cnt; ++i) {
-        ufo_ir_parallel_projector_subset_bp_real(UFO_IR_PARALLEL_PROJECTOR_TASK(self), output, inputs[0], &priv->full_subsets_list[i], &req, cmd_queue);
+    if (ensure_split (UFO_IR_PARALLEL_PROJECTOR_TASK(self), cmd_queue)) {
+        split_project (UFO_IR_PARALLEL_PROJECTOR_TASK(self), output, inputs[0], TRUE, cmd_queue);
+        return TRUE;
     }
 
+    project_subsets (UFO_IR_PARALLEL_PROJECTOR_TASK(self), output, inputs[0],
+                     priv->full_subsets_list, priv->full_subsets_cnt, TRUE, cmd_queue);
+
     return TRUE;
 }
 
@@ -505,9 +885,19 @@ ufo_ir_parallel_projector_subset_bp_real(UfoIrParallelProjectorTask *self,
                                          UfoRequisition *requisitions,
                                          cl_command_queue cmd_queue) {
     UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
-    cl_kernel kernel = priv->bp_kernel;
-    cl_mem d_volume = ufo_buffer_get_device_image (volume, cmd_queue);
-    cl_mem d_sino = ufo_buffer_get_device_image (sinogram, cmd_queue);
+    cl_kernel kernel;
+    cl_mem d_volume, d_sino;
+
+    if (use_buffer_kernels (priv, volume, sinogram, cmd_queue)) {
+        kernel = priv->bp_buffer_kernel;
+        d_volume = ufo_ir_profiler_get_device_array (volume, cmd_queue);
+        d_sino = ufo_ir_profiler_get_device_array (sinogram, cmd_queue);
+    }
+    else {
+        kernel = priv->bp_kernel;
+        d_volume = ufo_ir_profiler_get_device_image (volume, cmd_queue);
+        d_sino = ufo_ir_profiler_get_device_image (sinogram, cmd_queue);
+    }
 
     UfoRequisition sino_req;
     ufo_buffer_get_requisition(sinogram, &sino_req);
@@ -546,16 +936,13 @@ ufo_ir_parallel_projector_subset_bp_real(UfoIrParallelProjectorTask *self,
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 7, sizeof (gfloat), &axis_position));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 8, sizeof (UfoIrProjectionsSubset), subset));
 
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel(
-                                   cmd_queue,           // cl_command_queue command_queue
-                                   kernel,              // cl_kernel kernel
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (
+                                   cmd_queue,            // cl_command_queue command_queue
+                                   kernel,               // cl_kernel kernel
                                    requisitions->n_dims, // cl_uint work_dim
-                                   NULL,                // const size_t *global_work_offset
                                    requisitions->dims,   // const size_t *global_work_size
-                                   NULL,                // const size_t *local_work_size
-                                   0,                   // cl_uint num_events_in_wait_list
-                                   NULL,                // const cl_event *event_wait_list
-                                   NULL));            // cl_event *event
+                                   NULL,                 // const size_t *local_work_size
+                                   NULL));               // cl_event *event
 
 }
 
@@ -567,10 +954,19 @@ ufo_ir_parallel_projector_subset_fp_real(UfoIrParallelProjectorTask *self,
                                          UfoRequisition *requisitions,
                                          cl_command_queue cmd_queue) {
     UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
-    cl_kernel kernel = priv->fp_kernel[subset->direction];
+    cl_kernel kernel;
+    cl_mem d_volume, d_sinogram;
 
-    cl_mem d_volume = ufo_buffer_get_device_image (volume, cmd_queue);
-    cl_mem d_sinogram = ufo_buffer_get_device_image (sinogram, cmd_queue);
+    if (use_buffer_kernels (priv, volume, sinogram, cmd_queue)) {
+        kernel = priv->fp_buffer_kernel[subset->direction];
+        d_volume = ufo_ir_profiler_get_device_array (volume, cmd_queue);
+        d_sinogram = ufo_ir_profiler_get_device_array (sinogram, cmd_queue);
+    }
+    else {
+        kernel = priv->fp_kernel[subset->direction];
+        d_volume = ufo_ir_profiler_get_device_image (volume, cmd_queue);
+        d_sinogram = ufo_ir_profiler_get_device_image (sinogram, cmd_queue);
+    }
 
     UfoIrGeometryDims dims;
     dims.width = requisitions->dims[0];
@@ -611,16 +1007,588 @@ ufo_ir_parallel_projector_subset_fp_real(UfoIrParallelProjectorTask *self,
 //    ufo_buffer_get_requisition (measurements, &requisitions);
     requisitions->dims[1] = subset->n;
 
-    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel(
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (
                                    cmd_queue,
                                    kernel,
                                    requisitions->n_dims,
-                                   NULL,
                                    requisitions->dims,
                                    NULL,
-                                   0,
-                                   NULL,
                                    NULL));
 
 }
+static gboolean
+load_kernels (UfoResources *resources,
+              const gchar *model,
+              gpointer *fp_kernel,
+              gpointer *bp_kernel,
+              GError **error) {
+    gchar *filename = g_strdup_printf ("projector-parallel-%s.cl", model);
+
+    *bp_kernel = ufo_resources_get_kernel (resources, filename, "BP", NULL, error);
+
+    if (*bp_kernel != NULL)
+        fp_kernel[Horizontal] = ufo_resources_get_kernel (resources, filename, "FP_hor", NULL, error);
+
+    if (fp_kernel[Horizontal] != NULL)
+        fp_kernel[Vertical] = ufo_resources_get_kernel (resources, filename, "FP_vert", NULL, error);
+
+    g_free (filename);
+    return fp_kernel[Vertical] != NULL;
+}
+
+// With both kernel sets the buffer kernels run on devices without fast
+// images and whenever the data already is a device array, so callers that
+// keep their buffers as arrays never pay for a conversion.
+static gboolean
+use_buffer_kernels (UfoIrParallelProjectorTaskPrivate *priv,
+                    UfoBuffer *volume,
+                    UfoBuffer *sinogram,
+                    cl_command_queue cmd_queue) {
+    UfoBufferLocation volume_location, sinogram_location;
+
+    if (priv->bp_buffer_kernel == NULL)
+        return FALSE;
+
+    if (priv->bp_kernel == NULL)
+        return TRUE;
+
+    if (priv->prefer_buffers < 0)
+        priv->prefer_buffers = ufo_ir_device_prefers_buffers (cmd_queue);
+
+    if (priv->prefer_buffers)
+        return TRUE;
+
+    volume_location = ufo_buffer_get_location (volume);
+    sinogram_location = ufo_buffer_get_location (sinogram);
+
+    if (volume_location == UFO_BUFFER_LOCATION_DEVICE_IMAGE ||
+        sinogram_location == UFO_BUFFER_LOCATION_DEVICE_IMAGE)
+        return FALSE;
+
+    return volume_location == UFO_BUFFER_LOCATION_DEVICE ||
+           sinogram_location == UFO_BUFFER_LOCATION_DEVICE;
+}
+
+static gboolean
+ensure_matrix (UfoIrParallelProjectorTask *self, UfoBuffer *volume) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    UfoRequisition req;
+
+    if (priv->spmv_kernel == NULL || priv->matrix_failed)
+        return FALSE;
+
+    // Like the kernels, the matrix assumes a square slice as wide as the detector
+    ufo_buffer_get_requisition(volume, &req);
+
+    if (req.dims[0] != priv->detectors_num || req.dims[1] != priv->detectors_num)
+        return FALSE;
+
+    if (priv->matrix == NULL) {
+        float axis_position = ufo_ir_projector_task_get_axis_position(UFO_IR_PROJECTOR_TASK(self));
+
+        if (axis_position < 0)
+            axis_position = priv->detectors_num / 2.0;
+
+        priv->matrix = ufo_ir_sparse_matrix_acquire_parallel (priv->context,
+                                                              priv->detectors_num,
+                                                              priv->angles_num,
+                                                              priv->scan_host_sin_lut,
+                                                              priv->scan_host_cos_lut,
+                                                              axis_position,
+                                                              (gsize) priv->matrix_budget << 20);
+
+        if (priv->matrix == NULL) {
+            g_warning ("System matrix for %u detectors and %u angles does not fit into %u MiB, "
+                       "using the %s kernels", priv->detectors_num, priv->angles_num,
+                       priv->matrix_budget, CSR_FALLBACK_MODEL);
+            priv->matrix_failed = TRUE;
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static void
+matrix_product (UfoIrParallelProjectorTask *self,
+                UfoBuffer *volume,
+                UfoBuffer *sinogram,
+                guint offset,
+                guint n,
+                gboolean transposed,
+                cl_command_queue cmd_queue) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    UfoIrProjectorTask *projection_task = UFO_IR_PROJECTOR_TASK(self);
+    UfoIrSparseMatrix *matrix = priv->matrix;
+    cl_mem d_volume = ufo_ir_profiler_get_device_array (volume, cmd_queue);
+    cl_mem d_sinogram = ufo_ir_profiler_get_device_array (sinogram, cmd_queue);
+    cl_uint first_ray = offset * matrix->n_dets;
+    cl_uint last_ray = (offset + n) * matrix->n_dets;
+    cl_kernel kernel;
+    gsize global_size;
+
+    if (!transposed) {
+        // sinogram rows of the subset += correction_scale * A volume
+        gfloat scale = ufo_ir_projector_task_get_correction_scale(projection_task);
+        kernel = priv->spmv_kernel;
+        global_size = last_ray - first_ray;
+
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &matrix->row_ptr));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &matrix->col_idx));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &matrix->values));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof (cl_mem), &d_volume));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof (cl_mem), &d_sinogram));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 5, sizeof (cl_uint), &first_ray));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 6, sizeof (gfloat), &scale));
+    }
+    else {
+        // volume += relaxation * A^T restricted to the rays of the subset
+        gfloat scale = ufo_ir_projector_task_get_relaxation(projection_task);
+        kernel = priv->spmv_t_kernel;
+        global_size = matrix->n_cols;
+
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &matrix->t_row_ptr));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &matrix->t_col_idx));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &matrix->t_values));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof (cl_mem), &d_sinogram));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof (cl_mem), &d_volume));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 5, sizeof (cl_uint), &first_ray));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 6, sizeof (cl_uint), &last_ray));
+        UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 7, sizeof (gfloat), &scale));
+    }
+
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, kernel, 1, &global_size, NULL, NULL));
+}
+static void
+cpu_project (UfoIrParallelProjectorTask *self,
+             UfoBuffer *volume,
+             UfoBuffer *sinogram,
+             guint offset,
+             guint n,
+             gboolean backward,
+             cl_command_queue cmd_queue) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    UfoIrProjectorTask *projection_task = UFO_IR_PROJECTOR_TASK(self);
+    UfoRequisition volume_req, sino_req;
+
+    ufo_buffer_get_requisition(volume, &volume_req);
+    ufo_buffer_get_requisition(sinogram, &sino_req);
+
+    float axis_position = ufo_ir_projector_task_get_axis_position(projection_task);
+
+    if (axis_position < 0)
+        axis_position = sino_req.dims[0] / 2.0;
+
+    UfoIrCpuGeometry geometry = {
+        .width = volume_req.dims[0],
+        .height = volume_req.dims[1],
+        .n_dets = sino_req.dims[0],
+        .sin_vals = priv->scan_host_sin_lut,
+        .cos_vals = priv->scan_host_cos_lut,
+        .axis_pos = axis_position
+    };
+
+    // Fetching the host arrays downloads them if needed and marks the host
+    // copy as the valid one, later device reads upload the result
+    gfloat *h_volume = ufo_ir_profiler_get_host_array (volume, cmd_queue);
+    gfloat *h_sinogram = ufo_ir_profiler_get_host_array (sinogram, cmd_queue);
+
+    if (backward)
+        ufo_ir_cpu_projector_backward (&geometry, h_volume, h_sinogram, offset, n,
+                                       ufo_ir_projector_task_get_relaxation(projection_task));
+    else
+        ufo_ir_cpu_projector_forward (&geometry, h_volume, h_sinogram, offset, n,
+                                      ufo_ir_projector_task_get_correction_scale(projection_task));
+}
+
+static void
+project_subsets (UfoIrParallelProjectorTask *self,
+                 UfoBuffer *volume,
+                 UfoBuffer *sinogram,
+                 UfoIrProjectionsSubset *subsets,
+                 guint n_subsets,
+                 gboolean backward,
+                 cl_command_queue cmd_queue) {
+    UfoRequisition req;
+
+    if (backward) {
+        ufo_buffer_get_requisition(volume, &req);
+
+        for (guint i = 0 ; i < n_subsets; ++i)
+            ufo_ir_parallel_projector_subset_bp_real(self, volume, sinogram, &subsets[i], &req, cmd_queue);
+
+        return;
+    }
+
+    ufo_buffer_get_requisition(sinogram, &req);
+
+    // The subsets write disjoint sinogram rows and may run concurrently
+    ufo_ir_exec_fork (cmd_queue);
+
+    for (guint i = 0 ; i < n_subsets; ++i) {
+        ufo_ir_exec_branch (cmd_queue);
+        ufo_ir_parallel_projector_subset_fp_real(self, volume, sinogram, &subsets[i], &req, cmd_queue);
+    }
+
+    ufo_ir_exec_join (cmd_queue);
+}
+
+static void
+release_split (UfoIrParallelProjectorTaskPrivate *priv, gboolean subsets_only) {
+    for (guint p = 0; p < MAX_SPLIT; p++) {
+        g_free (priv->split_subsets[p]);
+        priv->split_subsets[p] = NULL;
+        priv->split_subsets_cnt[p] = 0;
+    }
+
+    if (subsets_only)
+        return;
+
+    if (priv->split_free != NULL) {
+        clWaitForEvents (1, &priv->split_free);
+        clReleaseEvent (priv->split_free);
+        priv->split_free = NULL;
+    }
+
+    for (guint p = 1; p < MAX_SPLIT; p++) {
+        if (priv->split_queues[p] != NULL) {
+            clFinish (priv->split_queues[p]);
+            clReleaseCommandQueue (priv->split_queues[p]);
+            priv->split_queues[p] = NULL;
+        }
+
+        if (priv->split_volumes[p] != NULL) {
+            g_object_unref (priv->split_volumes[p]);
+            priv->split_volumes[p] = NULL;
+        }
+
+        if (priv->split_sinograms[p] != NULL) {
+            g_object_unref (priv->split_sinograms[p]);
+            priv->split_sinograms[p] = NULL;
+        }
+    }
+
+    priv->split_device = NULL;
+}
+
+// Cuts the direction subsets at the borders of split equal angle ranges
+static void
+generate_split_subsets (UfoIrParallelProjectorTaskPrivate *priv) {
+    for (guint p = 0; p < priv->split; p++) {
+        guint first = p * priv->angles_num / priv->split;
+        guint last = (p + 1) * priv->angles_num / priv->split;
+
+        priv->split_subsets[p] = g_new (UfoIrProjectionsSubset, priv->full_subsets_cnt);
+        priv->split_subsets_cnt[p] = 0;
+
+        for (guint i = 0; i < priv->full_subsets_cnt; i++) {
+            UfoIrProjectionsSubset *subset = &priv->full_subsets_list[i];
+            guint start = MAX (subset->offset, first);
+            guint end = MIN (subset->offset + subset->n, last);
+
+            if (start < end) {
+                UfoIrProjectionsSubset *part = &priv->split_subsets[p][priv->split_subsets_cnt[p]++];
+                part->offset = start;
+                part->n = end - start;
+                part->direction = subset->direction;
+            }
+        }
+    }
+}
+
+// Splitting needs the buffer kernels, the partial results are cleared and
+// added with the array versions of the basic ops so they stay arrays
+static gboolean
+ensure_split (UfoIrParallelProjectorTask *self, cl_command_queue cmd_queue) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    cl_device_id device;
+    cl_int error;
+    guint first = 0;
+
+    if (priv->split <= 1)
+        return FALSE;
+
+    if (priv->bp_buffer_kernel == NULL) {
+        g_warning ("The %s model cannot be split, projecting on one device", priv->model_name);
+        priv->split = 1;
+        return FALSE;
+    }
+
+    UFO_RESOURCES_CHECK_CLERR (clGetCommandQueueInfo (cmd_queue, CL_QUEUE_DEVICE,
+                                                      sizeof (device), &device, NULL));
+
+    if (priv->split_device != device) {
+        release_split (priv, FALSE);
+
+        for (guint i = 0; i < priv->n_devices; i++) {
+            if (priv->devices[i] == device)
+                first = i;
+        }
+
+        // With fewer devices than partitions some get several queues
+        for (guint p = 1; p < priv->split; p++) {
+            cl_device_id target = priv->n_devices > 0 ? priv->devices[(first + p) % priv->n_devices] : device;
+
+            priv->split_queues[p] = clCreateCommandQueue (priv->context, target, 0, &error);
+
+            if (error != CL_SUCCESS) {
+                g_warning ("Could not create a command queue for partition %u, projecting on one device", p);
+                release_split (priv, FALSE);
+                priv->split = 1;
+                return FALSE;
+            }
+        }
+
+        priv->split_device = device;
+    }
+
+    if (priv->split_subsets[0] == NULL)
+        generate_split_subsets (priv);
+
+    return TRUE;
+}
+
+// Zeroed buffer like model on the device of cmd_queue
+static UfoBuffer *
+split_partial (UfoIrParallelProjectorTaskPrivate *priv,
+               UfoBuffer **partial,
+               UfoBuffer *model,
+               cl_command_queue cmd_queue) {
+    UfoRequisition req;
+
+    ufo_buffer_get_requisition (model, &req);
+
+    if (*partial != NULL && ufo_buffer_cmp_dimensions (*partial, &req)) {
+        g_object_unref (*partial);
+        *partial = NULL;
+    }
+
+    if (*partial == NULL)
+        *partial = ufo_buffer_dup (model);
+
+    ufo_ir_profiler_get_device_array (*partial, cmd_queue);
+    ufo_ir_op_set_buffer (*partial, 0.0f, cmd_queue, priv->op_set_buffer_kernel);
+
+    return *partial;
+}
+
+// Every partition projects its angle range, the ones on other queues into
+// partial results the caller's queue then adds up. Forward projections
+// write disjoint rows, but devices must not write the same buffer at once.
+static void
+split_project (UfoIrParallelProjectorTask *self,
+               UfoBuffer *volume,
+               UfoBuffer *sinogram,
+               gboolean backward,
+               cl_command_queue cmd_queue) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    UfoBuffer *target = backward ? volume : sinogram;
+    UfoBuffer **partials = backward ? priv->split_volumes : priv->split_sinograms;
+    cl_event done[MAX_SPLIT];
+    cl_event ready;
+
+    ufo_ir_profiler_get_device_array (volume, cmd_queue);
+    ufo_ir_profiler_get_device_array (sinogram, cmd_queue);
+
+    // The previous sum still reads the partial results
+    if (priv->split_free != NULL) {
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (cmd_queue, 1, &priv->split_free, NULL));
+        clReleaseEvent (priv->split_free);
+        priv->split_free = NULL;
+    }
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (cmd_queue, 0, NULL, &ready));
+    UFO_RESOURCES_CHECK_CLERR (clFlush (cmd_queue));
+
+    for (guint p = 1; p < priv->split; p++) {
+        cl_command_queue queue = priv->split_queues[p];
+        UfoBuffer *partial;
+
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (queue, 1, &ready, NULL));
+        partial = split_partial (priv, &partials[p], target, queue);
+
+        if (backward)
+            project_subsets (self, partial, sinogram, priv->split_subsets[p], priv->split_subsets_cnt[p], TRUE, queue);
+        else
+            project_subsets (self, volume, partial, priv->split_subsets[p], priv->split_subsets_cnt[p], FALSE, queue);
+
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (queue, 0, NULL, &done[p - 1]));
+        UFO_RESOURCES_CHECK_CLERR (clFlush (queue));
+    }
+
+    project_subsets (self, volume, sinogram, priv->split_subsets[0], priv->split_subsets_cnt[0], backward, cmd_queue);
+
+    // Reduction
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (cmd_queue, priv->split - 1, done, NULL));
+
+    for (guint p = 1; p < priv->split; p++) {
+        ufo_ir_op_add_buffer (partials[p], target, target, cmd_queue, priv->op_add_buffer_kernel);
+        clReleaseEvent (done[p - 1]);
+    }
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (cmd_queue, 0, NULL, &priv->split_free));
+    clReleaseEvent (ready);
+
+    // Downloads happen on the caller's queue again
+    ufo_ir_profiler_get_device_array (volume, cmd_queue);
+    ufo_ir_profiler_get_device_array (sinogram, cmd_queue);
+}
+// Device buffer of at least size bytes, kept between calls
+static cl_mem
+ensure_tile_memory (cl_context context, cl_mem *mem, gsize *current, gsize size) {
+    cl_int error;
+
+    if (*mem != NULL && *current >= size)
+        return *mem;
+
+    if (*mem != NULL)
+        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (*mem));
+
+    *mem = clCreateBuffer (context, CL_MEM_READ_WRITE, size, NULL, &error);
+    UFO_RESOURCES_CHECK_CLERR (error);
+    *current = size;
+
+    return *mem;
+}
+
+// Host array of a buffer the device may still use, the queue waits for a
+// previous projection instead of the host
+static gfloat *
+tile_host_array (UfoBuffer *buffer, cl_command_queue cmd_queue)
+{
+    cl_event hold = ufo_ir_profiler_get_host_hold (buffer);
+
+    if (hold == NULL || ufo_buffer_get_location (buffer) != UFO_BUFFER_LOCATION_HOST)
+        return ufo_ir_profiler_get_host_array (buffer, cmd_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (cmd_queue, 1, &hold, NULL));
+    return ufo_buffer_get_host_array (buffer, cmd_queue);
+}
+
+// Streams the host volume through the device one band of rows at a time.
+// Forward projections accumulate the bands into the sinogram, which stays
+// on the device, backprojections update every band and download it again.
+// Nothing waits here, the host arrays are held until the last transfer and
+// the next host access waits for it.
+static void
+tiled_project (UfoIrParallelProjectorTask *self,
+               UfoBuffer *volume,
+               UfoBuffer *sinogram,
+               UfoIrProjectionsSubset *subsets,
+               guint n_subsets,
+               gboolean backward,
+               cl_command_queue cmd_queue) {
+    UfoIrParallelProjectorTaskPrivate *priv = UFO_IR_PARALLEL_PROJECTOR_TASK_GET_PRIVATE(self);
+    UfoIrProjectorTask *projection_task = UFO_IR_PROJECTOR_TASK(self);
+    UfoRequisition volume_req, sino_req;
+    gboolean host_sinogram = ufo_buffer_get_location (sinogram) == UFO_BUFFER_LOCATION_HOST;
+    gsize sino_size = ufo_buffer_get_size (sinogram);
+    gfloat *h_volume, *h_sinogram = NULL;
+    cl_mem d_tile, d_sinogram;
+
+    ufo_buffer_get_requisition(volume, &volume_req);
+    ufo_buffer_get_requisition(sinogram, &sino_req);
+
+    UfoIrGeometryDims dims;
+    dims.width = volume_req.dims[0];
+    dims.height = volume_req.dims[1];
+    dims.n_dets = sino_req.dims[0];
+    dims.n_angles = sino_req.dims[1];
+
+    float relaxation = ufo_ir_projector_task_get_relaxation(projection_task);
+    float correction_scale = ufo_ir_projector_task_get_correction_scale(projection_task);
+    float axis_position = ufo_ir_projector_task_get_axis_position(projection_task);
+
+    if (axis_position < 0)
+        axis_position = sino_req.dims[0] / 2.0;
+
+    // The tiles may still be in use on another queue
+    if (priv->tile_done != NULL) {
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueBarrierWithWaitList (cmd_queue, 1, &priv->tile_done, NULL));
+        clReleaseEvent (priv->tile_done);
+        priv->tile_done = NULL;
+    }
+
+    h_volume = tile_host_array (volume, cmd_queue);
+    d_tile = ensure_tile_memory (priv->context, &priv->tile, &priv->tile_size,
+                                 (gsize) priv->tile_rows * dims.width * sizeof (gfloat));
+
+    // Host sinograms stay where they are, the methods keep all their
+    // buffers in host memory in this mode
+    if (host_sinogram) {
+        h_sinogram = tile_host_array (sinogram, cmd_queue);
+        d_sinogram = ensure_tile_memory (priv->context, &priv->tile_sinogram, &priv->tile_sinogram_size, sino_size);
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueWriteBuffer (cmd_queue, d_sinogram, CL_FALSE, 0, sino_size,
+                                                         h_sinogram, 0, NULL, NULL));
+    }
+    else {
+        d_sinogram = ufo_ir_profiler_get_device_array (sinogram, cmd_queue);
+    }
+
+    for (guint first = 0; first < dims.height; first += priv->tile_rows) {
+        cl_int first_row = (cl_int) first;
+        cl_int n_rows = (cl_int) MIN (priv->tile_rows, dims.height - first);
+        gsize size = (gsize) n_rows * dims.width * sizeof (gfloat);
+        gfloat *rows = h_volume + (gsize) first * dims.width;
+
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueWriteBuffer (cmd_queue, d_tile, CL_FALSE, 0, size, rows, 0, NULL, NULL));
+
+        for (guint i = 0; i < n_subsets; i++) {
+            UfoIrProjectionsSubset *subset = &subsets[i];
+            cl_kernel kernel;
+            gsize global[2];
+
+            if (backward) {
+                kernel = priv->bp_tile_kernel;
+                global[0] = dims.width;
+                global[1] = n_rows;
+
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &d_tile));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &d_tile));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &d_sinogram));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof (gfloat), &relaxation));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof (cl_mem), &priv->scan_sin_lut));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 5, sizeof (cl_mem), &priv->scan_cos_lut));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 6, sizeof (UfoIrGeometryDims), &dims));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 7, sizeof (gfloat), &axis_position));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 8, sizeof (UfoIrProjectionsSubset), subset));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 9, sizeof (cl_int), &first_row));
+            }
+            else {
+                kernel = priv->fp_tile_kernel[subset->direction];
+                global[0] = dims.n_dets;
+                global[1] = subset->n;
+
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &d_tile));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &d_sinogram));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &d_sinogram));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof (cl_mem), &priv->scan_sin_lut));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof (cl_mem), &priv->scan_cos_lut));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 5, sizeof (UfoIrGeometryDims), &dims));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 6, sizeof (gfloat), &axis_position));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 7, sizeof (UfoIrProjectionsSubset), subset));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 8, sizeof (gfloat), &correction_scale));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 9, sizeof (cl_int), &first_row));
+                UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 10, sizeof (cl_int), &n_rows));
+            }
+
+            UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, kernel, 2, global, NULL, NULL));
+        }
+
+        if (backward)
+            UFO_RESOURCES_CHECK_CLERR (clEnqueueReadBuffer (cmd_queue, d_tile, CL_FALSE, 0, size, rows, 0, NULL, NULL));
+    }
+
+    if (host_sinogram && !backward)
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueReadBuffer (cmd_queue, d_sinogram, CL_FALSE, 0, sino_size,
+                                                        h_sinogram, 0, NULL, NULL));
+
+    // The host arrays are read and written until here
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueMarkerWithWaitList (cmd_queue, 0, NULL, &priv->tile_done));
+    UFO_RESOURCES_CHECK_CLERR (clFlush (cmd_queue));
+    ufo_ir_profiler_hold_host (volume, priv->tile_done);
+
+    if (host_sinogram)
+        ufo_ir_profiler_hold_host (sinogram, priv->tile_done);
+}
 // -----------------------------------------------------------------------------
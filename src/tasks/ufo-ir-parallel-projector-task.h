@@ -90,6 +90,21 @@ void         ufo_ir_parallel_projector_set_model(UfoIrParallelProjectorTask *sel
 guint ufo_ir_parallel_projector_get_angles_num(UfoIrParallelProjectorTask *self);
 void  ufo_ir_parallel_projector_set_angles_num(UfoIrParallelProjectorTask *self, guint angles_num);
 
+guint ufo_ir_parallel_projector_get_matrix_budget(UfoIrParallelProjectorTask *self);
+void  ufo_ir_parallel_projector_set_matrix_budget(UfoIrParallelProjectorTask *self, guint matrix_budget);
+
+const gchar *ufo_ir_parallel_projector_get_backend(UfoIrParallelProjectorTask *self);
+void         ufo_ir_parallel_projector_set_backend(UfoIrParallelProjectorTask *self, const gchar *backend);
+
+guint ufo_ir_parallel_projector_get_split(UfoIrParallelProjectorTask *self);
+void  ufo_ir_parallel_projector_set_split(UfoIrParallelProjectorTask *self, guint split);
+
+guint ufo_ir_parallel_projector_get_tile_rows(UfoIrParallelProjectorTask *self);
+void  ufo_ir_parallel_projector_set_tile_rows(UfoIrParallelProjectorTask *self, guint tile_rows);
+
+guint ufo_ir_parallel_projector_get_angle_stride(UfoIrParallelProjectorTask *self);
+void  ufo_ir_parallel_projector_set_angle_stride(UfoIrParallelProjectorTask *self, guint angle_stride);
+
 void ufo_ir_parallel_projector_subset_fp(UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, UfoIrProjectionsSubset *subset);
 void ufo_ir_parallel_projector_subset_bp(UfoIrParallelProjectorTask *self, UfoBuffer *volume, UfoBuffer *sinogram, UfoIrProjectionsSubset *subset);
 
@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <math.h>
+
+#include "ufo-ir-pdhg-task.h"
+#include "core/ufo-ir-basic-ops-processor.h"
+#include "core/ufo-ir-gradient-processor.h"
+#include "core/ufo-ir-profiler.h"
+
+// Power iterations used to estimate ||A||
+#define NORM_ITERATIONS 20
+// ||D||^2 of the periodic forward differences of the gradient processor
+#define GRADIENT_NORM_SQUARED 8.0f
+
+static void ufo_ir_pdhg_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
+static void ufo_ir_pdhg_task_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
+static void ufo_ir_pdhg_task_dispose (GObject *object);
+static void ufo_task_interface_init (UfoTaskIface *iface);
+static void ufo_ir_pdhg_task_setup (UfoTask *task, UfoResources *resources, GError **error);
+static gboolean ufo_ir_pdhg_task_process (UfoTask *task, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+
+static void dual_data (UfoIrPdhgTaskPrivate *priv, UfoBuffer *q, UfoBuffer *ax, UfoBuffer *b, gfloat sigma, UfoBuffer *q_out, cl_command_queue cmd_queue);
+static void dual_tv (UfoIrPdhgTaskPrivate *priv, UfoBuffer *px, UfoBuffer *py, UfoBuffer *gx, UfoBuffer *gy, gfloat sigma, cl_command_queue cmd_queue);
+static void primal (UfoIrPdhgTaskPrivate *priv, UfoBuffer *x, UfoBuffer *g, gfloat tau, UfoBuffer *x_out, UfoBuffer *x_bar, cl_command_queue cmd_queue);
+
+struct _UfoIrPdhgTaskPrivate {
+    // Method parameters
+    gfloat lambda;
+    gboolean positive_constraint;
+
+    UfoIrBasicOpsProcessor *bo_processor;
+    UfoIrGradientProcessor *gradient_processor;
+    cl_kernel dual_data_kernel;
+    cl_kernel dual_tv_kernel;
+    cl_kernel primal_kernel;
+
+    // ||A|| for the last seen geometry
+    gfloat norm;
+    gsize norm_dims[2];
+};
+
+G_DEFINE_TYPE_WITH_CODE (UfoIrPdhgTask, ufo_ir_pdhg_task, UFO_IR_TYPE_METHOD_TASK,
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK,
+                                                ufo_task_interface_init))
+
+#define UFO_IR_PDHG_TASK_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_IR_TYPE_PDHG_TASK, UfoIrPdhgTaskPrivate))
+
+enum {
+    PROP_0 = 100,
+    PROP_LAMBDA,
+    PROP_POSITIVE_CONSTRAINT,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = { NULL, };
+
+static void
+ufo_task_interface_init (UfoTaskIface *iface)
+{
+    iface->process = ufo_ir_pdhg_task_process;
+    iface->setup = ufo_ir_pdhg_task_setup;
+}
+
+static void
+ufo_ir_pdhg_task_class_init (UfoIrPdhgTaskClass *klass)
+{
+    GObjectClass *oclass = G_OBJECT_CLASS (klass);
+
+    oclass->set_property = ufo_ir_pdhg_task_set_property;
+    oclass->get_property = ufo_ir_pdhg_task_get_property;
+    oclass->dispose = ufo_ir_pdhg_task_dispose;
+
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_volumes = 8;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_sinograms = 4;
+
+    properties[PROP_LAMBDA] =
+            g_param_spec_float("lambda",
+                               "Lambda",
+                               "Weight of the TV regularization",
+                               0.0f, G_MAXFLOAT, 0.1f,
+                               G_PARAM_READWRITE);
+
+    properties[PROP_POSITIVE_CONSTRAINT] =
+            g_param_spec_boolean("positive_constraint",
+                                 "Impose positive constraint",
+                                 "Impose positive constraint",
+                                 TRUE,
+                                 G_PARAM_READWRITE);
+
+    for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
+        g_object_class_install_property (oclass, i, properties[i]);
+
+    g_type_class_add_private (oclass, sizeof(UfoIrPdhgTaskPrivate));
+}
+
+static void
+ufo_ir_pdhg_task_init(UfoIrPdhgTask *self)
+{
+    UfoIrPdhgTaskPrivate *priv;
+    self->priv = priv = UFO_IR_PDHG_TASK_GET_PRIVATE(self);
+    priv->lambda = 0.1f;
+    priv->positive_constraint = TRUE;
+    priv->bo_processor = NULL;
+    priv->gradient_processor = NULL;
+    priv->norm = 0.0f;
+}
+
+static void
+ufo_ir_pdhg_task_set_property (GObject *object,
+                               guint property_id,
+                               const GValue *value,
+                               GParamSpec *pspec)
+{
+    UfoIrPdhgTask *self = UFO_IR_PDHG_TASK (object);
+
+    switch (property_id) {
+        case PROP_LAMBDA:
+            ufo_ir_pdhg_task_set_lambda(self, g_value_get_float(value));
+            break;
+        case PROP_POSITIVE_CONSTRAINT:
+            ufo_ir_pdhg_task_set_positive_constraint(self, g_value_get_boolean(value));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_ir_pdhg_task_get_property (GObject *object,
+                               guint property_id,
+                               GValue *value,
+                               GParamSpec *pspec)
+{
+    UfoIrPdhgTask *self = UFO_IR_PDHG_TASK (object);
+
+    switch (property_id) {
+        case PROP_LAMBDA:
+            g_value_set_float(value, ufo_ir_pdhg_task_get_lambda(self));
+            break;
+        case PROP_POSITIVE_CONSTRAINT:
+            g_value_set_boolean(value, ufo_ir_pdhg_task_get_positive_constraint(self));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_ir_pdhg_task_dispose (GObject *object)
+{
+    UfoIrPdhgTaskPrivate *priv = UFO_IR_PDHG_TASK_GET_PRIVATE (object);
+
+    if (priv->bo_processor != NULL) {
+        g_object_unref (priv->bo_processor);
+        priv->bo_processor = NULL;
+    }
+
+    if (priv->gradient_processor != NULL) {
+        g_object_unref (priv->gradient_processor);
+        priv->gradient_processor = NULL;
+    }
+
+    G_OBJECT_CLASS (ufo_ir_pdhg_task_parent_class)->dispose (object);
+}
+
+gfloat
+ufo_ir_pdhg_task_get_lambda(UfoIrPdhgTask *self)
+{
+    UfoIrPdhgTaskPrivate *priv = UFO_IR_PDHG_TASK_GET_PRIVATE (self);
+    return priv->lambda;
+}
+
+void
+ufo_ir_pdhg_task_set_lambda(UfoIrPdhgTask *self, gfloat value)
+{
+    UfoIrPdhgTaskPrivate *priv = UFO_IR_PDHG_TASK_GET_PRIVATE (self);
+    priv->lambda = value;
+}
+
+gboolean
+ufo_ir_pdhg_task_get_positive_constraint(UfoIrPdhgTask *self)
+{
+    UfoIrPdhgTaskPrivate *priv = UFO_IR_PDHG_TASK_GET_PRIVATE (self);
+    return priv->positive_constraint;
+}
+
+void
+ufo_ir_pdhg_task_set_positive_constraint(UfoIrPdhgTask *self, gboolean value)
+{
+    UfoIrPdhgTaskPrivate *priv = UFO_IR_PDHG_TASK_GET_PRIVATE (self);
+    priv->positive_constraint = value;
+}
+
+UfoNode *
+ufo_ir_pdhg_task_new (void)
+{
+    return UFO_NODE (g_object_new (UFO_IR_TYPE_PDHG_TASK, NULL));
+}
+
+static void
+ufo_ir_pdhg_task_setup (UfoTask      *task,
+                        UfoResources *resources,
+                        GError       **error)
+{
+    UfoIrPdhgTaskPrivate *priv = UFO_IR_PDHG_TASK_GET_PRIVATE (task);
+    ufo_task_node_set_proc_node(UFO_TASK_NODE(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), ufo_task_node_get_proc_node(UFO_TASK_NODE(task)));
+
+    ufo_task_setup(UFO_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), resources, error);
+    ufo_ir_method_task_setup_preview(UFO_IR_METHOD_TASK(task), resources, error);
+
+    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
+    priv->bo_processor = ufo_ir_basic_ops_processor_new(resources, cmd_queue);
+
+    priv->gradient_processor = ufo_ir_gradient_processor_new(resources, cmd_queue);
+
+    priv->dual_data_kernel = ufo_resources_get_kernel (resources, "ufo-ir-pdhg.cl", "pdhg_dual_data", NULL, error);
+
+    if (priv->dual_data_kernel == NULL)
+        return;
+
+    priv->dual_tv_kernel = ufo_resources_get_kernel (resources, "ufo-ir-pdhg.cl", "pdhg_dual_tv", NULL, error);
+
+    if (priv->dual_tv_kernel == NULL)
+        return;
+
+    priv->primal_kernel = ufo_resources_get_kernel (resources, "ufo-ir-pdhg.cl", "pdhg_primal", NULL, error);
+}
+
+static gboolean
+ufo_ir_pdhg_task_process (UfoTask *task,
+                          UfoBuffer **inputs,
+                          UfoBuffer *output,
+                          UfoRequisition *requisition)
+{
+    UfoIrPdhgTaskPrivate *priv = UFO_IR_PDHG_TASK_GET_PRIVATE (task);
+
+    ufo_ir_method_task_profile_slice (UFO_IR_METHOD_TASK(task));
+
+    if (ufo_ir_method_task_run_preview (UFO_IR_METHOD_TASK(task), inputs, output, requisition))
+        return TRUE;
+
+    inputs = ufo_ir_method_task_stage_inputs (UFO_IR_METHOD_TASK(task), inputs);
+    UfoIrBasicOpsProcessor *ops = priv->bo_processor;
+    UfoIrGradientProcessor *grad = priv->gradient_processor;
+    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
+
+    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task));
+    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK(projector);
+
+    UfoRequisition volume_req;
+    ufo_buffer_get_requisition (output, &volume_req);
+
+    // ||A|| only depends on the geometry
+    if (priv->norm <= 0.0f ||
+        priv->norm_dims[0] != volume_req.dims[0] ||
+        priv->norm_dims[1] != volume_req.dims[1]) {
+        priv->norm = ufo_ir_projector_task_estimate_norm (projector, ops, output, inputs[0], NORM_ITERATIONS);
+        priv->norm_dims[0] = volume_req.dims[0];
+        priv->norm_dims[1] = volume_req.dims[1];
+    }
+
+    // tau * sigma * ||K||^2 < 1 for K = (A, Dx, Dy)
+    gfloat tau = 0.99f / sqrtf (priv->norm * priv->norm + GRADIENT_NORM_SQUARED);
+    gfloat sigma = tau;
+
+    ufo_ir_projector_task_set_relaxation(projector, 1.0f);
+    ufo_ir_projector_task_set_correction_scale(projector, 1.0f);
+
+    UfoBuffer *x = output;
+    UfoBuffer *x_next = ufo_buffer_dup (output);
+    UfoBuffer *x_bar = ufo_buffer_dup (output);
+    UfoBuffer *g = ufo_buffer_dup (output);
+    UfoBuffer *gx = ufo_buffer_dup (output);
+    UfoBuffer *gy = ufo_buffer_dup (output);
+    UfoBuffer *px = ufo_buffer_dup (output);
+    UfoBuffer *py = ufo_buffer_dup (output);
+    UfoBuffer *q = ufo_buffer_dup (inputs[0]);
+    UfoBuffer *q_next = ufo_buffer_dup (inputs[0]);
+    UfoBuffer *ax = ufo_buffer_dup (inputs[0]);
+
+    ufo_ir_basic_ops_processor_set(ops, x, 0.0f);
+    ufo_ir_basic_ops_processor_set(ops, x_bar, 0.0f);
+    ufo_ir_basic_ops_processor_set(ops, px, 0.0f);
+    ufo_ir_basic_ops_processor_set(ops, py, 0.0f);
+    ufo_ir_basic_ops_processor_set(ops, q, 0.0f);
+
+    guint max_iterations = ufo_ir_method_task_get_iterations_number(UFO_IR_METHOD_TASK(task));
+
+    for (guint iteration = 0; iteration < max_iterations; iteration++) {
+        ufo_ir_method_task_profile_scope (UFO_IR_METHOD_TASK(task), iteration, -1);
+        ufo_ir_method_task_telemetry_begin (UFO_IR_METHOD_TASK(task));
+        // q = (q + sigma * (A x_bar - b)) / (1 + sigma)
+        ufo_ir_basic_ops_processor_set(ops, ax, 0.0f);
+        ufo_ir_state_dependent_task_forward(sdprojector, &x_bar, ax, requisition);
+        dual_data (priv, q, ax, inputs[0], sigma, q_next, cmd_queue);
+
+        UfoBuffer *tmp = q;
+        q = q_next;
+        q_next = tmp;
+
+        // p = proj(p + sigma * D x_bar)
+        ufo_ir_gradient_processor_dx_op(grad, x_bar, gx);
+        ufo_ir_gradient_processor_dy_op(grad, x_bar, gy);
+        dual_tv (priv, px, py, gx, gy, sigma, cmd_queue);
+
+        // g = D^T p + A^T q
+        ufo_ir_gradient_processor_dxt_op(grad, px, gx);
+        ufo_ir_gradient_processor_dyt_op(grad, py, gy);
+        ufo_ir_basic_ops_processor_add(ops, gx, gy, g);
+        ufo_ir_state_dependent_task_backward(sdprojector, &q, g, requisition);
+
+        // x = x - tau * g, x_bar = 2 * x_next - x
+        primal (priv, x, g, tau, x_next, x_bar, cmd_queue);
+
+        tmp = x;
+        x = x_next;
+        x_next = tmp;
+
+        g_debug ("PDHG iteration: %d", iteration);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "tau", tau);
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(task), "sigma", sigma);
+        ufo_ir_method_task_telemetry_end (UFO_IR_METHOD_TASK(task), iteration);
+
+        if (!ufo_ir_method_task_emit (UFO_IR_METHOD_TASK(task), x, iteration))
+            break;
+    }
+
+    if (x != output)
+        ufo_ir_profiler_copy (x, output);
+
+    g_object_unref (x == output ? x_next : x);
+    g_object_unref (x_bar);
+    g_object_unref (g);
+    g_object_unref (gx);
+    g_object_unref (gy);
+    g_object_unref (px);
+    g_object_unref (py);
+    g_object_unref (q);
+    g_object_unref (q_next);
+    g_object_unref (ax);
+
+    ufo_ir_method_task_publish_output (UFO_IR_METHOD_TASK(task), output);
+    return TRUE;
+}
+
+static void
+dual_data (UfoIrPdhgTaskPrivate *priv,
+           UfoBuffer *q,
+           UfoBuffer *ax,
+           UfoBuffer *b,
+           gfloat sigma,
+           UfoBuffer *q_out,
+           cl_command_queue cmd_queue)
+{
+    UfoRequisition requisition;
+    ufo_buffer_get_requisition (q, &requisition);
+
+    cl_mem d_q = ufo_ir_profiler_get_device_image (q, cmd_queue);
+    cl_mem d_ax = ufo_ir_profiler_get_device_image (ax, cmd_queue);
+    cl_mem d_b = ufo_ir_profiler_get_device_image (b, cmd_queue);
+    cl_mem d_q_out = ufo_ir_profiler_get_device_image (q_out, cmd_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_data_kernel, 0, sizeof (cl_mem), &d_q));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_data_kernel, 1, sizeof (cl_mem), &d_ax));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_data_kernel, 2, sizeof (cl_mem), &d_b));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_data_kernel, 3, sizeof (gfloat), &sigma));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_data_kernel, 4, sizeof (cl_mem), &d_q_out));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, priv->dual_data_kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, NULL));
+}
+
+static void
+dual_tv (UfoIrPdhgTaskPrivate *priv,
+         UfoBuffer *px,
+         UfoBuffer *py,
+         UfoBuffer *gx,
+         UfoBuffer *gy,
+         gfloat sigma,
+         cl_command_queue cmd_queue)
+{
+    UfoRequisition requisition;
+    ufo_buffer_get_requisition (px, &requisition);
+
+    cl_mem d_px = ufo_ir_profiler_get_device_array (px, cmd_queue);
+    cl_mem d_py = ufo_ir_profiler_get_device_array (py, cmd_queue);
+    cl_mem d_gx = ufo_ir_profiler_get_device_array (gx, cmd_queue);
+    cl_mem d_gy = ufo_ir_profiler_get_device_array (gy, cmd_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_tv_kernel, 0, sizeof (cl_mem), &d_px));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_tv_kernel, 1, sizeof (cl_mem), &d_py));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_tv_kernel, 2, sizeof (cl_mem), &d_gx));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_tv_kernel, 3, sizeof (cl_mem), &d_gy));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_tv_kernel, 4, sizeof (gfloat), &sigma));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->dual_tv_kernel, 5, sizeof (gfloat), &priv->lambda));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, priv->dual_tv_kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, NULL));
+}
+
+static void
+primal (UfoIrPdhgTaskPrivate *priv,
+        UfoBuffer *x,
+        UfoBuffer *g,
+        gfloat tau,
+        UfoBuffer *x_out,
+        UfoBuffer *x_bar,
+        cl_command_queue cmd_queue)
+{
+    UfoRequisition requisition;
+    ufo_buffer_get_requisition (x, &requisition);
+    gint positive = priv->positive_constraint;
+
+    cl_mem d_x = ufo_ir_profiler_get_device_image (x, cmd_queue);
+    cl_mem d_g = ufo_ir_profiler_get_device_image (g, cmd_queue);
+    cl_mem d_x_out = ufo_ir_profiler_get_device_image (x_out, cmd_queue);
+    cl_mem d_x_bar = ufo_ir_profiler_get_device_image (x_bar, cmd_queue);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->primal_kernel, 0, sizeof (cl_mem), &d_x));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->primal_kernel, 1, sizeof (cl_mem), &d_g));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->primal_kernel, 2, sizeof (gfloat), &tau));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->primal_kernel, 3, sizeof (gint), &positive));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->primal_kernel, 4, sizeof (cl_mem), &d_x_out));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->primal_kernel, 5, sizeof (cl_mem), &d_x_bar));
+    UFO_RESOURCES_CHECK_CLERR (ufo_ir_profiler_enqueue (cmd_queue, priv->primal_kernel,
+                                                        requisition.n_dims, requisition.dims, NULL, NULL));
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2011-2015 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_IR_PDHG_TASK_H
+#define __UFO_IR_PDHG_TASK_H
+
+#include "core/ufo-ir-method-task.h"
+
+
+G_BEGIN_DECLS
+
+#define UFO_IR_TYPE_PDHG_TASK             (ufo_ir_pdhg_task_get_type())
+#define UFO_IR_PDHG_TASK(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), UFO_IR_TYPE_PDHG_TASK, UfoIrPdhgTask))
+#define UFO_IR_IS_PDHG_TASK(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), UFO_IR_TYPE_PDHG_TASK))
+#define UFO_IR_PDHG_TASK_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), UFO_IR_TYPE_PDHG_TASK, UfoIrPdhgTaskClass))
+#define UFO_IR_IS_PDHG_TASK_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), UFO_IR_TYPE_PDHG_TASK))
+#define UFO_IR_PDHG_TASK_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), UFO_IR_TYPE_PDHG_TASK, UfoIrPdhgTaskClass))
+
+typedef struct _UfoIrPdhgTask           UfoIrPdhgTask;
+typedef struct _UfoIrPdhgTaskClass      UfoIrPdhgTaskClass;
+typedef struct _UfoIrPdhgTaskPrivate    UfoIrPdhgTaskPrivate;
+
+struct _UfoIrPdhgTask {
+    UfoIrMethodTask parent_instance;
+
+    UfoIrPdhgTaskPrivate *priv;
+};
+
+struct _UfoIrPdhgTaskClass {
+    UfoIrMethodTaskClass parent_class;
+};
+
+UfoNode  *ufo_ir_pdhg_task_new       (void);
+GType     ufo_ir_pdhg_task_get_type  (void);
+
+gfloat   ufo_ir_pdhg_task_get_lambda(UfoIrPdhgTask *self);
+void     ufo_ir_pdhg_task_set_lambda(UfoIrPdhgTask *self, gfloat value);
+
+gboolean ufo_ir_pdhg_task_get_positive_constraint(UfoIrPdhgTask *self);
+void     ufo_ir_pdhg_task_set_positive_constraint(UfoIrPdhgTask *self, gboolean value);
+
+G_END_DECLS
+
+#endif
+
@@ -25,14 +25,37 @@
 
 #include "ufo-ir-sart-task.h"
 #include "core/ufo-ir-basic-ops.h"
+#include "core/ufo-ir-profiler.h"
 #include "ufo-ir-parallel-projector-task.h"
 #include <math.h>
+#include <string.h>
 
 static void ufo_ir_sart_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
 static void ufo_ir_sart_task_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
 static void ufo_task_interface_init (UfoTaskIface *iface);
 static void ufo_ir_sart_task_setup (UfoTask *task, UfoResources *resources, GError **error);
+static void ufo_ir_sart_task_dispose (GObject *object);
 static gboolean ufo_ir_sart_task_process (UfoTask *task, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+static gboolean ufo_ir_sart_task_refine (UfoIrMethodTask *method, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+static gboolean ufo_ir_sart_task_generate (UfoTask *task, UfoBuffer *output, UfoRequisition *requisition);
+static void ufo_ir_sart_task_get_requisition (UfoTask *task, UfoBuffer **inputs, UfoRequisition *requisition, GError **error);
+static UfoTaskMode ufo_ir_sart_task_get_mode (UfoTask *task);
+
+// Workspace kept between calls as long as the geometry does not change
+typedef struct {
+    UfoIrProjectorTask *projector;
+    UfoRequisition sino_req;
+    UfoRequisition volume_req;
+    UfoIrProjectionsSubset *subsets;
+    guint n_subsets;
+    UfoBuffer *sino_tmp;
+    UfoBuffer *ray_weights;
+} Workspace;
+
+static gboolean stream_block (UfoIrSartTask *self, UfoBuffer *block);
+static Workspace *prepare_workspace (UfoIrSartTask *self, UfoBuffer *sinogram, UfoBuffer *volume, cl_command_queue cmd_queue, gboolean weights);
+static void release_workspace (Workspace *ws);
+static void sweep (UfoIrSartTask *self, Workspace *ws, UfoBuffer *sinogram, UfoBuffer *volume, guint first, guint last, guint iteration);
 static UfoIrProjectionsSubset *generate_subsets (UfoIrParallelProjectorTask *projector, guint *n_subsets);
 
 struct _UfoIrSartTaskPrivate {
@@ -42,6 +65,20 @@ struct _UfoIrSartTaskPrivate {
     gpointer op_add_kernel;
     gpointer op_mul_kernel;
     gpointer op_mul_rows_kernel;
+    gpointer op_copy_rows_kernel;
+
+    // One per concurrent slice
+    Workspace workspaces[UFO_IR_METHOD_TASK_MAX_LANES];
+
+    // streaming, blocks of angles are placed into the sinogram of the scan
+    // and the estimate is updated as they arrive
+    gboolean stream;
+    guint stream_sweeps;
+    guint received;
+    gpointer context;
+    UfoBuffer *stream_sinogram;
+    UfoBuffer *stream_volume;
+    UfoBuffer *stream_ones;
 };
 
 G_DEFINE_TYPE_WITH_CODE (UfoIrSartTask, ufo_ir_sart_task, UFO_IR_TYPE_METHOD_TASK,
@@ -53,16 +90,25 @@ G_DEFINE_TYPE_WITH_CODE (UfoIrSartTask, ufo_ir_sart_task, UFO_IR_TYPE_METHOD_TAS
 enum {
     PROP_0 = 100,
     PROP_RELAXATION_FACTOR,
+    PROP_STREAM,
+    PROP_STREAM_SWEEPS,
     N_PROPERTIES
 };
 
 static GParamSpec *properties[N_PROPERTIES] = { NULL, };
+static UfoTaskIface *parent_iface = NULL;
 
 static void
 ufo_task_interface_init (UfoTaskIface *iface)
 {
     iface->process = ufo_ir_sart_task_process;
     iface->setup = ufo_ir_sart_task_setup;
+    iface->generate = ufo_ir_sart_task_generate;
+    iface->get_requisition = ufo_ir_sart_task_get_requisition;
+    iface->get_mode = ufo_ir_sart_task_get_mode;
+
+    // The method task answers everything but streaming
+    parent_iface = g_type_interface_peek_parent (iface);
 }
 
 static void
@@ -72,6 +118,11 @@ ufo_ir_sart_task_class_init (UfoIrSartTaskClass *klass)
 
     oclass->set_property = ufo_ir_sart_task_set_property;
     oclass->get_property = ufo_ir_sart_task_get_property;
+    oclass->dispose = ufo_ir_sart_task_dispose;
+
+    UFO_IR_METHOD_TASK_CLASS (klass)->refine = ufo_ir_sart_task_refine;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_volumes = 2;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_sinograms = 3;
 
     properties[PROP_RELAXATION_FACTOR] =
             g_param_spec_float("relaxation_factor",
@@ -80,6 +131,23 @@ ufo_ir_sart_task_class_init (UfoIrSartTaskClass *klass)
                                0.0f, 1.0f, 0.25f,
                                G_PARAM_READWRITE);
 
+    // Inputs are consecutive blocks of angles of one scan, the projector
+    // must know its total number of angles
+    properties[PROP_STREAM] =
+            g_param_spec_boolean("stream",
+                                 "Update the estimate with blocks of angles as they arrive",
+                                 "Update the estimate with blocks of angles as they arrive",
+                                 FALSE,
+                                 G_PARAM_READWRITE);
+
+    // Passes over all angles received so far after each block
+    properties[PROP_STREAM_SWEEPS] =
+            g_param_spec_uint("stream-sweeps",
+                              "Sweeps over the received angles after each block",
+                              "Sweeps over the received angles after each block",
+                              0, G_MAXUINT, 1,
+                              G_PARAM_READWRITE);
+
     for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
         g_object_class_install_property (oclass, i, properties[i]);
 
@@ -91,6 +159,39 @@ ufo_ir_sart_task_init(UfoIrSartTask *self)
 {
     self->priv = UFO_IR_SART_TASK_GET_PRIVATE(self);
     self->priv->relaxation_factor = 0.25;
+    self->priv->stream_sweeps = 1;
+    memset (self->priv->workspaces, 0, sizeof (self->priv->workspaces));
+}
+
+static void
+ufo_ir_sart_task_dispose (GObject *object)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (object);
+
+    for (guint i = 0; i < UFO_IR_METHOD_TASK_MAX_LANES; i++)
+        release_workspace (&priv->workspaces[i]);
+
+    if (priv->stream_sinogram != NULL) {
+        g_object_unref (priv->stream_sinogram);
+        priv->stream_sinogram = NULL;
+    }
+
+    if (priv->stream_volume != NULL) {
+        g_object_unref (priv->stream_volume);
+        priv->stream_volume = NULL;
+    }
+
+    if (priv->stream_ones != NULL) {
+        g_object_unref (priv->stream_ones);
+        priv->stream_ones = NULL;
+    }
+
+    if (priv->context != NULL) {
+        UFO_RESOURCES_CHECK_CLERR (clReleaseContext (priv->context));
+        priv->context = NULL;
+    }
+
+    G_OBJECT_CLASS (ufo_ir_sart_task_parent_class)->dispose (object);
 }
 
 static void
@@ -105,6 +206,12 @@ ufo_ir_sart_task_set_property (GObject *object,
         case PROP_RELAXATION_FACTOR:
             ufo_ir_sart_task_set_relaxation_factor(self, g_value_get_float(value));
             break;
+        case PROP_STREAM:
+            ufo_ir_sart_task_set_stream(self, g_value_get_boolean(value));
+            break;
+        case PROP_STREAM_SWEEPS:
+            ufo_ir_sart_task_set_stream_sweeps(self, g_value_get_uint(value));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -123,6 +230,12 @@ ufo_ir_sart_task_get_property (GObject *object,
         case PROP_RELAXATION_FACTOR:
             g_value_set_float(value, ufo_ir_sart_task_get_relaxation_factor(self));
             break;
+        case PROP_STREAM:
+            g_value_set_boolean(value, ufo_ir_sart_task_get_stream(self));
+            break;
+        case PROP_STREAM_SWEEPS:
+            g_value_set_uint(value, ufo_ir_sart_task_get_stream_sweeps(self));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -143,6 +256,35 @@ ufo_ir_sart_task_set_relaxation_factor(UfoIrSartTask *self, gfloat value)
     priv->relaxation_factor = value;
 }
 
+gboolean
+ufo_ir_sart_task_get_stream(UfoIrSartTask *self)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (self);
+    return priv->stream;
+}
+
+void
+ufo_ir_sart_task_set_stream(UfoIrSartTask *self, gboolean value)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (self);
+    priv->stream = value;
+    priv->received = 0;
+}
+
+guint
+ufo_ir_sart_task_get_stream_sweeps(UfoIrSartTask *self)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (self);
+    return priv->stream_sweeps;
+}
+
+void
+ufo_ir_sart_task_set_stream_sweeps(UfoIrSartTask *self, guint value)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (self);
+    priv->stream_sweeps = value;
+}
+
 UfoNode *
 ufo_ir_sart_task_new (void)
 {
@@ -162,12 +304,89 @@ ufo_ir_sart_task_setup (UfoTask      *task,
     ufo_task_node_set_proc_node(UFO_TASK_NODE(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), ufo_task_node_get_proc_node(UFO_TASK_NODE(task)));
 
     ufo_task_setup(UFO_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), resources, error);
+    ufo_ir_method_task_setup_preview(UFO_IR_METHOD_TASK(task), resources, error);
     UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (task);
     priv->op_set_kernel = ufo_ir_op_set_generate_kernel(resources);
     priv->op_inv_kernel = ufo_ir_op_inv_generate_kernel(resources);
     priv->op_add_kernel = ufo_ir_op_add_generate_kernel(resources);
     priv->op_mul_kernel = ufo_ir_op_mul_generate_kernel(resources);
     priv->op_mul_rows_kernel = ufo_ir_op_mul_rows_generate_kernel(resources);
+
+    if (priv->stream)
+        priv->op_copy_rows_kernel = ufo_ir_op_copy_rows_generate_kernel(resources);
+
+    if (priv->context == NULL) {
+        priv->context = ufo_resources_get_context (resources);
+        UFO_RESOURCES_CHECK_CLERR (clRetainContext (priv->context));
+    }
+}
+
+static void
+release_workspace (Workspace *ws)
+{
+    if (ws->sino_tmp != NULL) {
+        g_object_unref (ws->sino_tmp);
+        ws->sino_tmp = NULL;
+    }
+
+    if (ws->ray_weights != NULL) {
+        g_object_unref (ws->ray_weights);
+        ws->ray_weights = NULL;
+    }
+
+    g_free (ws->subsets);
+    ws->subsets = NULL;
+    ws->n_subsets = 0;
+    ws->projector = NULL;
+}
+
+static Workspace *
+prepare_workspace (UfoIrSartTask *self,
+                   UfoBuffer *sinogram,
+                   UfoBuffer *volume,
+                   cl_command_queue cmd_queue,
+                   gboolean weights)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (self);
+    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(self));
+    Workspace *ws = &priv->workspaces[ufo_ir_method_task_get_lane (UFO_IR_METHOD_TASK(self))];
+
+    if (ws->ray_weights != NULL &&
+        ws->projector == projector &&
+        !ufo_buffer_cmp_dimensions (sinogram, &ws->sino_req) &&
+        !ufo_buffer_cmp_dimensions (volume, &ws->volume_req)) {
+        return ws;
+    }
+
+    release_workspace (ws);
+    ws->projector = projector;
+    ufo_buffer_get_requisition (sinogram, &ws->sino_req);
+    ufo_buffer_get_requisition (volume, &ws->volume_req);
+
+    UfoIrParallelProjectorTask *pprojector = UFO_IR_PARALLEL_PROJECTOR_TASK(projector);
+    ws->subsets = generate_subsets (pprojector, &ws->n_subsets);
+    ws->sino_tmp = ufo_buffer_dup (sinogram);
+    ws->ray_weights = ufo_buffer_dup (sinogram);
+
+    // Streaming adds the weights of every block as it arrives
+    if (!weights) {
+        ufo_ir_op_set (ws->ray_weights, 0.0f, cmd_queue, priv->op_set_kernel);
+        return ws;
+    }
+
+    // calculate the weighting coefficients
+    UfoBuffer *volume_tmp = ufo_buffer_dup (volume);
+    ufo_ir_op_set (volume_tmp,  1.0f, cmd_queue, priv->op_set_kernel);
+    ufo_ir_op_set (ws->ray_weights, 0.0f, cmd_queue, priv->op_set_kernel);
+    ufo_ir_projector_task_set_correction_scale(projector, 1.0f);
+    for (guint i = 0 ; i < ws->n_subsets; ++i) {
+        ufo_ir_parallel_projector_subset_fp(pprojector, volume_tmp, ws->ray_weights, &ws->subsets[i]);
+    }
+
+    ufo_ir_op_inv (ws->ray_weights, cmd_queue, priv->op_inv_kernel);
+    g_object_unref (volume_tmp);
+
+    return ws;
 }
 
 static gboolean
@@ -177,52 +396,255 @@ ufo_ir_sart_task_process (UfoTask *task,
                           UfoRequisition *requisition)
 {
     UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (task);
-    UfoIrParallelProjectorTask *projector = UFO_IR_PARALLEL_PROJECTOR_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task)));
-    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
-    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
 
+    ufo_ir_method_task_profile_slice (UFO_IR_METHOD_TASK(task));
 
-    UfoBuffer *sino_tmp = ufo_buffer_dup (inputs[0]);
-    UfoBuffer *volume_tmp = ufo_buffer_dup (output);
-    UfoBuffer *ray_weights = ufo_buffer_dup (inputs[0]);
+    if (priv->stream)
+        return stream_block (UFO_IR_SART_TASK(task), inputs[0]);
 
-    guint n_subsets = 0;
-    UfoIrProjectionsSubset *subsets = generate_subsets (projector, &n_subsets);
+    if (ufo_ir_method_task_run_preview (UFO_IR_METHOD_TASK(task), inputs, output, requisition))
+        return TRUE;
 
-    // calculate the weighting coefficients
-    ufo_ir_op_set (volume_tmp,  1.0f, cmd_queue, priv->op_set_kernel);
-    ufo_ir_op_set (ray_weights, 0.0f, cmd_queue, priv->op_set_kernel);
-    ufo_ir_projector_task_set_correction_scale(UFO_IR_PROJECTOR_TASK(projector), 1.0f);
-    for (guint i = 0 ; i < n_subsets; ++i) {
-        ufo_ir_parallel_projector_subset_fp(projector, volume_tmp, ray_weights, &subsets[i]);
-    }
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_ir_method_task_next_lane (UFO_IR_METHOD_TASK(task));
 
-    ufo_ir_op_inv (ray_weights, cmd_queue, priv->op_inv_kernel);
+    inputs = ufo_ir_method_task_stage_inputs (UFO_IR_METHOD_TASK(task), inputs);
+    ufo_ir_op_set(output, 0.0f, cmd_queue, priv->op_set_kernel);
+
+    gboolean result = ufo_ir_sart_task_refine (UFO_IR_METHOD_TASK(task), inputs, output, requisition);
+    ufo_ir_method_task_publish_output (UFO_IR_METHOD_TASK(task), output);
+    return result;
+}
 
-    // do SART
-    guint max_iterations = ufo_ir_method_task_get_iterations_number(UFO_IR_METHOD_TASK(task));
+static gboolean
+ufo_ir_sart_task_refine (UfoIrMethodTask *method,
+                         UfoBuffer **inputs,
+                         UfoBuffer *output,
+                         UfoRequisition *requisition)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (method);
+    UfoIrParallelProjectorTask *projector = UFO_IR_PARALLEL_PROJECTOR_TASK(ufo_ir_method_task_get_projector(method));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_ir_method_task_get_cmd_queue (method);
+    Workspace *ws = prepare_workspace (UFO_IR_SART_TASK(method), inputs[0], output, cmd_queue, TRUE);
+
+    // do SART starting from the current content of output
+    guint max_iterations = ufo_ir_method_task_get_iterations_number(method);
     guint iteration = 0;
     ufo_ir_projector_task_set_correction_scale(UFO_IR_PROJECTOR_TASK(projector), -1.0f);
     ufo_ir_projector_task_set_relaxation(UFO_IR_PROJECTOR_TASK(projector), priv->relaxation_factor);
-    ufo_ir_op_set(output, 0.0f, cmd_queue, priv->op_set_kernel);
     while (iteration < max_iterations) {
-        ufo_buffer_copy (inputs[0], sino_tmp);
+        gboolean telemetry = ufo_ir_method_task_telemetry_begin (method);
+        sweep (UFO_IR_SART_TASK(method), ws, inputs[0], output, 0, ws->n_subsets, iteration);
 
-        for (guint i = 0 ; i < n_subsets; i++) {
-            ufo_ir_parallel_projector_subset_fp(projector, output, sino_tmp, &subsets[i]);
+        if (telemetry)
+            ufo_ir_method_task_telemetry_record (method, "weighted_residual", ufo_ir_op_l1_norm (ws->sino_tmp, cmd_queue));
 
-            ufo_ir_op_mul_rows (sino_tmp, ray_weights, sino_tmp, subsets[i].offset, subsets[i].n, cmd_queue, priv->op_mul_rows_kernel);
+        ufo_ir_method_task_telemetry_end (method, iteration);
 
-            ufo_ir_parallel_projector_subset_bp (projector, output, sino_tmp, &subsets[i]);
-        }
+        if (!ufo_ir_method_task_emit (method, output, iteration))
+            break;
 
         iteration++;
     }
 
-    g_object_unref(sino_tmp);
-    g_object_unref(volume_tmp);
-    g_object_unref(ray_weights);
-    g_free(subsets);
+    return TRUE;
+}
+
+// One SART pass over the subsets [first, last), correction scale and
+// relaxation of the projector must be set. Afterwards the rows of each
+// subset in sino_tmp hold its ray weighted residual from before its update
+static void
+sweep (UfoIrSartTask *self,
+       Workspace *ws,
+       UfoBuffer *sinogram,
+       UfoBuffer *volume,
+       guint first,
+       guint last,
+       guint iteration)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (self);
+    UfoIrMethodTask *method = UFO_IR_METHOD_TASK(self);
+    UfoIrParallelProjectorTask *projector = UFO_IR_PARALLEL_PROJECTOR_TASK(ufo_ir_method_task_get_projector(method));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_ir_method_task_get_cmd_queue (method);
+    UfoIrProjectionsSubset *subsets = ws->subsets;
+
+    ufo_ir_profiler_copy (sinogram, ws->sino_tmp);
+
+    for (guint i = first; i < last; i++) {
+        ufo_ir_method_task_profile_scope (method, iteration, i);
+        ufo_ir_parallel_projector_subset_fp(projector, volume, ws->sino_tmp, &subsets[i]);
+
+        ufo_ir_op_mul_rows (ws->sino_tmp, ws->ray_weights, ws->sino_tmp, subsets[i].offset, subsets[i].n, cmd_queue, priv->op_mul_rows_kernel);
+
+        ufo_ir_parallel_projector_subset_bp (projector, volume, ws->sino_tmp, &subsets[i]);
+    }
+}
+
+static UfoBuffer *
+ensure_buffer (UfoIrSartTaskPrivate *priv, UfoBuffer *buffer, UfoRequisition *requisition)
+{
+    if (buffer == NULL)
+        return ufo_buffer_new (requisition, priv->context);
+
+    if (ufo_buffer_cmp_dimensions (buffer, requisition) != 0)
+        ufo_buffer_resize (buffer, requisition);
+
+    return buffer;
+}
+
+static void
+ufo_ir_sart_task_get_requisition (UfoTask *task,
+                                  UfoBuffer **inputs,
+                                  UfoRequisition *requisition,
+                                  GError **error)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (task);
+
+    if (!priv->stream) {
+        parent_iface->get_requisition (task, inputs, requisition, error);
+        return;
+    }
+
+    // The projector and the memory plan see the sinogram of the whole scan
+    UfoIrParallelProjectorTask *projector = UFO_IR_PARALLEL_PROJECTOR_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task)));
+    guint n_angles = ufo_ir_parallel_projector_get_angles_num (projector);
+    UfoRequisition sino_req;
+
+    if (n_angles == 0) {
+        g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_GET_REQUISITION,
+                     "Streaming needs angles_num of the projector set to the number of angles of the scan");
+        return;
+    }
+
+    if (priv->op_copy_rows_kernel == NULL) {
+        g_set_error (error, UFO_TASK_ERROR, UFO_TASK_ERROR_GET_REQUISITION,
+                     "Streaming must be enabled before the task is set up");
+        return;
+    }
+
+    ufo_buffer_get_requisition (inputs[0], &sino_req);
+    sino_req.dims[1] = n_angles;
+    priv->stream_sinogram = ensure_buffer (priv, priv->stream_sinogram, &sino_req);
+
+    parent_iface->get_requisition (task, &priv->stream_sinogram, requisition, error);
+
+    if (error == NULL || *error == NULL) {
+        priv->stream_volume = ensure_buffer (priv, priv->stream_volume, requisition);
+        priv->stream_ones = ensure_buffer (priv, priv->stream_ones, requisition);
+    }
+}
+
+static UfoTaskMode
+ufo_ir_sart_task_get_mode (UfoTask *task)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (task);
+
+    if (priv->stream)
+        return UFO_TASK_MODE_REDUCTOR | UFO_TASK_MODE_GPU;
+
+    return parent_iface->get_mode (task);
+}
+
+// Places the block after the angles received so far, adds the weights of
+// its rays and updates the estimate with the new angles first, then sweeps
+// over all of them while the next block is being acquired
+static gboolean
+stream_block (UfoIrSartTask *self, UfoBuffer *block)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (self);
+    UfoIrMethodTask *method = UFO_IR_METHOD_TASK(self);
+    UfoIrParallelProjectorTask *projector = UFO_IR_PARALLEL_PROJECTOR_TASK(ufo_ir_method_task_get_projector(method));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_ir_method_task_get_cmd_queue (method);
+    UfoRequisition block_req, sino_req;
+    Workspace *ws;
+
+    ufo_buffer_get_requisition (block, &block_req);
+    ufo_buffer_get_requisition (priv->stream_sinogram, &sino_req);
+
+    if (priv->received == 0) {
+        // A new scan, the weights are accumulated from scratch
+        release_workspace (&priv->workspaces[ufo_ir_method_task_get_lane (method)]);
+        ufo_ir_op_set (priv->stream_sinogram, 0.0f, cmd_queue, priv->op_set_kernel);
+        ufo_ir_op_set (priv->stream_volume, 0.0f, cmd_queue, priv->op_set_kernel);
+        ufo_ir_op_set (priv->stream_ones, 1.0f, cmd_queue, priv->op_set_kernel);
+    }
+
+    ws = prepare_workspace (self, priv->stream_sinogram, priv->stream_volume, cmd_queue, FALSE);
+
+    guint first = priv->received;
+    guint n = MIN ((guint) block_req.dims[1], (guint) sino_req.dims[1] - first);
+
+    if (n < block_req.dims[1])
+        g_warning ("Ignoring %u angles beyond the %u of the scan",
+                   (guint) block_req.dims[1] - n, (guint) sino_req.dims[1]);
+
+    if (n == 0)
+        return TRUE;
+
+    ufo_ir_op_copy_rows (block, priv->stream_sinogram, first, n, cmd_queue, priv->op_copy_rows_kernel);
+
+    // Inverse ray sums of the new rows, the other rows stay 0
+    ufo_ir_op_set (ws->sino_tmp, 0.0f, cmd_queue, priv->op_set_kernel);
+    ufo_ir_projector_task_set_correction_scale(UFO_IR_PROJECTOR_TASK(projector), 1.0f);
+
+    for (guint i = first; i < first + n; i++)
+        ufo_ir_parallel_projector_subset_fp(projector, priv->stream_ones, ws->sino_tmp, &ws->subsets[i]);
+
+    ufo_ir_op_inv (ws->sino_tmp, cmd_queue, priv->op_inv_kernel);
+    ufo_ir_op_add (ws->ray_weights, ws->sino_tmp, ws->ray_weights, cmd_queue, priv->op_add_kernel);
+    priv->received += n;
+
+    ufo_ir_projector_task_set_correction_scale(UFO_IR_PROJECTOR_TASK(projector), -1.0f);
+    ufo_ir_projector_task_set_relaxation(UFO_IR_PROJECTOR_TASK(projector), priv->relaxation_factor);
+    sweep (self, ws, priv->stream_sinogram, priv->stream_volume, first, priv->received, 0);
+
+    for (guint i = 0; i < priv->stream_sweeps; i++)
+        sweep (self, ws, priv->stream_sinogram, priv->stream_volume, 0, priv->received, i + 1);
+
+    return TRUE;
+}
+
+// Runs the iterations of the method over all received angles once the
+// stream ended and emits the estimate
+static gboolean
+ufo_ir_sart_task_generate (UfoTask *task,
+                           UfoBuffer *output,
+                           UfoRequisition *requisition)
+{
+    UfoIrSartTaskPrivate *priv = UFO_IR_SART_TASK_GET_PRIVATE (task);
+    UfoIrMethodTask *method = UFO_IR_METHOD_TASK(task);
+
+    if (!priv->stream || priv->received == 0)
+        return FALSE;
+
+    ufo_ir_method_task_profile_slice (method);
+
+    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(method);
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_ir_method_task_get_cmd_queue (method);
+    Workspace *ws = prepare_workspace (UFO_IR_SART_TASK(task), priv->stream_sinogram, priv->stream_volume, cmd_queue, FALSE);
+    UfoRequisition sino_req;
+
+    ufo_buffer_get_requisition (priv->stream_sinogram, &sino_req);
+
+    if (priv->received < sino_req.dims[1])
+        g_warning ("Stream ended after %u of %u angles", priv->received, (guint) sino_req.dims[1]);
+
+    guint max_iterations = ufo_ir_method_task_get_iterations_number(method);
+    ufo_ir_projector_task_set_correction_scale(projector, -1.0f);
+    ufo_ir_projector_task_set_relaxation(projector, priv->relaxation_factor);
+
+    for (guint iteration = 0; iteration < max_iterations; iteration++) {
+        gboolean telemetry = ufo_ir_method_task_telemetry_begin (method);
+        sweep (UFO_IR_SART_TASK(task), ws, priv->stream_sinogram, priv->stream_volume, 0, priv->received, iteration);
+
+        if (telemetry)
+            ufo_ir_method_task_telemetry_record (method, "weighted_residual", ufo_ir_op_l1_norm (ws->sino_tmp, cmd_queue));
+
+        ufo_ir_method_task_telemetry_end (method, iteration);
+    }
+
+    ufo_ir_profiler_copy (priv->stream_volume, output);
+    ufo_ir_method_task_publish_output (method, output);
+    priv->received = 0;
 
     return TRUE;
 }
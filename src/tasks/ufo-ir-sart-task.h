@@ -52,6 +52,11 @@ GType     ufo_ir_sart_task_get_type  (void);
 gfloat ufo_ir_sart_task_get_relaxation_factor(UfoIrSartTask *self);
 void   ufo_ir_sart_task_set_relaxation_factor(UfoIrSartTask *self, gfloat value);
 
+gboolean ufo_ir_sart_task_get_stream(UfoIrSartTask *self);
+void     ufo_ir_sart_task_set_stream(UfoIrSartTask *self, gboolean value);
+guint    ufo_ir_sart_task_get_stream_sweeps(UfoIrSartTask *self);
+void     ufo_ir_sart_task_set_stream_sweeps(UfoIrSartTask *self, guint value);
+
 G_END_DECLS
 
 #endif
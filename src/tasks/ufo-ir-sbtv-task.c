@@ -31,9 +31,20 @@
 #include "core/ufo-ir-basic-ops-processor.h"
 #include "core/ufo-ir-projector-task.h"
 #include "core/ufo-ir-debug.h"
+#include "core/ufo-ir-profiler.h"
+#include "core/ufo-ir-exec.h"
 
 #define EPS 2.2204E-16
 
+// Tolerance of the first Bregman subproblem, later ones follow the relative
+// change of u but never go below inner_tolerance
+#define INITIAL_INNER_TOLERANCE 1E-02
+
+typedef enum {
+    SOLVER_CGS,
+    SOLVER_PCG
+} UfoIrSbtvSolver;
+
 static void ufo_ir_sbtv_task_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
 static void ufo_ir_sbtv_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
 static void ufo_ir_sbtv_task_dispose (GObject *object);
@@ -42,7 +53,9 @@ static gboolean ufo_ir_sbtv_task_process (UfoTask *task, UfoBuffer **inputs, Ufo
 
 static void calculate_b(UfoIrSbtvTask *self, UfoBuffer *fbp, UfoBuffer *dx, UfoBuffer *dy, UfoBuffer *bx, UfoBuffer *by, UfoBuffer *b);
 static void update_db(UfoIrSbtvTask *self, UfoBuffer *u, UfoBuffer *dx, UfoBuffer *dy, UfoBuffer *bx, UfoBuffer *by);
-static void cgs(UfoIrSbtvTask *self, UfoBuffer *b, UfoBuffer *x, UfoBuffer *x0, guint maxIter, UfoBuffer *sino);
+static void cgs(UfoIrSbtvTask *self, UfoBuffer *b, UfoBuffer *x, UfoBuffer *x0, guint maxIter, gfloat tol, UfoBuffer *sino);
+static guint pcg(UfoIrSbtvTask *self, UfoBuffer *b, UfoBuffer *x, UfoBuffer *x0, guint maxIter, gfloat tol, UfoBuffer *inv_diag, UfoBuffer *sino);
+static void jacobi_preconditioner(UfoIrSbtvTask *self, UfoBuffer *sino, UfoBuffer *inv_diag);
 static void processA(UfoIrSbtvTask *self, UfoBuffer *in, UfoBuffer *out, UfoBuffer *sino);
 
 struct _UfoIrSbtvTaskPrivate {
@@ -50,8 +63,17 @@ struct _UfoIrSbtvTaskPrivate {
     gfloat mu;
     gfloat lambda;
 
+    // Inner solver of the Bregman subproblems
+    UfoIrSbtvSolver solver;
+    guint inner_iterations;
+    gfloat inner_tolerance;
+
     UfoIrGradientProcessor *gradient_processor;
     UfoIrBasicOpsProcessor *bo_processor;
+
+    // All buffers of a slice live on the host when the projector runs
+    // there and as device arrays otherwise
+    cl_command_queue cmd_queue;
 };
 
 static void ufo_task_interface_init (UfoTaskIface *iface);
@@ -66,6 +88,9 @@ enum {
     PROP_0,
     PROP_MU,
     PROP_LAMBDA,
+    PROP_SOLVER,
+    PROP_INNER_ITERATIONS,
+    PROP_INNER_TOLERANCE,
     N_PROPERTIES
 };
 
@@ -87,6 +112,11 @@ ufo_ir_sbtv_task_class_init (UfoIrSbtvTaskClass *klass)
     oclass->get_property = ufo_ir_sbtv_task_get_property;
     oclass->dispose = ufo_ir_sbtv_task_dispose;
 
+    // Peaks in the conjugate gradient solver nested in the split Bregman loop
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_volumes = 22;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_sinograms = 2;
+    UFO_IR_METHOD_TASK_CLASS (klass)->host_storage = TRUE;
+
     properties[PROP_LAMBDA] =
             g_param_spec_float("lambda",
                                "Lambda",
@@ -99,6 +129,24 @@ ufo_ir_sbtv_task_class_init (UfoIrSbtvTaskClass *klass)
                                "Mu",
                                0.0f, G_MAXFLOAT, 0.5f,
                                G_PARAM_READWRITE);
+    properties[PROP_SOLVER] =
+            g_param_spec_string("solver",
+                                "Inner solver",
+                                "Solver of the Bregman subproblems, \"pcg\" or \"cgs\"",
+                                "pcg",
+                                G_PARAM_READWRITE);
+    properties[PROP_INNER_ITERATIONS] =
+            g_param_spec_uint("inner_iterations",
+                              "Inner iterations",
+                              "Maximum number of inner solver iterations",
+                              1, G_MAXUINT, 30,
+                              G_PARAM_READWRITE);
+    properties[PROP_INNER_TOLERANCE] =
+            g_param_spec_float("inner_tolerance",
+                               "Inner tolerance",
+                               "Lower bound of the adaptive inner solver tolerance",
+                               0.0f, 1.0f, 1E-06,
+                               G_PARAM_READWRITE);
 
     for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
         g_object_class_install_property (oclass, i, properties[i]);
@@ -113,6 +161,9 @@ ufo_ir_sbtv_task_init(UfoIrSbtvTask *self)
     self->priv = priv = UFO_IR_SBTV_TASK_GET_PRIVATE(self);
     priv->lambda = 0.1f;
     priv->mu = 0.5f;
+    priv->solver = SOLVER_PCG;
+    priv->inner_iterations = 30;
+    priv->inner_tolerance = 1E-06;
 }
 
 gfloat
@@ -144,6 +195,57 @@ ufo_ir_sbtv_task_set_lambda(UfoIrSbtvTask *self,
     priv->lambda = value;
 }
 
+const gchar *
+ufo_ir_sbtv_task_get_solver(UfoIrSbtvTask *self)
+{
+    UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
+    return priv->solver == SOLVER_PCG ? "pcg" : "cgs";
+}
+
+void
+ufo_ir_sbtv_task_set_solver(UfoIrSbtvTask *self,
+                            const gchar *value)
+{
+    UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
+
+    if (!g_strcmp0 (value, "pcg"))
+        priv->solver = SOLVER_PCG;
+    else if (!g_strcmp0 (value, "cgs"))
+        priv->solver = SOLVER_CGS;
+    else
+        g_warning ("Unknown SBTV solver `%s', keeping `%s'", value, ufo_ir_sbtv_task_get_solver (self));
+}
+
+guint
+ufo_ir_sbtv_task_get_inner_iterations(UfoIrSbtvTask *self)
+{
+    UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
+    return priv->inner_iterations;
+}
+
+void
+ufo_ir_sbtv_task_set_inner_iterations(UfoIrSbtvTask *self,
+                                      guint value)
+{
+    UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
+    priv->inner_iterations = value;
+}
+
+gfloat
+ufo_ir_sbtv_task_get_inner_tolerance(UfoIrSbtvTask *self)
+{
+    UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
+    return priv->inner_tolerance;
+}
+
+void
+ufo_ir_sbtv_task_set_inner_tolerance(UfoIrSbtvTask *self,
+                                     gfloat value)
+{
+    UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
+    priv->inner_tolerance = value;
+}
+
 static void
 ufo_ir_sbtv_task_set_property (GObject *object,
                                guint property_id,
@@ -159,6 +261,15 @@ ufo_ir_sbtv_task_set_property (GObject *object,
         case PROP_LAMBDA:
             ufo_ir_sbtv_task_set_lambda(self, g_value_get_float(value));
             break;
+        case PROP_SOLVER:
+            ufo_ir_sbtv_task_set_solver(self, g_value_get_string(value));
+            break;
+        case PROP_INNER_ITERATIONS:
+            ufo_ir_sbtv_task_set_inner_iterations(self, g_value_get_uint(value));
+            break;
+        case PROP_INNER_TOLERANCE:
+            ufo_ir_sbtv_task_set_inner_tolerance(self, g_value_get_float(value));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -180,6 +291,15 @@ ufo_ir_sbtv_task_get_property (GObject *object,
         case PROP_LAMBDA:
             g_value_set_float(value, ufo_ir_sbtv_task_get_lambda(self));
             break;
+        case PROP_SOLVER:
+            g_value_set_string(value, ufo_ir_sbtv_task_get_solver(self));
+            break;
+        case PROP_INNER_ITERATIONS:
+            g_value_set_uint(value, ufo_ir_sbtv_task_get_inner_iterations(self));
+            break;
+        case PROP_INNER_TOLERANCE:
+            g_value_set_float(value, ufo_ir_sbtv_task_get_inner_tolerance(self));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -220,11 +340,13 @@ ufo_ir_sbtv_task_setup (UfoTask *task,
     ufo_task_node_set_proc_node(UFO_TASK_NODE(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), ufo_task_node_get_proc_node(UFO_TASK_NODE(task)));
 
     ufo_task_setup(UFO_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), resources, error);
+    ufo_ir_method_task_setup_preview(UFO_IR_METHOD_TASK(task), resources, error);
 
     UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
     cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
     priv->gradient_processor = ufo_ir_gradient_processor_new(resources, cmd_queue);
     priv->bo_processor = ufo_ir_basic_ops_processor_new(resources, cmd_queue);
+    priv->cmd_queue = cmd_queue;
 }
 
 static gboolean
@@ -235,8 +357,15 @@ ufo_ir_sbtv_task_process (UfoTask *task,
 {
     UfoIrSbtvTask *self = UFO_IR_SBTV_TASK(task);
     UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
-    UfoBuffer *input = inputs[0];
-    ufo_ir_basic_ops_processor_normalization( priv->bo_processor, input);
+
+    ufo_ir_method_task_profile_slice (UFO_IR_METHOD_TASK(task));
+
+    if (ufo_ir_method_task_run_preview (UFO_IR_METHOD_TASK(task), inputs, output, requisition))
+        return TRUE;
+
+    // Normalize on the host before the input is staged to the device
+    ufo_ir_basic_ops_processor_normalization( priv->bo_processor, inputs[0]);
+    UfoBuffer *input = ufo_ir_method_task_stage_inputs(UFO_IR_METHOD_TASK(self), inputs)[0];
     UfoRequisition sinogramReq;
     ufo_buffer_get_requisition(input, &sinogramReq);
 
@@ -244,11 +373,15 @@ ufo_ir_sbtv_task_process (UfoTask *task,
     guint max_iterations = ufo_ir_method_task_get_iterations_number(UFO_IR_METHOD_TASK(self));
 
     UfoBuffer *f = ufo_buffer_dup(input);
-    ufo_buffer_copy(input, f);
-    ufo_ir_basic_ops_processor_normalization(priv->bo_processor, f);
+    ufo_ir_profiler_copy(input, f);
+
+    // From here on every buffer of the slice stays in one storage and the
+    // iterations convert nothing
+    ufo_ir_method_task_place_buffer(UFO_IR_METHOD_TASK(self), f);
+    ufo_ir_method_task_place_buffer(UFO_IR_METHOD_TASK(self), output);
 
     // precompute At(f)
-    UfoBuffer *fbp = ufo_buffer_dup(output);
+    UfoBuffer *fbp = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), output);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, fbp, 0.0f);
     ufo_ir_state_dependent_task_backward(UFO_IR_STATE_DEPENDENT_TASK(projector), &f, fbp, NULL);
 
@@ -256,38 +389,79 @@ ufo_ir_sbtv_task_process (UfoTask *task,
     UfoBuffer *u = output;
     ufo_ir_basic_ops_processor_set(priv->bo_processor, u, 0.0f);
 
-    UfoBuffer *up = ufo_buffer_dup(fbp);
+    UfoBuffer *up = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
 
-    UfoBuffer *Z = ufo_buffer_dup(fbp);
+    UfoBuffer *Z = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, Z, 0.0f);
 
-    UfoBuffer *b = ufo_buffer_dup(fbp);
+    UfoBuffer *b = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
 
-    UfoBuffer *bx = ufo_buffer_dup(fbp);
+    UfoBuffer *bx = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, bx, 0.0f);
 
-    UfoBuffer *by = ufo_buffer_dup(fbp);
+    UfoBuffer *by = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, by, 0.0f);
 
-    UfoBuffer *dx = ufo_buffer_dup(fbp);
+    UfoBuffer *dx = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, dx, 0.0f);
 
-    UfoBuffer *dy = ufo_buffer_dup(fbp);
+    UfoBuffer *dy = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, dy, 0.0f);
 
     // fbp = fbp * mu
     ufo_ir_basic_ops_processor_mul_scalar(priv->bo_processor, fbp, priv->mu);
 
+    UfoBuffer *inv_diag = NULL;
+
+    if (priv->solver == SOLVER_PCG) {
+        inv_diag = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
+        jacobi_preconditioner(self, f, inv_diag);
+    }
+
+    // Early Bregman subproblems are solved loosely, the tolerance tightens
+    // with the relative change of u
+    gfloat tolerance = MAX (INITIAL_INNER_TOLERANCE, priv->inner_tolerance);
+
     // Main loop
     for (guint i = 0; i < max_iterations; ++i) {
-        g_debug ("SBTV iteration: %d", i);
-        ufo_buffer_copy(u, up);
+        ufo_ir_method_task_profile_scope (UFO_IR_METHOD_TASK(self), i, -1);
+        ufo_ir_method_task_telemetry_begin (UFO_IR_METHOD_TASK(self));
+        ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(self), "inner_tolerance", tolerance);
+        ufo_ir_profiler_copy(u, up);
 
         calculate_b(self, fbp, dx, dy, bx, by, b);
-        cgs(self, b, u, up, 30, f);
+
+        if (priv->solver == SOLVER_PCG) {
+            guint inner = pcg(self, b, u, up, priv->inner_iterations, tolerance, inv_diag, f);
+            g_debug ("SBTV iteration: %d, PCG iterations: %d, tolerance: %e", i, inner, tolerance);
+            ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(self), "inner_iterations", inner);
+        }
+        else {
+            cgs(self, b, u, up, priv->inner_iterations, tolerance, f);
+            g_debug ("SBTV iteration: %d, tolerance: %e", i, tolerance);
+        }
+
         update_db(self, u, dx, dy, bx, by);
+
+        // Z = u - up
+        ufo_ir_basic_ops_processor_deduction(priv->bo_processor, u, up, Z);
+        gfloat norm_u = ufo_ir_basic_ops_processor_l2_norm(priv->bo_processor, u);
+
+        if (norm_u > 0.0f) {
+            gfloat change = ufo_ir_basic_ops_processor_l2_norm(priv->bo_processor, Z) / norm_u;
+            tolerance = CLAMP (0.1f * change, priv->inner_tolerance, INITIAL_INNER_TOLERANCE);
+            ufo_ir_method_task_telemetry_record (UFO_IR_METHOD_TASK(self), "relative_change", change);
+        }
+
+        ufo_ir_method_task_telemetry_end (UFO_IR_METHOD_TASK(self), i);
+
+        if (!ufo_ir_method_task_emit (UFO_IR_METHOD_TASK(self), u, i))
+            break;
     }
 
+    if (inv_diag)
+        g_object_unref (inv_diag);
+
     g_object_unref (f);
     g_object_unref (fbp);
     g_object_unref (up);
@@ -298,6 +472,8 @@ ufo_ir_sbtv_task_process (UfoTask *task,
     g_object_unref (dx);
     g_object_unref (dy);
 
+    ufo_ir_method_task_publish_output(UFO_IR_METHOD_TASK(self), output);
+
     return TRUE;
 }
 
@@ -311,9 +487,9 @@ calculate_b(UfoIrSbtvTask *self,
             UfoBuffer *b)
 {
     UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
-    UfoBuffer *tmpx = ufo_buffer_dup(fbp);
-    UfoBuffer *tmpy = ufo_buffer_dup(fbp);
-    UfoBuffer *tmpDif = ufo_buffer_dup(fbp);
+    UfoBuffer *tmpx = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
+    UfoBuffer *tmpy = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
+    UfoBuffer *tmpDif = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), fbp);
 
     // tmpx = DXT(dx - bx);
     ufo_ir_basic_ops_processor_deduction(priv->bo_processor, dx, bx, tmpDif);
@@ -343,30 +519,36 @@ update_db(UfoIrSbtvTask *self,
 {
     UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
     // Mem allocation
-    UfoBuffer *tmpx = ufo_buffer_dup(u);
-    UfoBuffer *tmpy = ufo_buffer_dup(u);
-    UfoBuffer *s = ufo_buffer_dup(u);
-    UfoBuffer *temp_pow = ufo_buffer_dup(u);
-    UfoBuffer *tresh = ufo_buffer_dup(u);
-    UfoBuffer *temp_s_top = ufo_buffer_dup(u);
-    UfoBuffer *Z = ufo_buffer_dup(u);
+    UfoBuffer *tmpx = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
+    UfoBuffer *tmpy = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
+    UfoBuffer *s = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
+    UfoBuffer *temp_pow = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
+    UfoBuffer *tresh = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
+    UfoBuffer *temp_s_top = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
+    UfoBuffer *Z = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, Z, 0.0f);
-    UfoBuffer *e12 = ufo_buffer_dup(u);
+    UfoBuffer *e12 = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, e12, 1E-12);
 
     gfloat dLambda = - 1 / priv->lambda;
 
+    // The x and y parts are independent
+    ufo_ir_exec_fork (priv->cmd_queue);
+
     // tmpx = Dx(u)+bx;
     ufo_ir_gradient_processor_dx_op(priv->gradient_processor, u, tmpx);
     ufo_ir_basic_ops_processor_add(priv->bo_processor, tmpx, bx, tmpx);
 
     // tmpy = Dy(u)+by;
+    ufo_ir_exec_branch (priv->cmd_queue);
     ufo_ir_gradient_processor_dy_op(priv->gradient_processor, u, tmpy);
     ufo_ir_basic_ops_processor_add(priv->bo_processor, tmpy, by, tmpy);
 
+    ufo_ir_exec_join (priv->cmd_queue);
+
     // s = sqrt((tmpx.^2 + tmpy.^2));
     ufo_ir_basic_ops_processor_mul_element_wise(priv->bo_processor, tmpx, tmpx, temp_pow);
-    ufo_buffer_copy(temp_pow, s);
+    ufo_ir_profiler_copy(temp_pow, s);
     ufo_ir_basic_ops_processor_mul_element_wise(priv->bo_processor, tmpy, tmpy, temp_pow);
     ufo_ir_basic_ops_processor_add(priv->bo_processor, s, temp_pow, s);
     ufo_ir_basic_ops_processor_sqrt(priv->bo_processor, s);
@@ -407,25 +589,25 @@ cgs(UfoIrSbtvTask *self,
     UfoBuffer *x,
     UfoBuffer *x0,
     guint maxIter,
+    gfloat tol,
     UfoBuffer *sino)
 {
     UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
 
-    gfloat tol = 1E-06;
     float n2b = ufo_ir_basic_ops_processor_l2_norm(priv->bo_processor, b);
 
-    ufo_buffer_copy(x0, x);
+    ufo_ir_profiler_copy(x0, x);
 
     guint flag = 1;
 
     UfoBuffer *xmin;
-    xmin = ufo_buffer_dup(x);
-    ufo_buffer_copy(x, xmin);
+    xmin = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), x);
+    ufo_ir_profiler_copy(x, xmin);
 
     gfloat tolb = tol * n2b;
 
     // r = b - A * x
-    UfoBuffer *r = ufo_buffer_dup(b);
+    UfoBuffer *r = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), b);
     processA(self, x, r, sino); // A * x
     ufo_ir_basic_ops_processor_deduction(priv->bo_processor, b, r, r); // b - result of A * x
 
@@ -439,34 +621,34 @@ cgs(UfoIrSbtvTask *self,
         return;
     }
 
-    UfoBuffer *rt = ufo_buffer_dup(r);
-    ufo_buffer_copy(r, rt);
+    UfoBuffer *rt = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), r);
+    ufo_ir_profiler_copy(r, rt);
 
     float normmin = normr;
     gfloat rho = 1.0f;
     guint stag = 0;
     guint moresteps = 0;
     guint maxmsteps = 5;
-    UfoBuffer *u = ufo_buffer_dup(r);
+    UfoBuffer *u = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), r);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, u, 0.0f);
 
-    UfoBuffer *tmpa = ufo_buffer_dup(r);
+    UfoBuffer *tmpa = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), r);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, tmpa, 0.0f);
 
-    UfoBuffer *p = ufo_buffer_dup(r);
+    UfoBuffer *p = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), r);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, p, 0.0f);
-    UfoBuffer *ph = ufo_buffer_dup(r);
+    UfoBuffer *ph = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), r);
 
-    UfoBuffer *q = ufo_buffer_dup(r);
+    UfoBuffer *q = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), r);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, q, 0.0f);
 
-    UfoBuffer *vh = ufo_buffer_dup(r);
+    UfoBuffer *vh = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), r);
 
-    UfoBuffer *tempSum = ufo_buffer_dup(r);
+    UfoBuffer *tempSum = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), r);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, tempSum, 0.0f);
 
-    UfoBuffer *uh = ufo_buffer_dup(u);
-    UfoBuffer *qh = ufo_buffer_dup(u);
+    UfoBuffer *uh = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
+    UfoBuffer *qh = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), u);
     guint maxstagsteps = 3;
     guint iterationNum;
 
@@ -480,8 +662,8 @@ cgs(UfoIrSbtvTask *self,
         }
 
         if(iterationNum == 0) {
-            ufo_buffer_copy(r, u);
-            ufo_buffer_copy(u, p);
+            ufo_ir_profiler_copy(r, u);
+            ufo_ir_profiler_copy(u, p);
         }
         else {
             gfloat beta = rho / rho1;
@@ -495,7 +677,7 @@ cgs(UfoIrSbtvTask *self,
             ufo_ir_basic_ops_processor_add2(priv->bo_processor, u, tempSum, beta, p);
         }
 
-        ufo_buffer_copy(p, ph);
+        ufo_ir_profiler_copy(p, ph);
 
         processA(self, ph, vh, sino);
 
@@ -553,7 +735,7 @@ cgs(UfoIrSbtvTask *self,
 
         if(normr_act < normmin) {
             normmin = normr_act;
-            ufo_buffer_copy(x, xmin);
+            ufo_ir_profiler_copy(x, xmin);
 
         }
 
@@ -567,7 +749,7 @@ cgs(UfoIrSbtvTask *self,
         processA(self, xmin, tmpa, sino);
         ufo_ir_basic_ops_processor_deduction(priv->bo_processor, b, tmpa, r);
         if(ufo_ir_basic_ops_processor_l2_norm(priv->bo_processor, r) <= normr_act){
-            ufo_buffer_copy(xmin, x);
+            ufo_ir_profiler_copy(xmin, x);
         }
     }
 
@@ -584,6 +766,95 @@ cgs(UfoIrSbtvTask *self,
     g_object_unref(tmpa);
 }
 
+static guint
+pcg(UfoIrSbtvTask *self,
+    UfoBuffer *b,
+    UfoBuffer *x,
+    UfoBuffer *x0,
+    guint maxIter,
+    gfloat tol,
+    UfoBuffer *inv_diag,
+    UfoBuffer *sino)
+{
+    UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
+    UfoIrBasicOpsProcessor *ops = priv->bo_processor;
+    guint iterationNum;
+
+    gfloat tolb = tol * ufo_ir_basic_ops_processor_l2_norm(ops, b);
+
+    ufo_ir_profiler_copy(x0, x);
+
+    // r = b - A * x
+    UfoBuffer *r = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), b);
+    processA(self, x, r, sino);
+    ufo_ir_basic_ops_processor_deduction(ops, b, r, r);
+
+    // z = M^-1 * r, p = z
+    UfoBuffer *z = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), b);
+    ufo_ir_basic_ops_processor_mul(ops, r, inv_diag, z);
+    UfoBuffer *p = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), b);
+    ufo_ir_profiler_copy(z, p);
+    UfoBuffer *q = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), b);
+
+    gfloat rz = ufo_ir_basic_ops_processor_dot_product(ops, r, z);
+
+    for (iterationNum = 0; iterationNum < maxIter; ++iterationNum) {
+        if (ufo_ir_basic_ops_processor_l2_norm(ops, r) <= tolb)
+            break;
+
+        // The only operator application of the iteration
+        processA(self, p, q, sino);
+
+        gfloat pq = ufo_ir_basic_ops_processor_dot_product(ops, p, q);
+
+        if (pq <= 0 || isinf(pq) || isnan(pq))
+            break;
+
+        gfloat alpha = rz / pq;
+        ufo_ir_basic_ops_processor_add2(ops, x, p, alpha, x);
+        ufo_ir_basic_ops_processor_add2(ops, r, q, -alpha, r);
+
+        ufo_ir_basic_ops_processor_mul(ops, r, inv_diag, z);
+        gfloat rz_next = ufo_ir_basic_ops_processor_dot_product(ops, r, z);
+
+        // p = z + beta * p
+        ufo_ir_basic_ops_processor_add2(ops, z, p, rz_next / rz, p);
+        rz = rz_next;
+    }
+
+    g_object_unref(r);
+    g_object_unref(z);
+    g_object_unref(p);
+    g_object_unref(q);
+
+    return iterationNum;
+}
+
+static void
+jacobi_preconditioner(UfoIrSbtvTask *self,
+                      UfoBuffer *sino,
+                      UfoBuffer *inv_diag)
+{
+    UfoIrSbtvTaskPrivate *priv = UFO_IR_SBTV_TASK_GET_PRIVATE (self);
+    UfoIrStateDependentTask *projector = UFO_IR_STATE_DEPENDENT_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(self)));
+
+    // The interpolation weights of A are at most one, so the column sums
+    // A^T 1 bound diag(A^T A) from above. Each of Dxt Dx and Dyt Dy adds 2
+    // to the diagonal.
+    UfoBuffer *ones = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), sino);
+    ufo_ir_basic_ops_processor_set(priv->bo_processor, ones, 1.0f);
+    ufo_ir_basic_ops_processor_set(priv->bo_processor, inv_diag, 0.0f);
+    ufo_ir_state_dependent_task_backward(projector, &ones, inv_diag, NULL);
+
+    UfoBuffer *regularization = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), inv_diag);
+    ufo_ir_basic_ops_processor_set(priv->bo_processor, regularization, 4.0f * priv->lambda);
+    ufo_ir_basic_ops_processor_add2(priv->bo_processor, regularization, inv_diag, priv->mu, inv_diag);
+    ufo_ir_basic_ops_processor_inv(priv->bo_processor, inv_diag);
+
+    g_object_unref(ones);
+    g_object_unref(regularization);
+}
+
 static void
 processA(UfoIrSbtvTask *self,
          UfoBuffer *in,
@@ -600,10 +871,10 @@ processA(UfoIrSbtvTask *self,
     ufo_ir_basic_ops_processor_set(priv->bo_processor, out, 0.0f);
 
     // mu * At(A(z))
-    UfoBuffer *tempA = ufo_buffer_dup(sino);
+    UfoBuffer *tempA = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), sino);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, tempA, 0.0f);
 
-    UfoBuffer *tempAt = ufo_buffer_dup(in);
+    UfoBuffer *tempAt = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), in);
     ufo_ir_basic_ops_processor_set(priv->bo_processor, tempAt, 0.0f);
 
     ufo_ir_state_dependent_task_forward(projector, &in, tempA, NULL);
@@ -611,13 +882,13 @@ processA(UfoIrSbtvTask *self,
     ufo_ir_basic_ops_processor_mul_scalar(priv->bo_processor, tempAt, priv->mu);
 
     // DYT(DY(z))
-    UfoBuffer *tempD = ufo_buffer_dup(in);
+    UfoBuffer *tempD = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), in);
     ufo_ir_gradient_processor_dy_op(priv->gradient_processor, in, tempD);
     ufo_ir_gradient_processor_dyt_op(priv->gradient_processor, tempD, out);
 
     // DXT(DX(z))
     ufo_ir_gradient_processor_dx_op(priv->gradient_processor, in, tempD);
-    UfoBuffer *tempDxt = ufo_buffer_dup(in);
+    UfoBuffer *tempDxt = ufo_ir_method_task_dup_buffer(UFO_IR_METHOD_TASK(self), in);
     ufo_ir_gradient_processor_dxt_op(priv->gradient_processor, tempD, tempDxt);
 
     // DYT + DXT
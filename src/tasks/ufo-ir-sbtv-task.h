@@ -55,6 +55,15 @@ void   ufo_ir_sbtv_task_set_mu(UfoIrSbtvTask *self, gfloat value);
 gfloat ufo_ir_sbtv_task_get_lambda(UfoIrSbtvTask *self);
 void   ufo_ir_sbtv_task_set_lambda(UfoIrSbtvTask *self, gfloat value);
 
+const gchar *ufo_ir_sbtv_task_get_solver(UfoIrSbtvTask *self);
+void         ufo_ir_sbtv_task_set_solver(UfoIrSbtvTask *self, const gchar *value);
+
+guint  ufo_ir_sbtv_task_get_inner_iterations(UfoIrSbtvTask *self);
+void   ufo_ir_sbtv_task_set_inner_iterations(UfoIrSbtvTask *self, guint value);
+
+gfloat ufo_ir_sbtv_task_get_inner_tolerance(UfoIrSbtvTask *self);
+void   ufo_ir_sbtv_task_set_inner_tolerance(UfoIrSbtvTask *self, gfloat value);
+
 G_END_DECLS
 
 #endif
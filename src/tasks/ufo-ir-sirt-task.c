@@ -23,14 +23,32 @@
 #include <CL/cl.h>
 #endif
 
+#include <string.h>
 #include "ufo-ir-sirt-task.h"
 #include "core/ufo-ir-basic-ops.h"
+#include "core/ufo-ir-profiler.h"
 
 static void ufo_ir_sirt_task_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
 static void ufo_ir_sirt_task_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
 static void ufo_task_interface_init (UfoTaskIface *iface);
 static void ufo_ir_sirt_task_setup (UfoTask *task, UfoResources *resources, GError **error);
+static void ufo_ir_sirt_task_dispose (GObject *object);
 static gboolean ufo_ir_sirt_task_process (UfoTask *task, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+static gboolean ufo_ir_sirt_task_refine (UfoIrMethodTask *method, UfoBuffer **inputs, UfoBuffer *output, UfoRequisition *requisition);
+
+// Workspace kept between calls as long as the geometry does not change
+typedef struct {
+    UfoIrProjectorTask *projector;
+    UfoRequisition sino_req;
+    UfoRequisition volume_req;
+    UfoBuffer *sino_tmp;
+    UfoBuffer *volume_tmp;
+    UfoBuffer *ray_weights;
+    UfoBuffer *pixel_weights;
+} Workspace;
+
+static Workspace *prepare_workspace (UfoIrSirtTask *self, UfoBuffer *sinogram, UfoBuffer *volume, UfoRequisition *requisition, cl_command_queue cmd_queue);
+static void release_workspace (Workspace *ws);
 
 struct _UfoIrSirtTaskPrivate {
     gfloat relaxation_factor;
@@ -38,6 +56,9 @@ struct _UfoIrSirtTaskPrivate {
     gpointer op_inv_kernel;
     gpointer op_add_kernel;
     gpointer op_mul_kernel;
+
+    // One per concurrent slice
+    Workspace workspaces[UFO_IR_METHOD_TASK_MAX_LANES];
 };
 
 G_DEFINE_TYPE_WITH_CODE (UfoIrSirtTask, ufo_ir_sirt_task, UFO_IR_TYPE_METHOD_TASK,
@@ -68,6 +89,11 @@ ufo_ir_sirt_task_class_init (UfoIrSirtTaskClass *klass)
 
     oclass->set_property = ufo_ir_sirt_task_set_property;
     oclass->get_property = ufo_ir_sirt_task_get_property;
+    oclass->dispose = ufo_ir_sirt_task_dispose;
+
+    UFO_IR_METHOD_TASK_CLASS (klass)->refine = ufo_ir_sirt_task_refine;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_volumes = 3;
+    UFO_IR_METHOD_TASK_CLASS (klass)->n_sinograms = 3;
 
     properties[PROP_RELAXATION_FACTOR] =
             g_param_spec_float("relaxation_factor",
@@ -87,6 +113,18 @@ ufo_ir_sirt_task_init(UfoIrSirtTask *self)
 {
     self->priv = UFO_IR_SIRT_TASK_GET_PRIVATE(self);
     self->priv->relaxation_factor = 0.25;
+    memset (self->priv->workspaces, 0, sizeof (self->priv->workspaces));
+}
+
+static void
+ufo_ir_sirt_task_dispose (GObject *object)
+{
+    UfoIrSirtTaskPrivate *priv = UFO_IR_SIRT_TASK_GET_PRIVATE (object);
+
+    for (guint i = 0; i < UFO_IR_METHOD_TASK_MAX_LANES; i++)
+        release_workspace (&priv->workspaces[i]);
+
+    G_OBJECT_CLASS (ufo_ir_sirt_task_parent_class)->dispose (object);
 }
 
 static void
@@ -153,6 +191,7 @@ ufo_ir_sirt_task_setup (UfoTask      *task,
     ufo_task_node_set_proc_node(UFO_TASK_NODE(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), ufo_task_node_get_proc_node(UFO_TASK_NODE(task)));
 
     ufo_task_setup(UFO_TASK(ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task))), resources, error);
+    ufo_ir_method_task_setup_preview(UFO_IR_METHOD_TASK(task), resources, error);
     UfoIrSirtTaskPrivate *priv = UFO_IR_SIRT_TASK_GET_PRIVATE (task);
     priv->op_set_kernel = ufo_ir_op_set_generate_kernel(resources);
     priv->op_inv_kernel = ufo_ir_op_inv_generate_kernel(resources);
@@ -160,6 +199,67 @@ ufo_ir_sirt_task_setup (UfoTask      *task,
     priv->op_mul_kernel = ufo_ir_op_mul_generate_kernel(resources);
 }
 
+static void
+release_workspace (Workspace *ws)
+{
+    UfoBuffer **buffers[] = {&ws->sino_tmp, &ws->volume_tmp, &ws->ray_weights, &ws->pixel_weights};
+
+    for (guint i = 0; i < G_N_ELEMENTS (buffers); i++) {
+        if (*buffers[i] != NULL) {
+            g_object_unref (*buffers[i]);
+            *buffers[i] = NULL;
+        }
+    }
+
+    ws->projector = NULL;
+}
+
+static Workspace *
+prepare_workspace (UfoIrSirtTask *self,
+                   UfoBuffer *sinogram,
+                   UfoBuffer *volume,
+                   UfoRequisition *requisition,
+                   cl_command_queue cmd_queue)
+{
+    UfoIrSirtTaskPrivate *priv = UFO_IR_SIRT_TASK_GET_PRIVATE (self);
+    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(self));
+    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK(projector);
+    Workspace *ws = &priv->workspaces[ufo_ir_method_task_get_lane (UFO_IR_METHOD_TASK(self))];
+
+    if (ws->ray_weights != NULL &&
+        ws->projector == projector &&
+        !ufo_buffer_cmp_dimensions (sinogram, &ws->sino_req) &&
+        !ufo_buffer_cmp_dimensions (volume, &ws->volume_req)) {
+        return ws;
+    }
+
+    release_workspace (ws);
+    ws->projector = projector;
+    ufo_buffer_get_requisition (sinogram, &ws->sino_req);
+    ufo_buffer_get_requisition (volume, &ws->volume_req);
+
+    ufo_ir_projector_task_set_relaxation(projector, 1.0f);
+    ufo_ir_projector_task_set_correction_scale(projector, 1.0f);
+
+    // calculate Ray waights
+    ws->volume_tmp = ufo_buffer_dup (volume);
+    ufo_ir_op_set (ws->volume_tmp,  1.0f, cmd_queue, priv->op_set_kernel);
+    ws->ray_weights = ufo_buffer_dup (sinogram);
+    ufo_ir_op_set (ws->ray_weights, 0.0f, cmd_queue, priv->op_set_kernel);
+    ufo_ir_state_dependent_task_forward(sdprojector, &ws->volume_tmp, ws->ray_weights, requisition);
+    ufo_ir_op_inv (ws->ray_weights, cmd_queue, priv->op_inv_kernel);
+
+    // Calculate pixel weights
+    ws->sino_tmp = ufo_buffer_dup (sinogram);
+    ufo_ir_op_set (ws->sino_tmp, 1.0f, cmd_queue, priv->op_set_kernel);
+    ws->pixel_weights = ufo_buffer_dup (volume);
+    ufo_ir_op_set (ws->pixel_weights, 0.0f, cmd_queue, priv->op_set_kernel);
+    ufo_ir_state_dependent_task_backward(sdprojector, &ws->sino_tmp, ws->pixel_weights, requisition);
+    ufo_ir_op_inv (ws->pixel_weights, cmd_queue, priv->op_inv_kernel);
+
+    return ws;
+}
+
 static gboolean
 ufo_ir_sirt_task_process (UfoTask *task,
                           UfoBuffer **inputs,
@@ -167,56 +267,70 @@ ufo_ir_sirt_task_process (UfoTask *task,
                           UfoRequisition *requisition)
 {
     UfoIrSirtTaskPrivate *priv = UFO_IR_SIRT_TASK_GET_PRIVATE (task);
-    UfoGpuNode *node = UFO_GPU_NODE (ufo_task_node_get_proc_node (UFO_TASK_NODE(task)));
-    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue (node);
 
-    // Get and setup projector
-    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(UFO_IR_METHOD_TASK(task));
-    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK(projector);
-    ufo_ir_projector_task_set_relaxation(projector, 1.0f);
-    ufo_ir_projector_task_set_correction_scale(projector, 1.0f);
+    ufo_ir_method_task_profile_slice (UFO_IR_METHOD_TASK(task));
 
-    // calculate Ray waights
-    UfoBuffer *volume_tmp = ufo_buffer_dup (output);
-    ufo_ir_op_set (volume_tmp,  1.0f, cmd_queue, priv->op_set_kernel);
-    UfoBuffer *ray_weights   = ufo_buffer_dup (inputs[0]);
-    ufo_ir_op_set (ray_weights, 0.0f, cmd_queue, priv->op_set_kernel);
-    ufo_ir_state_dependent_task_forward(sdprojector, &volume_tmp, ray_weights, requisition);
-    ufo_ir_op_inv (ray_weights, cmd_queue, priv->op_inv_kernel);
+    if (ufo_ir_method_task_run_preview (UFO_IR_METHOD_TASK(task), inputs, output, requisition))
+        return TRUE;
 
-    // Calculate pixel weights
-    UfoBuffer *sino_tmp = ufo_buffer_dup (inputs[0]);
-    ufo_ir_op_set (sino_tmp, 1.0f, cmd_queue, priv->op_set_kernel);
-    UfoBuffer *pixel_weights = ufo_buffer_dup (output);
-    ufo_ir_op_set (pixel_weights, 0.0f, cmd_queue, priv->op_set_kernel);
-    ufo_ir_state_dependent_task_backward(sdprojector, &sino_tmp, pixel_weights, requisition);
-    ufo_ir_op_inv (pixel_weights, cmd_queue, priv->op_inv_kernel);
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_ir_method_task_next_lane (UFO_IR_METHOD_TASK(task));
+
+    inputs = ufo_ir_method_task_stage_inputs (UFO_IR_METHOD_TASK(task), inputs);
+    ufo_ir_op_set(output, 0.0f, cmd_queue, priv->op_set_kernel);
+
+    gboolean result = ufo_ir_sirt_task_refine (UFO_IR_METHOD_TASK(task), inputs, output, requisition);
+    ufo_ir_method_task_publish_output (UFO_IR_METHOD_TASK(task), output);
+    return result;
+}
+
+static gboolean
+ufo_ir_sirt_task_refine (UfoIrMethodTask *method,
+                         UfoBuffer **inputs,
+                         UfoBuffer *output,
+                         UfoRequisition *requisition)
+{
+    UfoIrSirtTaskPrivate *priv = UFO_IR_SIRT_TASK_GET_PRIVATE (method);
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_ir_method_task_get_cmd_queue (method);
+    Workspace *ws = prepare_workspace (UFO_IR_SIRT_TASK(method), inputs[0], output, requisition, cmd_queue);
 
+    // Get and setup projector
+    UfoIrProjectorTask *projector = ufo_ir_method_task_get_projector(method);
+    UfoIrStateDependentTask *sdprojector = UFO_IR_STATE_DEPENDENT_TASK(projector);
     ufo_ir_projector_task_set_relaxation(projector, priv->relaxation_factor);
     ufo_ir_projector_task_set_correction_scale(projector, -1.0f);
-    ufo_ir_op_set(output, 0.0f, cmd_queue, priv->op_set_kernel);
 
-    // do SIRT
+    UfoBuffer *sino_tmp = ws->sino_tmp;
+    UfoBuffer *volume_tmp = ws->volume_tmp;
+
+    // do SIRT starting from the current content of output
     guint iteration = 0;
-    guint max_iterations = ufo_ir_method_task_get_iterations_number(UFO_IR_METHOD_TASK(task));
+    guint max_iterations = ufo_ir_method_task_get_iterations_number(method);
     while (iteration < max_iterations) {
-        ufo_buffer_copy (inputs[0], sino_tmp);
+        ufo_ir_method_task_profile_scope (method, iteration, -1);
+        gboolean telemetry = ufo_ir_method_task_telemetry_begin (method);
+        ufo_ir_profiler_copy (inputs[0], sino_tmp);
 
         ufo_ir_state_dependent_task_forward(sdprojector, &output, sino_tmp, requisition);
 
-        ufo_ir_op_mul (sino_tmp, ray_weights, sino_tmp, cmd_queue, priv->op_mul_kernel);
+        ufo_ir_op_mul (sino_tmp, ws->ray_weights, sino_tmp, cmd_queue, priv->op_mul_kernel);
+
+        // sino_tmp holds the ray weighted residual b - Ax of this iteration
+        if (telemetry)
+            ufo_ir_method_task_telemetry_record (method, "weighted_residual", ufo_ir_op_l1_norm (sino_tmp, cmd_queue));
+
         ufo_ir_op_set (volume_tmp, 0, cmd_queue, priv->op_set_kernel);
         ufo_ir_state_dependent_task_backward(sdprojector, &sino_tmp, volume_tmp, requisition);
 
-        ufo_ir_op_mul (volume_tmp, pixel_weights, volume_tmp, cmd_queue, priv->op_mul_kernel);
+        ufo_ir_op_mul (volume_tmp, ws->pixel_weights, volume_tmp, cmd_queue, priv->op_mul_kernel);
         ufo_ir_op_add (volume_tmp, output, output, cmd_queue, priv->op_add_kernel);
 
+        ufo_ir_method_task_telemetry_end (method, iteration);
+
+        if (!ufo_ir_method_task_emit (method, output, iteration))
+            break;
+
         iteration++;
     }
 
-    g_object_unref(sino_tmp);
-    g_object_unref(volume_tmp);
-    g_object_unref(pixel_weights);
-    g_object_unref(ray_weights);
     return TRUE;
 }